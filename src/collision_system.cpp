@@ -0,0 +1,267 @@
+#include "collision_system.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Gap left between a box and whatever stopped it, so the next sweep does not
+// start in contact
+const float SKIN = 0.001f;
+
+// Terrain columns reach down to here
+const float COLUMN_BOTTOM = -10000.0f;
+
+// Contacts whose normal points at least this far up count as ground
+const float GROUND_NORMAL_Y = 0.7f;
+
+float component(const Vec3& v, int axis) {
+    return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+// Sweeps box [min, max] along d against a static box. On a hit before the
+// end of the move, 'time' is the fraction of d travelled and 'axis' the axis
+// of the face that was hit. Boxes that already overlap are ignored so that
+// anything stuck can move out again.
+bool sweepBoxes(const Vec3& min, const Vec3& max, const Vec3& d,
+                const Vec3& otherMin, const Vec3& otherMax, float& time, int& axis) {
+    float tEnter = -1.0f;
+    float tExit = 1.0f;
+    axis = -1;
+    
+    for (int i = 0; i < 3; i++) {
+        float move = component(d, i);
+        float lo = component(min, i);
+        float hi = component(max, i);
+        float otherLo = component(otherMin, i);
+        float otherHi = component(otherMax, i);
+        
+        if (move == 0.0f) {
+            // Touching faces do not block motion along them
+            if (hi <= otherLo || lo >= otherHi) return false;
+            continue;
+        }
+        
+        float entry = (move > 0.0f ? otherLo - hi : otherHi - lo) / move;
+        float exit = (move > 0.0f ? otherHi - lo : otherLo - hi) / move;
+        if (entry > tEnter) {
+            tEnter = entry;
+            axis = i;
+        }
+        tExit = std::min(tExit, exit);
+    }
+    
+    if (axis < 0 || tEnter < 0.0f || tEnter > tExit || tEnter > 1.0f) return false;
+    time = tEnter;
+    return true;
+}
+
+Vec3 axisNormal(int axis, const Vec3& d) {
+    Vec3 normal = Vec3::zero();
+    float sign = component(d, axis) > 0.0f ? -1.0f : 1.0f;
+    if (axis == 0) normal.x = sign;
+    else if (axis == 1) normal.y = sign;
+    else normal.z = sign;
+    return normal;
+}
+
+}  // namespace
+
+CollisionSystem::CollisionSystem(const World& world, const Settings& settings)
+    : world(world)
+    , settings(settings)
+    , bucketMask(0)
+{
+}
+
+uint32_t CollisionSystem::bucketOf(int cellX, int cellZ) const {
+    uint32_t hash = static_cast<uint32_t>(cellX) * 73856093u ^ static_cast<uint32_t>(cellZ) * 19349663u;
+    return hash & bucketMask;
+}
+
+void CollisionSystem::rebuild(const std::vector<Entity*>& entities) {
+    proxies.clear();
+    entries.clear();
+    
+    for (Entity* entity : entities) {
+        if (!entity || !entity->isActive()) continue;
+        
+        Entity::BoundingBox box = entity->getBoundingBox();
+        int proxy = static_cast<int>(proxies.size());
+        proxies.push_back({ entity, box.min, box.max });
+        
+        for (int cellZ = cellCoord(box.min.z); cellZ <= cellCoord(box.max.z); cellZ++) {
+            for (int cellX = cellCoord(box.min.x); cellX <= cellCoord(box.max.x); cellX++) {
+                entries.push_back({ proxy, cellX, cellZ });
+            }
+        }
+    }
+    
+    // About two buckets per entry keeps hash collisions between cells rare
+    uint32_t bucketCount = 16;
+    while (bucketCount < entries.size() * 2) bucketCount *= 2;
+    bucketMask = bucketCount - 1;
+    
+    // Counting sort of the entries by bucket
+    bucketStarts.assign(bucketCount + 1, 0);
+    for (const CellEntry& entry : entries) {
+        bucketStarts[bucketOf(entry.cellX, entry.cellZ) + 1]++;
+    }
+    for (uint32_t bucket = 0; bucket < bucketCount; bucket++) {
+        bucketStarts[bucket + 1] += bucketStarts[bucket];
+    }
+    
+    std::vector<CellEntry> sorted(entries.size());
+    std::vector<uint32_t> cursor(bucketStarts.begin(), bucketStarts.end() - 1);
+    for (const CellEntry& entry : entries) {
+        sorted[cursor[bucketOf(entry.cellX, entry.cellZ)]++] = entry;
+    }
+    entries.swap(sorted);
+}
+
+template <typename Fn>
+void CollisionSystem::forEachCandidate(const Vec3& min, const Vec3& max, Fn&& fn) const {
+    if (entries.empty()) return;
+    
+    for (int cellZ = cellCoord(min.z); cellZ <= cellCoord(max.z); cellZ++) {
+        for (int cellX = cellCoord(min.x); cellX <= cellCoord(max.x); cellX++) {
+            uint32_t bucket = bucketOf(cellX, cellZ);
+            for (uint32_t i = bucketStarts[bucket]; i < bucketStarts[bucket + 1]; i++) {
+                const CellEntry& entry = entries[i];
+                if (entry.cellX != cellX || entry.cellZ != cellZ) continue;
+                
+                const Proxy& proxy = proxies[entry.proxy];
+                if (proxy.max.x < min.x || proxy.min.x > max.x ||
+                    proxy.max.z < min.z || proxy.min.z > max.z) {
+                    continue;
+                }
+                
+                // A proxy spanning several cells is reported only from the
+                // cell holding the lower corner of its overlap with the query
+                if (cellCoord(std::max(min.x, proxy.min.x)) != cellX ||
+                    cellCoord(std::max(min.z, proxy.min.z)) != cellZ) {
+                    continue;
+                }
+                fn(entry.proxy);
+            }
+        }
+    }
+}
+
+Vec3 CollisionSystem::sweep(const Entity::BoundingBox& box, const Vec3& displacement, const Entity* ignore,
+                            SweepResult* result) const {
+    SweepResult contact;
+    Vec3 min = box.min;
+    Vec3 max = box.max;
+    
+    // Lift the box out of terrain it starts inside (e.g. after a height edit)
+    float lift = 0.0f;
+    for (int z = static_cast<int>(std::floor(min.z)); z <= static_cast<int>(std::floor(max.z)); z++) {
+        for (int x = static_cast<int>(std::floor(min.x)); x <= static_cast<int>(std::floor(max.x)); x++) {
+            if (!world.isValidPosition(x, z) || x >= max.x || z >= max.z) continue;
+            lift = std::max(lift, world.getTerrainHeight(x, z) - min.y);
+        }
+    }
+    if (lift > 0.0f) {
+        min.y += lift + SKIN;
+        max.y += lift + SKIN;
+        contact.grounded = true;
+    }
+    
+    Vec3 remaining = displacement;
+    for (int slide = 0; slide < settings.maxSlides; slide++) {
+        if (remaining.length() <= SKIN * 0.5f) break;
+        
+        // Everything the box could touch on the way
+        Vec3 sweptMin = Vec3::min(min, min + remaining);
+        Vec3 sweptMax = Vec3::max(max, max + remaining);
+        
+        float hitTime = 2.0f;
+        int hitAxis = -1;
+        Entity* hitEntity = nullptr;
+        float hitColumnTop = 0.0f;
+        Vec3 hitColumn;
+        
+        int x0 = std::max(0, static_cast<int>(std::floor(sweptMin.x)));
+        int x1 = std::min(world.getWidth() - 1, static_cast<int>(std::floor(sweptMax.x)));
+        int z0 = std::max(0, static_cast<int>(std::floor(sweptMin.z)));
+        int z1 = std::min(world.getHeight() - 1, static_cast<int>(std::floor(sweptMax.z)));
+        for (int z = z0; z <= z1; z++) {
+            for (int x = x0; x <= x1; x++) {
+                float top = world.getTerrainHeight(x, z);
+                if (top < sweptMin.y) continue;
+                
+                float time;
+                int axis;
+                if (sweepBoxes(min, max, remaining, Vec3(static_cast<float>(x), COLUMN_BOTTOM, static_cast<float>(z)),
+                               Vec3(static_cast<float>(x + 1), top, static_cast<float>(z + 1)), time, axis) &&
+                    time < hitTime) {
+                    hitTime = time;
+                    hitAxis = axis;
+                    hitEntity = nullptr;
+                    hitColumnTop = top;
+                    hitColumn = Vec3(x + 0.5f, top, z + 0.5f);
+                }
+            }
+        }
+        
+        forEachCandidate(sweptMin, sweptMax, [&](int index) {
+            const Proxy& proxy = proxies[index];
+            if (proxy.entity == ignore) return;
+            
+            float time;
+            int axis;
+            if (sweepBoxes(min, max, remaining, proxy.min, proxy.max, time, axis) && time < hitTime) {
+                hitTime = time;
+                hitAxis = axis;
+                hitEntity = proxy.entity;
+            }
+        });
+        
+        if (hitAxis < 0) {
+            min += remaining;
+            max += remaining;
+            break;
+        }
+        
+        // Climb low terrain steps instead of stopping against them
+        Vec3 normal = axisNormal(hitAxis, remaining);
+        if (!hitEntity && hitAxis != 1 && hitColumnTop - min.y <= settings.stepHeight) {
+            float step = hitColumnTop - min.y + SKIN;
+            min.y += step;
+            max.y += step;
+            continue;
+        }
+        
+        // Advance to just short of the contact
+        float length = remaining.length();
+        float travel = std::max(0.0f, hitTime - SKIN / length);
+        min += remaining * travel;
+        max += remaining * travel;
+        remaining = remaining * (1.0f - travel);
+        
+        // Column tops slide along the interpolated terrain slope; whatever of
+        // that still points into the flat top is dropped
+        Vec3 faceNormal = normal;
+        if (!hitEntity && hitAxis == 1 && normal.y > 0.0f) {
+            normal = world.getTerrainNormal(hitColumn);
+        }
+        remaining = world.projectVelocityOntoSurface(remaining, normal);
+        if (Vec3::dot(remaining, faceNormal) < 0.0f) {
+            remaining = world.projectVelocityOntoSurface(remaining, faceNormal);
+        }
+        
+        contact.collided = true;
+        contact.normal = normal;
+        contact.entity = hitEntity;
+        if (normal.y >= GROUND_NORMAL_Y) contact.grounded = true;
+    }
+    
+    if (result) *result = contact;
+    return min - box.min;
+}
+
+Vec3 CollisionSystem::moveEntity(Entity* entity, const Vec3& displacement, SweepResult* result) const {
+    Vec3 moved = sweep(entity->getBoundingBox(), displacement, entity, result);
+    entity->setPosition(entity->getPosition() + moved);
+    return moved;
+}
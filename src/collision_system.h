@@ -0,0 +1,88 @@
+#pragma once
+
+#include "entity.h"
+#include "math_utils.h"
+#include "world.h"
+#include <cstdint>
+#include <vector>
+
+// CollisionSystem moves boxes through the world without passing through the
+// terrain or entities. Terrain cells are solid columns up to their height,
+// the same model World::raycast uses.
+//
+// Entities are found through a uniform grid over XZ rebuilt by rebuild().
+// Grid cells are hashed into a bucket table sized to the entity count, so a
+// sweep's cost grows with how crowded its neighbourhood is rather than with
+// the total number of entities. Everything but rebuild() only reads, so
+// sweeps can run on several threads at once.
+class CollisionSystem {
+public:
+    struct Settings {
+        float cellSize;       // Broad-phase grid cell side in world units
+        float stepHeight;     // Ledges this high are climbed rather than blocking
+        int maxSlides;        // Collision responses per sweep before giving up
+        
+        Settings()
+            : cellSize(2.0f)
+            , stepHeight(0.55f)
+            , maxSlides(4)
+        {}
+    };
+    
+    struct SweepResult {
+        bool collided;
+        bool grounded;        // Ended up resting on something below
+        Vec3 normal;          // Normal of the last contact
+        Entity* entity;       // Entity of the last contact, null for terrain
+        
+        SweepResult() : collided(false), grounded(false), normal(Vec3::up()), entity(nullptr) {}
+    };
+    
+    explicit CollisionSystem(const World& world, const Settings& settings = Settings());
+    
+    // Snapshot the bounding boxes of the active entities into the grid.
+    // Sweeps see entities where they were at the last rebuild.
+    void rebuild(const std::vector<Entity*>& entities);
+    
+    // Move a box by 'displacement', stopping at contacts and sliding the rest
+    // of the motion along them. Sliding goes through
+    // World::projectVelocityOntoSurface, so motion into a slope follows it.
+    // Boxes climb terrain steps up to stepHeight and are lifted out of terrain
+    // they start inside. Returns the displacement actually applied.
+    Vec3 sweep(const Entity::BoundingBox& box, const Vec3& displacement, const Entity* ignore,
+               SweepResult* result = nullptr) const;
+    
+    // Sweep an entity's bounding box and move it to where the sweep ends
+    Vec3 moveEntity(Entity* entity, const Vec3& displacement, SweepResult* result = nullptr) const;
+    
+    size_t getEntityCount() const { return proxies.size(); }
+
+private:
+    struct Proxy {
+        Entity* entity;
+        Vec3 min;
+        Vec3 max;
+    };
+    
+    // One grid cell a proxy touches; sorted by bucket
+    struct CellEntry {
+        int proxy;
+        int cellX;
+        int cellZ;
+    };
+    
+    int cellCoord(float value) const { return static_cast<int>(std::floor(value / settings.cellSize)); }
+    uint32_t bucketOf(int cellX, int cellZ) const;
+    
+    // Calls fn(proxyIndex) once for each proxy overlapping [min, max] in XZ
+    template <typename Fn>
+    void forEachCandidate(const Vec3& min, const Vec3& max, Fn&& fn) const;
+    
+    const World& world;
+    Settings settings;
+    
+    std::vector<Proxy> proxies;
+    std::vector<CellEntry> entries;
+    std::vector<uint32_t> bucketStarts;   // entries of bucket b are [bucketStarts[b], bucketStarts[b + 1])
+    uint32_t bucketMask;
+};
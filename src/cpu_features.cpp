@@ -0,0 +1,47 @@
+#include "cpu_features.h"
+
+#if defined(FLOWER_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+
+CpuFeatures detectCpuFeatures() {
+    CpuFeatures features;
+    
+#if defined(FLOWER_X86) && defined(_MSC_VER)
+    int info[4] = {0, 0, 0, 0};
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    
+    __cpuid(info, 1);
+    features.sse2 = (info[3] & (1 << 26)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool fma = (info[2] & (1 << 12)) != 0;
+    
+    // The OS must save the wider registers on context switch
+    unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    bool ymmEnabled = (xcr0 & 0x6) == 0x6;
+    bool zmmEnabled = (xcr0 & 0xE6) == 0xE6;
+    
+    if (maxLeaf >= 7) {
+        __cpuidex(info, 7, 0);
+        features.avx2 = ymmEnabled && fma && (info[1] & (1 << 5)) != 0;
+        features.avx512 = zmmEnabled && (info[1] & (1 << 16)) != 0 && (info[1] & (1 << 17)) != 0;
+    }
+#elif defined(FLOWER_X86) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    features.sse2 = __builtin_cpu_supports("sse2");
+    features.avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    features.avx512 = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq");
+#endif
+    
+    return features;
+}
+
+}  // namespace
+
+const CpuFeatures& getCpuFeatures() {
+    static const CpuFeatures features = detectCpuFeatures();
+    return features;
+}
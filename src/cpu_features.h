@@ -0,0 +1,32 @@
+#pragma once
+
+// CPU feature detection for runtime selection of SIMD code paths.
+// Kernels compiled for wider instruction sets are only called when the
+// running processor reports support for them.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define FLOWER_X86 1
+#include <immintrin.h>
+#endif
+
+// Marks a function as compiled for a specific instruction set so that the
+// rest of the program can still be built for the baseline target.
+// MSVC accepts the intrinsics without any attribute.
+#if defined(FLOWER_X86) && (defined(__GNUC__) || defined(__clang__))
+#define FLOWER_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define FLOWER_TARGET_AVX512 __attribute__((target("avx512f,avx512dq")))
+#else
+#define FLOWER_TARGET_AVX2
+#define FLOWER_TARGET_AVX512
+#endif
+
+struct CpuFeatures {
+    bool sse2;
+    bool avx2;
+    bool avx512;
+    
+    CpuFeatures() : sse2(false), avx2(false), avx512(false) {}
+};
+
+// Detected once on first call and cached for the rest of the run
+const CpuFeatures& getCpuFeatures();
@@ -0,0 +1,229 @@
+#include "draw_list.h"
+#include "job_system.h"
+#include "world.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+namespace {
+    // Objects keyed per job
+    const int KEY_BATCH = 4096;
+    
+    // Distance in front of the camera along its view direction
+    float viewDepth(const Mat4& view, const Vec3& point) {
+        return -(view.at(2, 0) * point.x + view.at(2, 1) * point.y + view.at(2, 2) * point.z + view.at(2, 3));
+    }
+}
+
+DrawList::DrawList()
+    : batchCount(0)
+    , materialChangeCount(0)
+{
+}
+
+uint64_t DrawList::makeKey(Pass pass, int mesh, uint32_t material, float depth) {
+    // The bits of a non-negative float sort like its value; the top 24 of
+    // them are plenty to order objects
+    uint32_t depthBits;
+    float clamped = std::max(depth, 0.0f);
+    std::memcpy(&depthBits, &clamped, sizeof(depthBits));
+    depthBits >>= 7;
+    
+    uint64_t key = static_cast<uint64_t>(pass) << 62;
+    if (pass == Pass::BLENDED) {
+        key |= static_cast<uint64_t>(~depthBits & 0xFFFFFF) << 38;
+        key |= static_cast<uint64_t>(mesh) << 32;
+        key |= material;
+    } else {
+        key |= static_cast<uint64_t>(mesh) << 56;
+        key |= static_cast<uint64_t>(material) << 24;
+        key |= depthBits;
+    }
+    return key;
+}
+
+DrawList::Pass DrawList::getPass(uint64_t key) {
+    return static_cast<Pass>(key >> 62);
+}
+
+int DrawList::getMesh(uint64_t key) {
+    if (getPass(key) == Pass::BLENDED) return static_cast<int>((key >> 32) & 0x3F);
+    return static_cast<int>((key >> 56) & 0x3F);
+}
+
+uint32_t DrawList::getMaterial(uint64_t key) {
+    if (getPass(key) == Pass::BLENDED) return static_cast<uint32_t>(key);
+    return static_cast<uint32_t>(key >> 24);
+}
+
+void DrawList::build(const RenderScene& scene) {
+    const std::vector<RenderScene::Instance>& instances = scene.getInstances();
+    const std::vector<RenderScene::Line>& lines = scene.getLines();
+    const Mat4& view = scene.getView();
+    
+    // Instances, lines, then triangles; each job fills its own slots
+    const std::vector<RenderScene::Triangle>& triangles = scene.getTriangles();
+    size_t instanceCount = instances.size();
+    size_t lineEnd = instanceCount + lines.size();
+    commands.resize(lineEnd + triangles.size());
+    int batches = static_cast<int>((commands.size() + KEY_BATCH - 1) / KEY_BATCH);
+    JobSystem::instance().parallelFor(0, batches, 1, [&](int first, int last) {
+        size_t end = std::min(commands.size(), static_cast<size_t>(last) * KEY_BATCH);
+        for (size_t i = static_cast<size_t>(first) * KEY_BATCH; i < end; i++) {
+            Command& command = commands[i];
+            if (i < instanceCount) {
+                const RenderScene::Instance& instance = instances[i];
+                Pass pass = instance.color.a < 1.0f ? Pass::BLENDED : Pass::SOLID;
+                command.key = makeKey(pass, static_cast<int>(instance.mesh), MathUtils::packColorRGBA8(instance.color),
+                                      viewDepth(view, instance.position));
+                command.index = static_cast<uint32_t>(i);
+            } else if (i < lineEnd) {
+                const RenderScene::Line& line = lines[i - instanceCount];
+                Pass pass = line.color.a < 1.0f ? Pass::BLENDED : Pass::SOLID;
+                command.key = makeKey(pass, LINE_MESH, MathUtils::packColorRGBA8(line.color),
+                                      viewDepth(view, (line.start + line.end) * 0.5f));
+                command.index = static_cast<uint32_t>(i - instanceCount);
+            } else {
+                const RenderScene::Triangle& triangle = triangles[i - lineEnd];
+                Pass pass = triangle.color.a < 1.0f ? Pass::BLENDED : Pass::SOLID;
+                Vec3 centre = (triangle.corners[0] + triangle.corners[1] + triangle.corners[2]) * (1.0f / 3.0f);
+                command.key = makeKey(pass, TRIANGLE_MESH, MathUtils::packColorRGBA8(triangle.color), viewDepth(view, centre));
+                command.index = static_cast<uint32_t>(i - lineEnd);
+            }
+        }
+    });
+    
+    // Least significant byte first radix sort. It is stable, so equal keys
+    // keep their recording order, and bytes every key shares are skipped.
+    uint64_t differing = 0;
+    for (const Command& command : commands) {
+        differing |= command.key ^ commands[0].key;
+    }
+    sortBuffer.resize(commands.size());
+    for (int shift = 0; shift < 64; shift += 8) {
+        if (((differing >> shift) & 0xFF) == 0) continue;
+        
+        size_t offsets[256] = {};
+        for (const Command& command : commands) {
+            offsets[(command.key >> shift) & 0xFF]++;
+        }
+        size_t total = 0;
+        for (size_t& offset : offsets) {
+            size_t count = offset;
+            offset = total;
+            total += count;
+        }
+        for (const Command& command : commands) {
+            sortBuffer[offsets[(command.key >> shift) & 0xFF]++] = command;
+        }
+        commands.swap(sortBuffer);
+    }
+    
+    countStateChanges();
+}
+
+void DrawList::countStateChanges() {
+    batchCount = 0;
+    materialChangeCount = 0;
+    for (size_t i = 0; i < commands.size(); i++) {
+        uint64_t key = commands[i].key;
+        bool newBatch = i == 0
+            || getPass(key) != getPass(commands[i - 1].key)
+            || (getMesh(key) == LINE_MESH) != (getMesh(commands[i - 1].key) == LINE_MESH);
+        if (newBatch) batchCount++;
+        if (newBatch || getMaterial(key) != getMaterial(commands[i - 1].key)) materialChangeCount++;
+    }
+}
+
+bool DrawList::runBenchmark() {
+    const int WORLD_SIDE = 256;
+    const int FRAMES = 20;
+    
+    // A flower field recorded the way Engine::renderWorld does, with one
+    // flower head in ten translucent
+    World world(WORLD_SIDE, WORLD_SIDE);
+    world.generateHillyTerrain(8.0f, 0.05f);
+    std::mt19937 rng(17);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    RenderScene scene;
+    Vec3 eye(WORLD_SIDE * 0.5f, 20.0f, -8.0f);
+    scene.setCamera(Mat4::lookAt(eye, Vec3(WORLD_SIDE * 0.5f, 0.0f, WORLD_SIDE * 0.5f), Vec3::up()),
+                    Mat4::perspective(60.0f, 800.0f / 600.0f, 0.1f, 100.0f));
+    for (int i = 0; i <= WORLD_SIDE; i += 5) {
+        scene.addLine(Vec3(i, 0.01f, 0), Vec3(i, 0.01f, WORLD_SIDE), Color(0.2f, 0.5f, 0.2f));
+        scene.addLine(Vec3(0, 0.01f, i), Vec3(WORLD_SIDE, 0.01f, i), Color(0.2f, 0.5f, 0.2f));
+    }
+    for (int z = 0; z < WORLD_SIDE; z++) {
+        for (int x = 0; x < WORLD_SIDE; x++) {
+            Vec3 cellPos(x + 0.5f, world.getTerrainHeight(x, z), z + 0.5f);
+            scene.addCube(cellPos, World::getCellTypeColor(World::CellType::GRASS) * (0.8f + 0.2f * unit(rng)), 1.0f);
+            if (unit(rng) < 0.3f) {
+                Color flowerColor = World::getFlowerSpeciesColor(World::getFlowerSpecies(x, z));
+                if (unit(rng) < 0.1f) flowerColor.a = 0.6f;
+                scene.addFlower(cellPos + Vec3(0.0f, 0.5f, 0.0f), flowerColor, 0.3f);
+            }
+        }
+    }
+    
+    // What drawing in recording order costs: instances, then lines
+    int recordedBatches = 0;
+    int recordedChanges = 0;
+    bool previousBlended = false;
+    uint32_t previousMaterial = 0;
+    for (size_t i = 0; i < scene.getInstances().size(); i++) {
+        const Color& color = scene.getInstances()[i].color;
+        bool blended = color.a < 1.0f;
+        if (i == 0 || blended != previousBlended) recordedBatches++;
+        if (i == 0 || MathUtils::packColorRGBA8(color) != previousMaterial) recordedChanges++;
+        previousBlended = blended;
+        previousMaterial = MathUtils::packColorRGBA8(color);
+    }
+    recordedBatches++;
+    recordedChanges++;
+    
+    DrawList drawList;
+    drawList.build(scene);
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    for (int frame = 0; frame < FRAMES; frame++) {
+        drawList.build(scene);
+    }
+    double buildMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / FRAMES;
+    
+    // Every object exactly once, keys ascending, solid before blended, and
+    // blended objects back to front
+    const std::vector<Command>& commands = drawList.getCommands();
+    std::vector<bool> seenInstances(scene.getInstances().size(), false);
+    std::vector<bool> seenLines(scene.getLines().size(), false);
+    bool valid = commands.size() == seenInstances.size() + seenLines.size();
+    float previousDepth = 0.0f;
+    size_t blendedCount = 0;
+    for (size_t i = 0; i < commands.size() && valid; i++) {
+        const Command& command = commands[i];
+        bool line = getMesh(command.key) == LINE_MESH;
+        std::vector<bool>& seen = line ? seenLines : seenInstances;
+        if (command.index >= seen.size() || seen[command.index]) valid = false;
+        else seen[command.index] = true;
+        if (i > 0 && command.key < commands[i - 1].key) valid = false;
+        
+        if (getPass(command.key) == Pass::BLENDED && valid) {
+            const RenderScene::Instance& instance = scene.getInstances()[command.index];
+            float depth = viewDepth(scene.getView(), instance.position);
+            // Depths in the key are rounded to 16 mantissa bits
+            if (blendedCount > 0 && depth > previousDepth * (1.0f + 1e-4f)) valid = false;
+            previousDepth = depth;
+            blendedCount++;
+        }
+    }
+    
+    std::cout << "Draw list: " << commands.size() << " commands (" << blendedCount << " blended), "
+              << JobSystem::instance().getWorkerCount() + 1 << " threads" << std::endl;
+    std::cout << "  build and sort     " << buildMs << " ms" << std::endl;
+    std::cout << "  recording order    " << recordedBatches << " batches, " << recordedChanges << " colour changes" << std::endl;
+    std::cout << "  sorted             " << drawList.getBatchCount() << " batches, "
+              << drawList.getMaterialChangeCount() << " colour changes" << std::endl;
+    std::cout << "  order              " << (valid ? "valid" : "INVALID") << std::endl;
+    return valid;
+}
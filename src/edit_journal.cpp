@@ -0,0 +1,516 @@
+#include "edit_journal.h"
+#include "file_sync.h"
+#include "logger.h"
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+
+namespace {
+
+const uint32_t JOURNAL_MAGIC = 0x4C4E4A46;  // "FJNL"
+const uint32_t JOURNAL_VERSION = 2;
+const uint32_t BATCH_MAGIC = 0x48435442;    // "BTCH"
+
+struct JournalHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t snapshot;   // Number of the snapshot the records apply to
+    uint32_t reserved;
+};
+
+struct BatchHeader {
+    uint32_t magic;
+    uint32_t recordCount;
+    uint32_t checksum;
+    uint32_t reserved;
+};
+
+// FNV-1a, enough to spot a batch torn by a crash mid-write
+uint32_t checksum(const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+}  // namespace
+
+EditJournal::EditJournal(const Settings& settings)
+    : settings(settings)
+    , world(nullptr)
+    , journal(nullptr)
+    , journalSize(0)
+    , compactions(0)
+    , snapshot(0)
+    , failed(false)
+    , lastStats(makeRecord(RecordKind::PLAYER_STATS, 0, 0))
+    , hasStats(false)
+    , stopping(false)
+{
+}
+
+EditJournal::~EditJournal() {
+    close();
+}
+
+EditJournal::Record EditJournal::makeRecord(RecordKind kind, int x, int z) {
+    // Zeroed so padding bytes are deterministic for the checksum
+    Record record;
+    std::memset(&record, 0, sizeof(record));
+    record.kind = kind;
+    record.x = x;
+    record.z = z;
+    return record;
+}
+
+std::string EditJournal::path(const char* fileName) const {
+    return settings.directory + "/" + fileName;
+}
+
+bool EditJournal::open(World& target, PlayerStats* stats) {
+    close();
+    
+    std::error_code error;
+    std::filesystem::create_directories(settings.directory, error);
+    if (error) {
+        LOG_ERROR("Failed to create save directory {}: {}", settings.directory, error.message());
+        return false;
+    }
+    
+    // journal.log names the snapshot it applies to. Restore both, or make
+    // the current world the first snapshot.
+    placedEntities.clear();
+    hasStats = false;
+    snapshot = 0;
+    failed = false;
+    std::vector<Record> records;
+    std::string journalPath = path("journal.log");
+    bool hasSave = std::filesystem::exists(journalPath, error);
+    bool restored = hasSave && readJournal(journalPath, snapshot, records) &&
+                    target.loadMapFile(snapshotPath(snapshot));
+    if (hasSave && !restored) {
+        records.clear();
+        snapshot = 0;
+        if (!moveAsideUnreadable()) return false;
+    }
+    if (!restored && !writeSnapshot(target)) {
+        return false;
+    }
+    
+    shadow.reset(new World(target.getWidth(), target.getHeight()));
+    bool started = shadow->loadMapFile(snapshotPath(snapshot));
+    if (started && restored) {
+        applyRecords(target, records, true, stats);
+        applyRecords(*shadow, records, false, nullptr);
+        for (const Record& record : records) {
+            trackState(record);
+        }
+        
+        // Fold replayed edits into a fresh snapshot so the next crash
+        // replays less; failing that, keep them in a rewritten journal
+        bool hasTerrainRecords = false;
+        for (const Record& record : records) {
+            hasTerrainRecords = hasTerrainRecords || record.kind == RecordKind::CELL_TYPE ||
+                                record.kind == RecordKind::TERRAIN_HEIGHT;
+        }
+        if (!hasTerrainRecords || !compact()) {
+            startJournal(snapshot, hasTerrainRecords ? records : stateRecords());
+        }
+    }
+    if (!started || !journal) {
+        LOG_ERROR("Failed to start journaling in {}", settings.directory);
+        if (journal) {
+            std::fclose(journal);
+            journal = nullptr;
+        }
+        shadow.reset();
+        return false;
+    }
+    
+    world = &target;
+    world->addListener(this);
+    stopping = false;
+    writer = std::thread(&EditJournal::writerLoop, this);
+    
+    if (restored) {
+        LOG_INFO("Restored save from {} ({} journaled edits)", settings.directory, records.size());
+    }
+    return restored;
+}
+
+std::string EditJournal::snapshotPath(uint32_t number) const {
+    return path(("snapshot-" + std::to_string(number) + ".fmap").c_str());
+}
+
+std::vector<std::string> EditJournal::listSnapshots() const {
+    std::vector<std::string> names;
+    std::error_code error;
+    for (std::filesystem::directory_iterator it(settings.directory, error);
+         !error && it != std::filesystem::directory_iterator(); it.increment(error)) {
+        std::string name = it->path().filename().string();
+        if (name.compare(0, 9, "snapshot-") == 0) {
+            names.push_back(name);
+        }
+    }
+    return names;
+}
+
+void EditJournal::removeStaleSnapshots() {
+    // Windows refuses while a World still maps one; it goes after a later compaction
+    std::string current = std::filesystem::path(snapshotPath(snapshot)).filename().string();
+    for (const std::string& name : listSnapshots()) {
+        std::error_code error;
+        if (name != current) {
+            std::filesystem::remove(path(name.c_str()), error);
+        }
+    }
+}
+
+bool EditJournal::moveAsideUnreadable() {
+    std::error_code error;
+    std::string aside;
+    for (int n = 1; aside.empty() || std::filesystem::exists(aside, error); n++) {
+        aside = path(("unreadable-" + std::to_string(n)).c_str());
+    }
+    
+    std::filesystem::create_directory(aside, error);
+    std::filesystem::rename(path("journal.log"), aside + "/journal.log", error);
+    for (const std::string& name : listSnapshots()) {
+        if (!error) {
+            std::filesystem::rename(path(name.c_str()), aside + "/" + name, error);
+        }
+    }
+    if (error) {
+        LOG_ERROR("Failed to move unreadable save to {}: {}", aside, error.message());
+        return false;
+    }
+    
+    LOG_WARNING("Save in {} could not be loaded; moved it to {} and started a new one",
+                settings.directory, aside);
+    return true;
+}
+
+void EditJournal::close() {
+    if (!world) return;
+    
+    world->removeListener(this);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    writer.join();
+    
+    if (journal) {
+        std::fclose(journal);
+        journal = nullptr;
+    }
+    shadow.reset();
+    pendingResets.clear();
+    world = nullptr;
+}
+
+void EditJournal::recordPlayerStats(const PlayerStats& stats) {
+    Record record = makeRecord(RecordKind::PLAYER_STATS, stats.flowersPlanted, stats.flowersWatered);
+    record.value = stats.photographsTaken;
+    push(record);
+}
+
+void EditJournal::onCellChanged(int x, int z, World::CellType type) {
+    Record record = makeRecord(RecordKind::CELL_TYPE, x, z);
+    record.type = static_cast<uint8_t>(type);
+    push(record);
+}
+
+void EditJournal::onTerrainHeightChanged(int x, int z, float height) {
+    Record record = makeRecord(RecordKind::TERRAIN_HEIGHT, x, z);
+    std::memcpy(&record.value, &height, sizeof(height));
+    push(record);
+}
+
+void EditJournal::onCellEntityChanged(int x, int z, Entity* entity) {
+    if (!entity) {
+        push(makeRecord(RecordKind::ENTITY_CLEARED, x, z));
+        return;
+    }
+    
+    Record record = makeRecord(RecordKind::ENTITY_PLACED, x, z);
+    record.type = static_cast<uint8_t>(entity->getType());
+    std::strncpy(record.name, entity->getName().c_str(), sizeof(record.name) - 1);
+    push(record);
+}
+
+void EditJournal::onTerrainReset() {
+    if (failed) return;
+    
+    // Bulk changes are snapshotted rather than journaled cell by cell. Only
+    // the copy happens here; encoding and writing it is the writer's job.
+    std::unique_ptr<World> copy(new World(world->getWidth(), world->getHeight()));
+    copy->copyTerrain(*world);
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.push_back(makeRecord(RecordKind::RESET, 0, 0));
+    pendingResets.push_back(std::move(copy));
+}
+
+void EditJournal::push(const Record& record) {
+    if (failed) return;
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.push_back(record);
+}
+
+void EditJournal::disableSaving(const char* reason) {
+    LOG_ERROR("Saving disabled: {} in {}", reason, settings.directory);
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    failed = true;
+    pending.clear();
+    pendingResets.clear();
+}
+
+void EditJournal::writerLoop() {
+    for (;;) {
+        std::vector<Record> batch;
+        std::vector<std::unique_ptr<World>> resets;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait_for(lock, std::chrono::milliseconds(settings.batchIntervalMs), [this] { return stopping; });
+            batch.swap(pending);
+            resets.swap(pendingResets);
+            if (stopping && batch.empty()) return;
+        }
+        
+        // Journal records up to each reset, then switch to its snapshot
+        size_t segmentStart = 0;
+        size_t nextReset = 0;
+        for (size_t i = 0; i <= batch.size(); i++) {
+            if (i < batch.size() && batch[i].kind != RecordKind::RESET) continue;
+            
+            std::vector<Record> segment(batch.begin() + segmentStart, batch.begin() + i);
+            if (!segment.empty()) {
+                bool appended = appendBatch(segment);
+                applyRecords(*shadow, segment, false, nullptr);
+                for (const Record& record : segment) {
+                    trackState(record);
+                }
+                
+                // Replay stops at a torn batch, so save everything as a snapshot instead
+                if (!appended && !writeSnapshot(*shadow)) {
+                    disableSaving("could not write the journal");
+                    return;
+                }
+            }
+            segmentStart = i + 1;
+            
+            if (i < batch.size()) {
+                shadow = std::move(resets[nextReset++]);
+                if (!writeSnapshot(*shadow)) {
+                    disableSaving("could not write a snapshot");
+                    return;
+                }
+            }
+        }
+        
+        // A failed compaction keeps the current journal, so it is retried next batch
+        if (journalSize > settings.compactThreshold && !compact() && !journal) {
+            disableSaving("could not reopen the journal");
+            return;
+        }
+    }
+}
+
+bool EditJournal::writeSnapshot(const World& source) {
+    // Snapshots get new names rather than replacing the current one, which
+    // the worlds may still have mapped. Installing the journal that names
+    // the new snapshot switches both in one rename.
+    uint32_t next = snapshot + 1;
+    std::string nextPath = snapshotPath(next);
+    bool written = source.saveMapFile(nextPath) && FileSync::syncPath(nextPath) &&
+                   FileSync::syncDirectory(settings.directory);
+    if (!written || !startJournal(next, stateRecords())) {
+        LOG_ERROR("Failed to install snapshot: {}", nextPath);
+        std::error_code error;
+        std::filesystem::remove(nextPath, error);
+        return false;
+    }
+    
+    snapshot = next;
+    removeStaleSnapshots();
+    return true;
+}
+
+bool EditJournal::compact() {
+    if (!writeSnapshot(*shadow)) return false;
+    compactions++;
+    return true;
+}
+
+bool EditJournal::startJournal(uint32_t snapshotNumber, const std::vector<Record>& initialRecords) {
+    std::string tempPath = path("journal.log.tmp");
+    FILE* file = std::fopen(tempPath.c_str(), "wb");
+    if (!file) {
+        LOG_ERROR("Failed to create journal: {}", tempPath);
+        return false;
+    }
+    
+    JournalHeader header = {JOURNAL_MAGIC, JOURNAL_VERSION, snapshotNumber, 0};
+    bool written = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   (initialRecords.empty() || writeBatch(file, initialRecords));
+    std::fclose(file);
+    
+    // Replace the old journal only once the new one is complete on disk.
+    // Windows can't rename over an open file, so the old one is closed first
+    // and reopened if the switch fails.
+    bool hadJournal = journal != nullptr;
+    if (journal) {
+        std::fclose(journal);
+        journal = nullptr;
+    }
+    if (!written || !FileSync::replaceFile(tempPath, path("journal.log"))) {
+        LOG_ERROR("Failed to install journal: {}", tempPath);
+        if (hadJournal) {
+            journal = std::fopen(path("journal.log").c_str(), "ab");
+        }
+        return false;
+    }
+    
+    // Installed even if reopening fails; appendBatch reports that
+    journal = std::fopen(path("journal.log").c_str(), "ab");
+    journalSize = sizeof(header);
+    if (!initialRecords.empty()) {
+        journalSize += sizeof(BatchHeader) + initialRecords.size() * sizeof(Record);
+    }
+    return true;
+}
+
+bool EditJournal::writeBatch(FILE* file, const std::vector<Record>& records) {
+    BatchHeader header;
+    header.magic = BATCH_MAGIC;
+    header.recordCount = static_cast<uint32_t>(records.size());
+    header.checksum = checksum(records.data(), records.size() * sizeof(Record));
+    header.reserved = 0;
+    
+    return std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+           std::fwrite(records.data(), sizeof(Record), records.size(), file) == records.size();
+}
+
+bool EditJournal::appendBatch(const std::vector<Record>& records) {
+    if (!journal || !writeBatch(journal, records) || !FileSync::syncFile(journal)) {
+        LOG_ERROR("Failed to append to journal in {}", settings.directory);
+        return false;
+    }
+    
+    journalSize += sizeof(BatchHeader) + records.size() * sizeof(Record);
+    return true;
+}
+
+bool EditJournal::readJournal(const std::string& journalPath, uint32_t& snapshotNumber,
+                              std::vector<Record>& records) {
+    FILE* file = std::fopen(journalPath.c_str(), "rb");
+    if (!file) return false;
+    
+    JournalHeader header;
+    if (std::fread(&header, sizeof(header), 1, file) != 1 ||
+        header.magic != JOURNAL_MAGIC || header.version != JOURNAL_VERSION) {
+        LOG_WARNING("Unreadable journal: {}", journalPath);
+        std::fclose(file);
+        return false;
+    }
+    snapshotNumber = header.snapshot;
+    
+    // Stop at the first torn or corrupt batch; everything before it is intact
+    BatchHeader batch;
+    std::vector<Record> batchRecords;
+    while (std::fread(&batch, sizeof(batch), 1, file) == 1 && batch.magic == BATCH_MAGIC) {
+        batchRecords.resize(batch.recordCount);
+        if (std::fread(batchRecords.data(), sizeof(Record), batchRecords.size(), file) != batchRecords.size() ||
+            checksum(batchRecords.data(), batchRecords.size() * sizeof(Record)) != batch.checksum) {
+            break;
+        }
+        records.insert(records.end(), batchRecords.begin(), batchRecords.end());
+    }
+    
+    std::fclose(file);
+    return true;
+}
+
+void EditJournal::applyRecords(World& target, const std::vector<Record>& records, bool entities,
+                               PlayerStats* stats) {
+    for (const Record& record : records) {
+        switch (record.kind) {
+            case RecordKind::CELL_TYPE:
+                target.setCell(record.x, record.z, static_cast<World::CellType>(record.type));
+                break;
+            case RecordKind::TERRAIN_HEIGHT: {
+                float height;
+                std::memcpy(&height, &record.value, sizeof(height));
+                target.setTerrainHeight(record.x, record.z, height);
+                break;
+            }
+            case RecordKind::ENTITY_PLACED:
+                if (entities && target.isValidPosition(record.x, record.z)) {
+                    Entity* previous = target.getCellEntity(record.x, record.z);
+                    if (previous) {
+                        target.removeEntity(previous);
+                        delete previous;
+                    }
+                    
+                    Entity* entity = new Entity();
+                    char name[sizeof(record.name) + 1] = {};
+                    std::memcpy(name, record.name, sizeof(record.name));
+                    entity->setName(name);
+                    entity->setType(static_cast<Entity::Type>(record.type));
+                    entity->setPosition(target.gridToWorld(record.x, record.z));
+                    target.addEntity(entity);
+                    target.setCellEntity(record.x, record.z, entity);
+                }
+                break;
+            case RecordKind::ENTITY_CLEARED:
+                if (entities) {
+                    Entity* entity = target.getCellEntity(record.x, record.z);
+                    if (entity) {
+                        target.removeEntity(entity);
+                        delete entity;
+                    }
+                }
+                break;
+            case RecordKind::PLAYER_STATS:
+                if (stats) {
+                    stats->flowersPlanted = record.x;
+                    stats->flowersWatered = record.z;
+                    stats->photographsTaken = record.value;
+                }
+                break;
+            case RecordKind::RESET:
+                break;
+        }
+    }
+    
+    target.flushTerrainNormals();
+}
+
+void EditJournal::trackState(const Record& record) {
+    int64_t key = (static_cast<int64_t>(record.z) << 32) | static_cast<uint32_t>(record.x);
+    if (record.kind == RecordKind::ENTITY_PLACED) {
+        placedEntities[key] = record;
+    } else if (record.kind == RecordKind::ENTITY_CLEARED) {
+        placedEntities.erase(key);
+    } else if (record.kind == RecordKind::PLAYER_STATS) {
+        lastStats = record;
+        hasStats = true;
+    }
+}
+
+std::vector<EditJournal::Record> EditJournal::stateRecords() const {
+    std::vector<Record> records;
+    for (const auto& entry : placedEntities) {
+        records.push_back(entry.second);
+    }
+    if (hasStats) {
+        records.push_back(lastStats);
+    }
+    return records;
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include "world.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// EditJournal persists a World incrementally. It listens to World edits and
+// appends them as fixed-size records to a journal file; a background thread
+// writes and fsyncs one batch per interval, so the frame thread only pushes
+// records into a buffer. The writer also replays every batch into a private
+// shadow World and, once the journal grows past a threshold, compacts that
+// shadow into a map file snapshot and starts a fresh journal.
+//
+// Directory layout:
+//   snapshot-N.fmap  terrain at the last compaction (MapFile format)
+//   journal.log      the number of its snapshot, then batches of records
+//                    to replay on top of it
+//   unreadable-N/    a save open() could not load, kept for inspection
+//
+// Every file is synced before it is renamed into place. A compaction writes
+// the next numbered snapshot and then replaces journal.log with one naming
+// it, so the snapshot and journal switch together in a single rename and
+// the old snapshot is never overwritten while a World maps it.
+//
+// Records store absolute values, so replaying a batch twice is harmless.
+// After a crash, open() restores the snapshot plus every complete batch;
+// at most one batch interval of edits is lost. If the writer can't save,
+// it logs an error and saving stops; isOpen() then returns false. Bulk changes (generation,
+// map loads) copy the terrain on the calling thread and the writer turns
+// the copy into the next snapshot. Chunk paging is not journaled; a
+// StreamingWorld saves its own chunks.
+class EditJournal : public WorldListener {
+public:
+    struct Settings {
+        std::string directory;
+        int batchIntervalMs;       // How often the writer flushes and fsyncs
+        size_t compactThreshold;   // Journal size in bytes that triggers a snapshot
+        
+        Settings()
+            : directory("save")
+            , batchIntervalMs(500)
+            , compactThreshold(4 * 1024 * 1024)
+        {}
+    };
+    
+    struct PlayerStats {
+        int flowersPlanted;
+        int flowersWatered;
+        int photographsTaken;
+        
+        PlayerStats() : flowersPlanted(0), flowersWatered(0), photographsTaken(0) {}
+    };
+    
+    explicit EditJournal(const Settings& settings);
+    ~EditJournal();
+    
+    EditJournal(const EditJournal&) = delete;
+    EditJournal& operator=(const EditJournal&) = delete;
+    
+    // Restore the world (and player stats, when a save has them) from the
+    // directory, then start journaling its edits. Without a previous save the
+    // current world becomes the first snapshot. A save that fails to load is
+    // moved aside rather than overwritten. Returns true when a previous save
+    // was restored; check isOpen() to see whether journaling started.
+    bool open(World& world, PlayerStats* stats);
+    
+    // Flush pending records, stop the writer and detach from the world
+    void close();
+    bool isOpen() const { return world != nullptr && !failed; }
+    
+    // Player statistics are not part of the World, so the engine reports them
+    void recordPlayerStats(const PlayerStats& stats);
+    
+    // WorldListener
+    void onCellChanged(int x, int z, World::CellType type) override;
+    void onTerrainHeightChanged(int x, int z, float height) override;
+    void onCellEntityChanged(int x, int z, Entity* entity) override;
+    void onTerrainReset() override;
+    
+    size_t getJournalSize() const { return journalSize; }
+    int getCompactionCount() const { return compactions; }
+
+private:
+    enum class RecordKind : uint8_t {
+        CELL_TYPE,
+        TERRAIN_HEIGHT,
+        ENTITY_PLACED,
+        ENTITY_CLEARED,
+        PLAYER_STATS,
+        RESET             // Never written; the writer snapshots the next queued terrain copy
+    };
+    
+    struct Record {
+        RecordKind kind;
+        uint8_t type;      // Cell type or entity type
+        uint8_t reserved[2];
+        int32_t x;         // Flowers planted for PLAYER_STATS
+        int32_t z;         // Flowers watered for PLAYER_STATS
+        int32_t value;     // Height bits, or photographs taken for PLAYER_STATS
+        char name[32];     // Entity name, truncated
+    };
+    
+    static Record makeRecord(RecordKind kind, int x, int z);
+    
+    // Journal file access
+    std::string path(const char* fileName) const;
+    std::string snapshotPath(uint32_t number) const;
+    std::vector<std::string> listSnapshots() const;
+    void removeStaleSnapshots();
+    bool moveAsideUnreadable();
+    
+    // Installs a new journal.log for the given snapshot. Returns false when
+    // the old journal is still in place; after a true return 'journal' is
+    // null if the new one could not be reopened for appending.
+    bool startJournal(uint32_t snapshotNumber, const std::vector<Record>& initialRecords);
+    bool appendBatch(const std::vector<Record>& records);
+    static bool writeBatch(FILE* file, const std::vector<Record>& records);
+    static bool readJournal(const std::string& path, uint32_t& snapshotNumber, std::vector<Record>& records);
+    
+    // Applies records to a world; entities are created when 'entities' is set
+    static void applyRecords(World& target, const std::vector<Record>& records, bool entities,
+                             PlayerStats* stats);
+    
+    void writerLoop();
+    void disableSaving(const char* reason);
+    void push(const Record& record);
+    void trackState(const Record& record);
+    std::vector<Record> stateRecords() const;
+    bool writeSnapshot(const World& source);   // Also starts its journal
+    bool compact();
+    
+    Settings settings;
+    World* world;
+    std::unique_ptr<World> shadow;     // Writer-thread copy of the saved terrain
+    FILE* journal;
+    size_t journalSize;
+    int compactions;
+    uint32_t snapshot;                 // Number of the snapshot journal.log names
+    std::atomic<bool> failed;          // Set by the writer when saving stops
+    
+    // Saved entity placements and stats, rewritten at the head of each new journal
+    std::map<int64_t, Record> placedEntities;
+    Record lastStats;
+    bool hasStats;
+    
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<Record> pending;
+    std::vector<std::unique_ptr<World>> pendingResets;  // Terrain copies, one per queued RESET
+    bool stopping;
+    std::thread writer;
+};
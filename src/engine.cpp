@@ -1,4 +1,9 @@
 #include "engine.h"
+#include "job_system.h"
+#include "logger.h"
+#include "math_kernels.h"
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <cmath>
 
@@ -9,33 +14,21 @@
 #include <GL/gl.h>
 #endif
 
-WorldGrid::WorldGrid(int width, int height) 
-    : width(width), height(height) {
-    cells.resize(width * height, CellType::GRASS);
-}
-
-void WorldGrid::setCell(int x, int z, CellType type) {
-    if (isValidPosition(x, z)) {
-        cells[z * width + x] = type;
-    }
-}
-
-WorldGrid::CellType WorldGrid::getCell(int x, int z) const {
-    if (isValidPosition(x, z)) {
-        return cells[z * width + x];
-    }
-    return CellType::GRASS;
-}
-
-bool WorldGrid::isValidPosition(int x, int z) const {
-    return x >= 0 && x < width && z >= 0 && z < height;
+WorldGrid::WorldGrid(World& world)
+    : world(world) {
 }
 
 Engine::Engine() 
     : window(nullptr)
     , glContext(nullptr)
-    , world(50, 50)  // 50x50 grid (legacy)
-    , worldSystem(50, 50)  // New world system
+    , headlessFrames(0)
+    , worldSystem(WORLD_SIZE, WORLD_SIZE)
+    , world(worldSystem)  // Legacy view
+    , streamingEnabled(false)
+    , saveDirectory("save")
+    , collision(worldSystem)
+    , gameTime(DAY_LENGTH * 0.05f)  // Early morning
+    , hasCamera(false)
     , running(false)
     , mouseCaptured(false)
     , lastTime(0)
@@ -52,7 +45,12 @@ Engine::~Engine() {
     shutdown();
 }
 
-bool Engine::initialize() {
+void Engine::setHeadless(int frames, const std::string& imagePath) {
+    headlessFrames = std::max(frames, 1);
+    headlessImagePath = imagePath;
+}
+
+bool Engine::createWindow() {
     // Initialize SDL
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         std::cerr << "Failed to initialize SDL: " << SDL_GetError() << std::endl;
@@ -68,7 +66,7 @@ bool Engine::initialize() {
     // Create window
     window = SDL_CreateWindow(
         "Flower - A Peaceful Adventure",
-        800, 600,
+        WINDOW_WIDTH, WINDOW_HEIGHT,
         SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE
     );
     
@@ -91,27 +89,30 @@ bool Engine::initialize() {
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glClearColor(0.53f, 0.81f, 0.92f, 1.0f);  // Sky blue
+    return true;
+}
+
+bool Engine::initialize() {
+    if (headlessFrames > 0) {
+        rasterizer.reset(new SoftwareRasterizer());
+    } else if (!createWindow()) {
+        return false;
+    }
     
-    // Set up perspective projection
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    float aspect = 800.0f / 600.0f;
-    float fov = 60.0f;
-    float nearPlane = 0.1f;
-    float farPlane = 100.0f;
-    float f = 1.0f / std::tan(fov * 3.14159f / 360.0f);
-    
-    GLfloat projection[16] = {
-        f/aspect, 0, 0, 0,
-        0, f, 0, 0,
-        0, 0, (farPlane + nearPlane)/(nearPlane - farPlane), -1,
-        0, 0, (2*farPlane*nearPlane)/(nearPlane - farPlane), 0
-    };
-    glLoadMatrixf(projection);
+    // Set up perspective projection; submitScene loads it with the view
+    projection = Mat4::perspective(FIELD_OF_VIEW, static_cast<float>(WINDOW_WIDTH) / WINDOW_HEIGHT,
+                                   0.1f, VIEW_DISTANCE);
+    
+    // The streamed world starts the player in its middle; the starting
+    // area keeps the same layout as the fixed map
+    Vec3 origin = Vec3::zero();
+    if (streamingEnabled) {
+        worldSystem.resize(STREAMING_WORLD_SIZE, STREAMING_WORLD_SIZE);
+        origin = Vec3((STREAMING_WORLD_SIZE - WORLD_SIZE) / 2, 0.0f, (STREAMING_WORLD_SIZE - WORLD_SIZE) / 2);
+    }
     
     // Set player starting position
-    player.setPosition(Vec3(25, 1.7f, 25));
+    player.setPosition(origin + Vec3(WORLD_SIZE / 2, 1.7f, WORLD_SIZE / 2));
     
     // Initialize the new world system
     worldSystem.generateFlatTerrain();  // Start with flat terrain
@@ -119,15 +120,52 @@ bool Engine::initialize() {
     // Optionally generate some hills for testing slope movement
     // worldSystem.generateHillyTerrain(2.0f, 0.1f);
     
+    if (streamingEnabled) {
+        StreamingWorld::Settings streamSettings;
+        streamSettings.saveDirectory = "world";
+        streamingWorld.reset(new StreamingWorld(worldSystem, streamSettings));
+        streamingWorld->update(player.getPosition());
+        LOG_INFO("Streaming world enabled (chunks saved to {}/)", streamSettings.saveDirectory);
+    }
+    
+    // Restore the previous session, then keep saving edits in the background
+    if (!streamingEnabled && !saveDirectory.empty()) {
+        EditJournal::Settings journalSettings;
+        journalSettings.directory = saveDirectory;
+        journal.reset(new EditJournal(journalSettings));
+        EditJournal::PlayerStats stats;
+        if (journal->open(worldSystem, &stats)) {
+            player.setStatistics(stats.flowersPlanted, stats.flowersWatered, stats.photographsTaken);
+        }
+        if (!journal->isOpen()) {
+            LOG_ERROR("Saving disabled: could not open {}", saveDirectory);
+            journal.reset();
+        }
+    }
+    
+    // Shapes already in a restored garden aren't announced again
+    for (const auto& count : flowerPatterns.countAll(worldSystem.getFlowerLayer())) {
+        if (count.second > 0) completedPatterns.insert(count.first);
+    }
+    lightmap.attach(worldSystem);
+    updateWorldTime(0.0f);  // Sun position for the starting time of day
+    occlusion.attach(worldSystem);
+    terrainLod.attach(worldSystem);
+    
+    // Photos are read back and encoded off the frame; headless runs take none
+    if (window && photoAlbum.open()) {
+        photoCapture.initialize(photoAlbum);
+    }
+    
     // Create some initial pickups (seeds)
     for (int i = 0; i < 5; i++) {
-        pickups.push_back(new Pickup(Vec3(20 + i * 2, 0.5f, 20), Pickup::Type::SUNFLOWER_SEEDS));
-        pickups.push_back(new Pickup(Vec3(20 + i * 2, 0.5f, 22), Pickup::Type::ROSE_SEEDS));
+        pickups.push_back(new Pickup(origin + Vec3(20 + i * 2, 0.5f, 20), Pickup::Type::SUNFLOWER_SEEDS));
+        pickups.push_back(new Pickup(origin + Vec3(20 + i * 2, 0.5f, 22), Pickup::Type::ROSE_SEEDS));
     }
     
     // Create initial tools (tools)
-    tools.push_back(new Tool(Vec3(25, 1.5f, 20), Tool::Type::WATERING_CAN));
-    tools.push_back(new Tool(Vec3(27, 1.5f, 20), Tool::Type::CAMERA));
+    tools.push_back(new Tool(origin + Vec3(25, 1.5f, 20), Tool::Type::WATERING_CAN));
+    tools.push_back(new Tool(origin + Vec3(27, 1.5f, 20), Tool::Type::CAMERA));
     
     std::cout << "Flower game initialized successfully!" << std::endl;
     std::cout << "Controls:" << std::endl;
@@ -136,6 +174,7 @@ bool Engine::initialize() {
     std::cout << "  Mouse - Look around" << std::endl;
     std::cout << "  Left Click - Use tool" << std::endl;
     std::cout << "  E - Pick up items" << std::endl;
+    std::cout << "  C - Take a photo (once you have the camera)" << std::endl;
     std::cout << "  ESC - Exit" << std::endl;
     std::cout << "\nWorld system loaded with entity and slope support" << std::endl;
     
@@ -143,6 +182,11 @@ bool Engine::initialize() {
 }
 
 void Engine::run() {
+    if (rasterizer) {
+        runHeadless();
+        return;
+    }
+    
     running = true;
     lastTime = SDL_GetTicks();
     
@@ -161,7 +205,47 @@ void Engine::run() {
     }
 }
 
+void Engine::runHeadless() {
+    // Fixed steps and no input, so every run renders the same frames
+    const float FRAME_TIME = 1.0f / 60.0f;
+    typedef std::chrono::steady_clock Clock;
+    double updateMs = 0.0;
+    double renderMs = 0.0;
+    for (int frame = 0; frame < headlessFrames; frame++) {
+        Clock::time_point start = Clock::now();
+        update(FRAME_TIME);
+        Clock::time_point updated = Clock::now();
+        render();
+        updateMs += std::chrono::duration<double, std::milli>(updated - start).count();
+        renderMs += std::chrono::duration<double, std::milli>(Clock::now() - updated).count();
+    }
+    
+    std::cout << "Headless: " << headlessFrames << " frames at " << rasterizer->getWidth() << "x"
+              << rasterizer->getHeight() << ", " << updateMs / headlessFrames << " ms update, "
+              << renderMs / headlessFrames << " ms render per frame (" << scene.getInstances().size()
+              << " instances, " << rasterizer->getTriangleCount() << " triangles in the last)" << std::endl;
+    if (!headlessImagePath.empty() && rasterizer->saveImage(headlessImagePath)) {
+        std::cout << "Last frame saved to " << headlessImagePath << std::endl;
+    }
+}
+
 void Engine::shutdown() {
+    // Needs the GL context for readbacks still in flight
+    photoCapture.shutdown();
+    photoAlbum.close();
+    
+    // Flushes the last batch of edits
+    journal.reset();
+    lightmap.detach();
+    occlusion.detach();
+    terrainLod.detach();
+    
+    // Writes back edited chunks before the loader threads exit
+    streamingWorld.reset();
+    
+    // Messages still queued go out before the exit statistics
+    Logger::instance().flush();
+    
     // Clean up tools
     for (auto tool : tools) {
         delete tool;
@@ -224,6 +308,13 @@ void Engine::handleEvents() {
                     case SDLK_LSHIFT:
                         keyDown = true;
                         break;
+                    case SDLK_C:
+                        if (hasCamera) {
+                            takePhoto();
+                        } else {
+                            LOG_INFO("Find the camera to take photos.");
+                        }
+                        break;
                     case SDLK_E:
                         // Pick up nearby items
                         {
@@ -231,7 +322,7 @@ void Engine::handleEvents() {
                             for (auto it = pickups.begin(); it != pickups.end();) {
                                 Vec3 diff = (*it)->getPosition() - playerPos;
                                 if (diff.length() < 2.0f) {
-                                    std::cout << "Picked up seeds!" << std::endl;
+                                    LOG_INFO("Picked up seeds!");
                                     delete *it;
                                     it = pickups.erase(it);
                                 } else {
@@ -242,7 +333,11 @@ void Engine::handleEvents() {
                             for (auto it = tools.begin(); it != tools.end();) {
                                 Vec3 diff = (*it)->getPosition() - playerPos;
                                 if (diff.length() < 2.0f) {
-                                    std::cout << "Picked up " << (*it)->getName() << "!" << std::endl;
+                                    LOG_INFO("Picked up {}!", (*it)->getName());
+                                    if ((*it)->getType() == Tool::Type::CAMERA) {
+                                        hasCamera = true;
+                                        LOG_INFO("Press C to take a photo.");
+                                    }
                                     delete *it;
                                     it = tools.erase(it);
                                 } else {
@@ -284,22 +379,25 @@ void Engine::handleEvents() {
                         SDL_SetWindowRelativeMouseMode(window, true);
                         mouseCaptured = true;
                     } else {
-                        // Use current tool (plant flower, water, take photo)
-                        Vec3 pos = player.getPosition();
-                        Vec3 forward = player.getForward();
-                        Vec3 plantPos = pos + forward * 3.0f;
+                        // Use current tool (plant flower, water) on
+                        // the cell under the crosshair
+                        World::RaycastHit target;
+                        worldSystem.raycast(player.getPosition(), player.getForward(), TOOL_REACH, target);
+                        GridPos gridPos = target.cell;
                         
-                        GridPos gridPos(static_cast<int>(std::floor(plantPos.x)),
-                                      static_cast<int>(std::floor(plantPos.z)));
-                        
-                        if (world.isValidPosition(gridPos.x, gridPos.z)) {
+                        if (target.hit && world.isValidPosition(gridPos.x, gridPos.z)) {
                             if (world.getCell(gridPos.x, gridPos.z) == WorldGrid::CellType::GRASS) {
                                 world.setCell(gridPos.x, gridPos.z, WorldGrid::CellType::FLOWER);
                                 player.incrementFlowersPlanted();
-                                std::cout << "Planted a flower! Total: " << player.getFlowersPlanted() << std::endl;
+                                recordPlayerStats();
+                                LOG_INFO("Planted a flower! Total: {}", player.getFlowersPlanted());
+                                checkPlayerObjectives();
+                                checkFlowerPatterns(gridPos.x, gridPos.z);
                             } else if (world.getCell(gridPos.x, gridPos.z) == WorldGrid::CellType::FLOWER) {
                                 player.incrementFlowersWatered();
-                                std::cout << "Watered a flower! Total: " << player.getFlowersWatered() << std::endl;
+                                recordPlayerStats();
+                                LOG_INFO("Watered a flower! Total: {}", player.getFlowersWatered());
+                                checkPlayerObjectives();
                             }
                         }
                     }
@@ -318,17 +416,25 @@ void Engine::handleEvents() {
 }
 
 void Engine::update(float deltaTime) {
+    collision.rebuild(worldSystem.getEntities());
     handleKeyboard(deltaTime);
     
     // Update player's standing surface normal based on their position
     Vec3 playerPos = player.getPosition();
-    Vec3 surfaceNormal = worldSystem.getTerrainNormal(playerPos);
-    player.setStandingSurfaceNormal(surfaceNormal);
+    if (streamingWorld) {
+        // Only queues work for the loader threads; never waits on disk
+        streamingWorld->update(playerPos);
+    }
+    player.setStandingSurfaceNormal(worldSystem.getTerrainNormal(playerPos));
     
     player.update(deltaTime);
+    updateWorldTime(deltaTime);
     
     // Update world system (entities, etc.)
     worldSystem.update(deltaTime);
+    lightmap.update();
+    terrainLod.update();
+    physics.step(worldSystem, collision, deltaTime);
     
     // Update tools
     for (auto tool : tools) {
@@ -340,14 +446,24 @@ void Engine::update(float deltaTime) {
         pickup->update(deltaTime);
     }
     
-    // Update limbs (flower petals/stems that can animate)
-    for (auto limb : limbs) {
-        limb->update(deltaTime);
+    // Update limbs (flower petals/stems that can animate), with the wind
+    // waves of all of them in one batch
+    size_t phaseCount = limbs.size() * Limb::PHASE_COUNT;
+    limbPhases.resize(phaseCount);
+    limbSines.resize(phaseCount);
+    limbCosines.resize(phaseCount);
+    for (size_t i = 0; i < limbs.size(); i++) {
+        limbs[i]->advance(deltaTime, &limbPhases[i * Limb::PHASE_COUNT]);
+    }
+    MathUtils::sincosBatch(limbPhases.data(), limbSines.data(), limbCosines.data(), phaseCount);
+    for (size_t i = 0; i < limbs.size(); i++) {
+        limbs[i]->applyWaves(&limbSines[i * Limb::PHASE_COUNT], &limbCosines[i * Limb::PHASE_COUNT]);
     }
 }
 
 void Engine::handleKeyboard(float deltaTime) {
     float speed = 5.0f * deltaTime;
+    Vec3 start = player.getPosition();
     
     // Use the new slope-aware movement if the player is on a slope
     Vec3 surfaceNormal = player.getStandingSurfaceNormal();
@@ -369,42 +485,26 @@ void Engine::handleKeyboard(float deltaTime) {
     
     if (keyUp) player.moveUp(speed);
     if (keyDown) player.moveUp(-speed);
+    
+    // The moves above only propose a displacement; collision decides how
+    // much of it happens
+    Vec3 desired = player.getPosition() - start;
+    Entity::BoundingBox box(start + Vec3(-PLAYER_RADIUS, -PLAYER_EYE_HEIGHT, -PLAYER_RADIUS),
+                            start + Vec3(PLAYER_RADIUS, PLAYER_HEAD_ROOM, PLAYER_RADIUS));
+    player.setPosition(start + collision.sweep(box, desired, nullptr));
 }
 
 void Engine::render() {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // Record the frame into the scene, then hand it to OpenGL (or the
+    // software rasterizer when headless). Player yaw 0
+    // looks down +X and OpenGL looks down -Z by default; lookAt takes care
+    // of the difference.
+    Vec3 eye = player.getPosition();
+    scene.clear();
+    Mat4 view = Mat4::lookAt(eye, eye + player.getForward(), Vec3::up());
+    scene.setCamera(view, projection);
     
-    // Set up camera view matrix
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-    
-    Vec3 pos = player.getPosition();
-    Vec3 forward = player.getForward();
-    Vec3 up = player.getUp();
-    Vec3 target = pos + forward;
-    
-    // Simple lookAt implementation
-    Vec3 f = (target - pos).normalized();
-    Vec3 s = Vec3::cross(f, up).normalized();
-    Vec3 u = Vec3::cross(s, f);
-    
-    GLfloat viewMatrix[16] = {
-        s.x, u.x, -f.x, 0,
-        s.y, u.y, -f.y, 0,
-        s.z, u.z, -f.z, 0,
-        -Vec3::cross(s, Vec3(pos.x, pos.y, pos.z)).x,
-        -Vec3::cross(u, Vec3(pos.x, pos.y, pos.z)).x,
-        Vec3::cross(f, Vec3(pos.x, pos.y, pos.z)).x,
-        1
-    };
-    
-    // Camera transformation for FPS view
-    // Player coordinate system: yaw=0 looks +X, yaw=-90 looks -Z
-    // OpenGL default view: looking -Z
-    // We need to offset yaw by 90 degrees to align coordinate systems
-    glRotatef(-player.getPitch(), 1, 0, 0);
-    glRotatef(-player.getYaw() - 90.0f, 0, 1, 0);
-    glTranslatef(-pos.x, -pos.y, -pos.z);
+    occlusion.update(projection * view);
     
     // Render world
     renderWorld();
@@ -412,41 +512,98 @@ void Engine::render() {
     renderPickups();
     renderLimbs();
     
+    if (rasterizer) {
+        rasterizer->render(scene);
+        return;
+    }
+    submitScene();
+    
+    int drawableWidth = 0;
+    int drawableHeight = 0;
+    SDL_GetWindowSizeInPixels(window, &drawableWidth, &drawableHeight);
+    photoCapture.endFrame(drawableWidth, drawableHeight);
     SDL_GL_SwapWindow(window);
 }
 
 void Engine::renderWorld() {
-    drawGrid();
+    // Grid lines only suit the small flat map
+    if (!streamingWorld) {
+        recordGrid();
+    }
+    
+    // Each chunk records into its own scene on a worker; appending them in
+    // chunk order keeps the frame the same for any number of threads.
+    // Chunks beyond the cube radius record nothing.
+    int chunksX = (worldSystem.getWidth() + World::CHUNK_SIZE - 1) / World::CHUNK_SIZE;
+    int chunksZ = (worldSystem.getHeight() + World::CHUNK_SIZE - 1) / World::CHUNK_SIZE;
+    chunkScenes.resize(chunksX * chunksZ);
+    JobSystem::instance().parallelFor(0, chunksX * chunksZ, 1, [&](int first, int last) {
+        for (int chunk = first; chunk < last; chunk++) {
+            chunkScenes[chunk].clear();
+            recordChunk(chunk % chunksX, chunk / chunksX, chunkScenes[chunk]);
+        }
+    });
+    for (const RenderScene& chunkScene : chunkScenes) {
+        scene.append(chunkScene);
+    }
+    
+    recordDistantTerrain(scene.getProjection() * scene.getView());
+}
+
+void Engine::recordDistantTerrain(const Mat4& viewProjection) {
+    // One flat colour per triangle, from the cell under its centre
+    terrainLod.select(player.getPosition(), viewProjection, CUBE_VIEW_RADIUS);
+    terrainLod.buildMesh(lodVertices, lodIndices);
+    for (size_t i = 0; i + 2 < lodIndices.size(); i += 3) {
+        const Vec3& a = lodVertices[lodIndices[i]];
+        const Vec3& b = lodVertices[lodIndices[i + 1]];
+        const Vec3& c = lodVertices[lodIndices[i + 2]];
+        int x = std::min(static_cast<int>((a.x + b.x + c.x) / 3.0f), worldSystem.getWidth() - 1);
+        int z = std::min(static_cast<int>((a.z + b.z + c.z) / 3.0f), worldSystem.getHeight() - 1);
+        Color color = World::getCellTypeColor(worldSystem.getCellType(x, z)) * lightmap.getBrightness(x, z);
+        scene.addTriangle(a, b, c, color);
+    }
+}
+
+void Engine::recordChunk(int chunkX, int chunkZ, RenderScene& out) const {
+    int endX = std::min((chunkX + 1) * World::CHUNK_SIZE, worldSystem.getWidth());
+    int endZ = std::min((chunkZ + 1) * World::CHUNK_SIZE, worldSystem.getHeight());
+    
+    // Whole chunks past the cube radius are left to terrainLod
+    Vec3 eye = player.getPosition();
+    float nearestX = MathUtils::clamp(eye.x, static_cast<float>(chunkX * World::CHUNK_SIZE), static_cast<float>(endX));
+    float nearestZ = MathUtils::clamp(eye.z, static_cast<float>(chunkZ * World::CHUNK_SIZE), static_cast<float>(endZ));
+    float chunkDistanceX = nearestX - eye.x;
+    float chunkDistanceZ = nearestZ - eye.z;
+    if (chunkDistanceX * chunkDistanceX + chunkDistanceZ * chunkDistanceZ > CUBE_VIEW_RADIUS * CUBE_VIEW_RADIUS) return;
     
     // Draw flowers on grid
-    for (int z = 0; z < world.getHeight(); z++) {
-        for (int x = 0; x < world.getWidth(); x++) {
-            Vec3 cellPos(x + 0.5f, 0, z + 0.5f);
+    for (int z = chunkZ * World::CHUNK_SIZE; z < endZ; z++) {
+        for (int x = chunkX * World::CHUNK_SIZE; x < endX; x++) {
+            float dx = x + 0.5f - eye.x;
+            float dz = z + 0.5f - eye.z;
+            if (dx * dx + dz * dz > CUBE_VIEW_RADIUS * CUBE_VIEW_RADIUS) continue;
+            
+            Vec3 cellPos(x + 0.5f, worldSystem.getTerrainHeight(x, z), z + 0.5f);
             
-            WorldGrid::CellType cell = world.getCell(x, z);
+            World::CellType cell = worldSystem.getCellType(x, z);
+            
+            // Skip cells hidden behind hills; the box covers the flower too
+            float flowerTop = (cell == World::CellType::FLOWER) ? 0.5f : 0.0f;
+            if (!occlusion.isVisible(Vec3(x, cellPos.y - 1.0f, z), Vec3(x + 1.0f, cellPos.y + flowerTop, z + 1.0f))) {
+                continue;
+            }
             
-            // Draw ground
-            if (cell == WorldGrid::CellType::GRASS) {
-                drawCube(cellPos, Color(0.3f, 0.7f, 0.3f), 1.0f);
-            } else if (cell == WorldGrid::CellType::DIRT) {
-                drawCube(cellPos, Color(0.5f, 0.3f, 0.2f), 1.0f);
-            } else if (cell == WorldGrid::CellType::FLOWER) {
-                drawCube(cellPos, Color(0.3f, 0.7f, 0.3f), 1.0f);
+            // Draw ground, lit by the baked sun and sky visibility
+            out.addCube(cellPos, World::getCellTypeColor(cell) * lightmap.getBrightness(x, z), 1.0f);
+            
+            if (cell == World::CellType::FLOWER) {
                 // Draw flower on top
                 Vec3 flowerPos = cellPos;
-                flowerPos.y = 0.5f;
-                
-                // Randomize color based on position
-                float hue = (x * 7 + z * 13) % 6;
-                Color flowerColor;
-                if (hue < 1) flowerColor = Color(1.0f, 0.8f, 0.0f);  // Yellow
-                else if (hue < 2) flowerColor = Color(1.0f, 0.2f, 0.3f);  // Red
-                else if (hue < 3) flowerColor = Color(1.0f, 0.4f, 0.6f);  // Pink
-                else if (hue < 4) flowerColor = Color(0.9f, 0.9f, 1.0f);  // White
-                else if (hue < 5) flowerColor = Color(0.6f, 0.3f, 0.9f);  // Purple
-                else flowerColor = Color(1.0f, 0.6f, 0.2f);  // Orange
+                flowerPos.y += 0.5f;
                 
-                drawFlower(flowerPos, flowerColor, 0.3f);
+                Color flowerColor = World::getFlowerSpeciesColor(World::getFlowerSpecies(x, z));
+                out.addFlower(flowerPos, flowerColor, 0.3f);
             }
         }
     }
@@ -456,7 +613,8 @@ void Engine::renderTools() {
     for (auto tool : tools) {
         Vec3 pos = tool->getPosition();
         Color color = tool->getColor();
-        drawCube(pos, color, 0.3f);
+        if (!isCubeVisible(pos, 0.3f)) continue;
+        scene.addCube(pos, color, 0.3f);
     }
 }
 
@@ -466,113 +624,108 @@ void Engine::renderPickups() {
         Color color = pickup->getColor();
         
         // Make pickups bob up and down
-        float bobOffset = std::sin(SDL_GetTicks() / 300.0f) * 0.1f;
-        pos.y += bobOffset;
+        pos.y += pickup->getBobOffset();
         
-        drawCube(pos, color, 0.2f);
+        if (!isCubeVisible(pos, 0.2f)) continue;
+        scene.addCube(pos, color, 0.2f);
     }
 }
 
 void Engine::renderLimbs() {
+    // Limbs past the cube radius are too small to see; drop them four at a
+    // time before the per-limb occlusion test
+    limbPositions.clear();
     for (auto limb : limbs) {
-        Vec3 pos = limb->getPosition();
-        Color color = limb->getColor();
-        drawCube(pos, color, limb->getSize());
+        limbPositions.push_back(limb->getWorldPosition());
+    }
+    limbDistances.resize(limbs.size());
+    limbPositions.distanceSquared(player.getPosition(), limbDistances.data());
+    
+    for (size_t i = 0; i < limbs.size(); i++) {
+        if (limbDistances[i] > CUBE_VIEW_RADIUS * CUBE_VIEW_RADIUS) continue;
+        Vec3 pos = limbPositions.get(i);
+        Color color = limbs[i]->getColor();
+        if (!isCubeVisible(pos, limbs[i]->getSize())) continue;
+        scene.addCube(pos, color, limbs[i]->getSize());
     }
 }
 
-void Engine::drawGrid() {
-    glBegin(GL_LINES);
-    glColor3f(0.2f, 0.5f, 0.2f);
-    
-    // Draw grid lines every 5 units for visibility
+bool Engine::isCubeVisible(const Vec3& top, float size) const {
+    float halfSize = size * 0.5f;
+    return occlusion.isVisible(Vec3(top.x - halfSize, top.y - size, top.z - halfSize), Vec3(top.x + halfSize, top.y, top.z + halfSize));
+}
+
+void Engine::recordGrid() {
+    // Grid lines every 5 units for visibility
+    Color lineColor(0.2f, 0.5f, 0.2f);
     for (int i = 0; i <= world.getWidth(); i += 5) {
-        glVertex3f(i, 0.01f, 0);
-        glVertex3f(i, 0.01f, world.getHeight());
+        scene.addLine(Vec3(i, 0.01f, 0), Vec3(i, 0.01f, world.getHeight()), lineColor);
     }
     
     for (int i = 0; i <= world.getHeight(); i += 5) {
-        glVertex3f(0, 0.01f, i);
-        glVertex3f(world.getWidth(), 0.01f, i);
+        scene.addLine(Vec3(0, 0.01f, i), Vec3(world.getWidth(), 0.01f, i), lineColor);
     }
-    
-    glEnd();
 }
 
-void Engine::drawFlower(const Vec3& position, const Color& color, float size) {
-    glPushMatrix();
-    glTranslatef(position.x, position.y, position.z);
-    
-    // Draw stem (green)
-    glColor4f(0.2f, 0.6f, 0.2f, 1.0f);
-    glBegin(GL_LINES);
-    glVertex3f(0, -0.3f, 0);
-    glVertex3f(0, 0, 0);
-    glEnd();
+void Engine::submitScene() {
+    const Color& background = scene.getBackground();
+    glClearColor(background.r, background.g, background.b, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     
-    // Draw flower head (colored)
-    glColor4f(color.r, color.g, color.b, color.a);
-    glBegin(GL_TRIANGLE_FAN);
-    glVertex3f(0, 0, 0);
-    for (int i = 0; i <= 8; i++) {
-        float angle = i * 3.14159f * 2.0f / 8.0f;
-        glVertex3f(std::cos(angle) * size, 0, std::sin(angle) * size);
+    glMatrixMode(GL_PROJECTION);
+    glLoadMatrixf(scene.getProjection().data());
+    glMatrixMode(GL_MODELVIEW);
+    glLoadMatrixf(scene.getView().data());
+    
+    // Sorted commands; a new glBegin only where the pass or primitive type
+    // changes, and glColor only where the colour does
+    drawList.build(scene);
+    bool open = false;
+    DrawList::Pass pass = DrawList::Pass::SOLID;
+    bool lines = false;
+    uint32_t material = 0;
+    for (const DrawList::Command& command : drawList.getCommands()) {
+        DrawList::Pass commandPass = DrawList::getPass(command.key);
+        int mesh = DrawList::getMesh(command.key);
+        bool commandLines = mesh == DrawList::LINE_MESH;
+        uint32_t commandMaterial = DrawList::getMaterial(command.key);
+        
+        if (!open || commandPass != pass || commandLines != lines) {
+            if (open) glEnd();
+            
+            // Blended objects are depth tested but don't hide each other
+            glDepthMask(commandPass == DrawList::Pass::SOLID ? GL_TRUE : GL_FALSE);
+            glBegin(commandLines ? GL_LINES : GL_TRIANGLES);
+            open = true;
+            pass = commandPass;
+            lines = commandLines;
+            material = ~commandMaterial;
+        }
+        if (commandMaterial != material) {
+            glColor4ub(commandMaterial & 0xFF, (commandMaterial >> 8) & 0xFF, (commandMaterial >> 16) & 0xFF, commandMaterial >> 24);
+            material = commandMaterial;
+        }
+        
+        if (commandLines) {
+            const RenderScene::Line& line = scene.getLines()[command.index];
+            glVertex3f(line.start.x, line.start.y, line.start.z);
+            glVertex3f(line.end.x, line.end.y, line.end.z);
+        } else if (mesh == DrawList::TRIANGLE_MESH) {
+            for (const Vec3& corner : scene.getTriangles()[command.index].corners) {
+                glVertex3f(corner.x, corner.y, corner.z);
+            }
+        } else {
+            // Instances are expanded from their unit mesh
+            const RenderScene::Instance& instance = scene.getInstances()[command.index];
+            const RenderScene::MeshData& meshData = RenderScene::getMesh(instance.mesh);
+            for (uint16_t index : meshData.indices) {
+                Vec3 vertex = meshData.vertices[index] * instance.scale + instance.position;
+                glVertex3f(vertex.x, vertex.y, vertex.z);
+            }
+        }
     }
-    glEnd();
-    
-    glPopMatrix();
-}
-
-void Engine::drawCube(const Vec3& position, const Color& color, float size) {
-    glPushMatrix();
-    glTranslatef(position.x, position.y - size/2, position.z);
-    
-    float s = size / 2.0f;
-    
-    glColor4f(color.r, color.g, color.b, color.a);
-    
-    // Draw cube faces
-    glBegin(GL_QUADS);
-    
-    // Front
-    glVertex3f(-s, -s, s);
-    glVertex3f(s, -s, s);
-    glVertex3f(s, s, s);
-    glVertex3f(-s, s, s);
-    
-    // Back
-    glVertex3f(-s, -s, -s);
-    glVertex3f(-s, s, -s);
-    glVertex3f(s, s, -s);
-    glVertex3f(s, -s, -s);
-    
-    // Top
-    glVertex3f(-s, s, -s);
-    glVertex3f(-s, s, s);
-    glVertex3f(s, s, s);
-    glVertex3f(s, s, -s);
-    
-    // Bottom
-    glVertex3f(-s, -s, -s);
-    glVertex3f(s, -s, -s);
-    glVertex3f(s, -s, s);
-    glVertex3f(-s, -s, s);
-    
-    // Right
-    glVertex3f(s, -s, -s);
-    glVertex3f(s, s, -s);
-    glVertex3f(s, s, s);
-    glVertex3f(s, -s, s);
-    
-    // Left
-    glVertex3f(-s, -s, -s);
-    glVertex3f(-s, -s, s);
-    glVertex3f(-s, s, s);
-    glVertex3f(-s, s, -s);
-    
-    glEnd();
-    
-    glPopMatrix();
+    if (open) glEnd();
+    glDepthMask(GL_TRUE);
 }
 
 // Additional helper methods for enhanced gameplay
@@ -616,11 +769,11 @@ void Engine::spawnFlowerLimbs(const Vec3& flowerPosition) {
 }
 
 void Engine::updateWorldTime(float deltaTime) {
-    // Track game time for day/night cycles (future enhancement)
-    static float gameTime = 0.0f;
-    gameTime += deltaTime;
+    gameTime = std::fmod(gameTime + deltaTime, DAY_LENGTH);
     
-    // Could be used to change lighting, sky color, etc.
+    // The sun rises at the start of the day and sets halfway through; only
+    // the per-frame sun terms change, the baked lightmap stays
+    lightmap.setSunAngle(gameTime / DAY_LENGTH * 2.0f * PI);
 }
 
 void Engine::checkPlayerObjectives() {
@@ -631,15 +784,33 @@ void Engine::checkPlayerObjectives() {
     
     // Milestone notifications
     if (planted == 10 || planted == 25 || planted == 50 || planted == 100) {
-        std::cout << "🌸 Milestone! You've planted " << planted << " flowers!" << std::endl;
+        LOG_INFO("🌸 Milestone! You've planted {} flowers!", planted);
     }
     
     if (watered == 10 || watered == 25 || watered == 50) {
-        std::cout << "💧 Milestone! You've watered " << watered << " flowers!" << std::endl;
+        LOG_INFO("💧 Milestone! You've watered {} flowers!", watered);
     }
     
     if (photos == 5 || photos == 10 || photos == 25) {
-        std::cout << "📷 Milestone! You've taken " << photos << " photographs!" << std::endl;
+        LOG_INFO("📷 Milestone! You've taken {} photographs!", photos);
+    }
+}
+
+void Engine::checkFlowerPatterns(int x, int z) {
+    // Shapes through the planted cell ("Precision Gardener", "The Path",
+    // "The Artist"), each announced the first time it appears
+    for (const auto& count : flowerPatterns.countAround(worldSystem.getFlowerLayer(), x, z)) {
+        if (count.second == 0 || !completedPatterns.insert(count.first).second) continue;
+        
+        if (count.first == "precision_grid") {
+            LOG_INFO("🎯 Precision Gardener! A perfect 5x5 grid of flowers.");
+        } else if (count.first == "path_row" || count.first == "path_column") {
+            LOG_INFO("🌼 The Path! Five flowers in a straight {}.", count.first == "path_row" ? "row" : "column");
+        } else {
+            std::string shape = count.first;
+            std::replace(shape.begin(), shape.end(), '_', ' ');
+            LOG_INFO("🎨 The Artist! Your flowers form a {}.", shape);
+        }
     }
 }
 
@@ -664,6 +835,40 @@ float Engine::calculateFlowerDensity(int gridX, int gridZ, int radius) {
     return static_cast<float>(flowerCount) / static_cast<float>(totalCells);
 }
 
+void Engine::recordPlayerStats() {
+    if (!journal) return;
+    
+    EditJournal::PlayerStats stats;
+    stats.flowersPlanted = player.getFlowersPlanted();
+    stats.flowersWatered = player.getFlowersWatered();
+    stats.photographsTaken = player.getPhotographsTaken();
+    journal->recordPlayerStats(stats);
+}
+
+void Engine::takePhoto() {
+    PhotoScorer::Camera camera;
+    camera.position = player.getPosition();
+    camera.forward = player.getForward();
+    camera.right = player.getRight();
+    camera.up = player.getUp();
+    camera.verticalFov = FIELD_OF_VIEW;
+    camera.aspect = static_cast<float>(WINDOW_WIDTH) / WINDOW_HEIGHT;
+    
+    PhotoScorer::Score score = photoScorer.score(worldSystem, camera);
+    photoCapture.requestCapture(score.total);
+    LOG_INFO("Click! Photo score {}/100 ({} flowers, {} species)",
+             static_cast<int>(score.total), score.visibleFlowers, score.species);
+    
+    // Only beautiful scenes count towards the photographer objective
+    if (score.total >= BEAUTIFUL_PHOTO_SCORE) {
+        player.incrementPhotographsTaken();
+        recordPlayerStats();
+        checkPlayerObjectives();
+    } else if (score.visibleFlowers == 0) {
+        LOG_INFO("Try framing some flowers.");
+    }
+}
+
 void Engine::generateInitialWorld() {
     // Create an initial world with some features
     // Add a few water spots for visual interest
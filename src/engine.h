@@ -5,50 +5,110 @@
 #include "pickup.h"
 #include "limb.h"
 #include "world.h"
+#include "collision_system.h"
+#include "draw_list.h"
+#include "edit_journal.h"
+#include "flower_patterns.h"
+#include "occlusion_culler.h"
+#include "photo_album.h"
+#include "photo_capture.h"
+#include "photo_scorer.h"
+#include "physics_system.h"
+#include "render_scene.h"
+#include "simd_math.h"
+#include "software_rasterizer.h"
+#include "streaming_world.h"
+#include "terrain_lightmap.h"
+#include "terrain_lod.h"
 #include <SDL3/SDL.h>
 #include <vector>
 #include <map>
+#include <memory>
+#include <set>
 
-// Grid-based world map (legacy - kept for compatibility)
+// Grid-based world map (legacy interface). It holds no cells of its own:
+// every call goes straight to the World it views, so both always agree and
+// World's change notifications cover edits made through either.
 class WorldGrid {
 public:
-    WorldGrid(int width, int height);
+    using CellType = World::CellType;
     
-    enum class CellType {
-        GRASS,
-        DIRT,
-        FLOWER,
-        WATER
-    };
+    explicit WorldGrid(World& world);
     
-    void setCell(int x, int z, CellType type);
-    CellType getCell(int x, int z) const;
-    bool isValidPosition(int x, int z) const;
+    void setCell(int x, int z, CellType type) { world.setCell(x, z, type); }
+    CellType getCell(int x, int z) const { return world.getCellType(x, z); }
+    bool isValidPosition(int x, int z) const { return world.isValidPosition(x, z); }
     
-    int getWidth() const { return width; }
-    int getHeight() const { return height; }
+    int getWidth() const { return world.getWidth(); }
+    int getHeight() const { return world.getHeight(); }
     
 private:
-    int width;
-    int height;
-    std::vector<CellType> cells;
+    World& world;
 };
 
 // Main game engine
 class Engine {
 public:
+    // Side length of the bounded world in cells
+    static const int WORLD_SIZE = 50;
+    
+    // Side length of the world StreamingWorld pages terrain into
+    static const int STREAMING_WORLD_SIZE = 2048;
+    
+    // How far from the eye tools can reach, in world units
+    static constexpr float TOOL_REACH = 8.0f;
+    
+    // Window size at startup and the projection's vertical field of view
+    // (degrees); photos are scored through the same frustum
+    static const int WINDOW_WIDTH = 800;
+    static const int WINDOW_HEIGHT = 600;
+    static constexpr float FIELD_OF_VIEW = 60.0f;
+    
+    // Photo score (0-100) a photograph needs to count for the photographer objective
+    static constexpr float BEAUTIFUL_PHOTO_SCORE = 40.0f;
+    
+    // Player collision box around the eye position
+    static constexpr float PLAYER_RADIUS = 0.3f;
+    static constexpr float PLAYER_EYE_HEIGHT = 1.7f;
+    static constexpr float PLAYER_HEAD_ROOM = 0.1f;
+    
+    // Seconds of play per day/night cycle
+    static constexpr float DAY_LENGTH = 240.0f;
+    
+    // Cells within this distance of the player are drawn as cubes with their
+    // flowers; terrain beyond is drawn by terrainLod up to VIEW_DISTANCE
+    static constexpr float CUBE_VIEW_RADIUS = 64.0f;
+    static constexpr float VIEW_DISTANCE = 1000.0f;
+    
     Engine();
     ~Engine();
     
+    // Stream a large generated world around the player instead of the
+    // fixed-size map. Must be called before initialize().
+    void setStreamingMode(bool enabled) { streamingEnabled = enabled; }
+    
+    // Where the fixed-size map is kept between sessions; empty to not save.
+    // Streaming saves its own chunks, so this is ignored there.
+    void setSaveDirectory(const std::string& directory) { saveDirectory = directory; }
+    
+    // Render frames with SoftwareRasterizer instead of opening a window:
+    // run() steps 'frames' frames at 60 Hz without input, prints the frame
+    // times and writes the last frame to imagePath (PPM) unless it is empty.
+    // Must be called before initialize().
+    void setHeadless(int frames, const std::string& imagePath);
+    
     bool initialize();
     void run();
     void shutdown();
     
     Player& getPlayer() { return player; }
     WorldGrid& getWorld() { return world; }
-    World& getWorldSystem() { return worldSystem; }  // New world system
+    World& getWorldSystem() { return worldSystem; }
+    StreamingWorld* getStreamingWorld() { return streamingWorld.get(); }  // Null unless streaming
     
 private:
+    bool createWindow();
+    void runHeadless();
     void handleEvents();
     void update(float deltaTime);
     void render();
@@ -58,31 +118,66 @@ private:
     
     // Rendering helpers
     void renderWorld();
+    void recordChunk(int chunkX, int chunkZ, RenderScene& out) const;
+    void recordDistantTerrain(const Mat4& viewProjection);
     void renderTools();
     void renderPickups();
     void renderLimbs();
     void renderHUD();
-    void drawGrid();
-    void drawFlower(const Vec3& position, const Color& color, float size);
-    void drawCube(const Vec3& position, const Color& color, float size);
+    void recordGrid();
+    bool isCubeVisible(const Vec3& top, float size) const;   // Same box as RenderScene::addCube
+    void submitScene();   // Draws the recorded scene with OpenGL
     
     // Gameplay helpers
     void spawnFlowerLimbs(const Vec3& flowerPosition);
     void updateWorldTime(float deltaTime);
     void checkPlayerObjectives();
+    void checkFlowerPatterns(int x, int z);   // After planting at (x, z)
     float calculateFlowerDensity(int gridX, int gridZ, int radius);
     void generateInitialWorld();
+    void recordPlayerStats();
+    void takePhoto();
     
     SDL_Window* window;
     SDL_GLContext glContext;
+    Mat4 projection;
+    RenderScene scene;       // This frame's draw submission, rebuilt by render()
+    std::vector<RenderScene> chunkScenes;  // Per worldSystem chunk, recorded in parallel
+    DrawList drawList;       // scene in OpenGL submission order
+    int headlessFrames;      // Frames run() renders without a window; 0 with a window
+    std::string headlessImagePath;
+    std::unique_ptr<SoftwareRasterizer> rasterizer;  // Draws scene when headless
     
     Player player;
-    WorldGrid world;         // Legacy grid system
-    World worldSystem;       // New enhanced world system with entities and slopes
+    World worldSystem;       // Authoritative cell store with entities and slopes
+    WorldGrid world;         // Legacy view of worldSystem
+    bool streamingEnabled;
+    std::string saveDirectory;
+    std::unique_ptr<StreamingWorld> streamingWorld;  // Pages terrain into worldSystem
+    std::unique_ptr<EditJournal> journal;  // Saves worldSystem edits as they happen
+    PhotoScorer photoScorer;
+    PatternRegistry flowerPatterns;         // Shapes the objectives look for in the flower layer
+    std::set<std::string> completedPatterns;
+    PhotoAlbum photoAlbum;                  // Photographs saved to photos/
+    PhotoCapture photoCapture;              // Reads frames back for photoAlbum
+    CollisionSystem collision;              // Keeps the player and physics bodies out of terrain and entities
+    PhysicsSystem physics;                  // Moves DYNAMIC entities of worldSystem
+    TerrainLightmap lightmap;               // Baked sun and sky visibility of worldSystem
+    OcclusionCuller occlusion;              // Skips objects hidden behind worldSystem's terrain
+    TerrainLod terrainLod;                  // worldSystem's terrain past CUBE_VIEW_RADIUS
+    std::vector<Vec3> lodVertices;
+    std::vector<uint32_t> lodIndices;
+    float gameTime;                         // Seconds into the current day
     
     std::vector<Tool*> tools;
+    bool hasCamera;                         // Photos need the CAMERA tool picked up
     std::vector<Pickup*> pickups;
     std::vector<Limb*> limbs;
+    std::vector<float> limbPhases;          // Limb::PHASE_COUNT per limb, reused every frame
+    std::vector<float> limbSines;
+    std::vector<float> limbCosines;
+    Vec3Batch limbPositions;                // World positions, gathered for the distance test
+    std::vector<float> limbDistances;       // Squared distance of each limb from the eye
     
     bool running;
     bool mouseCaptured;
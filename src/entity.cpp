@@ -36,14 +36,9 @@ Entity::Entity(const Vec3& position, const Vec3& rotation, const Vec3& scale)
 Entity::~Entity() {
 }
 
-void Entity::update(float deltaTime) {
-    // Base entity update - override in derived classes for specific behavior
-    
-    // Apply velocity if dynamic
-    if (type == Type::DYNAMIC && active) {
-        position += velocity * deltaTime;
-        updateBoundingBox();
-    }
+void Entity::update(float /*deltaTime*/) {
+    // Base entity update - override in derived classes for specific behavior.
+    // Motion of DYNAMIC entities is integrated in batches by PhysicsSystem.
 }
 
 void Entity::setPosition(const Vec3& pos) {
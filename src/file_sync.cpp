@@ -0,0 +1,54 @@
+#include "file_sync.h"
+#include <filesystem>
+#include <system_error>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace FileSync {
+
+bool syncFile(FILE* file) {
+    if (std::fflush(file) != 0) return false;
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+bool syncPath(const std::string& path) {
+    // Windows only flushes handles opened for writing
+    FILE* file = std::fopen(path.c_str(), "r+b");
+    if (!file) return false;
+    bool synced = syncFile(file);
+    std::fclose(file);
+    return synced;
+}
+
+bool syncDirectory(const std::string& path) {
+#ifdef _WIN32
+    (void)path;
+    return true;
+#else
+    int descriptor = ::open(path.empty() ? "." : path.c_str(), O_RDONLY);
+    if (descriptor < 0) return false;
+    bool synced = fsync(descriptor) == 0;
+    ::close(descriptor);
+    return synced;
+#endif
+}
+
+bool replaceFile(const std::string& tempPath, const std::string& path) {
+    if (!syncPath(tempPath)) return false;
+    
+    std::error_code error;
+    std::filesystem::rename(tempPath, path, error);
+    if (error) return false;
+    return syncDirectory(std::filesystem::path(path).parent_path().string());
+}
+
+}  // namespace FileSync
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+// Durable file writes. Closing a file does not put its data on disk, so
+// anything that must survive a power loss is written to a temporary file,
+// synced, and renamed over the old one; the rename is synced through the
+// directory afterwards.
+namespace FileSync {
+    // Flush stdio buffers and sync the file to disk
+    bool syncFile(FILE* file);
+    
+    // Sync a file that has already been closed
+    bool syncPath(const std::string& path);
+    
+    // Sync a directory so entries created or renamed in it are durable.
+    // Windows has no equivalent, and NTFS journals renames itself.
+    bool syncDirectory(const std::string& path);
+    
+    // Sync tempPath, rename it over path and sync the directory
+    bool replaceFile(const std::string& tempPath, const std::string& path);
+}
@@ -0,0 +1,46 @@
+#include "flower_bitboard.h"
+#include <algorithm>
+#include <bitset>
+
+FlowerBitboard::FlowerBitboard(int width, int height)
+    : width(width)
+    , height(height)
+    , wordsPerRow((width + 63) / 64 + 1)
+{
+    words.resize(static_cast<size_t>(wordsPerRow) * height, 0);
+}
+
+void FlowerBitboard::set(int x, int z) {
+    if (x < 0 || x >= width || z < 0 || z >= height) return;
+    words[static_cast<size_t>(z) * wordsPerRow + (x >> 6)] |= (uint64_t(1) << (x & 63));
+}
+
+void FlowerBitboard::clear(int x, int z) {
+    if (x < 0 || x >= width || z < 0 || z >= height) return;
+    words[static_cast<size_t>(z) * wordsPerRow + (x >> 6)] &= ~(uint64_t(1) << (x & 63));
+}
+
+void FlowerBitboard::assign(int x, int z, bool flower) {
+    if (flower) {
+        set(x, z);
+    } else {
+        clear(x, z);
+    }
+}
+
+bool FlowerBitboard::test(int x, int z) const {
+    if (x < 0 || x >= width || z < 0 || z >= height) return false;
+    return (words[static_cast<size_t>(z) * wordsPerRow + (x >> 6)] >> (x & 63)) & 1;
+}
+
+void FlowerBitboard::clearAll() {
+    std::fill(words.begin(), words.end(), 0);
+}
+
+int FlowerBitboard::count() const {
+    int total = 0;
+    for (uint64_t word : words) {
+        total += static_cast<int>(std::bitset<64>(word).count());
+    }
+    return total;
+}
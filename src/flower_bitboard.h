@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// FlowerBitboard mirrors flower occupancy of the world as packed bits,
+// 64 cells per word, one row of words per grid row.
+// Bit (x % 64) of word (x / 64) in row z is set when cell (x, z) holds a flower.
+// Every row carries one extra zero word at its end so that pattern kernels
+// can always read the word following the one they work on.
+class FlowerBitboard {
+public:
+    FlowerBitboard(int width, int height);
+    
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getWordsPerRow() const { return wordsPerRow; }
+    
+    // Number of words that hold cells (excluding the padding word)
+    int getUsedWordsPerRow() const { return wordsPerRow - 1; }
+    
+    void set(int x, int z);
+    void clear(int x, int z);
+    void assign(int x, int z, bool flower);
+    bool test(int x, int z) const;
+    void clearAll();
+    
+    // Total number of flowers on the board
+    int count() const;
+    
+    const uint64_t* row(int z) const { return &words[static_cast<size_t>(z) * wordsPerRow]; }
+
+private:
+    int width;
+    int height;
+    int wordsPerRow;
+    std::vector<uint64_t> words;
+};
@@ -0,0 +1,294 @@
+#include "flower_patterns.h"
+#include "cpu_features.h"
+#include <algorithm>
+#include <bitset>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+
+// acc[i] &= (row shifted right by 'shift' bits) ^ invert, over 'words' words.
+// Shifting right by c moves cell x + c onto bit x, so after AND-ing one
+// shifted row per template cell, bit x survives only where the template fits.
+typedef void (*AndShiftedKernel)(uint64_t* acc, const uint64_t* row, int words,
+                                 int shift, uint64_t invert);
+
+void andShiftedScalar(uint64_t* acc, const uint64_t* row, int words, int shift, uint64_t invert) {
+    for (int i = 0; i < words; i++) {
+        uint64_t carry = shift ? (row[i + 1] << (64 - shift)) : 0;
+        acc[i] &= ((row[i] >> shift) | carry) ^ invert;
+    }
+}
+
+#ifdef FLOWER_X86
+// Vector shifts by 64 produce zero, so shift == 0 needs no special case
+void andShiftedSSE2(uint64_t* acc, const uint64_t* row, int words, int shift, uint64_t invert) {
+    __m128i countRight = _mm_cvtsi32_si128(shift);
+    __m128i countLeft = _mm_cvtsi32_si128(64 - shift);
+    __m128i inv = _mm_set1_epi64x(static_cast<long long>(invert));
+    
+    int i = 0;
+    for (; i + 2 <= words; i += 2) {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i + 1));
+        __m128i shifted = _mm_or_si128(_mm_srl_epi64(lo, countRight), _mm_sll_epi64(hi, countLeft));
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + i));
+        a = _mm_and_si128(a, _mm_xor_si128(shifted, inv));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + i), a);
+    }
+    andShiftedScalar(acc + i, row + i, words - i, shift, invert);
+}
+
+FLOWER_TARGET_AVX2
+void andShiftedAVX2(uint64_t* acc, const uint64_t* row, int words, int shift, uint64_t invert) {
+    __m128i countRight = _mm_cvtsi32_si128(shift);
+    __m128i countLeft = _mm_cvtsi32_si128(64 - shift);
+    __m256i inv = _mm256_set1_epi64x(static_cast<long long>(invert));
+    
+    int i = 0;
+    for (; i + 4 <= words; i += 4) {
+        __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+        __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i + 1));
+        __m256i shifted = _mm256_or_si256(_mm256_srl_epi64(lo, countRight),
+                                          _mm256_sll_epi64(hi, countLeft));
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + i));
+        a = _mm256_and_si256(a, _mm256_xor_si256(shifted, inv));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + i), a);
+    }
+    andShiftedScalar(acc + i, row + i, words - i, shift, invert);
+}
+#endif
+
+AndShiftedKernel selectKernel() {
+#ifdef FLOWER_X86
+    const CpuFeatures& cpu = getCpuFeatures();
+    if (cpu.avx2) return andShiftedAVX2;
+    if (cpu.sse2) return andShiftedSSE2;
+#endif
+    return andShiftedScalar;
+}
+
+int popcount64(uint64_t value) {
+    return static_cast<int>(std::bitset<64>(value).count());
+}
+
+int countTrailingZeros(uint64_t value) {
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return static_cast<int>(index);
+#elif defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(value);
+#else
+    int index = 0;
+    while (!(value & 1)) {
+        value >>= 1;
+        index++;
+    }
+    return index;
+#endif
+}
+
+bool isFlowerChar(char c) {
+    return c == 'X' || c == 'x' || c == '#' || c == '*';
+}
+
+}  // namespace
+
+bool FlowerPattern::fromStrings(const std::string& name, const std::vector<std::string>& lines,
+                                bool exact, FlowerPattern& out) {
+    int patternWidth = 0;
+    for (const auto& line : lines) {
+        patternWidth = std::max(patternWidth, static_cast<int>(line.size()));
+    }
+    if (lines.empty() || patternWidth == 0 || patternWidth > MAX_WIDTH) {
+        return false;
+    }
+    
+    FlowerPattern pattern;
+    pattern.name = name;
+    pattern.width = patternWidth;
+    pattern.height = static_cast<int>(lines.size());
+    pattern.exact = exact;
+    
+    bool hasFlower = false;
+    for (const auto& line : lines) {
+        uint64_t bits = 0;
+        for (size_t c = 0; c < line.size(); c++) {
+            if (isFlowerChar(line[c])) {
+                bits |= uint64_t(1) << c;
+                hasFlower = true;
+            }
+        }
+        pattern.rows.push_back(bits);
+    }
+    
+    if (!hasFlower) {
+        return false;
+    }
+    
+    out = pattern;
+    return true;
+}
+
+int FlowerPatterns::findAll(const FlowerBitboard& board, const FlowerPattern& pattern,
+                            std::vector<GridPos>* matches) {
+    static const AndShiftedKernel andShifted = selectKernel();
+    
+    if (pattern.width <= 0 || pattern.height <= 0 ||
+        pattern.width > board.getWidth() || pattern.height > board.getHeight()) {
+        return 0;
+    }
+    
+    const int words = board.getUsedWordsPerRow();
+    
+    // Anchors are only valid where the whole template stays inside the board
+    const int lastAnchorX = board.getWidth() - pattern.width;
+    std::vector<uint64_t> validMask(words, 0);
+    for (int i = 0; i < words; i++) {
+        int firstX = i * 64;
+        if (firstX > lastAnchorX) break;
+        int validBits = std::min(64, lastAnchorX - firstX + 1);
+        validMask[i] = validBits == 64 ? ~uint64_t(0) : ((uint64_t(1) << validBits) - 1);
+    }
+    
+    std::vector<uint64_t> acc(words);
+    int total = 0;
+    
+    for (int z = 0; z + pattern.height <= board.getHeight(); z++) {
+        acc = validMask;
+        bool alive = true;
+        
+        for (int r = 0; r < pattern.height && alive; r++) {
+            const uint64_t* row = board.row(z + r);
+            uint64_t bits = pattern.rows[r];
+            
+            for (int c = 0; c < pattern.width; c++) {
+                if ((bits >> c) & 1) {
+                    andShifted(acc.data(), row, words, c, 0);
+                } else if (pattern.exact) {
+                    andShifted(acc.data(), row, words, c, ~uint64_t(0));
+                }
+            }
+            
+            // Stop early once no anchor in this row can match any more
+            alive = false;
+            for (int i = 0; i < words; i++) {
+                if (acc[i]) {
+                    alive = true;
+                    break;
+                }
+            }
+        }
+        
+        if (!alive) continue;
+        
+        for (int i = 0; i < words; i++) {
+            uint64_t word = acc[i];
+            total += popcount64(word);
+            if (matches) {
+                while (word) {
+                    matches->push_back(GridPos(i * 64 + countTrailingZeros(word), z));
+                    word &= word - 1;
+                }
+            }
+        }
+    }
+    
+    return total;
+}
+
+PatternRegistry::PatternRegistry() {
+    registerDefaults();
+}
+
+bool PatternRegistry::registerPattern(const std::string& name, const std::vector<std::string>& lines,
+                                      bool exact) {
+    FlowerPattern pattern;
+    if (!FlowerPattern::fromStrings(name, lines, exact, pattern)) {
+        return false;
+    }
+    patterns[name] = pattern;
+    return true;
+}
+
+void PatternRegistry::registerPattern(const FlowerPattern& pattern) {
+    patterns[pattern.name] = pattern;
+}
+
+bool PatternRegistry::unregisterPattern(const std::string& name) {
+    return patterns.erase(name) > 0;
+}
+
+const FlowerPattern* PatternRegistry::getPattern(const std::string& name) const {
+    auto it = patterns.find(name);
+    if (it == patterns.end()) {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+std::map<std::string, int> PatternRegistry::countAll(const FlowerBitboard& board) const {
+    std::map<std::string, int> counts;
+    for (const auto& entry : patterns) {
+        counts[entry.first] = FlowerPatterns::findAll(board, entry.second);
+    }
+    return counts;
+}
+
+std::map<std::string, int> PatternRegistry::countAround(const FlowerBitboard& board, int x, int z) const {
+    int reachX = 0, reachZ = 0;
+    for (const auto& entry : patterns) {
+        reachX = std::max(reachX, entry.second.width - 1);
+        reachZ = std::max(reachZ, entry.second.height - 1);
+    }
+    
+    // Copy the neighbourhood into a small board; every match that covers
+    // (x, z) lies entirely inside it
+    int x0 = std::max(0, x - reachX), x1 = std::min(board.getWidth() - 1, x + reachX);
+    int z0 = std::max(0, z - reachZ), z1 = std::min(board.getHeight() - 1, z + reachZ);
+    if (x0 > x1 || z0 > z1) return std::map<std::string, int>();
+    
+    FlowerBitboard window(x1 - x0 + 1, z1 - z0 + 1);
+    for (int wz = z0; wz <= z1; wz++) {
+        for (int wx = x0; wx <= x1; wx++) {
+            if (board.test(wx, wz)) window.set(wx - x0, wz - z0);
+        }
+    }
+    return countAll(window);
+}
+
+void PatternRegistry::registerDefaults() {
+    // "Precision Gardener" objective: a perfect 5x5 grid of flowers
+    registerPattern("precision_grid", {
+        "XXXXX",
+        "XXXXX",
+        "XXXXX",
+        "XXXXX",
+        "XXXXX"
+    });
+    
+    // Pixel-art shapes suggested for "The Artist"
+    registerPattern("heart", {
+        ".XX.XX.",
+        "XXXXXXX",
+        "XXXXXXX",
+        ".XXXXX.",
+        "..XXX..",
+        "...X..."
+    }, true);
+    
+    registerPattern("smiley", {
+        ".X.X.",
+        ".X.X.",
+        ".....",
+        "X...X",
+        ".XXX."
+    }, true);
+    
+    // Straight segments of "The Path"
+    registerPattern("path_row", {"XXXXX"});
+    registerPattern("path_column", {"X", "X", "X", "X", "X"});
+}
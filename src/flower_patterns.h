@@ -0,0 +1,65 @@
+#pragma once
+
+#include "flower_bitboard.h"
+#include "math_utils.h"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// FlowerPattern is a small template of flower cells (e.g. the 5x5
+// "Precision Gardener" grid or pixel-art shapes from OBJECTIVES.md).
+// Bit c of rows[r] is set when the template needs a flower at (c, r)
+// relative to its top-left corner.
+struct FlowerPattern {
+    static const int MAX_WIDTH = 64;
+    
+    std::string name;
+    int width;
+    int height;
+    bool exact;                  // Empty template cells must also be empty in the world
+    std::vector<uint64_t> rows;
+    
+    FlowerPattern() : width(0), height(0), exact(false) {}
+    
+    // Build a template from text rows, where 'X', '#' or '*' marks a flower
+    // and any other character an empty cell. Returns false for templates that
+    // are empty or wider than MAX_WIDTH.
+    static bool fromStrings(const std::string& name, const std::vector<std::string>& lines,
+                            bool exact, FlowerPattern& out);
+};
+
+namespace FlowerPatterns {
+    // Find every occurrence of the pattern on the board using shifted-AND
+    // convolution over whole rows of bits. Returns the number of matches and
+    // optionally their top-left grid positions.
+    int findAll(const FlowerBitboard& board, const FlowerPattern& pattern,
+                std::vector<GridPos>* matches = nullptr);
+}
+
+// PatternRegistry holds the named templates that designers can query.
+// The built-in objective shapes are registered on construction.
+class PatternRegistry {
+public:
+    PatternRegistry();
+    
+    bool registerPattern(const std::string& name, const std::vector<std::string>& lines,
+                         bool exact = false);
+    void registerPattern(const FlowerPattern& pattern);
+    bool unregisterPattern(const std::string& name);
+    
+    const FlowerPattern* getPattern(const std::string& name) const;
+    const std::map<std::string, FlowerPattern>& getPatterns() const { return patterns; }
+    
+    // Count occurrences of every registered pattern
+    std::map<std::string, int> countAll(const FlowerBitboard& board) const;
+    
+    // Same, but only over the window of cells a pattern covering (x, z)
+    // could span, so a single edit doesn't rescan the whole board
+    std::map<std::string, int> countAround(const FlowerBitboard& board, int x, int z) const;
+
+private:
+    void registerDefaults();
+    
+    std::map<std::string, FlowerPattern> patterns;
+};
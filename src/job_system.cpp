@@ -0,0 +1,118 @@
+#include "job_system.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+JobSystem::JobSystem(unsigned workerCount)
+    : stopping(false)
+{
+    if (workerCount == 0) {
+        unsigned hardwareThreads = std::thread::hardware_concurrency();
+        workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+    }
+    
+    for (unsigned i = 0; i < workerCount; i++) {
+        workers.emplace_back(&JobSystem::workerLoop, this);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    taskAvailable.notify_all();
+    
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+JobSystem& JobSystem::instance() {
+    static JobSystem pool;
+    return pool;
+}
+
+void JobSystem::workerLoop() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            taskAvailable.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+void JobSystem::submit(std::function<void()> task) {
+    if (workers.empty()) {
+        task();
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    taskAvailable.notify_one();
+}
+
+void JobSystem::parallelFor(int begin, int end, int grainSize, const std::function<void(int, int)>& fn) {
+    if (end <= begin) return;
+    grainSize = std::max(1, grainSize);
+    
+    int rangeCount = (end - begin + grainSize - 1) / grainSize;
+    if (rangeCount == 1 || workers.empty()) {
+        for (int start = begin; start < end; start += grainSize) {
+            fn(start, std::min(start + grainSize, end));
+        }
+        return;
+    }
+    
+    // Shared so helpers that start after the loop has finished stay valid
+    struct LoopState {
+        std::atomic<int> nextRange;
+        std::atomic<int> finishedRanges;
+        std::mutex doneMutex;
+        std::condition_variable done;
+    };
+    auto state = std::make_shared<LoopState>();
+    state->nextRange = 0;
+    state->finishedRanges = 0;
+    
+    const std::function<void(int, int)>* body = &fn;
+    auto runRanges = [state, body, begin, end, grainSize, rangeCount]() {
+        for (;;) {
+            int range = state->nextRange.fetch_add(1);
+            if (range >= rangeCount) return;
+            
+            int start = begin + range * grainSize;
+            (*body)(start, std::min(start + grainSize, end));
+            
+            if (state->finishedRanges.fetch_add(1) + 1 == rangeCount) {
+                std::lock_guard<std::mutex> lock(state->doneMutex);
+                state->done.notify_all();
+            }
+        }
+    };
+    
+    int helperCount = std::min(static_cast<int>(workers.size()), rangeCount - 1);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int i = 0; i < helperCount; i++) {
+            tasks.push_back(runRanges);
+        }
+    }
+    taskAvailable.notify_all();
+    
+    // The caller works too, then waits for ranges claimed by helpers
+    runRanges();
+    
+    std::unique_lock<std::mutex> lock(state->doneMutex);
+    state->done.wait(lock, [&state, rangeCount] { return state->finishedRanges.load() == rangeCount; });
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// JobSystem is a small pool of worker threads shared by the engine for
+// data-parallel work such as terrain generation. The calling thread always
+// takes part in parallelFor, so it also works with zero workers.
+class JobSystem {
+public:
+    // workerCount of 0 picks one worker per hardware thread, minus the caller
+    explicit JobSystem(unsigned workerCount = 0);
+    ~JobSystem();
+    
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+    
+    // Process-wide pool used by the world and engine systems
+    static JobSystem& instance();
+    
+    unsigned getWorkerCount() const { return static_cast<unsigned>(workers.size()); }
+    
+    // Split [begin, end) into ranges of at most grainSize elements and run
+    // fn(rangeBegin, rangeEnd) on the workers and the calling thread.
+    // Returns once every range has finished.
+    void parallelFor(int begin, int end, int grainSize, const std::function<void(int, int)>& fn);
+    
+    // Queue a fire-and-forget task for the workers (runs inline without workers)
+    void submit(std::function<void()> task);
+
+private:
+    void workerLoop();
+    
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable taskAvailable;
+    bool stopping;
+};
@@ -0,0 +1,248 @@
+#include "light_grid.h"
+#include "job_system.h"
+#include "world.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+LightGrid::LightGrid(const Settings& settings)
+    : settings(settings)
+    , inverseClusterSize(1.0f / settings.clusterSize)
+    , bucketMask(0)
+{
+}
+
+uint32_t LightGrid::bucketOf(int clusterX, int clusterY, int clusterZ) const {
+    uint32_t hash = static_cast<uint32_t>(clusterX) * 73856093u ^
+                    static_cast<uint32_t>(clusterY) * 19349663u ^
+                    static_cast<uint32_t>(clusterZ) * 83492791u;
+    return hash & bucketMask;
+}
+
+void LightGrid::rebuild(const std::vector<PointLight>& lights) {
+    for (std::vector<float>* column : { &lightX, &lightY, &lightZ, &radiusSquared, &inverseRadius,
+                                        &lightRed, &lightGreen, &lightBlue }) {
+        column->clear();
+    }
+    entries.clear();
+    globalLights.clear();
+    
+    for (const PointLight& light : lights) {
+        if (light.radius <= 0.0f) continue;
+        
+        int index = static_cast<int>(lightX.size());
+        const Vec3& p = light.position;
+        float r = light.radius;
+        lightX.push_back(p.x);
+        lightY.push_back(p.y);
+        lightZ.push_back(p.z);
+        radiusSquared.push_back(r * r);
+        inverseRadius.push_back(1.0f / r);
+        lightRed.push_back(light.color.r * light.intensity);
+        lightGreen.push_back(light.color.g * light.intensity);
+        lightBlue.push_back(light.color.b * light.intensity);
+        
+        int x0 = clusterCoord(p.x - r), x1 = clusterCoord(p.x + r);
+        int y0 = clusterCoord(p.y - r), y1 = clusterCoord(p.y + r);
+        int z0 = clusterCoord(p.z - r), z1 = clusterCoord(p.z + r);
+        long long span = static_cast<long long>(x1 - x0 + 1) * (y1 - y0 + 1) * (z1 - z0 + 1);
+        if (span > settings.maxClustersPerLight) {
+            globalLights.push_back(index);
+            continue;
+        }
+        
+        for (int cz = z0; cz <= z1; cz++) {
+            for (int cy = y0; cy <= y1; cy++) {
+                for (int cx = x0; cx <= x1; cx++) {
+                    // Skip the corners of the bounding box the sphere misses
+                    float nearX = MathUtils::clamp(p.x, cx * settings.clusterSize, (cx + 1) * settings.clusterSize);
+                    float nearY = MathUtils::clamp(p.y, cy * settings.clusterSize, (cy + 1) * settings.clusterSize);
+                    float nearZ = MathUtils::clamp(p.z, cz * settings.clusterSize, (cz + 1) * settings.clusterSize);
+                    if (Vec3(nearX, nearY, nearZ).distanceSquared(p) >= r * r) continue;
+                    entries.push_back({ index, cx, cy, cz });
+                }
+            }
+        }
+    }
+    
+    // About two buckets per entry keeps hash collisions between clusters rare
+    uint32_t bucketCount = 16;
+    while (bucketCount < entries.size() * 2) bucketCount *= 2;
+    bucketMask = bucketCount - 1;
+    
+    // Counting sort of the entries by bucket
+    bucketStarts.assign(bucketCount + 1, 0);
+    for (const ClusterEntry& entry : entries) {
+        bucketStarts[bucketOf(entry.clusterX, entry.clusterY, entry.clusterZ) + 1]++;
+    }
+    for (uint32_t bucket = 0; bucket < bucketCount; bucket++) {
+        bucketStarts[bucket + 1] += bucketStarts[bucket];
+    }
+    
+    std::vector<ClusterEntry> sorted(entries.size());
+    std::vector<uint32_t> cursor(bucketStarts.begin(), bucketStarts.end() - 1);
+    for (const ClusterEntry& entry : entries) {
+        sorted[cursor[bucketOf(entry.clusterX, entry.clusterY, entry.clusterZ)]++] = entry;
+    }
+    entries.swap(sorted);
+}
+
+void LightGrid::gatherCluster(int clusterX, int clusterY, int clusterZ, std::vector<int>& out) const {
+    if (entries.empty()) return;
+    
+    uint32_t bucket = bucketOf(clusterX, clusterY, clusterZ);
+    for (uint32_t i = bucketStarts[bucket]; i < bucketStarts[bucket + 1]; i++) {
+        const ClusterEntry& entry = entries[i];
+        if (entry.clusterX == clusterX && entry.clusterY == clusterY && entry.clusterZ == clusterZ) {
+            out.push_back(entry.light);
+        }
+    }
+}
+
+void LightGrid::accumulate(const Vec3& position, const int* candidates, size_t count,
+                           float& red, float& green, float& blue) const {
+    for (size_t i = 0; i < count; i++) {
+        int light = candidates[i];
+        float dx = lightX[light] - position.x;
+        float dy = lightY[light] - position.y;
+        float dz = lightZ[light] - position.z;
+        float distanceSquared = dx * dx + dy * dy + dz * dz;
+        if (distanceSquared >= radiusSquared[light]) continue;
+        
+        // Linear falloff, 1 at the light and 0 at its radius
+        float attenuation = 1.0f - std::sqrt(distanceSquared) * inverseRadius[light];
+        red += lightRed[light] * attenuation;
+        green += lightGreen[light] * attenuation;
+        blue += lightBlue[light] * attenuation;
+    }
+}
+
+Color LightGrid::shade(const Vec3& position) const {
+    float red = 0.0f, green = 0.0f, blue = 0.0f;
+    
+    if (!entries.empty()) {
+        int clusterX = clusterCoord(position.x);
+        int clusterY = clusterCoord(position.y);
+        int clusterZ = clusterCoord(position.z);
+        uint32_t bucket = bucketOf(clusterX, clusterY, clusterZ);
+        for (uint32_t i = bucketStarts[bucket]; i < bucketStarts[bucket + 1]; i++) {
+            const ClusterEntry& entry = entries[i];
+            if (entry.clusterX == clusterX && entry.clusterY == clusterY && entry.clusterZ == clusterZ) {
+                accumulate(position, &entry.light, 1, red, green, blue);
+            }
+        }
+    }
+    accumulate(position, globalLights.data(), globalLights.size(), red, green, blue);
+    
+    return Color(std::min(1.0f, red), std::min(1.0f, green), std::min(1.0f, blue));
+}
+
+void LightGrid::shadeBatch(const Vec3* positions, Color* out, size_t count) const {
+    std::vector<int> candidates;
+    bool haveCluster = false;
+    int clusterX = 0, clusterY = 0, clusterZ = 0;
+    
+    for (size_t i = 0; i < count; i++) {
+        const Vec3& position = positions[i];
+        int x = clusterCoord(position.x);
+        int y = clusterCoord(position.y);
+        int z = clusterCoord(position.z);
+        if (!haveCluster || x != clusterX || y != clusterY || z != clusterZ) {
+            candidates.clear();
+            gatherCluster(x, y, z, candidates);
+            candidates.insert(candidates.end(), globalLights.begin(), globalLights.end());
+            haveCluster = true;
+            clusterX = x;
+            clusterY = y;
+            clusterZ = z;
+        }
+        
+        float red = 0.0f, green = 0.0f, blue = 0.0f;
+        accumulate(position, candidates.data(), candidates.size(), red, green, blue);
+        out[i] = Color(std::min(1.0f, red), std::min(1.0f, green), std::min(1.0f, blue));
+    }
+}
+
+bool LightGrid::runBenchmark() {
+    const int WORLD_SIDE = 256;
+    const int LIGHT_COUNT = 10000;
+    
+    // Fireflies and lanterns scattered a little above hilly terrain; the
+    // world's default light stays in and exercises the global list
+    World world(WORLD_SIDE, WORLD_SIDE);
+    world.generateHillyTerrain();
+    
+    std::mt19937 rng(2024);
+    std::uniform_real_distribution<float> coordinate(0.0f, static_cast<float>(WORLD_SIDE));
+    std::uniform_real_distribution<float> lift(0.5f, 3.0f);
+    std::uniform_real_distribution<float> radius(1.5f, 6.0f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (int i = 0; i < LIGHT_COUNT; i++) {
+        float x = coordinate(rng);
+        float z = coordinate(rng);
+        Vec3 position(x, world.getTerrainHeight(Vec3(x, 0.0f, z)) + lift(rng), z);
+        Color color(1.0f, 0.6f + 0.4f * unit(rng), 0.2f + 0.3f * unit(rng));
+        world.addLight(PointLight(position, color, 0.3f + 0.7f * unit(rng), radius(rng)));
+    }
+    
+    typedef std::chrono::steady_clock Clock;
+    const std::vector<World::Light>& lights = world.getLights();
+    size_t cellCount = static_cast<size_t>(WORLD_SIDE) * WORLD_SIDE;
+    
+    // Reference: every light for every cell, as calculateLightingAt used to
+    std::vector<Color> reference(cellCount);
+    Clock::time_point start = Clock::now();
+    JobSystem::instance().parallelFor(0, WORLD_SIDE, 4, [&](int first, int last) {
+        for (int z = first; z < last; z++) {
+            for (int x = 0; x < WORLD_SIDE; x++) {
+                Vec3 position = world.gridToWorld(x, z);
+                Color total = Color::black();
+                for (const World::Light& light : lights) {
+                    float distance = light.position.distance(position);
+                    if (distance < light.radius) {
+                        total = total + light.color * (light.intensity * (1.0f - distance / light.radius));
+                    }
+                }
+                reference[static_cast<size_t>(z) * WORLD_SIDE + x] = total;
+            }
+        }
+    });
+    double bruteMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    
+    // The first pass pays for the grid rebuild, the second does not
+    std::vector<Color> clustered;
+    start = Clock::now();
+    world.calculateCellLighting(clustered);
+    double firstMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    start = Clock::now();
+    world.calculateCellLighting(clustered);
+    double secondMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    
+    float maxError = 0.0f;
+    for (size_t i = 0; i < cellCount; i++) {
+        maxError = std::max(maxError, std::abs(clustered[i].r - reference[i].r));
+        maxError = std::max(maxError, std::abs(clustered[i].g - reference[i].g));
+        maxError = std::max(maxError, std::abs(clustered[i].b - reference[i].b));
+    }
+    
+    // Single-point queries must agree with the batch pass
+    for (int i = 0; i < 1000; i++) {
+        int x = static_cast<int>(coordinate(rng));
+        int z = static_cast<int>(coordinate(rng));
+        Color single = world.calculateLightingAt(world.gridToWorld(x, z));
+        const Color& batch = clustered[static_cast<size_t>(z) * WORLD_SIDE + x];
+        maxError = std::max(maxError, std::abs(single.r - batch.r));
+        maxError = std::max(maxError, std::abs(single.g - batch.g));
+        maxError = std::max(maxError, std::abs(single.b - batch.b));
+    }
+    
+    bool passed = maxError <= 1e-4f;
+    std::cout << "Light grid: " << lights.size() << " lights over " << WORLD_SIDE << "x" << WORLD_SIDE
+              << " cells" << std::endl;
+    std::cout << "  brute force        " << bruteMs << " ms" << std::endl;
+    std::cout << "  clustered + build  " << firstMs << " ms" << std::endl;
+    std::cout << "  clustered          " << secondMs << " ms" << std::endl;
+    std::cout << "  max difference     " << maxError << (passed ? "" : "  FAILED") << std::endl;
+    return passed;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "math_utils.h"
+#include <cstdint>
+#include <vector>
+
+// Point light with linear falloff to zero at 'radius'
+struct PointLight {
+    Vec3 position;
+    Color color;
+    float intensity;
+    float radius;
+    
+    PointLight() : position(Vec3::zero()), color(Color::white()), intensity(1.0f), radius(10.0f) {}
+    PointLight(const Vec3& pos, const Color& col, float intensity, float radius)
+        : position(pos), color(col), intensity(intensity), radius(radius) {}
+};
+
+// LightGrid bins point lights into cubic world-space clusters so a lighting
+// query only visits the lights whose sphere reaches its cluster, instead of
+// every light in the world. Clusters are hashed into a bucket table sized
+// to the number of light/cluster pairs, like the CollisionSystem grid, so
+// memory follows the lights rather than the extent of the world.
+//
+// Lights that would span more than maxClustersPerLight clusters (e.g. a
+// sun-sized default light) are kept in a short global list that every query
+// checks. Everything but rebuild() only reads, so queries can run on several
+// threads at once.
+class LightGrid {
+public:
+    struct Settings {
+        float clusterSize;         // Cluster side in world units
+        int maxClustersPerLight;   // Larger lights go to the global list
+        
+        Settings()
+            : clusterSize(4.0f)
+            , maxClustersPerLight(512)
+        {}
+    };
+    
+    explicit LightGrid(const Settings& settings = Settings());
+    
+    void rebuild(const std::vector<PointLight>& lights);
+    
+    // Sum of the light reaching 'position', each channel clamped to 1
+    Color shade(const Vec3& position) const;
+    
+    // shade() for many points. Consecutive points in the same cluster share
+    // one cluster lookup, so rows of neighbouring cells are cheap.
+    void shadeBatch(const Vec3* positions, Color* out, size_t count) const;
+    
+    size_t getLightCount() const { return lightX.size(); }
+    size_t getGlobalLightCount() const { return globalLights.size(); }
+    size_t getEntryCount() const { return entries.size(); }
+    
+    // Times a brute-force pass against the clustered pass over a world lit
+    // by 10k small lights, checks they agree and prints the result
+    static bool runBenchmark();
+
+private:
+    // One cluster a light reaches; sorted by bucket
+    struct ClusterEntry {
+        int light;
+        int clusterX;
+        int clusterY;
+        int clusterZ;
+    };
+    
+    int clusterCoord(float value) const { return static_cast<int>(std::floor(value * inverseClusterSize)); }
+    uint32_t bucketOf(int clusterX, int clusterY, int clusterZ) const;
+    
+    // Appends the lights reaching cluster (x, y, z) to 'out'
+    void gatherCluster(int clusterX, int clusterY, int clusterZ, std::vector<int>& out) const;
+    void accumulate(const Vec3& position, const int* candidates, size_t count,
+                    float& red, float& green, float& blue) const;
+    
+    Settings settings;
+    float inverseClusterSize;
+    
+    // Structure-of-arrays copy of the lights, with color pre-scaled by intensity
+    std::vector<float> lightX, lightY, lightZ;
+    std::vector<float> radiusSquared, inverseRadius;
+    std::vector<float> lightRed, lightGreen, lightBlue;
+    
+    std::vector<ClusterEntry> entries;
+    std::vector<uint32_t> bucketStarts;   // entries of bucket b are [bucketStarts[b], bucketStarts[b + 1])
+    uint32_t bucketMask;
+    std::vector<int> globalLights;
+};
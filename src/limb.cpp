@@ -1,4 +1,5 @@
 #include "limb.h"
+#include "simd_math.h"
 #include <cmath>
 
 Limb::Limb(const Vec3& position, Type type, const Vec3& parentPosition)
@@ -29,16 +30,40 @@ Limb::Limb(const Vec3& position, Type type, const Vec3& parentPosition)
 Limb::~Limb() {
 }
 
-void Limb::update(float deltaTime) {
-    animationTime += deltaTime;
+namespace {
+
+// Every wave rate below (2, 5, 1.5, 1.8, 3 and 4 radians per second) turns
+// a whole number of times in 20 pi seconds, so the clock wraps there
+// without a visible jump
+const float WAVE_PERIOD = 20.0f * PI;
+
+// Batch sin/cos are only accurate for |x| <= 1e4
+inline float wrapPhase(float phase) {
+    return std::fmod(phase, 2.0f * PI);
+}
+
+}  // namespace
+
+void Limb::advance(float deltaTime, float* phases) {
+    animationTime = std::fmod(animationTime + deltaTime, WAVE_PERIOD);
     
+    phases[0] = wrapPhase(animationTime * 2.0f);
+    phases[1] = wrapPhase(animationTime * 5.0f);
+    phases[2] = wrapPhase(position.x * 0.5f + position.z * 0.3f);
+    phases[3] = wrapPhase(animationTime * 1.5f);
+    phases[4] = wrapPhase(animationTime * 1.8f);
+    phases[5] = wrapPhase(animationTime * 3.0f);
+    phases[6] = wrapPhase(animationTime * 4.0f);
+}
+
+void Limb::applyWaves(const float* sines, const float* cosines) {
     // Calculate wind effect - multiple sine waves for natural motion
-    float windBase = std::sin(animationTime * 2.0f) * 0.1f;
-    float windDetail = std::sin(animationTime * 5.0f) * 0.02f;
+    float windBase = sines[0] * 0.1f;
+    float windDetail = sines[1] * 0.02f;
     float sway = windBase + windDetail;
     
     // Add variation based on limb position for more organic look
-    float positionVariation = std::sin(position.x * 0.5f + position.z * 0.3f) * 0.05f;
+    float positionVariation = sines[2] * 0.05f;
     sway += positionVariation;
     
     // Apply different animation styles based on limb type
@@ -46,13 +71,7 @@ void Limb::update(float deltaTime) {
         case Type::PETAL:
             // Petals rotate and slightly bob
             rotation.y = sway * 10.0f;
-            rotation.x = std::cos(animationTime * 1.5f) * 3.0f;
-            
-            // Subtle size pulsing (breathing effect)
-            {
-                float pulse = 1.0f + std::sin(animationTime * 2.0f) * 0.05f;
-                // This would scale the petal (applied in rendering)
-            }
+            rotation.x = cosines[3] * 3.0f;
             break;
             
         case Type::STEM:
@@ -61,17 +80,17 @@ void Limb::update(float deltaTime) {
                 // Calculate distance from base (parent position)
                 float heightFactor = (position.y - parentPosition.y) * 2.0f;
                 rotation.x = sway * 5.0f * (1.0f + heightFactor);
-                rotation.z = std::cos(animationTime * 1.8f) * 3.0f * (1.0f + heightFactor);
+                rotation.z = cosines[4] * 3.0f * (1.0f + heightFactor);
             }
             break;
             
         case Type::LEAF:
             // Leaves flutter more dramatically
             rotation.z = sway * 15.0f;
-            rotation.y = std::cos(animationTime * 3.0f) * 8.0f;
+            rotation.y = cosines[5] * 8.0f;
             
             // Leaves can fold slightly
-            rotation.x = std::sin(animationTime * 4.0f) * 5.0f;
+            rotation.x = sines[6] * 5.0f;
             break;
     }
     
@@ -85,7 +104,7 @@ void Limb::update(float deltaTime) {
 void Limb::animate(float amount) {
     // Trigger a special animation (e.g., when flower is watered)
     // This causes an excited movement
-    animationTime += amount * 5.0f;  // Speed up animation temporarily
+    animationTime = std::fmod(animationTime + amount * 5.0f, WAVE_PERIOD);  // Speed up animation temporarily
     
     // Add an impulse to the rotation based on type
     switch (type) {
@@ -112,13 +131,9 @@ void Limb::setWindStrength(float strength) {
 }
 
 Vec3 Limb::getWorldPosition() const {
-    // Calculate the actual world position considering parent
-    // and any offset from animation
+    // Swing the offset from the parent flower by the current rotation
     Vec3 offset = position - parentPosition;
-    
-    // Apply rotation to offset (simplified - would use proper rotation matrix in full impl)
-    // For now, return the base position
-    return position;
+    return parentPosition + Quat::fromEuler(rotation.x, rotation.y, rotation.z).rotate(offset);
 }
 
 Color Limb::getAnimatedColor() const {
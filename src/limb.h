@@ -16,8 +16,14 @@ public:
     Limb(const Vec3& position, Type type, const Vec3& parentPosition);
     ~Limb();
     
-    // Update animation state based on wind and time
-    void update(float deltaTime);
+    // Sine waves behind one frame of wind animation
+    static const int PHASE_COUNT = 7;
+    
+    // Update animation state based on wind and time. advance() moves the
+    // clock and writes PHASE_COUNT phases; applyWaves() takes their sines
+    // and cosines, so the engine can evaluate every limb in one batch.
+    void advance(float deltaTime, float* phases);
+    void applyWaves(const float* sines, const float* cosines);
     
     // Trigger a special animation (e.g., when flower is watered)
     void animate(float amount);
@@ -49,5 +55,5 @@ private:
     Type type;            // What kind of limb this is
     Color color;          // Base color
     float size;           // Size/scale of the limb
-    float animationTime;  // Time accumulator for animations
+    float animationTime;  // Time accumulator for animations, wrapped so it stays precise
 };
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Logger moves message formatting and output off the calling thread. Each
+// thread writes fixed-size records into its own single-producer ring (no
+// locks, no allocation): the format string pointer and the raw argument
+// values. A sink thread collects the rings every few milliseconds, formats
+// the records in time order and writes them out in one go.
+//
+// Use the LOG_* macros below. Formats are string literals with {} for each
+// argument; arguments may be numbers, enums, C strings or std::strings
+// (strings are copied, and truncated if the record is full). Each call site
+// is rate limited; the next message from a site that gets through says how
+// many were suppressed. When a ring is full the message is dropped and the
+// sink reports the count rather than making the thread wait.
+class Logger {
+public:
+    // Not upper case like other enums: <wingdi.h> defines ERROR
+    enum class Severity : uint8_t {
+        Debug,
+        Info,
+        Warning,
+        Error
+    };
+    
+    struct Settings {
+        Severity minimumSeverity;
+        int rateLimit;           // Messages per call site per window; 0 for no limit
+        int rateWindowMs;
+        int flushIntervalMs;     // How often the sink collects the rings
+        size_t ringCapacity;     // Records per thread
+        std::FILE* output;       // Debug and Info
+        std::FILE* errorOutput;  // Warning and Error
+        
+        Settings()
+            : minimumSeverity(Severity::Info)
+            , rateLimit(10)
+            , rateWindowMs(1000)
+            , flushIntervalMs(10)
+            , ringCapacity(1024)
+            , output(stdout)
+            , errorOutput(stderr)
+        {}
+    };
+    
+    // Rate-limit state of one LOG_* call site
+    struct Site {
+        std::atomic<uint64_t> windowStart;
+        std::atomic<uint32_t> windowCount;
+        std::atomic<uint32_t> suppressed;
+        
+        constexpr Site() : windowStart(0), windowCount(0), suppressed(0) {}
+    };
+    
+    // A thread's record buffer, defined in logger.cpp
+    struct Ring;
+    
+    explicit Logger(const Settings& settings = Settings());
+    ~Logger();
+    
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+    
+    // Process-wide logger behind the LOG_* macros
+    static Logger& instance();
+    
+    bool isEnabled(Severity severity) const {
+        return severity >= minimumSeverity.load(std::memory_order_relaxed);
+    }
+    void setMinimumSeverity(Severity severity) { minimumSeverity.store(severity, std::memory_order_relaxed); }
+    
+    template <typename... Args>
+    void write(Site& site, Severity severity, const char* format, const Args&... args) {
+        uint64_t time = getTime();
+        uint32_t suppressed = 0;
+        if (!allow(site, time, suppressed)) return;
+        
+        Record* record = beginRecord();
+        if (!record) {
+            site.suppressed.fetch_add(suppressed, std::memory_order_relaxed);
+            return;
+        }
+        record->format = format;
+        record->time = time;
+        record->suppressed = suppressed;
+        record->size = 0;
+        record->severity = severity;
+        (encode(*record, args), ...);
+        commitRecord();
+    }
+    
+    // Wait until everything logged so far has been written out
+    void flush();
+    
+    // Times logging against synchronous stream output, checks messages from
+    // several threads all arrive and that rate limiting reports what it drops
+    static bool runBenchmark();
+
+private:
+    struct Record {
+        const char* format;
+        uint64_t time;           // Steady clock, nanoseconds
+        uint32_t suppressed;     // Rate-limited messages from this site since the last one
+        uint16_t size;           // Payload bytes used
+        Severity severity;
+        uint8_t payload[105];    // Tagged argument values
+    };
+    static_assert(sizeof(Record) == 128, "Records should stay two cache lines");
+    
+    static uint64_t getTime();
+    bool allow(Site& site, uint64_t time, uint32_t& suppressed);
+    Record* beginRecord();
+    void commitRecord();
+    Ring* registerThread();
+    
+    static void put(Record& record, char tag, const void* value, size_t size);
+    static void putString(Record& record, const char* text, size_t length);
+    
+    template <typename T>
+    static void encode(Record& record, const T& value) {
+        if constexpr (std::is_same<T, bool>::value) {
+            putString(record, value ? "true" : "false", value ? 4 : 5);
+        } else if constexpr (std::is_enum<T>::value) {
+            int64_t number = static_cast<int64_t>(value);
+            put(record, 'i', &number, sizeof(number));
+        } else if constexpr (std::is_integral<T>::value && std::is_signed<T>::value) {
+            int64_t number = value;
+            put(record, 'i', &number, sizeof(number));
+        } else if constexpr (std::is_integral<T>::value) {
+            uint64_t number = value;
+            put(record, 'u', &number, sizeof(number));
+        } else if constexpr (std::is_floating_point<T>::value) {
+            double number = value;
+            put(record, 'f', &number, sizeof(number));
+        } else if constexpr (std::is_same<T, std::string>::value) {
+            putString(record, value.data(), value.size());
+        } else {
+            const char* text = value;
+            putString(record, text ? text : "(null)", text ? std::strlen(text) : 6);
+        }
+    }
+    
+    void sinkLoop();
+    void drain(const std::vector<std::shared_ptr<Ring>>& active);
+    static void format(const Record& record, std::string& out);
+    
+    Settings settings;
+    uint64_t id;                          // Tells this logger's rings apart from other loggers'
+    std::atomic<Severity> minimumSeverity;
+    
+    std::thread sink;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable flushed;
+    std::vector<std::shared_ptr<Ring>> rings;
+    uint64_t flushRequests;
+    uint64_t flushesDone;
+    bool stopping;
+};
+
+#define LOG_AT(severity, ...)                                            \
+    do {                                                                 \
+        static Logger::Site logSite;                                     \
+        Logger& logger = Logger::instance();                             \
+        if (logger.isEnabled(severity)) {                                \
+            logger.write(logSite, severity, __VA_ARGS__);                \
+        }                                                                \
+    } while (0)
+    
+#define LOG_DEBUG(...) LOG_AT(Logger::Severity::Debug, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(Logger::Severity::Info, __VA_ARGS__)
+#define LOG_WARNING(...) LOG_AT(Logger::Severity::Warning, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(Logger::Severity::Error, __VA_ARGS__)
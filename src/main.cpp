@@ -1,7 +1,55 @@
+#include "draw_list.h"
 #include "engine.h"
+#include "light_grid.h"
+#include "logger.h"
+#include "math_kernels.h"
+#include "occlusion_culler.h"
+#include "photo_album.h"
+#include "software_rasterizer.h"
+#include "terrain_lightmap.h"
+#include "terrain_lod.h"
+#include "vertex_format.h"
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
 int main(int argc, char* argv[]) {
+    // Self-checks and benchmarks; these run without opening a window
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--math-bench") == 0) {
+            return MathUtils::runMathKernelBenchmark() ? 0 : 1;
+        }
+        if (std::strcmp(argv[i], "--light-bench") == 0) {
+            return LightGrid::runBenchmark() ? 0 : 1;
+        }
+        if (std::strcmp(argv[i], "--lightmap-bench") == 0) {
+            return TerrainLightmap::runBenchmark() ? 0 : 1;
+        }
+        if (std::strcmp(argv[i], "--render-bench") == 0) {
+            const char* imagePath = i + 1 < argc ? argv[i + 1] : nullptr;
+            return SoftwareRasterizer::runBenchmark(imagePath) ? 0 : 1;
+        }
+        if (std::strcmp(argv[i], "--occlusion-bench") == 0) {
+            return OcclusionCuller::runBenchmark() ? 0 : 1;
+        }
+        if (std::strcmp(argv[i], "--drawlist-bench") == 0) {
+            return DrawList::runBenchmark() ? 0 : 1;
+        }
+        if (std::strcmp(argv[i], "--vertex-bench") == 0) {
+            return VertexFormat::runVertexFormatBenchmark() ? 0 : 1;
+        }
+        if (std::strcmp(argv[i], "--lod-bench") == 0) {
+            return TerrainLod::runBenchmark() ? 0 : 1;
+        }
+        if (std::strcmp(argv[i], "--photo-bench") == 0) {
+            return PhotoAlbum::runBenchmark() ? 0 : 1;
+        }
+        if (std::strcmp(argv[i], "--log-bench") == 0) {
+            return Logger::runBenchmark() ? 0 : 1;
+        }
+    }
+    
     std::cout << "==================================" << std::endl;
     std::cout << "   Flower - A Peaceful Adventure  " << std::endl;
     std::cout << "==================================" << std::endl;
@@ -12,6 +60,28 @@ int main(int argc, char* argv[]) {
     
     Engine engine;
     
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--stream") == 0) {
+            engine.setStreamingMode(true);
+        }
+        if (std::strcmp(argv[i], "--no-save") == 0) {
+            engine.setSaveDirectory("");
+        }
+        if (std::strcmp(argv[i], "--headless") == 0) {
+            // --headless [frames] [image.ppm]; leaves the saved garden alone
+            int frames = 300;
+            std::string imagePath;
+            if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0]))) {
+                frames = std::atoi(argv[++i]);
+            }
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                imagePath = argv[++i];
+            }
+            engine.setHeadless(frames, imagePath);
+            engine.setSaveDirectory("");
+        }
+    }
+    
     if (!engine.initialize()) {
         std::cerr << "Failed to initialize engine" << std::endl;
         return 1;
@@ -0,0 +1,306 @@
+#include "map_file.h"
+#include "logger.h"
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const uint8_t PLANE_RAW = 0;
+const uint8_t PLANE_RLE = 1;
+const size_t PAYLOAD_ALIGNMENT = 16;
+
+// Each plane starts with its encoded size and encoding, padded to 8 bytes
+struct PlaneHeader {
+    uint32_t encodedSize;
+    uint8_t encoding;
+    uint8_t reserved[3];
+};
+
+// Runs are (uint16 length, element) pairs. Falls back to the raw plane
+// when that is not smaller, which is the usual case for noisy heights.
+void encodePlane(const void* plane, size_t elementSize, std::vector<uint8_t>& out) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(plane);
+    size_t planeSize = elementSize * TerrainChunk::CELL_COUNT;
+    
+    std::vector<uint8_t> runs;
+    for (int i = 0; i < TerrainChunk::CELL_COUNT;) {
+        int runEnd = i + 1;
+        while (runEnd < TerrainChunk::CELL_COUNT && runEnd - i < 0xFFFF &&
+               std::memcmp(bytes + runEnd * elementSize, bytes + i * elementSize, elementSize) == 0) {
+            runEnd++;
+        }
+        
+        uint16_t length = static_cast<uint16_t>(runEnd - i);
+        runs.insert(runs.end(), reinterpret_cast<const uint8_t*>(&length),
+                    reinterpret_cast<const uint8_t*>(&length) + sizeof(length));
+        runs.insert(runs.end(), bytes + i * elementSize, bytes + (i + 1) * elementSize);
+        
+        if (runs.size() >= planeSize) break;
+        i = runEnd;
+    }
+    
+    PlaneHeader planeHeader = {};
+    bool useRuns = runs.size() < planeSize;
+    planeHeader.encoding = useRuns ? PLANE_RLE : PLANE_RAW;
+    planeHeader.encodedSize = static_cast<uint32_t>(useRuns ? runs.size() : planeSize);
+    
+    out.insert(out.end(), reinterpret_cast<const uint8_t*>(&planeHeader),
+               reinterpret_cast<const uint8_t*>(&planeHeader) + sizeof(planeHeader));
+    if (useRuns) {
+        out.insert(out.end(), runs.begin(), runs.end());
+    } else {
+        out.insert(out.end(), bytes, bytes + planeSize);
+    }
+}
+
+// Decodes one plane starting at 'cursor' and advances it. Returns false on
+// data that runs past 'end' or does not fill the plane exactly.
+bool decodePlane(const uint8_t*& cursor, const uint8_t* end, size_t elementSize, void* plane) {
+    PlaneHeader planeHeader;
+    if (static_cast<size_t>(end - cursor) < sizeof(planeHeader)) return false;
+    std::memcpy(&planeHeader, cursor, sizeof(planeHeader));
+    cursor += sizeof(planeHeader);
+    
+    if (static_cast<size_t>(end - cursor) < planeHeader.encodedSize) return false;
+    const uint8_t* encoded = cursor;
+    cursor += planeHeader.encodedSize;
+    
+    uint8_t* out = static_cast<uint8_t*>(plane);
+    size_t planeSize = elementSize * TerrainChunk::CELL_COUNT;
+    
+    if (planeHeader.encoding == PLANE_RAW) {
+        if (planeHeader.encodedSize != planeSize) return false;
+        std::memcpy(out, encoded, planeSize);
+        return true;
+    }
+    if (planeHeader.encoding != PLANE_RLE) return false;
+    
+    size_t written = 0;
+    const uint8_t* runEnd = encoded + planeHeader.encodedSize;
+    while (encoded + sizeof(uint16_t) + elementSize <= runEnd) {
+        uint16_t length;
+        std::memcpy(&length, encoded, sizeof(length));
+        encoded += sizeof(length);
+        if (written + length * elementSize > planeSize) return false;
+        
+        for (uint16_t i = 0; i < length; i++) {
+            std::memcpy(out + written, encoded, elementSize);
+            written += elementSize;
+        }
+        encoded += elementSize;
+    }
+    return encoded == runEnd && written == planeSize;
+}
+
+}  // namespace
+
+MapFile::MapFile()
+    : header()
+    , table(nullptr)
+    , data(nullptr)
+    , size(0)
+#ifdef _WIN32
+    , fileHandle(nullptr)
+    , mappingHandle(nullptr)
+#else
+    , fileDescriptor(-1)
+#endif
+{
+}
+
+MapFile::~MapFile() {
+    close();
+}
+
+bool MapFile::save(const std::string& path, int width, int height,
+                   const std::vector<ChunkSource>& chunks) {
+    Header fileHeader = {};
+    fileHeader.magic = MAGIC;
+    fileHeader.version = VERSION;
+    fileHeader.width = width;
+    fileHeader.height = height;
+    fileHeader.chunkSize = TerrainChunk::SIZE;
+    fileHeader.chunksX = (width + TerrainChunk::SIZE - 1) / TerrainChunk::SIZE;
+    fileHeader.chunksZ = (height + TerrainChunk::SIZE - 1) / TerrainChunk::SIZE;
+    fileHeader.tableOffset = sizeof(Header);
+    
+    size_t chunkCount = static_cast<size_t>(fileHeader.chunksX) * fileHeader.chunksZ;
+    if (chunks.size() != chunkCount) {
+        LOG_ERROR("Map file chunk count mismatch: {} != {}", chunks.size(), chunkCount);
+        return false;
+    }
+    
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        LOG_ERROR("Failed to create map file: {}", path);
+        return false;
+    }
+    
+    // Payloads follow the table; offsets are known once each is encoded
+    std::vector<ChunkEntry> entries(chunkCount);
+    std::vector<uint8_t> payloads;
+    uint64_t payloadBase = fileHeader.tableOffset + chunkCount * sizeof(ChunkEntry);
+    payloadBase = (payloadBase + PAYLOAD_ALIGNMENT - 1) / PAYLOAD_ALIGNMENT * PAYLOAD_ALIGNMENT;
+    
+    for (size_t i = 0; i < chunkCount; i++) {
+        const ChunkSource& source = chunks[i];
+        ChunkEntry& entry = entries[i];
+        entry = ChunkEntry();
+        
+        if (!source.data) {
+            entry.uniformType = source.uniformType;
+            entry.uniformHeight = source.uniformHeight;
+            entry.uniformNormal = source.uniformNormal;
+            entry.typeMask = static_cast<uint8_t>(1u << source.uniformType);
+            continue;
+        }
+        
+        for (int cell = 0; cell < TerrainChunk::CELL_COUNT; cell++) {
+            entry.typeMask |= static_cast<uint8_t>(1u << source.data->types[cell]);
+        }
+        
+        payloads.resize((payloads.size() + PAYLOAD_ALIGNMENT - 1) / PAYLOAD_ALIGNMENT * PAYLOAD_ALIGNMENT);
+        size_t start = payloads.size();
+        encodePlane(source.data->types, sizeof(uint8_t), payloads);
+        encodePlane(source.data->heights, sizeof(float), payloads);
+        encodePlane(source.data->normals, sizeof(uint16_t), payloads);
+        
+        entry.payloadOffset = payloadBase + start;
+        entry.payloadSize = static_cast<uint32_t>(payloads.size() - start);
+    }
+    
+    std::vector<char> padding(payloadBase - fileHeader.tableOffset - chunkCount * sizeof(ChunkEntry), 0);
+    file.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
+    file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(ChunkEntry));
+    file.write(padding.data(), padding.size());
+    file.write(reinterpret_cast<const char*>(payloads.data()), payloads.size());
+    
+    if (!file) {
+        LOG_ERROR("Failed to write map file: {}", path);
+        return false;
+    }
+    return true;
+}
+
+bool MapFile::open(const std::string& path) {
+    close();
+    
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        LOG_ERROR("Failed to open map file: {}", path);
+        return false;
+    }
+    
+    LARGE_INTEGER fileSize;
+    HANDLE mapping = nullptr;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    }
+    void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        LOG_ERROR("Failed to map map file: {}", path);
+        return false;
+    }
+    
+    fileHandle = file;
+    mappingHandle = mapping;
+    size = static_cast<size_t>(fileSize.QuadPart);
+#else
+    int descriptor = ::open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        LOG_ERROR("Failed to open map file: {}", path);
+        return false;
+    }
+    
+    struct stat fileStat;
+    void* view = MAP_FAILED;
+    if (fstat(descriptor, &fileStat) == 0 && fileStat.st_size > 0) {
+        view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+    }
+    if (view == MAP_FAILED) {
+        ::close(descriptor);
+        LOG_ERROR("Failed to map map file: {}", path);
+        return false;
+    }
+    
+    fileDescriptor = descriptor;
+    size = static_cast<size_t>(fileStat.st_size);
+#endif
+    
+    data = static_cast<const uint8_t*>(view);
+    
+    // Validate everything decodeChunk relies on up front
+    bool valid = size >= sizeof(Header);
+    if (valid) {
+        std::memcpy(&header, data, sizeof(Header));
+        valid = header.magic == MAGIC && header.version == VERSION &&
+                header.chunkSize == TerrainChunk::SIZE && header.width > 0 && header.height > 0 &&
+                header.chunksX == (header.width + TerrainChunk::SIZE - 1) / TerrainChunk::SIZE &&
+                header.chunksZ == (header.height + TerrainChunk::SIZE - 1) / TerrainChunk::SIZE &&
+                header.tableOffset % alignof(ChunkEntry) == 0 &&
+                header.tableOffset <= size &&
+                (size - header.tableOffset) / sizeof(ChunkEntry) >= static_cast<uint64_t>(getChunkCount());
+    }
+    if (!valid) {
+        LOG_ERROR("Invalid or unsupported map file: {}", path);
+        close();
+        return false;
+    }
+    
+    table = reinterpret_cast<const ChunkEntry*>(data + header.tableOffset);
+    return true;
+}
+
+void MapFile::close() {
+    if (!data) return;
+    
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+    CloseHandle(static_cast<HANDLE>(mappingHandle));
+    CloseHandle(static_cast<HANDLE>(fileHandle));
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    munmap(const_cast<uint8_t*>(data), size);
+    ::close(fileDescriptor);
+    fileDescriptor = -1;
+#endif
+    
+    data = nullptr;
+    table = nullptr;
+    size = 0;
+    header = Header();
+}
+
+bool MapFile::decodeChunk(int index, TerrainChunk& out) const {
+    if (!data || index < 0 || index >= getChunkCount()) return false;
+    
+    const ChunkEntry& entry = table[index];
+    if (entry.payloadOffset == 0 || entry.payloadOffset > size || entry.payloadSize > size - entry.payloadOffset) {
+        return false;
+    }
+    
+    const uint8_t* cursor = data + entry.payloadOffset;
+    const uint8_t* end = cursor + entry.payloadSize;
+    bool decoded = decodePlane(cursor, end, sizeof(uint8_t), out.types) &&
+                   decodePlane(cursor, end, sizeof(float), out.heights) &&
+                   decodePlane(cursor, end, sizeof(uint16_t), out.normals);
+    out.dirty = false;
+    return decoded;
+}
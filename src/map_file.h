@@ -0,0 +1,92 @@
+#pragma once
+
+#include "terrain_chunk.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// MapFile is the on-disk format for worlds. The layout is
+//
+//   Header      magic, version, world size and the chunk table location
+//   ChunkEntry  one per chunk, row-major, 8-byte aligned
+//   payloads    per-chunk type, height and normal planes, 16-byte aligned
+//
+// Uniform chunks have no payload; their single value lives in the table.
+// Each plane of a payload is stored raw or run-length encoded, whichever is
+// smaller. Opening a file maps it into memory and only reads the header, so
+// chunks can be decoded one at a time when they are first needed.
+class MapFile {
+public:
+    static const uint32_t MAGIC = 0x50414D46;  // "FMAP"
+    static const uint32_t VERSION = 1;
+    
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        int32_t width;
+        int32_t height;
+        int32_t chunkSize;
+        int32_t chunksX;
+        int32_t chunksZ;
+        uint32_t reserved;
+        uint64_t tableOffset;
+    };
+    
+    struct ChunkEntry {
+        uint64_t payloadOffset;  // 0 for uniform chunks
+        uint32_t payloadSize;
+        float uniformHeight;
+        uint16_t uniformNormal;
+        uint8_t uniformType;
+        uint8_t typeMask;        // Bit t set when cell type t occurs in the chunk
+        uint32_t reserved;
+    };
+    
+    // What the writer stores for one chunk: either its planes or, when
+    // data is null, the single uniform value
+    struct ChunkSource {
+        const TerrainChunk* data;
+        uint8_t uniformType;
+        float uniformHeight;
+        uint16_t uniformNormal;
+    };
+    
+    MapFile();
+    ~MapFile();
+    
+    MapFile(const MapFile&) = delete;
+    MapFile& operator=(const MapFile&) = delete;
+    
+    // Write a world of width x height cells split into chunks row-major
+    static bool save(const std::string& path, int width, int height,
+                     const std::vector<ChunkSource>& chunks);
+    
+    // Map a file and validate its header and chunk table
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return data != nullptr; }
+    
+    int getWidth() const { return header.width; }
+    int getHeight() const { return header.height; }
+    int getChunksX() const { return header.chunksX; }
+    int getChunksZ() const { return header.chunksZ; }
+    int getChunkCount() const { return header.chunksX * header.chunksZ; }
+    const ChunkEntry& getChunkEntry(int index) const { return table[index]; }
+    
+    // Decode a chunk that has a payload. Safe to call from several threads.
+    bool decodeChunk(int index, TerrainChunk& out) const;
+
+private:
+    Header header;
+    const ChunkEntry* table;
+    const uint8_t* data;
+    size_t size;
+    
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#else
+    int fileDescriptor;
+#endif
+};
@@ -0,0 +1,710 @@
+#include "math_kernels.h"
+#include "cpu_features.h"
+#include "math_utils.h"
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+// Cody-Waite split of pi/2. The first two parts have short mantissas, so
+// k * part is exact for every quadrant count k below 2^16.
+const float TWO_OVER_PI = 0.636619772367581343f;
+const float PIO2_1 = 1.5703125f;
+const float PIO2_2 = 4.837512969970703125e-4f;
+const float PIO2_3 = 7.54978995489188216e-8f;
+
+// Minimax polynomials for sin and cos on [-pi/4, pi/4] (Cephes sinf/cosf)
+const float SIN_C1 = -1.6666654611e-1f;
+const float SIN_C2 = 8.3321608736e-3f;
+const float SIN_C3 = -1.9515295891e-4f;
+const float COS_C1 = 4.166664568298827e-2f;
+const float COS_C2 = -1.388731625493765e-3f;
+const float COS_C3 = 2.443315711809948e-5f;
+
+// asin(x) = x + x^3 P(x^2) on [0, 0.5] (Cephes asinf). acos is derived
+// from it, using asin(sqrt((1 - x) / 2)) above 0.5.
+const float ASIN_P0 = 1.6666752422e-1f;
+const float ASIN_P1 = 7.4953002686e-2f;
+const float ASIN_P2 = 4.5470025998e-2f;
+const float ASIN_P3 = 2.4181311049e-2f;
+const float ASIN_P4 = 4.2163199048e-2f;
+const float HALF_PI = 1.57079632679489662f;
+
+// exp(x) = 2^n exp(r) with r = x - n ln2 and |r| <= ln2 / 2 (Cephes expf).
+// The clamp keeps 2^n a normal float.
+const float LOG2E = 1.44269504088896341f;
+const float LN2_HI = 0.693359375f;
+const float LN2_LO = -2.12194440e-4f;
+const float EXP_P0 = 5.0000001201e-1f;
+const float EXP_P1 = 1.6666665459e-1f;
+const float EXP_P2 = 4.1665795894e-2f;
+const float EXP_P3 = 8.3334519073e-3f;
+const float EXP_P4 = 1.3981999507e-3f;
+const float EXP_P5 = 1.9875691500e-4f;
+const float EXP_MIN = -87.0f;
+const float EXP_MAX = 88.0f;
+
+// Round to nearest without a libm call; the vector kernels use the
+// conversion instructions instead
+inline int roundToInt(float v) {
+    return static_cast<int>(v + std::copysign(0.5f, v));
+}
+
+typedef void (*UnaryKernel)(const float* x, float* out, size_t count);
+typedef void (*SinCosKernel)(const float* x, float* sinOut, float* cosOut, size_t count);
+
+struct KernelSet {
+    const char* name;
+    UnaryKernel sin;
+    UnaryKernel cos;
+    SinCosKernel sincos;
+    UnaryKernel acos;
+    UnaryKernel rsqrt;
+    UnaryKernel exp;
+};
+
+// Scalar kernels, also used for the tails of the vector loops
+
+void sincosApprox(float x, float& s, float& c) {
+    int quadrant = roundToInt(x * TWO_OVER_PI);
+    float k = static_cast<float>(quadrant);
+    float r = ((x - k * PIO2_1) - k * PIO2_2) - k * PIO2_3;
+    float z = r * r;
+    float sinR = r + r * z * (SIN_C1 + z * (SIN_C2 + z * SIN_C3));
+    float cosR = 1.0f - 0.5f * z + z * z * (COS_C1 + z * (COS_C2 + z * COS_C3));
+    
+    // Odd quadrants swap sine and cosine; bit 1 of the quadrant flips the
+    // sign. Done on the bits, as the quadrant of random inputs defeats
+    // branch prediction.
+    uint32_t sinBits, cosBits;
+    std::memcpy(&sinBits, &sinR, sizeof(sinBits));
+    std::memcpy(&cosBits, &cosR, sizeof(cosBits));
+    uint32_t swap = 0u - static_cast<uint32_t>(quadrant & 1);
+    uint32_t sinResult = ((cosBits & swap) | (sinBits & ~swap)) ^ (static_cast<uint32_t>(quadrant & 2) << 30);
+    uint32_t cosResult = ((sinBits & swap) | (cosBits & ~swap)) ^ (static_cast<uint32_t>((quadrant + 1) & 2) << 30);
+    std::memcpy(&s, &sinResult, sizeof(s));
+    std::memcpy(&c, &cosResult, sizeof(c));
+}
+
+float acosApprox(float x) {
+    float a = std::min(std::abs(x), 1.0f);
+    bool big = a > 0.5f;
+    float z = big ? 0.5f * (1.0f - a) : a * a;
+    float s = big ? std::sqrt(z) : a;
+    float p = s + s * z * (ASIN_P0 + z * (ASIN_P1 + z * (ASIN_P2 + z * (ASIN_P3 + z * ASIN_P4))));
+    float r = big ? 2.0f * p : HALF_PI - p;
+    return x < 0.0f ? PI - r : r;
+}
+
+float expApprox(float x) {
+    x = std::max(EXP_MIN, std::min(x, EXP_MAX));
+    int exponent = roundToInt(x * LOG2E);
+    float n = static_cast<float>(exponent);
+    float r = (x - n * LN2_HI) - n * LN2_LO;
+    float p = ((((EXP_P5 * r + EXP_P4) * r + EXP_P3) * r + EXP_P2) * r + EXP_P1) * r + EXP_P0;
+    float y = 1.0f + r + r * r * p;
+    
+    uint32_t bits = static_cast<uint32_t>(exponent + 127) << 23;
+    float scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+    return y * scale;
+}
+
+void sinScalar(const float* x, float* out, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        float c;
+        sincosApprox(x[i], out[i], c);
+    }
+}
+
+void cosScalar(const float* x, float* out, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        float s;
+        sincosApprox(x[i], s, out[i]);
+    }
+}
+
+void sincosScalar(const float* x, float* sinOut, float* cosOut, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        float s, c;
+        sincosApprox(x[i], s, c);
+        sinOut[i] = s;
+        cosOut[i] = c;
+    }
+}
+
+void acosScalar(const float* x, float* out, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] = acosApprox(x[i]);
+    }
+}
+
+void rsqrtScalar(const float* x, float* out, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] = 1.0f / std::sqrt(x[i]);
+    }
+}
+
+void expScalar(const float* x, float* out, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] = expApprox(x[i]);
+    }
+}
+
+const KernelSet SCALAR_KERNELS = {
+    "scalar", sinScalar, cosScalar, sincosScalar, acosScalar, rsqrtScalar, expScalar
+};
+
+#ifdef FLOWER_X86
+// SSE2 kernels. SSE2 has no blend instruction, so lane selection is done
+// with and/andnot/or.
+
+inline __m128 selectSSE2(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+inline void sincosSSE2(__m128 x, __m128& s, __m128& c) {
+    __m128i quadrant = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(TWO_OVER_PI)));
+    __m128 k = _mm_cvtepi32_ps(quadrant);
+    __m128 r = _mm_sub_ps(x, _mm_mul_ps(k, _mm_set1_ps(PIO2_1)));
+    r = _mm_sub_ps(r, _mm_mul_ps(k, _mm_set1_ps(PIO2_2)));
+    r = _mm_sub_ps(r, _mm_mul_ps(k, _mm_set1_ps(PIO2_3)));
+    __m128 z = _mm_mul_ps(r, r);
+    
+    __m128 sinPoly = _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(SIN_C3)), _mm_set1_ps(SIN_C2));
+    sinPoly = _mm_add_ps(_mm_mul_ps(sinPoly, z), _mm_set1_ps(SIN_C1));
+    __m128 sinR = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, z), sinPoly));
+    
+    __m128 cosPoly = _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(COS_C3)), _mm_set1_ps(COS_C2));
+    cosPoly = _mm_add_ps(_mm_mul_ps(cosPoly, z), _mm_set1_ps(COS_C1));
+    __m128 cosR = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), z));
+    cosR = _mm_add_ps(cosR, _mm_mul_ps(_mm_mul_ps(z, z), cosPoly));
+    
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i two = _mm_set1_epi32(2);
+    __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, one), one));
+    __m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, two), 30));
+    __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant, one), two), 30));
+    s = _mm_xor_ps(selectSSE2(swap, cosR, sinR), sinSign);
+    c = _mm_xor_ps(selectSSE2(swap, sinR, cosR), cosSign);
+}
+
+inline __m128 sinSSE2(__m128 x) {
+    __m128 s, c;
+    sincosSSE2(x, s, c);
+    return s;
+}
+
+inline __m128 cosSSE2(__m128 x) {
+    __m128 s, c;
+    sincosSSE2(x, s, c);
+    return c;
+}
+
+inline __m128 acosSSE2(__m128 x) {
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    __m128 a = _mm_min_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), x), one);
+    __m128 big = _mm_cmpgt_ps(a, half);
+    __m128 z = selectSSE2(big, _mm_mul_ps(half, _mm_sub_ps(one, a)), _mm_mul_ps(a, a));
+    __m128 s = selectSSE2(big, _mm_sqrt_ps(z), a);
+    
+    __m128 poly = _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(ASIN_P4)), _mm_set1_ps(ASIN_P3));
+    poly = _mm_add_ps(_mm_mul_ps(poly, z), _mm_set1_ps(ASIN_P2));
+    poly = _mm_add_ps(_mm_mul_ps(poly, z), _mm_set1_ps(ASIN_P1));
+    poly = _mm_add_ps(_mm_mul_ps(poly, z), _mm_set1_ps(ASIN_P0));
+    __m128 p = _mm_add_ps(s, _mm_mul_ps(_mm_mul_ps(s, z), poly));
+    
+    __m128 r = selectSSE2(big, _mm_add_ps(p, p), _mm_sub_ps(_mm_set1_ps(HALF_PI), p));
+    return selectSSE2(_mm_cmplt_ps(x, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps(PI), r), r);
+}
+
+inline __m128 rsqrtSSE2(__m128 x) {
+    // One Newton step on the 12-bit estimate: y (3 - x y^2) / 2. At x = 0
+    // the estimate is inf, which the step would turn into NaN.
+    __m128 y = _mm_rsqrt_ps(x);
+    __m128 refined = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), y),
+                                _mm_sub_ps(_mm_set1_ps(3.0f), _mm_mul_ps(_mm_mul_ps(x, y), y)));
+    return selectSSE2(_mm_cmpeq_ps(x, _mm_setzero_ps()), y, refined);
+}
+
+inline __m128 expSSE2(__m128 x) {
+    x = _mm_max_ps(_mm_set1_ps(EXP_MIN), _mm_min_ps(x, _mm_set1_ps(EXP_MAX)));
+    __m128i n = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(LOG2E)));
+    __m128 nf = _mm_cvtepi32_ps(n);
+    __m128 r = _mm_sub_ps(x, _mm_mul_ps(nf, _mm_set1_ps(LN2_HI)));
+    r = _mm_sub_ps(r, _mm_mul_ps(nf, _mm_set1_ps(LN2_LO)));
+    
+    __m128 p = _mm_add_ps(_mm_mul_ps(r, _mm_set1_ps(EXP_P5)), _mm_set1_ps(EXP_P4));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(EXP_P3));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(EXP_P2));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(EXP_P1));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(EXP_P0));
+    __m128 y = _mm_add_ps(_mm_add_ps(_mm_set1_ps(1.0f), r), _mm_mul_ps(_mm_mul_ps(r, r), p));
+    
+    __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23));
+    return _mm_mul_ps(y, scale);
+}
+
+template <__m128 (*Kernel)(__m128), UnaryKernel Tail>
+void mapSSE2(const float* x, float* out, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(out + i, Kernel(_mm_loadu_ps(x + i)));
+    }
+    Tail(x + i, out + i, count - i);
+}
+
+void sincosBatchSSE2(const float* x, float* sinOut, float* cosOut, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 s, c;
+        sincosSSE2(_mm_loadu_ps(x + i), s, c);
+        _mm_storeu_ps(sinOut + i, s);
+        _mm_storeu_ps(cosOut + i, c);
+    }
+    sincosScalar(x + i, sinOut + i, cosOut + i, count - i);
+}
+
+const KernelSet SSE2_KERNELS = {
+    "sse2",
+    mapSSE2<sinSSE2, sinScalar>,
+    mapSSE2<cosSSE2, cosScalar>,
+    sincosBatchSSE2,
+    mapSSE2<acosSSE2, acosScalar>,
+    mapSSE2<rsqrtSSE2, rsqrtScalar>,
+    mapSSE2<expSSE2, expScalar>
+};
+
+// AVX2 kernels: the same algorithms eight lanes wide, with fused
+// multiply-adds in the range reductions and polynomials
+
+FLOWER_TARGET_AVX2
+inline void sincosAVX2(__m256 x, __m256& s, __m256& c) {
+    __m256i quadrant = _mm256_cvtps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(TWO_OVER_PI)));
+    __m256 k = _mm256_cvtepi32_ps(quadrant);
+    __m256 r = _mm256_fnmadd_ps(k, _mm256_set1_ps(PIO2_1), x);
+    r = _mm256_fnmadd_ps(k, _mm256_set1_ps(PIO2_2), r);
+    r = _mm256_fnmadd_ps(k, _mm256_set1_ps(PIO2_3), r);
+    __m256 z = _mm256_mul_ps(r, r);
+    
+    __m256 sinPoly = _mm256_fmadd_ps(z, _mm256_set1_ps(SIN_C3), _mm256_set1_ps(SIN_C2));
+    sinPoly = _mm256_fmadd_ps(sinPoly, z, _mm256_set1_ps(SIN_C1));
+    __m256 sinR = _mm256_fmadd_ps(_mm256_mul_ps(r, z), sinPoly, r);
+    
+    __m256 cosPoly = _mm256_fmadd_ps(z, _mm256_set1_ps(COS_C3), _mm256_set1_ps(COS_C2));
+    cosPoly = _mm256_fmadd_ps(cosPoly, z, _mm256_set1_ps(COS_C1));
+    __m256 cosR = _mm256_fnmadd_ps(_mm256_set1_ps(0.5f), z, _mm256_set1_ps(1.0f));
+    cosR = _mm256_fmadd_ps(_mm256_mul_ps(z, z), cosPoly, cosR);
+    
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i two = _mm256_set1_epi32(2);
+    __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(quadrant, one), one));
+    __m256 sinSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(quadrant, two), 30));
+    __m256 cosSign = _mm256_castsi256_ps(
+        _mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(quadrant, one), two), 30));
+    s = _mm256_xor_ps(_mm256_blendv_ps(sinR, cosR, swap), sinSign);
+    c = _mm256_xor_ps(_mm256_blendv_ps(cosR, sinR, swap), cosSign);
+}
+
+FLOWER_TARGET_AVX2
+inline __m256 sinAVX2(__m256 x) {
+    __m256 s, c;
+    sincosAVX2(x, s, c);
+    return s;
+}
+
+FLOWER_TARGET_AVX2
+inline __m256 cosAVX2(__m256 x) {
+    __m256 s, c;
+    sincosAVX2(x, s, c);
+    return c;
+}
+
+FLOWER_TARGET_AVX2
+inline __m256 acosAVX2(__m256 x) {
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    __m256 a = _mm256_min_ps(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), x), one);
+    __m256 big = _mm256_cmp_ps(a, half, _CMP_GT_OQ);
+    __m256 z = _mm256_blendv_ps(_mm256_mul_ps(a, a), _mm256_mul_ps(half, _mm256_sub_ps(one, a)), big);
+    __m256 s = _mm256_blendv_ps(a, _mm256_sqrt_ps(z), big);
+    
+    __m256 poly = _mm256_fmadd_ps(z, _mm256_set1_ps(ASIN_P4), _mm256_set1_ps(ASIN_P3));
+    poly = _mm256_fmadd_ps(poly, z, _mm256_set1_ps(ASIN_P2));
+    poly = _mm256_fmadd_ps(poly, z, _mm256_set1_ps(ASIN_P1));
+    poly = _mm256_fmadd_ps(poly, z, _mm256_set1_ps(ASIN_P0));
+    __m256 p = _mm256_fmadd_ps(_mm256_mul_ps(s, z), poly, s);
+    
+    __m256 r = _mm256_blendv_ps(_mm256_sub_ps(_mm256_set1_ps(HALF_PI), p), _mm256_add_ps(p, p), big);
+    __m256 negative = _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LT_OQ);
+    return _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(PI), r), negative);
+}
+
+FLOWER_TARGET_AVX2
+inline __m256 rsqrtAVX2(__m256 x) {
+    __m256 y = _mm256_rsqrt_ps(x);
+    __m256 refined = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), y),
+                                   _mm256_fnmadd_ps(_mm256_mul_ps(x, y), y, _mm256_set1_ps(3.0f)));
+    return _mm256_blendv_ps(refined, y, _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_EQ_OQ));
+}
+
+FLOWER_TARGET_AVX2
+inline __m256 expAVX2(__m256 x) {
+    x = _mm256_max_ps(_mm256_set1_ps(EXP_MIN), _mm256_min_ps(x, _mm256_set1_ps(EXP_MAX)));
+    __m256i n = _mm256_cvtps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(LOG2E)));
+    __m256 nf = _mm256_cvtepi32_ps(n);
+    __m256 r = _mm256_fnmadd_ps(nf, _mm256_set1_ps(LN2_HI), x);
+    r = _mm256_fnmadd_ps(nf, _mm256_set1_ps(LN2_LO), r);
+    
+    __m256 p = _mm256_fmadd_ps(r, _mm256_set1_ps(EXP_P5), _mm256_set1_ps(EXP_P4));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P3));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P2));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P1));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P0));
+    __m256 y = _mm256_fmadd_ps(_mm256_mul_ps(r, r), p, _mm256_add_ps(_mm256_set1_ps(1.0f), r));
+    
+    __m256 scale = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(n, _mm256_set1_epi32(127)), 23));
+    return _mm256_mul_ps(y, scale);
+}
+
+template <__m256 (*Kernel)(__m256), UnaryKernel Tail>
+FLOWER_TARGET_AVX2
+void mapAVX2(const float* x, float* out, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(out + i, Kernel(_mm256_loadu_ps(x + i)));
+    }
+    Tail(x + i, out + i, count - i);
+}
+
+FLOWER_TARGET_AVX2
+void sincosBatchAVX2(const float* x, float* sinOut, float* cosOut, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 s, c;
+        sincosAVX2(_mm256_loadu_ps(x + i), s, c);
+        _mm256_storeu_ps(sinOut + i, s);
+        _mm256_storeu_ps(cosOut + i, c);
+    }
+    sincosScalar(x + i, sinOut + i, cosOut + i, count - i);
+}
+
+const KernelSet AVX2_KERNELS = {
+    "avx2",
+    mapAVX2<sinAVX2, sinScalar>,
+    mapAVX2<cosAVX2, cosScalar>,
+    sincosBatchAVX2,
+    mapAVX2<acosAVX2, acosScalar>,
+    mapAVX2<rsqrtAVX2, rsqrtScalar>,
+    mapAVX2<expAVX2, expScalar>
+};
+
+// AVX-512 kernels: sixteen lanes, with mask registers for lane selection.
+// GCC 12 reports its own AVX-512 intrinsics as reading an uninitialized
+// placeholder operand, so that warning is silenced for this section.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+FLOWER_TARGET_AVX512
+inline void sincosAVX512(__m512 x, __m512& s, __m512& c) {
+    __m512i quadrant = _mm512_cvtps_epi32(_mm512_mul_ps(x, _mm512_set1_ps(TWO_OVER_PI)));
+    __m512 k = _mm512_cvtepi32_ps(quadrant);
+    __m512 r = _mm512_fnmadd_ps(k, _mm512_set1_ps(PIO2_1), x);
+    r = _mm512_fnmadd_ps(k, _mm512_set1_ps(PIO2_2), r);
+    r = _mm512_fnmadd_ps(k, _mm512_set1_ps(PIO2_3), r);
+    __m512 z = _mm512_mul_ps(r, r);
+    
+    __m512 sinPoly = _mm512_fmadd_ps(z, _mm512_set1_ps(SIN_C3), _mm512_set1_ps(SIN_C2));
+    sinPoly = _mm512_fmadd_ps(sinPoly, z, _mm512_set1_ps(SIN_C1));
+    __m512 sinR = _mm512_fmadd_ps(_mm512_mul_ps(r, z), sinPoly, r);
+    
+    __m512 cosPoly = _mm512_fmadd_ps(z, _mm512_set1_ps(COS_C3), _mm512_set1_ps(COS_C2));
+    cosPoly = _mm512_fmadd_ps(cosPoly, z, _mm512_set1_ps(COS_C1));
+    __m512 cosR = _mm512_fnmadd_ps(_mm512_set1_ps(0.5f), z, _mm512_set1_ps(1.0f));
+    cosR = _mm512_fmadd_ps(_mm512_mul_ps(z, z), cosPoly, cosR);
+    
+    const __m512i one = _mm512_set1_epi32(1);
+    const __m512i two = _mm512_set1_epi32(2);
+    __mmask16 swap = _mm512_test_epi32_mask(quadrant, one);
+    __m512 sinSign = _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_and_si512(quadrant, two), 30));
+    __m512 cosSign = _mm512_castsi512_ps(
+        _mm512_slli_epi32(_mm512_and_si512(_mm512_add_epi32(quadrant, one), two), 30));
+    s = _mm512_xor_ps(_mm512_mask_blend_ps(swap, sinR, cosR), sinSign);
+    c = _mm512_xor_ps(_mm512_mask_blend_ps(swap, cosR, sinR), cosSign);
+}
+
+FLOWER_TARGET_AVX512
+inline __m512 sinAVX512(__m512 x) {
+    __m512 s, c;
+    sincosAVX512(x, s, c);
+    return s;
+}
+
+FLOWER_TARGET_AVX512
+inline __m512 cosAVX512(__m512 x) {
+    __m512 s, c;
+    sincosAVX512(x, s, c);
+    return c;
+}
+
+FLOWER_TARGET_AVX512
+inline __m512 acosAVX512(__m512 x) {
+    const __m512 one = _mm512_set1_ps(1.0f);
+    const __m512 half = _mm512_set1_ps(0.5f);
+    __m512 a = _mm512_min_ps(_mm512_abs_ps(x), one);
+    __mmask16 big = _mm512_cmp_ps_mask(a, half, _CMP_GT_OQ);
+    __m512 z = _mm512_mask_blend_ps(big, _mm512_mul_ps(a, a), _mm512_mul_ps(half, _mm512_sub_ps(one, a)));
+    __m512 s = _mm512_mask_blend_ps(big, a, _mm512_sqrt_ps(z));
+    
+    __m512 poly = _mm512_fmadd_ps(z, _mm512_set1_ps(ASIN_P4), _mm512_set1_ps(ASIN_P3));
+    poly = _mm512_fmadd_ps(poly, z, _mm512_set1_ps(ASIN_P2));
+    poly = _mm512_fmadd_ps(poly, z, _mm512_set1_ps(ASIN_P1));
+    poly = _mm512_fmadd_ps(poly, z, _mm512_set1_ps(ASIN_P0));
+    __m512 p = _mm512_fmadd_ps(_mm512_mul_ps(s, z), poly, s);
+    
+    __m512 r = _mm512_mask_blend_ps(big, _mm512_sub_ps(_mm512_set1_ps(HALF_PI), p), _mm512_add_ps(p, p));
+    __mmask16 negative = _mm512_cmp_ps_mask(x, _mm512_setzero_ps(), _CMP_LT_OQ);
+    return _mm512_mask_blend_ps(negative, r, _mm512_sub_ps(_mm512_set1_ps(PI), r));
+}
+
+FLOWER_TARGET_AVX512
+inline __m512 rsqrtAVX512(__m512 x) {
+    // The 14-bit estimate needs one Newton step as well
+    __m512 y = _mm512_rsqrt14_ps(x);
+    __m512 refined = _mm512_mul_ps(_mm512_mul_ps(_mm512_set1_ps(0.5f), y),
+                                   _mm512_fnmadd_ps(_mm512_mul_ps(x, y), y, _mm512_set1_ps(3.0f)));
+    return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(x, _mm512_setzero_ps(), _CMP_EQ_OQ), refined, y);
+}
+
+FLOWER_TARGET_AVX512
+inline __m512 expAVX512(__m512 x) {
+    x = _mm512_max_ps(_mm512_set1_ps(EXP_MIN), _mm512_min_ps(x, _mm512_set1_ps(EXP_MAX)));
+    __m512i n = _mm512_cvtps_epi32(_mm512_mul_ps(x, _mm512_set1_ps(LOG2E)));
+    __m512 nf = _mm512_cvtepi32_ps(n);
+    __m512 r = _mm512_fnmadd_ps(nf, _mm512_set1_ps(LN2_HI), x);
+    r = _mm512_fnmadd_ps(nf, _mm512_set1_ps(LN2_LO), r);
+    
+    __m512 p = _mm512_fmadd_ps(r, _mm512_set1_ps(EXP_P5), _mm512_set1_ps(EXP_P4));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P3));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P2));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P1));
+    p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P0));
+    __m512 y = _mm512_fmadd_ps(_mm512_mul_ps(r, r), p, _mm512_add_ps(_mm512_set1_ps(1.0f), r));
+    
+    __m512 scale = _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_add_epi32(n, _mm512_set1_epi32(127)), 23));
+    return _mm512_mul_ps(y, scale);
+}
+
+template <__m512 (*Kernel)(__m512), UnaryKernel Tail>
+FLOWER_TARGET_AVX512
+void mapAVX512(const float* x, float* out, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        _mm512_storeu_ps(out + i, Kernel(_mm512_loadu_ps(x + i)));
+    }
+    Tail(x + i, out + i, count - i);
+}
+
+FLOWER_TARGET_AVX512
+void sincosBatchAVX512(const float* x, float* sinOut, float* cosOut, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m512 s, c;
+        sincosAVX512(_mm512_loadu_ps(x + i), s, c);
+        _mm512_storeu_ps(sinOut + i, s);
+        _mm512_storeu_ps(cosOut + i, c);
+    }
+    sincosScalar(x + i, sinOut + i, cosOut + i, count - i);
+}
+
+const KernelSet AVX512_KERNELS = {
+    "avx512",
+    mapAVX512<sinAVX512, sinScalar>,
+    mapAVX512<cosAVX512, cosScalar>,
+    sincosBatchAVX512,
+    mapAVX512<acosAVX512, acosScalar>,
+    mapAVX512<rsqrtAVX512, rsqrtScalar>,
+    mapAVX512<expAVX512, expScalar>
+};
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+// Every kernel set the running processor can execute, narrowest first
+std::vector<const KernelSet*> supportedKernelSets() {
+    std::vector<const KernelSet*> sets;
+    sets.push_back(&SCALAR_KERNELS);
+#ifdef FLOWER_X86
+    const CpuFeatures& cpu = getCpuFeatures();
+    if (cpu.sse2) sets.push_back(&SSE2_KERNELS);
+    if (cpu.avx2) sets.push_back(&AVX2_KERNELS);
+    if (cpu.avx512) sets.push_back(&AVX512_KERNELS);
+#endif
+    return sets;
+}
+
+const KernelSet& activeKernels() {
+    static const KernelSet* kernels = supportedKernelSets().back();
+    return *kernels;
+}
+
+}  // namespace
+
+namespace MathUtils {
+
+void sinBatch(const float* x, float* out, size_t count) {
+    activeKernels().sin(x, out, count);
+}
+
+void cosBatch(const float* x, float* out, size_t count) {
+    activeKernels().cos(x, out, count);
+}
+
+void sincosBatch(const float* x, float* sinOut, float* cosOut, size_t count) {
+    activeKernels().sincos(x, sinOut, cosOut, count);
+}
+
+void acosBatch(const float* x, float* out, size_t count) {
+    activeKernels().acos(x, out, count);
+}
+
+void rsqrtBatch(const float* x, float* out, size_t count) {
+    activeKernels().rsqrt(x, out, count);
+}
+
+void expBatch(const float* x, float* out, size_t count) {
+    activeKernels().exp(x, out, count);
+}
+
+float fastAcos(float x) {
+    return acosApprox(x);
+}
+
+const char* getMathKernelName() {
+    return activeKernels().name;
+}
+
+bool runMathKernelBenchmark() {
+    const size_t COUNT = 1 << 20;
+    const int REPEATS = 20;
+    
+    // Inputs cover each kernel's documented range
+    std::mt19937 rng(12345);
+    std::uniform_real_distribution<float> wideAngle(-1.0e4f, 1.0e4f);
+    std::uniform_real_distribution<float> smallAngle(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> unitRange(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> log2Range(-20.0f, 20.0f);
+    std::uniform_real_distribution<float> expRange(EXP_MIN, EXP_MAX);
+    
+    std::vector<float> angles(COUNT), cosines(COUNT), positives(COUNT), exponents(COUNT);
+    for (size_t i = 0; i < COUNT; i++) {
+        angles[i] = (i % 4 == 0) ? wideAngle(rng) : smallAngle(rng);
+        cosines[i] = unitRange(rng);
+        positives[i] = std::exp2(log2Range(rng));
+        exponents[i] = expRange(rng);
+    }
+    cosines[0] = -1.0f;
+    cosines[1] = 1.0f;
+    cosines[2] = 0.0f;
+    
+    struct Function {
+        const char* name;
+        UnaryKernel KernelSet::*kernel;
+        const std::vector<float>* input;
+        float bound;
+        bool relative;
+        double (*reference)(double);
+        float (*libm)(float);
+    };
+    const Function functions[] = {
+        { "sin", &KernelSet::sin, &angles, 2e-7f, false,
+          [](double v) { return std::sin(v); }, [](float v) { return std::sin(v); } },
+        { "cos", &KernelSet::cos, &angles, 2e-7f, false,
+          [](double v) { return std::cos(v); }, [](float v) { return std::cos(v); } },
+        { "acos", &KernelSet::acos, &cosines, 5e-7f, false,
+          [](double v) { return std::acos(v); }, [](float v) { return std::acos(v); } },
+        { "rsqrt", &KernelSet::rsqrt, &positives, 5e-7f, true,
+          [](double v) { return 1.0 / std::sqrt(v); }, [](float v) { return 1.0f / std::sqrt(v); } },
+        { "exp", &KernelSet::exp, &exponents, 2.5e-7f, true,
+          [](double v) { return std::exp(v); }, [](float v) { return std::exp(v); } },
+    };
+    
+    typedef std::chrono::steady_clock Clock;
+    std::vector<float> out(COUNT);
+    volatile float sink = 0.0f;
+    bool passed = true;
+    
+    std::cout << "Math kernels (active: " << getMathKernelName() << ")" << std::endl;
+    std::cout << std::left << std::setw(10) << "variant" << std::setw(8) << "func"
+              << std::setw(14) << "max error" << std::setw(10) << "bound" << "ns/value" << std::endl;
+    
+    for (const Function& function : functions) {
+        const std::vector<float>& input = *function.input;
+        
+        // libm baseline, one value at a time
+        Clock::time_point start = Clock::now();
+        for (int repeat = 0; repeat < REPEATS; repeat++) {
+            for (size_t i = 0; i < COUNT; i++) {
+                out[i] = function.libm(input[i]);
+            }
+            sink = sink + out[repeat];
+        }
+        double libmNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / (COUNT * REPEATS);
+        std::cout << std::setw(10) << "libm" << std::setw(8) << function.name << std::setw(14) << "-"
+                  << std::setw(10) << "-" << std::fixed << std::setprecision(2) << libmNs
+                  << std::defaultfloat << std::endl;
+        
+        for (const KernelSet* kernels : supportedKernelSets()) {
+            UnaryKernel kernel = kernels->*function.kernel;
+            start = Clock::now();
+            for (int repeat = 0; repeat < REPEATS; repeat++) {
+                kernel(input.data(), out.data(), COUNT);
+                sink = sink + out[repeat];
+            }
+            double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / (COUNT * REPEATS);
+            
+            double maxError = 0.0;
+            for (size_t i = 0; i < COUNT; i++) {
+                double expected = function.reference(input[i]);
+                double error = std::abs(out[i] - expected);
+                if (function.relative) error /= std::abs(expected);
+                maxError = std::max(maxError, error);
+            }
+            
+            bool ok = maxError <= function.bound;
+            passed = passed && ok;
+            std::cout << std::setw(10) << kernels->name << std::setw(8) << function.name
+                      << std::setw(14) << std::setprecision(3) << maxError << std::setw(10) << function.bound
+                      << std::fixed << std::setprecision(2) << ns << std::defaultfloat
+                      << (ok ? "" : "  FAILED") << std::endl;
+        }
+    }
+    
+    // sincos must match the separate sin and cos kernels exactly
+    std::vector<float> sinOut(COUNT), cosOut(COUNT), reference(COUNT);
+    for (const KernelSet* kernels : supportedKernelSets()) {
+        kernels->sincos(angles.data(), sinOut.data(), cosOut.data(), COUNT);
+        kernels->sin(angles.data(), out.data(), COUNT);
+        kernels->cos(angles.data(), reference.data(), COUNT);
+        if (std::memcmp(sinOut.data(), out.data(), COUNT * sizeof(float)) != 0 ||
+            std::memcmp(cosOut.data(), reference.data(), COUNT * sizeof(float)) != 0) {
+            std::cout << kernels->name << " sincos differs from sin/cos  FAILED" << std::endl;
+            passed = false;
+        }
+    }
+    
+    return passed;
+}
+
+}  // namespace MathUtils
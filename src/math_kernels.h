@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+
+// Batch transcendental kernels. Each function evaluates a polynomial
+// approximation over 'count' floats using the widest instruction set the
+// processor supports (AVX-512, AVX2, SSE2 or scalar), picked once by CPUID
+// on first use. Output may alias input.
+//
+// Error bounds against double-precision libm (checked by --math-bench):
+//   sin, cos, sincos   absolute error <= 2e-7 for |x| <= 1e4
+//   acos               absolute error <= 5e-7, inputs clamped to [-1, 1]
+//   rsqrt              relative error <= 5e-7 for x > 0; rsqrt(0) = inf
+//   exp                relative error <= 2.5e-7, inputs clamped to [-87, 88]
+namespace MathUtils {
+    void sinBatch(const float* x, float* out, size_t count);
+    void cosBatch(const float* x, float* out, size_t count);
+    void sincosBatch(const float* x, float* sinOut, float* cosOut, size_t count);
+    void acosBatch(const float* x, float* out, size_t count);
+    void rsqrtBatch(const float* x, float* out, size_t count);
+    void expBatch(const float* x, float* out, size_t count);
+    
+    // Single-value form of the scalar acos kernel
+    float fastAcos(float x);
+    
+    // Name of the instruction set the batch kernels run on
+    const char* getMathKernelName();
+    
+    // Measures accuracy and throughput of every supported kernel variant
+    // against libm and prints a report. Returns false if any kernel is
+    // outside its error bound.
+    bool runMathKernelBenchmark();
+}
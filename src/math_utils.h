@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cmath>
+#include <cstdint>
 #include <algorithm>
 
 // Constants
@@ -261,4 +262,71 @@ namespace MathUtils {
     inline float toDegrees(float radians) {
         return radians * RAD_TO_DEG;
     }
+    
+    // Octahedral normal packing: the unit sphere is projected onto an
+    // octahedron and unfolded into a square, stored as two 8-bit coordinates.
+    // Values are quantized to [0, 254] so that 127 maps exactly to zero and
+    // straight-up normals survive a round trip unchanged.
+    inline uint16_t packNormalOct(const Vec3& n) {
+        float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+        if (l1 <= 0.0f) {
+            return static_cast<uint16_t>(127 | (127 << 8));
+        }
+        
+        float u = n.x / l1;
+        float v = n.z / l1;
+        
+        // Fold the lower hemisphere over the diagonals
+        if (n.y < 0.0f) {
+            float foldedU = (1.0f - std::abs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+            float foldedV = (1.0f - std::abs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+            u = foldedU;
+            v = foldedV;
+        }
+        
+        int qu = static_cast<int>(std::lround(clamp(u, -1.0f, 1.0f) * 127.0f)) + 127;
+        int qv = static_cast<int>(std::lround(clamp(v, -1.0f, 1.0f) * 127.0f)) + 127;
+        return static_cast<uint16_t>(qu | (qv << 8));
+    }
+    
+    inline Vec3 unpackNormalOct(uint16_t packed) {
+        float u = (static_cast<int>(packed & 0xFF) - 127) / 127.0f;
+        float v = (static_cast<int>(packed >> 8) - 127) / 127.0f;
+        float y = 1.0f - std::abs(u) - std::abs(v);
+        
+        if (y < 0.0f) {
+            float unfoldedU = (1.0f - std::abs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+            float unfoldedV = (1.0f - std::abs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+            u = unfoldedU;
+            v = unfoldedV;
+        }
+        
+        return Vec3(u, y, v).normalized();
+    }
+    
+    // RGBA8 colour with red in the lowest byte, channels clamped to [0, 1]
+    inline uint32_t packColorRGBA8(const Color& color) {
+        auto channel = [](float value) {
+            return static_cast<uint32_t>(std::lround(clamp(value, 0.0f, 1.0f) * 255.0f));
+        };
+        return channel(color.r) | channel(color.g) << 8 | channel(color.b) << 16 | channel(color.a) << 24;
+    }
+    
+    inline Color unpackColorRGBA8(uint32_t packed) {
+        return Color((packed & 0xFF) / 255.0f, ((packed >> 8) & 0xFF) / 255.0f,
+                     ((packed >> 16) & 0xFF) / 255.0f, (packed >> 24) / 255.0f);
+    }
+    
+    // Packs the heightfield normal of one cell from its four neighbour heights.
+    // The normal is (-(hRight - hLeft), 2, -(hForward - hBack)) before
+    // normalization, and since the octahedral projection divides by the L1
+    // norm anyway, no square root is needed.
+    inline uint16_t packHeightfieldNormal(float hLeft, float hRight, float hBack, float hForward) {
+        float dx = hRight - hLeft;
+        float dz = hForward - hBack;
+        float l1 = std::abs(dx) + 2.0f + std::abs(dz);
+        int qu = static_cast<int>(std::lround(-dx / l1 * 127.0f)) + 127;
+        int qv = static_cast<int>(std::lround(-dz / l1 * 127.0f)) + 127;
+        return static_cast<uint16_t>(qu | (qv << 8));
+    }
 }
@@ -0,0 +1,595 @@
+#include "occlusion_culler.h"
+#include "job_system.h"
+#include "software_rasterizer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <random>
+
+namespace {
+    // Rows rasterized per job
+    const int BAND_HEIGHT = 16;
+    
+    // Only pixels the triangle covers completely take its depth, so edges
+    // never hide anything; pushing each edge in by half a pixel diagonal
+    const float COVERAGE_MARGIN = 0.5f;
+    
+    // Finer pyramid levels are only read while the box covers at most this
+    // many of their texels
+    const int REFINE_TEXELS = 16;
+    
+    // Boxes tested per job by isVisibleBatch
+    const int BOX_GRAIN = 1024;
+    
+    // Bit per frustum plane the point is outside of
+    int outcode(const Vec4& v) {
+        return (v.x < -v.w ? 1 : 0) | (v.x > v.w ? 2 : 0) |
+               (v.y < -v.w ? 4 : 0) | (v.y > v.w ? 8 : 0) |
+               (v.z < -v.w ? 16 : 0) | (v.z > v.w ? 32 : 0);
+    }
+}
+
+OcclusionCuller::OcclusionCuller(const Settings& settings)
+    : settings(settings)
+    , world(nullptr)
+    , worldWidth(0)
+    , worldHeight(0)
+    , chunksX(0)
+    , chunksZ(0)
+    , blocksPerChunk(World::CHUNK_SIZE / settings.blockSize)
+    , ready(false)
+{
+    // Level 0 is the depth buffer; each level halves it, rounding up
+    int width = settings.width, height = settings.height;
+    while (true) {
+        levelWidths.push_back(width);
+        levelHeights.push_back(height);
+        pyramid.push_back(std::vector<float>(static_cast<size_t>(width) * height, 1.0f));
+        if (width == 1 && height == 1) break;
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+    }
+}
+
+OcclusionCuller::~OcclusionCuller() {
+    detach();
+}
+
+void OcclusionCuller::attach(World& target) {
+    detach();
+    world = &target;
+    world->addListener(this);
+    worldWidth = 0;
+    worldHeight = 0;
+    ready = false;
+}
+
+void OcclusionCuller::detach() {
+    if (!world) return;
+    world->removeListener(this);
+    world = nullptr;
+    ready = false;
+}
+
+void OcclusionCuller::onTerrainHeightChanged(int x, int z, float /*height*/) {
+    if (x < 0 || z < 0 || x >= worldWidth || z >= worldHeight) return;
+    chunks[(z / World::CHUNK_SIZE) * chunksX + x / World::CHUNK_SIZE].dirty = true;
+}
+
+void OcclusionCuller::onTerrainRegionChanged(int minX, int minZ, int maxX, int maxZ) {
+    int chunkX0 = std::max(minX, 0) / World::CHUNK_SIZE;
+    int chunkZ0 = std::max(minZ, 0) / World::CHUNK_SIZE;
+    int chunkX1 = std::min(maxX / World::CHUNK_SIZE, chunksX - 1);
+    int chunkZ1 = std::min(maxZ / World::CHUNK_SIZE, chunksZ - 1);
+    for (int chunkZ = chunkZ0; chunkZ <= chunkZ1; chunkZ++) {
+        for (int chunkX = chunkX0; chunkX <= chunkX1; chunkX++) {
+            chunks[chunkZ * chunksX + chunkX].dirty = true;
+        }
+    }
+}
+
+void OcclusionCuller::onTerrainReset() {
+    for (ChunkOccluder& chunk : chunks) {
+        chunk.dirty = true;
+    }
+}
+
+size_t OcclusionCuller::getOccluderTriangleCount() const {
+    size_t count = 0;
+    for (const std::vector<Triangle>& triangles : chunkTriangles) {
+        count += triangles.size();
+    }
+    return count;
+}
+
+float OcclusionCuller::blockTop(int blockX, int blockZ) const {
+    const ChunkOccluder& chunk = chunks[(blockZ / blocksPerChunk) * chunksX + blockX / blocksPerChunk];
+    size_t block = (blockZ % blocksPerChunk) * blocksPerChunk + blockX % blocksPerChunk;
+    if (chunk.blockBottoms[block] > chunk.blockTops[block]) return -std::numeric_limits<float>::max();
+    return chunk.blockTops[block];
+}
+
+void OcclusionCuller::rebuildChunk(int index) {
+    ChunkOccluder& chunk = chunks[index];
+    int cellX0 = (index % chunksX) * World::CHUNK_SIZE;
+    int cellZ0 = (index / chunksX) * World::CHUNK_SIZE;
+    
+    chunk.blockTops.assign(static_cast<size_t>(blocksPerChunk) * blocksPerChunk, 0.0f);
+    chunk.blockBottoms.assign(chunk.blockTops.size(), 1.0f);
+    chunk.maxHeight = -std::numeric_limits<float>::max();
+    for (int blockZ = 0; blockZ < blocksPerChunk; blockZ++) {
+        for (int blockX = 0; blockX < blocksPerChunk; blockX++) {
+            int x0 = cellX0 + blockX * settings.blockSize;
+            int z0 = cellZ0 + blockZ * settings.blockSize;
+            int x1 = std::min(x0 + settings.blockSize, worldWidth);
+            int z1 = std::min(z0 + settings.blockSize, worldHeight);
+            if (x0 >= x1 || z0 >= z1) continue;
+            
+            float lowest = std::numeric_limits<float>::max();
+            float highest = -lowest;
+            for (int z = z0; z < z1; z++) {
+                for (int x = x0; x < x1; x++) {
+                    float height = world->getTerrainHeight(x, z);
+                    lowest = std::min(lowest, height);
+                    highest = std::max(highest, height);
+                }
+            }
+            chunk.blockTops[blockZ * blocksPerChunk + blockX] = lowest;
+            chunk.blockBottoms[blockZ * blocksPerChunk + blockX] = highest - 1.0f;
+            chunk.maxHeight = std::max(chunk.maxHeight, highest);
+        }
+    }
+    chunk.dirty = false;
+}
+
+void OcclusionCuller::update(const Mat4& matrix) {
+    if (!world) return;
+    viewProjection = matrix;
+    
+    // Loading a map can change the world's size
+    if (world->getWidth() != worldWidth || world->getHeight() != worldHeight) {
+        worldWidth = world->getWidth();
+        worldHeight = world->getHeight();
+        chunksX = (worldWidth + World::CHUNK_SIZE - 1) / World::CHUNK_SIZE;
+        chunksZ = (worldHeight + World::CHUNK_SIZE - 1) / World::CHUNK_SIZE;
+        chunks.assign(static_cast<size_t>(chunksX) * chunksZ, ChunkOccluder());
+        onTerrainReset();
+    }
+    
+    int chunkCount = chunksX * chunksZ;
+    JobSystem::instance().parallelFor(0, chunkCount, 1, [&](int first, int last) {
+        for (int index = first; index < last; index++) {
+            if (chunks[index].dirty) rebuildChunk(index);
+        }
+    });
+    
+    // Boxes of every block in view; neighbouring blocks are read across
+    // chunk borders, so this waits for all rebuilds above
+    int blocksX = (worldWidth + settings.blockSize - 1) / settings.blockSize;
+    int blocksZ = (worldHeight + settings.blockSize - 1) / settings.blockSize;
+    chunkTriangles.resize(chunkCount);
+    JobSystem::instance().parallelFor(0, chunkCount, 1, [&](int first, int last) {
+        for (int index = first; index < last; index++) {
+            std::vector<Triangle>& triangles = chunkTriangles[index];
+            triangles.clear();
+            
+            // Skip chunks entirely outside the view
+            const ChunkOccluder& chunk = chunks[index];
+            float x0 = static_cast<float>((index % chunksX) * World::CHUNK_SIZE);
+            float z0 = static_cast<float>((index / chunksX) * World::CHUNK_SIZE);
+            float x1 = std::min(x0 + World::CHUNK_SIZE, static_cast<float>(worldWidth));
+            float z1 = std::min(z0 + World::CHUNK_SIZE, static_cast<float>(worldHeight));
+            float y0 = *std::min_element(chunk.blockTops.begin(), chunk.blockTops.end()) - 1.0f;
+            int outside = ~0;
+            for (int corner = 0; corner < 8; corner++) {
+                Vec3 point((corner & 1) ? x1 : x0, (corner & 2) ? chunk.maxHeight : y0, (corner & 4) ? z1 : z0);
+                outside &= outcode(viewProjection * Vec4(point, 1.0f));
+            }
+            if (outside) continue;
+            
+            int firstBlockX = (index % chunksX) * blocksPerChunk;
+            int firstBlockZ = (index / chunksX) * blocksPerChunk;
+            int lastBlockX = std::min(firstBlockX + blocksPerChunk, blocksX);
+            int lastBlockZ = std::min(firstBlockZ + blocksPerChunk, blocksZ);
+            for (int blockZ = firstBlockZ; blockZ < lastBlockZ; blockZ++) {
+                for (int blockX = firstBlockX; blockX < lastBlockX; blockX++) {
+                    float top = blockTop(blockX, blockZ);
+                    float boxBottom = chunk.blockBottoms[(blockZ % blocksPerChunk) * blocksPerChunk + blockX % blocksPerChunk];
+                    if (boxBottom > top) continue;
+                    float left = static_cast<float>(blockX * settings.blockSize);
+                    float back = static_cast<float>(blockZ * settings.blockSize);
+                    float right = std::min(left + settings.blockSize, static_cast<float>(worldWidth));
+                    float front = std::min(back + settings.blockSize, static_cast<float>(worldHeight));
+                    addQuad(Vec3(left, top, back), Vec3(right, top, back),
+                            Vec3(right, top, front), Vec3(left, top, front), triangles);
+                    
+                    // Sides down to a lower neighbour's top, but no further
+                    // than the box goes
+                    auto sideBottom = [&](int neighbourX, int neighbourZ) {
+                        if (neighbourX < 0 || neighbourZ < 0 || neighbourX >= blocksX || neighbourZ >= blocksZ) {
+                            return boxBottom;
+                        }
+                        return std::max(boxBottom, blockTop(neighbourX, neighbourZ));
+                    };
+                    float bottom = sideBottom(blockX - 1, blockZ);
+                    if (bottom < top) {
+                        addQuad(Vec3(left, bottom, back), Vec3(left, top, back),
+                                Vec3(left, top, front), Vec3(left, bottom, front), triangles);
+                    }
+                    bottom = sideBottom(blockX + 1, blockZ);
+                    if (bottom < top) {
+                        addQuad(Vec3(right, bottom, back), Vec3(right, top, back),
+                                Vec3(right, top, front), Vec3(right, bottom, front), triangles);
+                    }
+                    bottom = sideBottom(blockX, blockZ - 1);
+                    if (bottom < top) {
+                        addQuad(Vec3(left, bottom, back), Vec3(right, bottom, back),
+                                Vec3(right, top, back), Vec3(left, top, back), triangles);
+                    }
+                    bottom = sideBottom(blockX, blockZ + 1);
+                    if (bottom < top) {
+                        addQuad(Vec3(left, bottom, front), Vec3(right, bottom, front),
+                                Vec3(right, top, front), Vec3(left, top, front), triangles);
+                    }
+                }
+            }
+        }
+    });
+    
+    int bands = (settings.height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+    JobSystem::instance().parallelFor(0, bands, 1, [&](int first, int last) {
+        for (int band = first; band < last; band++) {
+            rasterizeRows(band * BAND_HEIGHT, std::min((band + 1) * BAND_HEIGHT, settings.height) - 1);
+        }
+    });
+    
+    buildPyramid();
+    ready = true;
+}
+
+void OcclusionCuller::addQuad(const Vec3& p0, const Vec3& p1, const Vec3& p2, const Vec3& p3,
+                              std::vector<Triangle>& out) const {
+    Vec4 v0 = viewProjection * Vec4(p0, 1.0f);
+    Vec4 v1 = viewProjection * Vec4(p1, 1.0f);
+    Vec4 v2 = viewProjection * Vec4(p2, 1.0f);
+    Vec4 v3 = viewProjection * Vec4(p3, 1.0f);
+    if (outcode(v0) & outcode(v1) & outcode(v2) & outcode(v3)) return;
+    addTriangle(v0, v1, v2, out);
+    addTriangle(v0, v2, v3, out);
+}
+
+void OcclusionCuller::addTriangle(const Vec4& v0, const Vec4& v1, const Vec4& v2, std::vector<Triangle>& out) const {
+    if (outcode(v0) & outcode(v1) & outcode(v2)) return;
+    
+    // Clip against the near plane (z >= -w); the other sides are handled by
+    // the bounding box
+    Vec4 polygon[4];
+    int count = 0;
+    const Vec4* corners[3] = { &v0, &v1, &v2 };
+    for (int i = 0; i < 3; i++) {
+        const Vec4& current = *corners[i];
+        const Vec4& next = *corners[(i + 1) % 3];
+        float d0 = current.z + current.w;
+        float d1 = next.z + next.w;
+        if (d0 >= 0.0f) polygon[count++] = current;
+        if ((d0 >= 0.0f) != (d1 >= 0.0f)) polygon[count++] = current + (next - current) * (d0 / (d0 - d1));
+    }
+    if (count < 3) return;
+    
+    Vec3 screen[4];
+    for (int i = 0; i < count; i++) {
+        float inverseW = 1.0f / polygon[i].w;
+        screen[i] = Vec3((polygon[i].x * inverseW * 0.5f + 0.5f) * settings.width,
+                         (0.5f - polygon[i].y * inverseW * 0.5f) * settings.height,
+                         polygon[i].z * inverseW * 0.5f + 0.5f);
+    }
+    
+    for (int fan = 2; fan < count; fan++) {
+        Vec3 p0 = screen[0], p1 = screen[fan - 1], p2 = screen[fan];
+        float area = (p1.x - p0.x) * (p2.y - p0.y) - (p2.x - p0.x) * (p1.y - p0.y);
+        if (!(area != 0.0f) || !std::isfinite(area)) continue;
+        if (area > 0.0f) {
+            std::swap(p1, p2);
+            area = -area;
+        }
+        
+        Triangle triangle;
+        triangle.minX = std::max(0, static_cast<int>(std::ceil(std::min({ p0.x, p1.x, p2.x }) - 0.5f)));
+        triangle.minY = std::max(0, static_cast<int>(std::ceil(std::min({ p0.y, p1.y, p2.y }) - 0.5f)));
+        triangle.maxX = std::min(settings.width - 1, static_cast<int>(std::floor(std::max({ p0.x, p1.x, p2.x }) - 0.5f)));
+        triangle.maxY = std::min(settings.height - 1, static_cast<int>(std::floor(std::max({ p0.y, p1.y, p2.y }) - 0.5f)));
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) continue;
+        
+        const Vec3* points[3] = { &p0, &p1, &p2 };
+        for (int i = 0; i < 3; i++) {
+            const Vec3& from = *points[i];
+            const Vec3& to = *points[(i + 1) % 3];
+            triangle.a[i] = to.y - from.y;
+            triangle.b[i] = from.x - to.x;
+            triangle.c[i] = -(triangle.a[i] * from.x + triangle.b[i] * from.y);
+        }
+        
+        // Store the farthest depth the plane reaches inside each pixel, so
+        // a pixel the occluder only partly slopes across never hides more
+        // than the occluder does
+        float dx1 = p1.x - p0.x, dy1 = p1.y - p0.y, dz1 = p1.z - p0.z;
+        float dx2 = p2.x - p0.x, dy2 = p2.y - p0.y, dz2 = p2.z - p0.z;
+        triangle.depthX = (dz1 * dy2 - dz2 * dy1) / area;
+        triangle.depthY = (dx1 * dz2 - dx2 * dz1) / area;
+        triangle.depthC = p0.z - triangle.depthX * p0.x - triangle.depthY * p0.y +
+                          0.5f * (std::abs(triangle.depthX) + std::abs(triangle.depthY));
+        out.push_back(triangle);
+    }
+}
+
+void OcclusionCuller::rasterizeRows(int firstRow, int lastRow) {
+    std::vector<float>& depth = pyramid[0];
+    for (int y = firstRow; y <= lastRow; y++) {
+        std::fill(depth.begin() + static_cast<size_t>(y) * settings.width,
+                  depth.begin() + static_cast<size_t>(y + 1) * settings.width, 1.0f);
+    }
+    
+    for (const std::vector<Triangle>& triangles : chunkTriangles) {
+        for (const Triangle& triangle : triangles) {
+            int minY = std::max(triangle.minY, firstRow);
+            int maxY = std::min(triangle.maxY, lastRow);
+            for (int y = minY; y <= maxY; y++) {
+                // Solve the edge functions for the span of pixel centres
+                // inside the triangle on this row
+                float py = y + 0.5f;
+                float left = static_cast<float>(triangle.minX);
+                float right = static_cast<float>(triangle.maxX);
+                for (int i = 0; i < 3; i++) {
+                    float rowTerm = triangle.b[i] * py + triangle.c[i] - COVERAGE_MARGIN * (std::abs(triangle.a[i]) + std::abs(triangle.b[i]));
+                    if (triangle.a[i] > 0.0f) {
+                        left = std::max(left, std::ceil(-rowTerm / triangle.a[i] - 0.5f));
+                    } else if (triangle.a[i] < 0.0f) {
+                        right = std::min(right, std::floor(-rowTerm / triangle.a[i] - 0.5f));
+                    } else if (rowTerm < 0.0f) {
+                        right = left - 1.0f;
+                    }
+                }
+                
+                float* row = &depth[static_cast<size_t>(y) * settings.width];
+                float rowDepth = triangle.depthY * py + triangle.depthC;
+                for (int x = static_cast<int>(left); x <= static_cast<int>(right); x++) {
+                    float z = std::min(1.0f, triangle.depthX * (x + 0.5f) + rowDepth);
+                    row[x] = std::min(row[x], z);
+                }
+            }
+        }
+    }
+}
+
+void OcclusionCuller::buildPyramid() {
+    for (size_t level = 1; level < pyramid.size(); level++) {
+        const std::vector<float>& source = pyramid[level - 1];
+        std::vector<float>& target = pyramid[level];
+        int sourceWidth = levelWidths[level - 1], sourceHeight = levelHeights[level - 1];
+        int width = levelWidths[level], height = levelHeights[level];
+        for (int y = 0; y < height; y++) {
+            int y0 = y * 2, y1 = std::min(y * 2 + 1, sourceHeight - 1);
+            for (int x = 0; x < width; x++) {
+                int x0 = x * 2, x1 = std::min(x * 2 + 1, sourceWidth - 1);
+                target[static_cast<size_t>(y) * width + x] = std::max(
+                    std::max(source[static_cast<size_t>(y0) * sourceWidth + x0], source[static_cast<size_t>(y0) * sourceWidth + x1]),
+                    std::max(source[static_cast<size_t>(y1) * sourceWidth + x0], source[static_cast<size_t>(y1) * sourceWidth + x1]));
+            }
+        }
+    }
+}
+
+bool OcclusionCuller::isVisible(const Vec3& min, const Vec3& max) const {
+    if (!ready) return true;
+    
+    float minX = std::numeric_limits<float>::max(), maxX = -minX;
+    float minY = minX, maxY = -minX;
+    float nearest = 1.0f;
+    int outside = ~0;
+    
+    // One full transform for the min corner; the others add scaled matrix
+    // columns along the box edges
+    const float* m = viewProjection.data();
+    Vec4 base = viewProjection * Vec4(min, 1.0f);
+    Vec4 edgeX = Vec4(m[0], m[1], m[2], m[3]) * (max.x - min.x);
+    Vec4 edgeY = Vec4(m[4], m[5], m[6], m[7]) * (max.y - min.y);
+    Vec4 edgeZ = Vec4(m[8], m[9], m[10], m[11]) * (max.z - min.z);
+    for (int corner = 0; corner < 8; corner++) {
+        Vec4 clip = base;
+        if (corner & 1) clip = clip + edgeX;
+        if (corner & 2) clip = clip + edgeY;
+        if (corner & 4) clip = clip + edgeZ;
+        int code = outcode(clip);
+        outside &= code;
+        
+        // Boxes crossing the near plane are too close to test
+        if (code & 16) return true;
+        
+        float inverseW = 1.0f / clip.w;
+        float x = (clip.x * inverseW * 0.5f + 0.5f) * settings.width;
+        float y = (0.5f - clip.y * inverseW * 0.5f) * settings.height;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        nearest = std::min(nearest, clip.z * inverseW * 0.5f + 0.5f);
+    }
+    if (outside) return false;
+    
+    // Every pixel the box touches, then the pyramid level where that is at
+    // most 2x2 texels
+    int x0 = std::max(0, static_cast<int>(std::floor(minX)));
+    int y0 = std::max(0, static_cast<int>(std::floor(minY)));
+    int x1 = std::min(settings.width - 1, static_cast<int>(std::floor(maxX)));
+    int y1 = std::min(settings.height - 1, static_cast<int>(std::floor(maxY)));
+    if (x0 > x1 || y0 > y1) return false;
+    
+    size_t level = 0;
+    while (level + 1 < pyramid.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1)) {
+        level++;
+    }
+    
+    // The coarse level rejects most hidden boxes in a few reads. Its texels
+    // reach past the box, so a box it can't reject is tried again at finer
+    // levels, which hug the box more closely.
+    if (isHiddenAt(level, x0, y0, x1, y1, nearest)) return false;
+    while (level > 0) {
+        level--;
+        int texels = ((x1 >> level) - (x0 >> level) + 1) * ((y1 >> level) - (y0 >> level) + 1);
+        if (texels > REFINE_TEXELS) break;
+        if (isHiddenAt(level, x0, y0, x1, y1, nearest)) return false;
+    }
+    return true;
+}
+
+void OcclusionCuller::isVisibleBatch(const Vec3* mins, const Vec3* maxs, size_t count, uint8_t* visible) const {
+    JobSystem::instance().parallelFor(0, static_cast<int>(count), BOX_GRAIN, [&](int first, int last) {
+        for (int i = first; i < last; i++) {
+            visible[i] = isVisible(mins[i], maxs[i]) ? 1 : 0;
+        }
+    });
+}
+
+bool OcclusionCuller::isHiddenAt(size_t level, int x0, int y0, int x1, int y1, float nearest) const {
+    const std::vector<float>& depth = pyramid[level];
+    int width = levelWidths[level];
+    for (int y = y0 >> level; y <= y1 >> level; y++) {
+        const float* row = &depth[static_cast<size_t>(y) * width];
+        for (int x = x0 >> level; x <= x1 >> level; x++) {
+            if (nearest < row[x]) return false;
+        }
+    }
+    return true;
+}
+
+bool OcclusionCuller::runBenchmark() {
+    const int WORLD_SIDE = 256;
+    const int FRAMES = 20;
+    
+    World world(WORLD_SIDE, WORLD_SIDE);
+    world.generateHillyTerrain(10.0f, 0.05f);
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (int z = 0; z < WORLD_SIDE; z++) {
+        for (int x = 0; x < WORLD_SIDE; x++) {
+            if (unit(rng) < 0.3f) world.setCell(x, z, World::CellType::FLOWER);
+        }
+    }
+    
+    // Stand at the lowest point of the middle of the map, looking along +X
+    int eyeX = WORLD_SIDE / 2, eyeZ = WORLD_SIDE / 2;
+    for (int z = WORLD_SIDE / 4; z < WORLD_SIDE * 3 / 4; z++) {
+        for (int x = WORLD_SIDE / 4; x < WORLD_SIDE * 3 / 4; x++) {
+            if (world.getTerrainHeight(x, z) < world.getTerrainHeight(eyeX, eyeZ)) {
+                eyeX = x;
+                eyeZ = z;
+            }
+        }
+    }
+    Vec3 eye(eyeX + 0.5f, world.getTerrainHeight(eyeX, eyeZ) + 1.7f, eyeZ + 0.5f);
+    Mat4 view = Mat4::lookAt(eye, eye + Vec3(1.0f, -0.1f, 0.3f), Vec3::up());
+    Mat4 projection = Mat4::perspective(60.0f, 800.0f / 600.0f, 0.1f, 100.0f);
+    
+    OcclusionCuller culler;
+    culler.attach(world);
+    
+    typedef std::chrono::steady_clock Clock;
+    culler.update(projection * view);
+    Clock::time_point start = Clock::now();
+    for (int frame = 0; frame < FRAMES; frame++) {
+        culler.update(projection * view);
+    }
+    double updateMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / FRAMES;
+    
+    // One box per cell, covering its ground cube and flower
+    std::vector<Vec3> mins, maxs;
+    for (int z = 0; z < WORLD_SIDE; z++) {
+        for (int x = 0; x < WORLD_SIDE; x++) {
+            float height = world.getTerrainHeight(x, z);
+            bool flower = world.getCellType(x, z) == World::CellType::FLOWER;
+            mins.push_back(Vec3(x, height - 1.0f, z));
+            maxs.push_back(Vec3(x + 1.0f, height + (flower ? 0.5f : 0.0f), z + 1.0f));
+        }
+    }
+    
+    // The engine tests a box per cell of the 50x50 map, or per cell within
+    // its 64-cell cube radius of a streamed world; time the cells around the
+    // eye at those counts, and the whole world
+    std::vector<Vec3> mapMins, mapMaxs, radiusMins, radiusMaxs;
+    for (size_t i = 0; i < mins.size(); i++) {
+        float dx = mins[i].x + 0.5f - eye.x;
+        float dz = mins[i].z + 0.5f - eye.z;
+        if (std::abs(dx) < 25.0f && std::abs(dz) < 25.0f) {
+            mapMins.push_back(mins[i]);
+            mapMaxs.push_back(maxs[i]);
+        }
+        if (dx * dx + dz * dz <= 64.0f * 64.0f) {
+            radiusMins.push_back(mins[i]);
+            radiusMaxs.push_back(maxs[i]);
+        }
+    }
+    
+    std::vector<uint8_t> visible(mins.size());
+    auto timeBatch = [&](const std::vector<Vec3>& batchMins, const std::vector<Vec3>& batchMaxs) {
+        Clock::time_point batchStart = Clock::now();
+        for (int frame = 0; frame < FRAMES; frame++) {
+            culler.isVisibleBatch(batchMins.data(), batchMaxs.data(), batchMins.size(), visible.data());
+        }
+        return std::chrono::duration<double, std::milli>(Clock::now() - batchStart).count() / FRAMES;
+    };
+    double mapMs = timeBatch(mapMins, mapMaxs);
+    double radiusMs = timeBatch(radiusMins, radiusMaxs);
+    double worldMs = timeBatch(mins, maxs);
+    
+    // Every cell's ground cube and flower, with and without culling
+    RenderScene all, culled;
+    all.setCamera(view, projection);
+    culled.setCamera(view, projection);
+    size_t kept = 0;
+    for (int z = 0; z < WORLD_SIDE; z++) {
+        for (int x = 0; x < WORLD_SIDE; x++) {
+            World::CellType cell = world.getCellType(x, z);
+            bool flower = cell == World::CellType::FLOWER;
+            Vec3 top(x + 0.5f, world.getTerrainHeight(x, z), z + 0.5f);
+            Color flowerColor = World::getFlowerSpeciesColor(World::getFlowerSpecies(x, z));
+            
+            all.addCube(top, World::getCellTypeColor(cell), 1.0f);
+            if (flower) all.addFlower(top + Vec3(0.0f, 0.5f, 0.0f), flowerColor, 0.3f);
+            
+            if (!visible[static_cast<size_t>(z) * WORLD_SIDE + x]) continue;
+            kept++;
+            culled.addCube(top, World::getCellTypeColor(cell), 1.0f);
+            if (flower) culled.addFlower(top + Vec3(0.0f, 0.5f, 0.0f), flowerColor, 0.3f);
+        }
+    }
+    
+    SoftwareRasterizer reference, check;
+    reference.render(all);
+    check.render(culled);
+    size_t mismatches = 0;
+    for (size_t i = 0; i < reference.getColorBuffer().size(); i++) {
+        if (reference.getColorBuffer()[i] != check.getColorBuffer()[i]) mismatches++;
+    }
+    
+    // Culling is conservative, so not a single pixel may change
+    bool passed = mismatches == 0;
+    std::cout << "Occlusion culling: " << WORLD_SIDE << "x" << WORLD_SIDE << " cells, eye in a valley at ("
+              << eyeX << ", " << eyeZ << "), " << culler.settings.width << "x" << culler.settings.height
+              << " depth buffer, " << JobSystem::instance().getWorkerCount() + 1 << " threads" << std::endl;
+    std::cout << "  occluder update    " << updateMs << " ms (" << culler.getOccluderTriangleCount()
+              << " triangles)" << std::endl;
+    auto report = [](const char* label, size_t boxes, double ms) {
+        std::cout << "  " << label << boxes << " boxes  " << ms << " ms/frame"
+                  << (ms <= BOX_TEST_BUDGET_MS ? "" : "  over") << " (budget " << BOX_TEST_BUDGET_MS << " ms)" << std::endl;
+    };
+    report("50x50 map          ", mapMins.size(), mapMs);
+    report("64-cell radius     ", radiusMins.size(), radiusMs);
+    report("whole world        ", mins.size(), worldMs);
+    std::cout << "  cells submitted    " << kept << " of " << mins.size() << " ("
+              << 100.0 * (mins.size() - kept) / mins.size() << "% culled)" << std::endl;
+    std::cout << "  instances          " << culled.getInstances().size() << " of " << all.getInstances().size() << std::endl;
+    std::cout << "  changed pixels     " << mismatches << (passed ? "" : "  FAILED") << std::endl;
+    return passed;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "simd_math.h"
+#include "world.h"
+#include <cstdint>
+#include <vector>
+
+// OcclusionCuller decides which objects are hidden behind terrain before
+// they are submitted for drawing. Each frame it rasterizes the terrain into
+// a small CPU depth buffer and reduces that into a hierarchical-Z (HiZ)
+// pyramid whose texels hold the farthest depth below them; a bounding box
+// is hidden when its nearest point is behind every texel it covers. The
+// coarsest level where the box spans at most 2x2 texels rejects most hidden
+// boxes in a handful of reads; the rest are retried at finer levels while
+// they cover few enough texels.
+//
+// Occluders are built per terrain chunk. Every blockSize x blockSize cells
+// become one box, drawn as its top and the sides that stand above a lower
+// neighbour. Each cell is drawn as a cube one unit deep below its top, so
+// the box spans only the heights every cube of the block fills: from the
+// highest top less one up to the lowest top. Blocks whose tops differ by
+// more than a unit get no box. Boxes therefore lie inside the drawn
+// terrain and hide only what it really hides, including through the gaps
+// under steep cells. The boxes of a chunk are kept until one of its
+// heights changes.
+//
+// Rasterization is conservative too: a depth buffer texel takes an
+// occluder's depth only when the occluder covers it completely, and then
+// the farthest depth the occluder reaches inside it.
+//
+// Occluder setup runs one job per chunk and rasterization one job per band
+// of rows. isVisible() only reads and can be called from several threads;
+// isVisibleBatch() splits a list of boxes across the job system.
+class OcclusionCuller : public WorldListener {
+public:
+    struct Settings {
+        int width;        // Depth buffer resolution
+        int height;
+        int blockSize;    // Terrain cells per occluder box side; divides World::CHUNK_SIZE
+        
+        Settings()
+            : width(256)
+            , height(192)
+            , blockSize(4)
+        {}
+    };
+    
+    explicit OcclusionCuller(const Settings& settings = Settings());
+    ~OcclusionCuller();
+    
+    OcclusionCuller(const OcclusionCuller&) = delete;
+    OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+    
+    // Start using the world's terrain as the occluder
+    void attach(World& world);
+    void detach();
+    
+    // Rasterize the occluders seen by this camera and rebuild the pyramid
+    void update(const Mat4& viewProjection);
+    
+    // False when the box is certainly hidden by terrain or outside the view.
+    // Everything is visible until the first update().
+    bool isVisible(const Vec3& min, const Vec3& max) const;
+    
+    // Tests count boxes on the job system; visible[i] is 1 when box i is visible
+    void isVisibleBatch(const Vec3* mins, const Vec3* maxs, size_t count, uint8_t* visible) const;
+    
+    // Occluder triangles rasterized by the last update()
+    size_t getOccluderTriangleCount() const;
+    
+    // WorldListener
+    void onTerrainHeightChanged(int x, int z, float height) override;
+    void onTerrainReset() override;
+    void onTerrainRegionChanged(int minX, int minZ, int maxX, int maxZ) override;
+    
+    // Culls the cells of a hilly world seen from a valley, checks with the
+    // software rasterizer that dropping the hidden ones leaves the image
+    // unchanged, and prints the cull rate and per-frame timings at the
+    // engine's box counts against BOX_TEST_BUDGET_MS
+    static bool runBenchmark();
+    static constexpr double BOX_TEST_BUDGET_MS = 1.0;
+
+private:
+    // Screen-space occluder triangle; edge i is inside where
+    // a[i] * x + b[i] * y + c[i] >= 0
+    struct Triangle {
+        float a[3];
+        float b[3];
+        float c[3];
+        float depthX;     // Farthest depth within a pixel centred on (x, y) is
+        float depthY;     // depthX * x + depthY * y + depthC
+        float depthC;
+        int minX, minY, maxX, maxY;
+    };
+    
+    struct ChunkOccluder {
+        std::vector<float> blockTops;      // Lowest cell top per block, row-major
+        std::vector<float> blockBottoms;   // Highest cell top less one; above blockTops for no box
+        float maxHeight;
+        bool dirty;
+    };
+    
+    void rebuildChunk(int chunk);
+    void addQuad(const Vec3& p0, const Vec3& p1, const Vec3& p2, const Vec3& p3, std::vector<Triangle>& out) const;
+    void addTriangle(const Vec4& v0, const Vec4& v1, const Vec4& v2, std::vector<Triangle>& out) const;
+    void rasterizeRows(int firstRow, int lastRow);
+    void buildPyramid();
+    
+    // Whether no texel of the level under pixels [x0, x1] x [y0, y1] lies beyond 'nearest'
+    bool isHiddenAt(size_t level, int x0, int y0, int x1, int y1, float nearest) const;
+    
+    // Top of the block's box, or lowest float when it has none
+    float blockTop(int blockX, int blockZ) const;
+    
+    Settings settings;
+    World* world;
+    int worldWidth;
+    int worldHeight;
+    int chunksX;
+    int chunksZ;
+    int blocksPerChunk;
+    std::vector<ChunkOccluder> chunks;
+    
+    Mat4 viewProjection;
+    std::vector<std::vector<Triangle>> chunkTriangles;   // Per chunk, rebuilt every update
+    std::vector<std::vector<float>> pyramid;             // Level 0 is the depth buffer
+    std::vector<int> levelWidths;
+    std::vector<int> levelHeights;
+    bool ready;
+};
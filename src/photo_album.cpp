@@ -0,0 +1,532 @@
+#include "photo_album.h"
+#include "software_rasterizer.h"
+#include "world.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+const uint8_t QOI_OP_INDEX = 0x00;
+const uint8_t QOI_OP_DIFF = 0x40;
+const uint8_t QOI_OP_LUMA = 0x80;
+const uint8_t QOI_OP_RUN = 0xc0;
+const uint8_t QOI_OP_RGB = 0xfe;
+const uint8_t QOI_OP_RGBA = 0xff;
+const uint8_t QOI_MASK = 0xc0;
+const size_t QOI_HEADER_SIZE = 14;
+const uint8_t QOI_END_MARKER[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+// Frame-sized buffers kept for reuse; a new one costs its page faults on the
+// frame thread during the copy
+const size_t SPARE_BUFFERS = 3;
+
+int qoiHash(const uint8_t* pixel) {
+    return (pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + pixel[3] * 11) % 64;
+}
+
+void writeBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back(static_cast<uint8_t>(value >> 24));
+    out.push_back(static_cast<uint8_t>(value >> 16));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+uint32_t readBigEndian(const uint8_t* bytes) {
+    return (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) | (uint32_t(bytes[2]) << 8) | bytes[3];
+}
+
+void flipRows(std::vector<uint8_t>& pixels, int width, int height) {
+    size_t rowSize = static_cast<size_t>(width) * 4;
+    std::vector<uint8_t> row(rowSize);
+    for (int y = 0; y < height / 2; y++) {
+        uint8_t* top = &pixels[y * rowSize];
+        uint8_t* bottom = &pixels[(height - 1 - y) * rowSize];
+        std::memcpy(row.data(), top, rowSize);
+        std::memcpy(top, bottom, rowSize);
+        std::memcpy(bottom, row.data(), rowSize);
+    }
+}
+
+// Box filter: each thumbnail pixel averages the source pixels it covers
+void downsample(const std::vector<uint8_t>& pixels, int width, int height,
+                int thumbWidth, int thumbHeight, std::vector<uint8_t>& out) {
+    out.resize(static_cast<size_t>(thumbWidth) * thumbHeight * 4);
+    for (int ty = 0; ty < thumbHeight; ty++) {
+        int y0 = ty * height / thumbHeight;
+        int y1 = std::max(y0 + 1, (ty + 1) * height / thumbHeight);
+        for (int tx = 0; tx < thumbWidth; tx++) {
+            int x0 = tx * width / thumbWidth;
+            int x1 = std::max(x0 + 1, (tx + 1) * width / thumbWidth);
+            uint32_t sum[4] = {0, 0, 0, 0};
+            for (int y = y0; y < y1; y++) {
+                const uint8_t* source = &pixels[(static_cast<size_t>(y) * width + x0) * 4];
+                for (int x = x0; x < x1; x++, source += 4) {
+                    sum[0] += source[0];
+                    sum[1] += source[1];
+                    sum[2] += source[2];
+                    sum[3] += source[3];
+                }
+            }
+            uint32_t count = static_cast<uint32_t>((x1 - x0) * (y1 - y0));
+            uint8_t* target = &out[(static_cast<size_t>(ty) * thumbWidth + tx) * 4];
+            for (int c = 0; c < 4; c++) {
+                target[c] = static_cast<uint8_t>((sum[c] + count / 2) / count);
+            }
+        }
+    }
+}
+
+std::string photoName(int id) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "photo-%06d", id);
+    return name;
+}
+
+}  // namespace
+
+PhotoAlbum::PhotoAlbum(const Settings& settings)
+    : settings(settings)
+    , nextId(1)
+    , encoding(false)
+    , stopping(false)
+    , running(false)
+{
+}
+
+PhotoAlbum::~PhotoAlbum() {
+    close();
+}
+
+std::string PhotoAlbum::path(const std::string& name) const {
+    return settings.directory + "/" + name;
+}
+
+std::string PhotoAlbum::getImagePath(int id) const {
+    return path(photoName(id) + ".qoi");
+}
+
+std::string PhotoAlbum::getThumbnailPath(int id) const {
+    return path(photoName(id) + "-thumb.qoi");
+}
+
+bool PhotoAlbum::open() {
+    close();
+    
+    std::error_code error;
+    std::filesystem::create_directories(settings.directory, error);
+    if (error) {
+        std::cerr << "Failed to create photo directory " << settings.directory << ": " << error.message() << std::endl;
+        return false;
+    }
+    
+    photos.clear();
+    nextId = 1;
+    std::ifstream index(path("index.txt"));
+    std::string line;
+    while (std::getline(index, line)) {
+        std::istringstream fields(line);
+        Photo photo;
+        if (fields >> photo.id >> photo.width >> photo.height >> photo.score) {
+            photos.push_back(photo);
+            nextId = std::max(nextId, photo.id + 1);
+        }
+    }
+    
+    stopping = false;
+    running = true;
+    encoder = std::thread(&PhotoAlbum::encoderLoop, this);
+    return true;
+}
+
+void PhotoAlbum::close() {
+    if (!running) return;
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    encoder.join();
+    running = false;
+}
+
+std::vector<uint8_t> PhotoAlbum::takeBuffer(size_t size) {
+    std::vector<uint8_t> buffer;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!spareBuffers.empty()) {
+            buffer.swap(spareBuffers.back());
+            spareBuffers.pop_back();
+        }
+    }
+    buffer.resize(size);
+    return buffer;
+}
+
+bool PhotoAlbum::add(std::vector<uint8_t>&& pixels, int width, int height, bool bottomUp, float score) {
+    if (width <= 0 || height <= 0 || pixels.size() < static_cast<size_t>(width) * height * 4) return false;
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running || stopping || queue.size() >= settings.maxQueued) return false;
+        
+        Job job;
+        job.id = nextId++;
+        job.width = width;
+        job.height = height;
+        job.bottomUp = bottomUp;
+        job.score = score;
+        job.pixels.swap(pixels);
+        queue.push_back(std::move(job));
+    }
+    wake.notify_one();
+    return true;
+}
+
+void PhotoAlbum::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return !running || (queue.empty() && !encoding); });
+}
+
+std::vector<PhotoAlbum::Photo> PhotoAlbum::getPhotos() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return photos;
+}
+
+void PhotoAlbum::encoderLoop() {
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty()) {
+                idle.notify_all();
+                return;
+            }
+            job = std::move(queue.front());
+            queue.pop_front();
+            encoding = true;
+        }
+        
+        write(job);
+        
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            encoding = false;
+            if (spareBuffers.size() < SPARE_BUFFERS) spareBuffers.push_back(std::move(job.pixels));
+        }
+        idle.notify_all();
+    }
+}
+
+void PhotoAlbum::write(Job& job) {
+    if (job.bottomUp) flipRows(job.pixels, job.width, job.height);
+    
+    std::vector<uint8_t> encoded;
+    encodeQoi(job.pixels.data(), job.width, job.height, encoded);
+    if (!writeFile(getImagePath(job.id), encoded)) return;
+    
+    int thumbWidth = std::min(settings.thumbnailWidth, job.width);
+    int thumbHeight = std::max(1, job.height * thumbWidth / job.width);
+    std::vector<uint8_t> thumbnail;
+    downsample(job.pixels, job.width, job.height, thumbWidth, thumbHeight, thumbnail);
+    encodeQoi(thumbnail.data(), thumbWidth, thumbHeight, encoded);
+    if (!writeFile(getThumbnailPath(job.id), encoded)) return;
+    
+    FILE* index = std::fopen(path("index.txt").c_str(), "a");
+    if (!index) {
+        std::cerr << "Failed to open photo index in " << settings.directory << std::endl;
+        return;
+    }
+    std::fprintf(index, "%d %d %d %.3f\n", job.id, job.width, job.height, job.score);
+    std::fclose(index);
+    
+    Photo photo;
+    photo.id = job.id;
+    photo.width = job.width;
+    photo.height = job.height;
+    photo.score = job.score;
+    std::lock_guard<std::mutex> lock(mutex);
+    photos.push_back(photo);
+}
+
+bool PhotoAlbum::writeFile(const std::string& filePath, const std::vector<uint8_t>& data) const {
+    std::string temporaryPath = filePath + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(data.data()), data.size());
+        if (!file) {
+            std::cerr << "Failed to write photo " << temporaryPath << std::endl;
+            return false;
+        }
+    }
+    
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, filePath, error);
+    if (error) {
+        std::cerr << "Failed to install photo " << filePath << ": " << error.message() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void PhotoAlbum::encodeQoi(const uint8_t* pixels, int width, int height, std::vector<uint8_t>& out) {
+    size_t count = static_cast<size_t>(width) * height;
+    out.clear();
+    out.reserve(QOI_HEADER_SIZE + count * 5 + sizeof(QOI_END_MARKER));
+    out.insert(out.end(), {'q', 'o', 'i', 'f'});
+    writeBigEndian(out, static_cast<uint32_t>(width));
+    writeBigEndian(out, static_cast<uint32_t>(height));
+    out.push_back(4);   // RGBA
+    out.push_back(0);   // sRGB with linear alpha
+    
+    uint8_t index[64][4];
+    std::memset(index, 0, sizeof(index));
+    uint8_t previous[4] = {0, 0, 0, 255};
+    int run = 0;
+    
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* pixel = pixels + i * 4;
+        if (std::memcmp(pixel, previous, 4) == 0) {
+            run++;
+            if (run == 62 || i == count - 1) {
+                out.push_back(QOI_OP_RUN | static_cast<uint8_t>(run - 1));
+                run = 0;
+            }
+            continue;
+        }
+        
+        if (run > 0) {
+            out.push_back(QOI_OP_RUN | static_cast<uint8_t>(run - 1));
+            run = 0;
+        }
+        
+        int hash = qoiHash(pixel);
+        if (std::memcmp(index[hash], pixel, 4) == 0) {
+            out.push_back(QOI_OP_INDEX | static_cast<uint8_t>(hash));
+        } else {
+            std::memcpy(index[hash], pixel, 4);
+            if (pixel[3] == previous[3]) {
+                int dr = static_cast<int8_t>(pixel[0] - previous[0]);
+                int dg = static_cast<int8_t>(pixel[1] - previous[1]);
+                int db = static_cast<int8_t>(pixel[2] - previous[2]);
+                int drg = dr - dg;
+                int dbg = db - dg;
+                if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                    out.push_back(QOI_OP_DIFF | static_cast<uint8_t>((dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+                } else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7) {
+                    out.push_back(QOI_OP_LUMA | static_cast<uint8_t>(dg + 32));
+                    out.push_back(static_cast<uint8_t>((drg + 8) << 4 | (dbg + 8)));
+                } else {
+                    out.insert(out.end(), {QOI_OP_RGB, pixel[0], pixel[1], pixel[2]});
+                }
+            } else {
+                out.insert(out.end(), {QOI_OP_RGBA, pixel[0], pixel[1], pixel[2], pixel[3]});
+            }
+        }
+        std::memcpy(previous, pixel, 4);
+    }
+    
+    out.insert(out.end(), QOI_END_MARKER, QOI_END_MARKER + sizeof(QOI_END_MARKER));
+}
+
+bool PhotoAlbum::decodeQoi(const std::vector<uint8_t>& data, Image& out) {
+    if (data.size() < QOI_HEADER_SIZE + sizeof(QOI_END_MARKER) || std::memcmp(data.data(), "qoif", 4) != 0) {
+        return false;
+    }
+    uint32_t width = readBigEndian(&data[4]);
+    uint32_t height = readBigEndian(&data[8]);
+    if (width == 0 || height == 0 || data[12] != 4 || width > 16384 || height > 16384) return false;
+    
+    size_t count = static_cast<size_t>(width) * height;
+    out.width = static_cast<int>(width);
+    out.height = static_cast<int>(height);
+    out.pixels.resize(count * 4);
+    
+    uint8_t index[64][4];
+    std::memset(index, 0, sizeof(index));
+    uint8_t pixel[4] = {0, 0, 0, 255};
+    size_t position = QOI_HEADER_SIZE;
+    size_t end = data.size() - sizeof(QOI_END_MARKER);
+    int run = 0;
+    
+    for (size_t i = 0; i < count; i++) {
+        if (run > 0) {
+            run--;
+        } else {
+            // Every op reads at most 5 bytes, which the end marker covers
+            if (position >= end) return false;
+            uint8_t op = data[position++];
+            if (op == QOI_OP_RGB) {
+                std::memcpy(pixel, &data[position], 3);
+                position += 3;
+            } else if (op == QOI_OP_RGBA) {
+                std::memcpy(pixel, &data[position], 4);
+                position += 4;
+            } else if ((op & QOI_MASK) == QOI_OP_INDEX) {
+                std::memcpy(pixel, index[op], 4);
+            } else if ((op & QOI_MASK) == QOI_OP_DIFF) {
+                pixel[0] += ((op >> 4) & 3) - 2;
+                pixel[1] += ((op >> 2) & 3) - 2;
+                pixel[2] += (op & 3) - 2;
+            } else if ((op & QOI_MASK) == QOI_OP_LUMA) {
+                uint8_t second = data[position++];
+                int dg = (op & 0x3f) - 32;
+                pixel[0] += dg - 8 + ((second >> 4) & 0x0f);
+                pixel[1] += dg;
+                pixel[2] += dg - 8 + (second & 0x0f);
+            } else {
+                run = op & 0x3f;
+            }
+            std::memcpy(index[qoiHash(pixel)], pixel, 4);
+        }
+        std::memcpy(&out.pixels[i * 4], pixel, 4);
+    }
+    return true;
+}
+
+bool PhotoAlbum::loadImage(const std::string& filePath, Image& out) {
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file) return false;
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return decodeQoi(data, out);
+}
+
+bool PhotoAlbum::runBenchmark() {
+    const int WORLD_SIDE = 64;
+    const int BURST = 30;
+    const int SYNC_SAMPLES = 3;
+    const double FRAME_MS = 1000.0 / 60.0;
+    
+    // A software-rendered flower field stands in for the GL back buffer
+    World world(WORLD_SIDE, WORLD_SIDE);
+    world.generateHillyTerrain(4.0f, 0.08f);
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    RenderScene scene;
+    Vec3 eye(WORLD_SIDE * 0.5f, 10.0f, -4.0f);
+    scene.setCamera(Mat4::lookAt(eye, Vec3(WORLD_SIDE * 0.5f, 0.0f, WORLD_SIDE * 0.4f), Vec3::up()),
+                    Mat4::perspective(60.0f, 800.0f / 600.0f, 0.1f, 100.0f));
+    for (int z = 0; z < WORLD_SIDE; z++) {
+        for (int x = 0; x < WORLD_SIDE; x++) {
+            Vec3 cellPos(x + 0.5f, world.getTerrainHeight(x, z), z + 0.5f);
+            bool flower = unit(rng) < 0.3f;
+            scene.addCube(cellPos, World::getCellTypeColor(flower ? World::CellType::FLOWER : World::CellType::GRASS), 1.0f);
+            if (flower) {
+                scene.addFlower(cellPos + Vec3(0.0f, 0.5f, 0.0f),
+                                World::getFlowerSpeciesColor(World::getFlowerSpecies(x, z)), 0.3f);
+            }
+        }
+    }
+    SoftwareRasterizer rasterizer;
+    rasterizer.render(scene);
+    int width = rasterizer.getWidth();
+    int height = rasterizer.getHeight();
+    const std::vector<uint32_t>& colors = rasterizer.getColorBuffer();
+    std::vector<uint8_t> frame(colors.size() * 4);
+    for (size_t i = 0; i < colors.size(); i++) {
+        for (int c = 0; c < 4; c++) {
+            frame[i * 4 + c] = static_cast<uint8_t>(colors[i] >> (c * 8));
+        }
+    }
+    
+    Settings settings;
+    settings.directory = (std::filesystem::temp_directory_path() / "flower-photo-bench").string();
+    std::error_code error;
+    std::filesystem::remove_all(settings.directory, error);
+    
+    typedef std::chrono::steady_clock Clock;
+    typedef std::chrono::duration<double, std::milli> Milliseconds;
+    
+    // Encoding and writing in place, as a synchronous capture would
+    PhotoAlbum album(settings);
+    if (!album.open()) return false;
+    double syncMs = 0.0;
+    for (int i = 0; i < SYNC_SAMPLES; i++) {
+        Job job;
+        job.id = 0;
+        job.width = width;
+        job.height = height;
+        job.bottomUp = true;
+        job.score = 0.0f;
+        job.pixels = frame;
+        Clock::time_point start = Clock::now();
+        album.write(job);
+        syncMs += Milliseconds(Clock::now() - start).count() / SYNC_SAMPLES;
+    }
+    album.close();
+    std::filesystem::remove_all(settings.directory, error);
+    
+    // A burst through the queue, one photo per frame as when the key is held
+    // down; each photo marks its first pixel so files can be matched to ids
+    if (!album.open()) return false;
+    double addTotalMs = 0.0;
+    double addMaxMs = 0.0;
+    int refused = 0;
+    Clock::time_point burstStart = Clock::now();
+    for (int i = 0; i < BURST; i++) {
+        frame[0] = static_cast<uint8_t>(i);
+        Clock::time_point start = Clock::now();
+        std::vector<uint8_t> pixels = album.takeBuffer(frame.size());
+        std::memcpy(pixels.data(), frame.data(), frame.size());
+        if (!album.add(std::move(pixels), width, height, true, static_cast<float>(i))) refused++;
+        double ms = Milliseconds(Clock::now() - start).count();
+        addTotalMs += ms;
+        addMaxMs = std::max(addMaxMs, ms);
+        std::this_thread::sleep_until(burstStart + std::chrono::duration_cast<Clock::duration>(Milliseconds(FRAME_MS * (i + 1))));
+    }
+    album.flush();
+    double burstMs = Milliseconds(Clock::now() - burstStart).count();
+    album.close();
+    
+    // Everything must come back from disk through the index
+    bool passed = refused == 0;
+    if (!album.open()) return false;
+    std::vector<Photo> photos = album.getPhotos();
+    album.close();
+    if (photos.size() != BURST) passed = false;
+    
+    size_t rowSize = static_cast<size_t>(width) * 4;
+    size_t mismatches = 0;
+    uintmax_t imageBytes = 0;
+    for (const Photo& photo : photos) {
+        Image image;
+        if (!loadImage(album.getImagePath(photo.id), image) || image.width != width || image.height != height) {
+            passed = false;
+            continue;
+        }
+        imageBytes += std::filesystem::file_size(album.getImagePath(photo.id), error);
+        frame[0] = static_cast<uint8_t>(photo.id - 1);
+        for (int y = 0; y < height; y++) {
+            if (std::memcmp(&image.pixels[y * rowSize], &frame[(height - 1 - y) * rowSize], rowSize) != 0) {
+                mismatches++;
+            }
+        }
+        
+        Image thumbnail;
+        if (!loadImage(album.getThumbnailPath(photo.id), thumbnail) ||
+            thumbnail.width != settings.thumbnailWidth || thumbnail.height != height * settings.thumbnailWidth / width) {
+            passed = false;
+        }
+    }
+    if (mismatches > 0) passed = false;
+    std::filesystem::remove_all(settings.directory, error);
+    
+    std::cout << "Photo album: " << BURST << " photos of " << width << "x" << height << ", QOI "
+              << (photos.empty() ? 0 : imageBytes / photos.size() / 1024) << " KiB each ("
+              << frame.size() / 1024 << " KiB raw)" << std::endl;
+    std::cout << "  encode in place       " << syncMs << " ms/photo" << std::endl;
+    std::cout << "  queue on frame thread " << addTotalMs / BURST << " ms/photo, " << addMaxMs << " ms worst" << std::endl;
+    std::cout << "  burst written in      " << burstMs << " ms (" << BURST * FRAME_MS << " ms of frames)" << std::endl;
+    std::cout << "  refused " << refused << ", indexed " << photos.size() << ", mismatched rows " << mismatches
+              << (passed ? "" : "  FAILED") << std::endl;
+    return passed;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// PhotoAlbum keeps the player's photographs on disk. add() only queues the
+// pixels; a background thread turns them upright, encodes the image and a
+// thumbnail as QOI (the "Quite OK Image" format: lossless, single pass and
+// several times faster to encode than PNG) and appends a line to the index,
+// so taking a photo never stalls a frame.
+//
+// Directory layout:
+//   index.txt                 one line per photo: id width height score
+//   photo-000001.qoi          the image
+//   photo-000001-thumb.qoi    its thumbnail
+//
+// Each image is written under a temporary name and renamed into place
+// before its index line is appended, so the index never lists a partial
+// file.
+class PhotoAlbum {
+public:
+    struct Settings {
+        std::string directory;
+        int thumbnailWidth;   // Thumbnail height follows the aspect ratio
+        size_t maxQueued;     // Photos waiting for the encoder; add() refuses more
+        
+        Settings()
+            : directory("photos")
+            , thumbnailWidth(160)
+            , maxQueued(16)
+        {}
+    };
+    
+    struct Photo {
+        int id;
+        int width;
+        int height;
+        float score;
+    };
+    
+    // RGBA8 pixels, top row first
+    struct Image {
+        int width;
+        int height;
+        std::vector<uint8_t> pixels;
+    };
+    
+    explicit PhotoAlbum(const Settings& settings = Settings());
+    ~PhotoAlbum();
+    
+    PhotoAlbum(const PhotoAlbum&) = delete;
+    PhotoAlbum& operator=(const PhotoAlbum&) = delete;
+    
+    // Read the index and start the encoder
+    bool open();
+    
+    // Write everything queued, then stop the encoder
+    void close();
+    bool isOpen() const { return running; }
+    
+    // A buffer of at least 'size' bytes for the next add(), reusing the
+    // memory of photos already written
+    std::vector<uint8_t> takeBuffer(size_t size);
+    
+    // Queue RGBA8 pixels for encoding; bottomUp when the first row is the
+    // bottom one, as glReadPixels returns them. Returns false when the album
+    // is closed or the queue is full.
+    bool add(std::vector<uint8_t>&& pixels, int width, int height, bool bottomUp, float score);
+    
+    // Wait until every queued photo is on disk
+    void flush();
+    
+    std::vector<Photo> getPhotos() const;
+    std::string getImagePath(int id) const;
+    std::string getThumbnailPath(int id) const;
+    
+    static void encodeQoi(const uint8_t* pixels, int width, int height, std::vector<uint8_t>& out);
+    static bool decodeQoi(const std::vector<uint8_t>& data, Image& out);
+    static bool loadImage(const std::string& path, Image& out);
+    
+    // Takes a burst of photos of a software-rendered frame, compares the
+    // frame-thread cost of add() with encoding in place, and checks every
+    // file and the reopened index
+    static bool runBenchmark();
+
+private:
+    struct Job {
+        int id;
+        int width;
+        int height;
+        bool bottomUp;
+        float score;
+        std::vector<uint8_t> pixels;
+    };
+    
+    void encoderLoop();
+    void write(Job& job);
+    bool writeFile(const std::string& path, const std::vector<uint8_t>& data) const;
+    std::string path(const std::string& name) const;
+    
+    Settings settings;
+    std::vector<Photo> photos;
+    int nextId;
+    
+    std::thread encoder;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    std::deque<Job> queue;
+    std::vector<std::vector<uint8_t>> spareBuffers;
+    bool encoding;
+    bool stopping;
+    bool running;
+};
@@ -0,0 +1,225 @@
+#include "photo_capture.h"
+#include "logger.h"
+#include "photo_album.h"
+#include <SDL3/SDL.h>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+// OpenGL includes
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#else
+#include <GL/gl.h>
+#endif
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+// Buffer object and sync tokens, missing from OpenGL 1.1 headers
+#ifndef GL_PIXEL_PACK_BUFFER
+#define GL_PIXEL_PACK_BUFFER 0x88EB
+#endif
+#ifndef GL_STREAM_READ
+#define GL_STREAM_READ 0x88E1
+#endif
+#ifndef GL_READ_ONLY
+#define GL_READ_ONLY 0x88B8
+#endif
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#endif
+#ifndef GL_ALREADY_SIGNALED
+#define GL_ALREADY_SIGNALED 0x911A
+#endif
+#ifndef GL_CONDITION_SATISFIED
+#define GL_CONDITION_SATISFIED 0x911C
+#endif
+#ifndef GL_WAIT_FAILED
+#define GL_WAIT_FAILED 0x911D
+#endif
+
+namespace {
+
+typedef void (APIENTRY* GenBuffersProc)(GLsizei count, GLuint* buffers);
+typedef void (APIENTRY* DeleteBuffersProc)(GLsizei count, const GLuint* buffers);
+typedef void (APIENTRY* BindBufferProc)(GLenum target, GLuint buffer);
+typedef void (APIENTRY* BufferDataProc)(GLenum target, std::ptrdiff_t size, const void* data, GLenum usage);
+typedef void* (APIENTRY* MapBufferProc)(GLenum target, GLenum access);
+typedef GLboolean (APIENTRY* UnmapBufferProc)(GLenum target);
+typedef void* (APIENTRY* FenceSyncProc)(GLenum condition, GLbitfield flags);
+typedef GLenum (APIENTRY* ClientWaitSyncProc)(void* sync, GLbitfield flags, uint64_t timeout);
+typedef void (APIENTRY* DeleteSyncProc)(void* sync);
+
+GenBuffersProc genBuffers = nullptr;
+DeleteBuffersProc deleteBuffers = nullptr;
+BindBufferProc bindBuffer = nullptr;
+BufferDataProc bufferData = nullptr;
+MapBufferProc mapBuffer = nullptr;
+UnmapBufferProc unmapBuffer = nullptr;
+FenceSyncProc fenceSync = nullptr;
+ClientWaitSyncProc clientWaitSync = nullptr;
+DeleteSyncProc deleteSync = nullptr;
+
+template <typename Proc>
+bool loadProc(Proc& proc, const char* name) {
+    proc = reinterpret_cast<Proc>(SDL_GL_GetProcAddress(name));
+    return proc != nullptr;
+}
+
+// GetProcAddress may hand out entry points the context doesn't support,
+// so check the version or extension first
+bool hasVersion(int major, int minor) {
+    const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+    int contextMajor = 0;
+    int contextMinor = 0;
+    if (!version || std::sscanf(version, "%d.%d", &contextMajor, &contextMinor) != 2) return false;
+    return contextMajor > major || (contextMajor == major && contextMinor >= minor);
+}
+
+}  // namespace
+
+PhotoCapture::PhotoCapture(const Settings& settings)
+    : settings(settings)
+    , album(nullptr)
+    , oldestSlot(0)
+    , busySlots(0)
+    , hasBuffers(false)
+    , hasFences(false)
+{
+}
+
+PhotoCapture::~PhotoCapture() {
+    shutdown();
+}
+
+bool PhotoCapture::initialize(PhotoAlbum& target) {
+    shutdown();
+    album = &target;
+    
+    hasBuffers = (hasVersion(2, 1) || SDL_GL_ExtensionSupported("GL_ARB_pixel_buffer_object")) &&
+                 loadProc(genBuffers, "glGenBuffers") && loadProc(deleteBuffers, "glDeleteBuffers") &&
+                 loadProc(bindBuffer, "glBindBuffer") && loadProc(bufferData, "glBufferData") &&
+                 loadProc(mapBuffer, "glMapBuffer") && loadProc(unmapBuffer, "glUnmapBuffer");
+    hasFences = hasBuffers && (hasVersion(3, 2) || SDL_GL_ExtensionSupported("GL_ARB_sync")) &&
+                loadProc(fenceSync, "glFenceSync") && loadProc(clientWaitSync, "glClientWaitSync") &&
+                loadProc(deleteSync, "glDeleteSync");
+    
+    if (hasBuffers) {
+        slots.resize(settings.slotCount);
+        for (Slot& slot : slots) {
+            genBuffers(1, &slot.buffer);
+            slot.capacity = 0;
+            slot.fence = nullptr;
+        }
+    } else {
+        std::cerr << "Pixel buffer objects unavailable, photos are read back synchronously" << std::endl;
+    }
+    return hasBuffers;
+}
+
+void PhotoCapture::shutdown() {
+    if (!album) return;
+    
+    // Mapping waits for the copy, so nothing taken is lost
+    while (busySlots > 0) {
+        finishReadback(slots[oldestSlot]);
+        oldestSlot = (oldestSlot + 1) % slots.size();
+        busySlots--;
+    }
+    for (Slot& slot : slots) {
+        deleteBuffers(1, &slot.buffer);
+    }
+    slots.clear();
+    requests.clear();
+    oldestSlot = 0;
+    album = nullptr;
+}
+
+void PhotoCapture::requestCapture(float score) {
+    requests.push_back(score);
+}
+
+void PhotoCapture::endFrame(int width, int height) {
+    if (!album) return;
+    
+    // Finished copies go to the album oldest first, so photos keep their order
+    for (size_t i = 0; i < busySlots; i++) {
+        slots[(oldestSlot + i) % slots.size()].frames++;
+    }
+    while (busySlots > 0 && isReadbackDone(slots[oldestSlot])) {
+        finishReadback(slots[oldestSlot]);
+        oldestSlot = (oldestSlot + 1) % slots.size();
+        busySlots--;
+    }
+    
+    while (!requests.empty() && width > 0 && height > 0) {
+        if (!hasBuffers) {
+            readSynchronously(width, height, requests.front());
+        } else if (busySlots < slots.size()) {
+            startReadback(slots[(oldestSlot + busySlots) % slots.size()], width, height, requests.front());
+            busySlots++;
+        } else {
+            break;
+        }
+        requests.pop_front();
+    }
+}
+
+void PhotoCapture::startReadback(Slot& slot, int width, int height, float score) {
+    size_t size = static_cast<size_t>(width) * height * 4;
+    bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    if (slot.capacity < size) {
+        bufferData(GL_PIXEL_PACK_BUFFER, static_cast<std::ptrdiff_t>(size), nullptr, GL_STREAM_READ);
+        slot.capacity = size;
+    }
+    // With a pack buffer bound the pointer is an offset into it, and the
+    // call returns without waiting for the copy
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    
+    slot.fence = hasFences ? fenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) : nullptr;
+    slot.width = width;
+    slot.height = height;
+    slot.frames = 0;
+    slot.score = score;
+}
+
+bool PhotoCapture::isReadbackDone(const Slot& slot) const {
+    if (!slot.fence) return slot.frames >= settings.fallbackDelay;
+    
+    GLenum status = clientWaitSync(slot.fence, 0, 0);
+    return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED || status == GL_WAIT_FAILED;
+}
+
+void PhotoCapture::finishReadback(Slot& slot) {
+    if (slot.fence) {
+        deleteSync(slot.fence);
+        slot.fence = nullptr;
+    }
+    
+    size_t size = static_cast<size_t>(slot.width) * slot.height * 4;
+    bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    const void* mapped = mapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+    if (mapped) {
+        std::vector<uint8_t> pixels = album->takeBuffer(size);
+        std::memcpy(pixels.data(), mapped, size);
+        if (!album->add(std::move(pixels), slot.width, slot.height, true, slot.score)) {
+            LOG_WARNING("Photo album is busy, photo dropped");
+        }
+        unmapBuffer(GL_PIXEL_PACK_BUFFER);
+    } else {
+        LOG_ERROR("Failed to map photo readback buffer");
+    }
+    bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void PhotoCapture::readSynchronously(int width, int height, float score) {
+    std::vector<uint8_t> pixels = album->takeBuffer(static_cast<size_t>(width) * height * 4);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    if (!album->add(std::move(pixels), width, height, true, score)) {
+        LOG_WARNING("Photo album is busy, photo dropped");
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+class PhotoAlbum;
+
+// PhotoCapture reads frames back from OpenGL for the PhotoAlbum without
+// stalling the frame. A plain glReadPixels waits for the GPU to finish
+// everything queued before it; instead each capture copies the back buffer
+// into a pixel buffer object (PBO), which returns immediately, and places a
+// fence behind the copy. Later frames poll the fence and only map the buffer
+// once the copy is done, usually a frame or two after the request.
+//
+// Fences need OpenGL 3.2 or ARB_sync. Without them a buffer is mapped a
+// fixed number of frames after its copy, which by then has almost always
+// completed. Without PBOs at all the copy falls back to a synchronous
+// glReadPixels; encoding still happens on the album's thread.
+class PhotoCapture {
+public:
+    struct Settings {
+        int slotCount;        // Readbacks in flight; more requests wait their turn
+        int fallbackDelay;    // Frames before mapping a buffer when fences are missing
+        
+        Settings()
+            : slotCount(3)
+            , fallbackDelay(2)
+        {}
+    };
+    
+    explicit PhotoCapture(const Settings& settings = Settings());
+    ~PhotoCapture();
+    
+    PhotoCapture(const PhotoCapture&) = delete;
+    PhotoCapture& operator=(const PhotoCapture&) = delete;
+    
+    // Load the buffer and sync entry points; the GL context must be current
+    bool initialize(PhotoAlbum& album);
+    
+    // Finish the readbacks in flight and release the buffers
+    void shutdown();
+    
+    // Photograph the frame being drawn
+    void requestCapture(float score);
+    
+    // After drawing a frame and before swapping: starts the readbacks
+    // requested for it and hands finished ones to the album
+    void endFrame(int width, int height);
+    
+    size_t getPendingCount() const { return requests.size() + busySlots; }
+
+private:
+    struct Slot {
+        unsigned int buffer;
+        size_t capacity;  // Bytes allocated for the buffer
+        void* fence;
+        int width;
+        int height;
+        int frames;       // Frames since the copy was issued
+        float score;
+    };
+    
+    void startReadback(Slot& slot, int width, int height, float score);
+    bool isReadbackDone(const Slot& slot) const;
+    void finishReadback(Slot& slot);
+    void readSynchronously(int width, int height, float score);
+    
+    Settings settings;
+    PhotoAlbum* album;
+    std::vector<Slot> slots;     // Ring; busy slots start at oldestSlot
+    std::deque<float> requests;
+    size_t oldestSlot;
+    size_t busySlots;
+    bool hasBuffers;
+    bool hasFences;
+};
@@ -0,0 +1,112 @@
+#include "photo_scorer.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Weights of the component scores in the total
+const float SUBJECT_WEIGHT = 0.35f;
+const float DIVERSITY_WEIGHT = 0.25f;
+const float COMPOSITION_WEIGHT = 0.2f;
+const float FRAMING_WEIGHT = 0.2f;
+
+// A photo of this many flowers, or this much of the frame in flowers,
+// earns the full subject score
+const float FULL_FLOWER_COUNT = 20.0f;
+const float FULL_COVERAGE = 0.3f;
+
+}  // namespace
+
+PhotoScorer::PhotoScorer(const Settings& settings)
+    : settings(settings)
+{
+}
+
+PhotoScorer::Score PhotoScorer::score(const World& world, const Camera& camera) {
+    Score result;
+    int raysX = std::max(settings.raysX, 2);
+    int raysY = std::max(settings.raysY, 2);
+    size_t rayCount = static_cast<size_t>(raysX) * raysY;
+    
+    // One ray through the centre of each grid cell of the image plane
+    float halfHeight = std::tan(camera.verticalFov * 0.5f * DEG_TO_RAD);
+    float halfWidth = halfHeight * camera.aspect;
+    origins.assign(rayCount, camera.position);
+    directions.resize(rayCount);
+    hits.resize(rayCount);
+    for (int row = 0; row < raysY; row++) {
+        float v = (1.0f - 2.0f * (row + 0.5f) / raysY) * halfHeight;
+        for (int column = 0; column < raysX; column++) {
+            float u = (2.0f * (column + 0.5f) / raysX - 1.0f) * halfWidth;
+            directions[row * raysX + column] = camera.forward + camera.right * u + camera.up * v;
+        }
+    }
+    
+    world.raycastBatch(origins.data(), directions.data(), rayCount, settings.maxDistance, hits.data());
+    
+    // Flower rays: where they land in the frame and which cells they see
+    int flowerRays = 0;
+    int edgeRays = 0;
+    float sumU = 0.0f;
+    float sumV = 0.0f;
+    flowerCells.clear();
+    for (int row = 0; row < raysY; row++) {
+        for (int column = 0; column < raysX; column++) {
+            const World::RaycastHit& hit = hits[row * raysX + column];
+            if (!hit.hit || hit.entity) continue;
+            if (world.getCellType(hit.cell.x, hit.cell.z) != World::CellType::FLOWER) continue;
+            
+            flowerRays++;
+            sumU += (column + 0.5f) / raysX;
+            sumV += (row + 0.5f) / raysY;
+            if (row == 0 || column == 0 || row == raysY - 1 || column == raysX - 1) {
+                edgeRays++;
+            }
+            flowerCells.push_back(hit.cell.z * world.getWidth() + hit.cell.x);
+        }
+    }
+    if (flowerRays == 0) return result;
+    
+    std::sort(flowerCells.begin(), flowerCells.end());
+    flowerCells.erase(std::unique(flowerCells.begin(), flowerCells.end()), flowerCells.end());
+    result.visibleFlowers = static_cast<int>(flowerCells.size());
+    result.coverage = static_cast<float>(flowerRays) / rayCount;
+    
+    int speciesCounts[World::FLOWER_SPECIES_COUNT] = {};
+    for (int cell : flowerCells) {
+        speciesCounts[World::getFlowerSpecies(cell % world.getWidth(), cell / world.getWidth())]++;
+    }
+    float entropy = 0.0f;
+    for (int count : speciesCounts) {
+        if (count == 0) continue;
+        result.species++;
+        float share = static_cast<float>(count) / result.visibleFlowers;
+        entropy -= share * std::log(share);
+    }
+    result.diversity = entropy / std::log(static_cast<float>(World::FLOWER_SPECIES_COUNT));
+    
+    // Rule of thirds: the centroid is best on one of the four intersections
+    // and worst in a corner of the frame
+    float centroidU = sumU / flowerRays;
+    float centroidV = sumV / flowerRays;
+    float nearest = 1.0f;
+    for (float thirdU : { 1.0f / 3.0f, 2.0f / 3.0f }) {
+        for (float thirdV : { 1.0f / 3.0f, 2.0f / 3.0f }) {
+            float du = centroidU - thirdU;
+            float dv = centroidV - thirdV;
+            nearest = std::min(nearest, std::sqrt(du * du + dv * dv));
+        }
+    }
+    const float worstDistance = std::sqrt(2.0f) / 3.0f;
+    result.composition = std::max(0.0f, 1.0f - nearest / worstDistance);
+    
+    result.framing = 1.0f - static_cast<float>(edgeRays) / flowerRays;
+    
+    float subject = 0.5f * std::min(1.0f, result.visibleFlowers / FULL_FLOWER_COUNT) +
+                    0.5f * std::min(1.0f, result.coverage / FULL_COVERAGE);
+    result.total = 100.0f * (SUBJECT_WEIGHT * subject +
+                             DIVERSITY_WEIGHT * result.diversity +
+                             COMPOSITION_WEIGHT * result.composition +
+                             FRAMING_WEIGHT * result.framing);
+    return result;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "math_utils.h"
+#include "world.h"
+#include <vector>
+
+// PhotoScorer rates how beautiful a photograph is. It casts a grid of rays
+// through the camera frustum (in parallel, see World::raycastBatch) and
+// looks at the flowers they land on: how many are in view, how many species
+// they cover, where they sit in the frame and whether the frame cuts them off.
+class PhotoScorer {
+public:
+    struct Settings {
+        int raysX;            // Ray grid resolution across the frame
+        int raysY;
+        float maxDistance;    // Anything further away is treated as sky
+        
+        Settings()
+            : raysX(64)
+            , raysY(48)
+            , maxDistance(60.0f)
+        {}
+    };
+    
+    struct Camera {
+        Vec3 position;
+        Vec3 forward;
+        Vec3 right;
+        Vec3 up;
+        float verticalFov;    // Degrees
+        float aspect;         // Width over height
+        
+        Camera()
+            : position(Vec3::zero())
+            , forward(Vec3::forward())
+            , right(Vec3::right())
+            , up(Vec3::up())
+            , verticalFov(60.0f)
+            , aspect(4.0f / 3.0f)
+        {}
+    };
+    
+    // Component scores are in [0, 1]; the overall score is in [0, 100]
+    struct Score {
+        int visibleFlowers;   // Distinct flower cells hit by at least one ray
+        int species;          // Distinct flower species among them
+        float coverage;       // Share of rays that landed on a flower
+        float diversity;      // Evenness of the species mix (normalized entropy)
+        float composition;    // Closeness of the flowers' centroid to a rule-of-thirds point
+        float framing;        // Share of flower rays away from the frame edge
+        float total;
+        
+        Score()
+            : visibleFlowers(0)
+            , species(0)
+            , coverage(0.0f)
+            , diversity(0.0f)
+            , composition(0.0f)
+            , framing(0.0f)
+            , total(0.0f)
+        {}
+    };
+    
+    explicit PhotoScorer(const Settings& settings = Settings());
+    
+    Score score(const World& world, const Camera& camera);
+    
+    const Settings& getSettings() const { return settings; }
+
+private:
+    Settings settings;
+    
+    // Reused between photographs
+    std::vector<Vec3> origins;
+    std::vector<Vec3> directions;
+    std::vector<World::RaycastHit> hits;
+    std::vector<int> flowerCells;
+};
@@ -0,0 +1,103 @@
+#include "physics_system.h"
+#include "cpu_features.h"
+#include <algorithm>
+#include <cmath>
+
+PhysicsSystem::PhysicsSystem(const Settings& settings)
+    : settings(settings)
+{
+}
+
+void PhysicsSystem::step(World& world, const CollisionSystem& collision, float deltaTime) {
+    if (deltaTime <= 0.0f) return;
+    
+    gather(world.getEntities());
+    if (bodies.empty()) return;
+    
+    integrate(deltaTime);
+    move(world, collision, deltaTime);
+    world.markEntitiesMoved();
+}
+
+void PhysicsSystem::gather(const std::vector<Entity*>& entities) {
+    bodies.clear();
+    for (Entity* entity : entities) {
+        if (entity && entity->isActive() && entity->getType() == Entity::Type::DYNAMIC) {
+            bodies.push_back(entity);
+        }
+    }
+    
+    size_t count = bodies.size();
+    velocity.resize(count);
+    dragFactor.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        const Entity* body = bodies[i];
+        velocity.set(i, body->getVelocity());
+        dragFactor[i] = settings.drag / body->getMass();
+    }
+}
+
+void PhysicsSystem::integrate(float deltaTime) {
+    size_t count = bodies.size();
+    Vec3 gravityStep = settings.gravity * deltaTime;
+    size_t i = 0;
+    
+#ifdef FLOWER_X86
+    const __m128 dt = _mm_set1_ps(deltaTime);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 gx = _mm_set1_ps(gravityStep.x);
+    const __m128 gy = _mm_set1_ps(gravityStep.y);
+    const __m128 gz = _mm_set1_ps(gravityStep.z);
+    
+    for (; i + 4 <= count; i += 4) {
+        __m128 keep = _mm_max_ps(zero, _mm_sub_ps(one, _mm_mul_ps(_mm_loadu_ps(&dragFactor[i]), dt)));
+        __m128 vx = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&velocity.x[i]), keep), gx);
+        __m128 vy = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&velocity.y[i]), keep), gy);
+        __m128 vz = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&velocity.z[i]), keep), gz);
+        _mm_storeu_ps(&velocity.x[i], vx);
+        _mm_storeu_ps(&velocity.y[i], vy);
+        _mm_storeu_ps(&velocity.z[i], vz);
+    }
+#endif
+    
+    for (; i < count; i++) {
+        float keep = std::max(0.0f, 1.0f - dragFactor[i] * deltaTime);
+        velocity.x[i] = velocity.x[i] * keep + gravityStep.x;
+        velocity.y[i] = velocity.y[i] * keep + gravityStep.y;
+        velocity.z[i] = velocity.z[i] * keep + gravityStep.z;
+    }
+}
+
+void PhysicsSystem::move(const World& world, const CollisionSystem& collision, float deltaTime) {
+    // Friction removes up to this much tangential speed per unit of normal.y
+    float frictionStep = settings.friction * settings.gravity.length() * deltaTime;
+    Vec3 probe(0.0f, -settings.snapDistance, 0.0f);
+    
+    for (size_t i = 0; i < bodies.size(); i++) {
+        Entity* body = bodies[i];
+        Vec3 bodyVelocity = velocity.get(i);
+        
+        // Ground contact comes from a probe that is not applied, so a body
+        // held by friction does not creep along the slope under it
+        CollisionSystem::SweepResult ground;
+        collision.sweep(body->getBoundingBox(), probe, body, &ground);
+        if (ground.grounded) {
+            if (Vec3::dot(bodyVelocity, ground.normal) < 0.0f) {
+                bodyVelocity = world.projectVelocityOntoSurface(bodyVelocity, ground.normal);
+            }
+            float speed = bodyVelocity.length();
+            float reduced = std::max(0.0f, speed - frictionStep * ground.normal.y);
+            if (speed > 0.0f) bodyVelocity = bodyVelocity * (reduced / speed);
+            body->setSurfaceNormal(ground.normal);
+        }
+        
+        // Whatever the body ran into this step takes the velocity into it
+        CollisionSystem::SweepResult contact;
+        collision.moveEntity(body, bodyVelocity * deltaTime, &contact);
+        if (contact.collided && Vec3::dot(bodyVelocity, contact.normal) < 0.0f) {
+            bodyVelocity = world.projectVelocityOntoSurface(bodyVelocity, contact.normal);
+        }
+        body->setVelocity(bodyVelocity);
+    }
+}
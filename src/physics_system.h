@@ -0,0 +1,59 @@
+#pragma once
+
+#include "collision_system.h"
+#include "entity.h"
+#include "math_utils.h"
+#include "simd_math.h"
+#include "world.h"
+#include <vector>
+
+// PhysicsSystem moves every active DYNAMIC entity of a World once per step.
+// Gravity and drag are integrated for all bodies at once as a SIMD kernel
+// over structure-of-arrays velocities; each body's displacement is then
+// swept through the CollisionSystem, so bodies rest on the same solid
+// terrain columns the player walks on and World::raycast hits, and stop
+// against other entities.
+//
+// A body is on the ground when a short probe below it hits something. It
+// then loses the part of its velocity pointing into the contact and Coulomb
+// friction slows the rest, so gravity along a slope makes it slide unless
+// friction holds it: slopes steeper than atan(friction) shed bodies and
+// gentler ones keep them.
+class PhysicsSystem {
+public:
+    struct Settings {
+        Vec3 gravity;
+        float friction;       // Coulomb coefficient between bodies and terrain
+        float drag;           // Air drag; a body loses drag / mass of its velocity per second
+        float snapDistance;   // Bodies this close above the ground rest on it
+        
+        Settings()
+            : gravity(0.0f, -9.81f, 0.0f)
+            , friction(0.6f)
+            , drag(0.05f)
+            , snapDistance(0.05f)
+        {}
+    };
+    
+    explicit PhysicsSystem(const Settings& settings = Settings());
+    
+    // The collision grid should have been rebuilt this frame
+    void step(World& world, const CollisionSystem& collision, float deltaTime);
+    
+    const Settings& getSettings() const { return settings; }
+    size_t getBodyCount() const { return bodies.size(); }
+
+private:
+    void gather(const std::vector<Entity*>& entities);
+    
+    // Gravity and drag over [0, bodies.size()); SSE path and a scalar tail
+    void integrate(float deltaTime);
+    void move(const World& world, const CollisionSystem& collision, float deltaTime);
+    
+    Settings settings;
+    
+    // Structure-of-arrays body state, rebuilt every step
+    std::vector<Entity*> bodies;
+    Vec3Batch velocity;
+    std::vector<float> dragFactor;       // drag / mass
+};
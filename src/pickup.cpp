@@ -1,8 +1,10 @@
 #include "pickup.h"
+#include <cmath>
 
 Pickup::Pickup(const Vec3& position, Type type)
     : position(position)
     , type(type)
+    , bobPhase(0.0f)
 {
     // Set color based on type
     switch (type) {
@@ -31,7 +33,13 @@ Pickup::~Pickup() {
 }
 
 void Pickup::update(float deltaTime) {
-    // Pickups can have idle animations, bobbing, etc.
+    // One bob every 0.6 pi (about 1.9) seconds, driven by the frame time so
+    // headless runs see the same motion every time
+    bobPhase = std::fmod(bobPhase + deltaTime / 0.3f, 2.0f * PI);
+}
+
+float Pickup::getBobOffset() const {
+    return std::sin(bobPhase) * 0.1f;
 }
 
 std::string Pickup::getName() const {
@@ -25,8 +25,12 @@ public:
     Color getColor() const { return color; }
     std::string getName() const;
     
+    // Height of the idle bob above the resting position
+    float getBobOffset() const;
+    
 private:
     Vec3 position;
     Type type;
     Color color;
+    float bobPhase;   // Radians, advanced in update() and kept in [0, 2pi)
 };
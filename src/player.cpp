@@ -1,4 +1,5 @@
 #include "player.h"
+#include "math_kernels.h"
 #include <cmath>
 
 Player::Player() 
@@ -199,7 +200,7 @@ float Player::getStandingSlopeAngle() const {
     dotProduct = std::max(-1.0f, std::min(1.0f, dotProduct));
     
     // Convert to degrees
-    float angleRad = std::acos(dotProduct);
+    float angleRad = MathUtils::fastAcos(dotProduct);
     return angleRad * 180.0f / 3.14159f;
 }
 
@@ -61,6 +61,13 @@ public:
     void incrementFlowersWatered() { flowersWatered++; }
     void incrementPhotographsTaken() { photographsTaken++; }
     
+    // Restore statistics from a save
+    void setStatistics(int planted, int watered, int photographs) {
+        flowersPlanted = planted;
+        flowersWatered = watered;
+        photographsTaken = photographs;
+    }
+    
     // Reset statistics
     void resetStatistics() {
         flowersPlanted = 0;
@@ -0,0 +1,96 @@
+#include "render_scene.h"
+#include "math_kernels.h"
+
+namespace {
+    RenderScene::MeshData buildCube() {
+        RenderScene::MeshData mesh;
+        mesh.doubleSided = false;
+        
+        // Corner i has x, y and z at +1 where bits 0, 1 and 2 of i are set
+        for (int i = 0; i < 8; i++) {
+            mesh.vertices.push_back(Vec3((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f));
+        }
+        
+        // Front, back, top, bottom, right, left
+        const uint16_t quads[6][4] = {
+            { 4, 5, 7, 6 }, { 0, 2, 3, 1 }, { 2, 6, 7, 3 },
+            { 0, 1, 5, 4 }, { 1, 3, 7, 5 }, { 0, 4, 6, 2 }
+        };
+        for (const uint16_t* quad : quads) {
+            mesh.indices.insert(mesh.indices.end(), { quad[0], quad[1], quad[2], quad[0], quad[2], quad[3] });
+        }
+        return mesh;
+    }
+    
+    RenderScene::MeshData buildFlowerHead() {
+        RenderScene::MeshData mesh;
+        mesh.doubleSided = true;
+        
+        const int segments = RenderScene::FLOWER_HEAD_SEGMENTS;
+        float angles[segments];
+        float rimSin[segments];
+        float rimCos[segments];
+        for (int i = 0; i < segments; i++) {
+            angles[i] = i * 3.14159f * 2.0f / segments;
+        }
+        MathUtils::sincosBatch(angles, rimSin, rimCos, segments);
+        
+        mesh.vertices.push_back(Vec3::zero());
+        for (int i = 0; i < segments; i++) {
+            mesh.vertices.push_back(Vec3(rimCos[i], 0.0f, rimSin[i]));
+        }
+        for (int i = 0; i < segments; i++) {
+            mesh.indices.insert(mesh.indices.end(), {
+                static_cast<uint16_t>(0),
+                static_cast<uint16_t>(1 + i),
+                static_cast<uint16_t>(1 + (i + 1) % segments)
+            });
+        }
+        return mesh;
+    }
+}
+
+RenderScene::RenderScene()
+    : background(0.53f, 0.81f, 0.92f)  // Sky blue
+{
+}
+
+const RenderScene::MeshData& RenderScene::getMesh(Mesh mesh) {
+    static const MeshData meshes[] = { buildCube(), buildFlowerHead() };
+    return meshes[static_cast<int>(mesh)];
+}
+
+void RenderScene::clear() {
+    instances.clear();
+    lines.clear();
+    triangles.clear();
+}
+
+void RenderScene::setCamera(const Mat4& view, const Mat4& projection) {
+    this->view = view;
+    this->projection = projection;
+}
+
+void RenderScene::addCube(const Vec3& top, const Color& color, float size) {
+    float halfSize = size * 0.5f;
+    instances.push_back({ Vec3(top.x, top.y - halfSize, top.z), halfSize, color, Mesh::CUBE });
+}
+
+void RenderScene::addFlower(const Vec3& position, const Color& color, float size) {
+    lines.push_back({ Vec3(position.x, position.y - 0.3f, position.z), position, Color(0.2f, 0.6f, 0.2f) });
+    instances.push_back({ position, size, color, Mesh::FLOWER_HEAD });
+}
+
+void RenderScene::addLine(const Vec3& start, const Vec3& end, const Color& color) {
+    lines.push_back({ start, end, color });
+}
+
+void RenderScene::addTriangle(const Vec3& a, const Vec3& b, const Vec3& c, const Color& color) {
+    triangles.push_back({ { a, b, c }, color });
+}
+
+void RenderScene::append(const RenderScene& other) {
+    instances.insert(instances.end(), other.instances.begin(), other.instances.end());
+    lines.insert(lines.end(), other.lines.begin(), other.lines.end());
+    triangles.insert(triangles.end(), other.triangles.begin(), other.triangles.end());
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "math_utils.h"
+#include "simd_math.h"
+#include <cstdint>
+#include <vector>
+
+// RenderScene is one frame's scene submission. The engine records what it
+// wants drawn (camera, instances of a few shared meshes, lines and loose
+// triangles) and a backend consumes the result: the OpenGL path in Engine
+// or the SoftwareRasterizer. Nothing here touches a graphics API, so a scene can
+// be built and rendered without a window.
+class RenderScene {
+public:
+    // Triangles in the fan drawn for a flower head
+    static const int FLOWER_HEAD_SEGMENTS = 8;
+    
+    enum class Mesh : uint8_t {
+        CUBE,          // Unit half-extent box around the origin
+        FLOWER_HEAD,   // Unit-radius disc in the XZ plane
+        COUNT
+    };
+    
+    // Unit-size triangle list shared by every instance of a mesh. Triangles
+    // wind counter-clockwise seen from outside; double-sided meshes are
+    // visible from both sides.
+    struct MeshData {
+        std::vector<Vec3> vertices;
+        std::vector<uint16_t> indices;
+        bool doubleSided;
+    };
+    
+    // A mesh scaled uniformly by 'scale' and moved to 'position'
+    struct Instance {
+        Vec3 position;
+        float scale;
+        Color color;
+        Mesh mesh;
+    };
+    
+    struct Line {
+        Vec3 start;
+        Vec3 end;
+        Color color;
+    };
+    
+    // A free-standing triangle such as terrain; counter-clockwise seen from
+    // its visible side
+    struct Triangle {
+        Vec3 corners[3];
+        Color color;
+    };
+    
+    RenderScene();
+    
+    static const MeshData& getMesh(Mesh mesh);
+    
+    // Forget the previous frame's objects; the camera and background stay
+    void clear();
+    
+    void setCamera(const Mat4& view, const Mat4& projection);
+    const Mat4& getView() const { return view; }
+    const Mat4& getProjection() const { return projection; }
+    
+    void setBackground(const Color& color) { background = color; }
+    const Color& getBackground() const { return background; }
+    
+    // Axis-aligned cube of side 'size' whose top face is centred on 'top'
+    void addCube(const Vec3& top, const Color& color, float size);
+    
+    // Flower head of radius 'size' at 'position' with its stem below
+    void addFlower(const Vec3& position, const Color& color, float size);
+    
+    void addLine(const Vec3& start, const Vec3& end, const Color& color);
+    void addTriangle(const Vec3& a, const Vec3& b, const Vec3& c, const Color& color);
+    
+    // Add another scene's objects after this one's, e.g. one recorded on a
+    // worker thread; the other scene's camera is ignored
+    void append(const RenderScene& other);
+    
+    const std::vector<Instance>& getInstances() const { return instances; }
+    const std::vector<Line>& getLines() const { return lines; }
+    const std::vector<Triangle>& getTriangles() const { return triangles; }
+
+private:
+    Mat4 view;
+    Mat4 projection;
+    Color background;
+    std::vector<Instance> instances;
+    std::vector<Line> lines;
+    std::vector<Triangle> triangles;
+};
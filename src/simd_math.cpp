@@ -0,0 +1,376 @@
+#include "simd_math.h"
+#include <cmath>
+
+// Quat
+
+Quat Quat::fromAxisAngle(const Vec3& axis, float angleDeg) {
+    Vec3 unit = axis.normalized();
+    float half = angleDeg * DEG_TO_RAD * 0.5f;
+    float s = std::sin(half);
+    return Quat(unit.x * s, unit.y * s, unit.z * s, std::cos(half));
+}
+
+Quat Quat::fromEuler(float pitchDeg, float yawDeg, float rollDeg) {
+    return fromAxisAngle(Vec3(0, 1, 0), yawDeg) *
+           fromAxisAngle(Vec3(1, 0, 0), pitchDeg) *
+           fromAxisAngle(Vec3(0, 0, 1), rollDeg);
+}
+
+Quat Quat::operator*(const Quat& o) const {
+    return Quat(w * o.x + x * o.w + y * o.z - z * o.y,
+                w * o.y - x * o.z + y * o.w + z * o.x,
+                w * o.z + x * o.y - y * o.x + z * o.w,
+                w * o.w - x * o.x - y * o.y - z * o.z);
+}
+
+Quat Quat::normalized() const {
+    float len = Vec4(x, y, z, w).length();
+    if (len <= 0.0f) return Quat();
+    return Quat(x / len, y / len, z / len, w / len);
+}
+
+Vec3 Quat::rotate(const Vec3& v) const {
+    // v + 2w(q x v) + 2q x (q x v), cheaper than two quaternion products
+    Vec3 q(x, y, z);
+    Vec3 t = Vec3::cross(q, v) * 2.0f;
+    return v + t * w + Vec3::cross(q, t);
+}
+
+Quat Quat::slerp(const Quat& a, const Quat& b, float t) {
+    float cosTheta = Vec4::dot(Vec4(a.x, a.y, a.z, a.w), Vec4(b.x, b.y, b.z, b.w));
+    Quat end = b;
+    if (cosTheta < 0.0f) {
+        cosTheta = -cosTheta;
+        end = Quat(-b.x, -b.y, -b.z, -b.w);
+    }
+    
+    // Nearly parallel: fall back to normalized linear interpolation
+    float wa, wb;
+    if (cosTheta > 0.9995f) {
+        wa = 1.0f - t;
+        wb = t;
+    } else {
+        float theta = std::acos(cosTheta);
+        float sinTheta = std::sin(theta);
+        wa = std::sin((1.0f - t) * theta) / sinTheta;
+        wb = std::sin(t * theta) / sinTheta;
+    }
+    return Quat(a.x * wa + end.x * wb, a.y * wa + end.y * wb,
+                a.z * wa + end.z * wb, a.w * wa + end.w * wb).normalized();
+}
+
+// Mat4
+
+Mat4::Mat4() {
+    for (int i = 0; i < 16; i++) {
+        m[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+    }
+}
+
+Mat4 Mat4::translation(const Vec3& offset) {
+    Mat4 result;
+    result.m[12] = offset.x;
+    result.m[13] = offset.y;
+    result.m[14] = offset.z;
+    return result;
+}
+
+Mat4 Mat4::scale(const Vec3& factors) {
+    Mat4 result;
+    result.m[0] = factors.x;
+    result.m[5] = factors.y;
+    result.m[10] = factors.z;
+    return result;
+}
+
+Mat4 Mat4::rotationX(float angleDeg) {
+    float c = std::cos(angleDeg * DEG_TO_RAD);
+    float s = std::sin(angleDeg * DEG_TO_RAD);
+    Mat4 result;
+    result.at(1, 1) = c;
+    result.at(1, 2) = -s;
+    result.at(2, 1) = s;
+    result.at(2, 2) = c;
+    return result;
+}
+
+Mat4 Mat4::rotationY(float angleDeg) {
+    float c = std::cos(angleDeg * DEG_TO_RAD);
+    float s = std::sin(angleDeg * DEG_TO_RAD);
+    Mat4 result;
+    result.at(0, 0) = c;
+    result.at(0, 2) = s;
+    result.at(2, 0) = -s;
+    result.at(2, 2) = c;
+    return result;
+}
+
+Mat4 Mat4::rotationZ(float angleDeg) {
+    float c = std::cos(angleDeg * DEG_TO_RAD);
+    float s = std::sin(angleDeg * DEG_TO_RAD);
+    Mat4 result;
+    result.at(0, 0) = c;
+    result.at(0, 1) = -s;
+    result.at(1, 0) = s;
+    result.at(1, 1) = c;
+    return result;
+}
+
+Mat4 Mat4::rotation(const Quat& q) {
+    Quat n = q.normalized();
+    float xx = n.x * n.x, yy = n.y * n.y, zz = n.z * n.z;
+    float xy = n.x * n.y, xz = n.x * n.z, yz = n.y * n.z;
+    float wx = n.w * n.x, wy = n.w * n.y, wz = n.w * n.z;
+    
+    Mat4 result;
+    result.at(0, 0) = 1.0f - 2.0f * (yy + zz);
+    result.at(0, 1) = 2.0f * (xy - wz);
+    result.at(0, 2) = 2.0f * (xz + wy);
+    result.at(1, 0) = 2.0f * (xy + wz);
+    result.at(1, 1) = 1.0f - 2.0f * (xx + zz);
+    result.at(1, 2) = 2.0f * (yz - wx);
+    result.at(2, 0) = 2.0f * (xz - wy);
+    result.at(2, 1) = 2.0f * (yz + wx);
+    result.at(2, 2) = 1.0f - 2.0f * (xx + yy);
+    return result;
+}
+
+Mat4 Mat4::perspective(float fovYDeg, float aspect, float nearPlane, float farPlane) {
+    float f = 1.0f / std::tan(fovYDeg * DEG_TO_RAD * 0.5f);
+    Mat4 result;
+    result.at(0, 0) = f / aspect;
+    result.at(1, 1) = f;
+    result.at(2, 2) = (farPlane + nearPlane) / (nearPlane - farPlane);
+    result.at(2, 3) = 2.0f * farPlane * nearPlane / (nearPlane - farPlane);
+    result.at(3, 2) = -1.0f;
+    result.at(3, 3) = 0.0f;
+    return result;
+}
+
+Mat4 Mat4::lookAt(const Vec3& eye, const Vec3& target, const Vec3& up) {
+    Vec3 f = (target - eye).normalized();
+    Vec3 s = Vec3::cross(f, up).normalized();
+    Vec3 u = Vec3::cross(s, f);
+    
+    Mat4 result;
+    result.at(0, 0) = s.x;
+    result.at(0, 1) = s.y;
+    result.at(0, 2) = s.z;
+    result.at(1, 0) = u.x;
+    result.at(1, 1) = u.y;
+    result.at(1, 2) = u.z;
+    result.at(2, 0) = -f.x;
+    result.at(2, 1) = -f.y;
+    result.at(2, 2) = -f.z;
+    result.at(0, 3) = -Vec3::dot(s, eye);
+    result.at(1, 3) = -Vec3::dot(u, eye);
+    result.at(2, 3) = Vec3::dot(f, eye);
+    return result;
+}
+
+Mat4 Mat4::operator*(const Mat4& other) const {
+    Mat4 result;
+#ifdef FLOWER_X86
+    // Each result column is this matrix applied to the other's column
+    __m128 c0 = _mm_load_ps(m);
+    __m128 c1 = _mm_load_ps(m + 4);
+    __m128 c2 = _mm_load_ps(m + 8);
+    __m128 c3 = _mm_load_ps(m + 12);
+    for (int column = 0; column < 4; column++) {
+        const float* b = other.m + column * 4;
+        __m128 sum = _mm_mul_ps(c0, _mm_set1_ps(b[0]));
+        sum = _mm_add_ps(sum, _mm_mul_ps(c1, _mm_set1_ps(b[1])));
+        sum = _mm_add_ps(sum, _mm_mul_ps(c2, _mm_set1_ps(b[2])));
+        sum = _mm_add_ps(sum, _mm_mul_ps(c3, _mm_set1_ps(b[3])));
+        _mm_store_ps(result.m + column * 4, sum);
+    }
+#else
+    for (int column = 0; column < 4; column++) {
+        for (int row = 0; row < 4; row++) {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; k++) {
+                sum += at(row, k) * other.at(k, column);
+            }
+            result.at(row, column) = sum;
+        }
+    }
+#endif
+    return result;
+}
+
+Mat4 Mat4::transposed() const {
+    Mat4 result = *this;
+#ifdef FLOWER_X86
+    __m128 c0 = _mm_load_ps(m);
+    __m128 c1 = _mm_load_ps(m + 4);
+    __m128 c2 = _mm_load_ps(m + 8);
+    __m128 c3 = _mm_load_ps(m + 12);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    _mm_store_ps(result.m, c0);
+    _mm_store_ps(result.m + 4, c1);
+    _mm_store_ps(result.m + 8, c2);
+    _mm_store_ps(result.m + 12, c3);
+#else
+    for (int row = 0; row < 4; row++) {
+        for (int column = 0; column < 4; column++) {
+            result.at(row, column) = at(column, row);
+        }
+    }
+#endif
+    return result;
+}
+
+Mat4 Mat4::inverseAffine() const {
+    // Inverse of the upper 3x3 by cofactors, then the translation
+    float a = at(0, 0), b = at(0, 1), c = at(0, 2);
+    float d = at(1, 0), e = at(1, 1), f = at(1, 2);
+    float g = at(2, 0), h = at(2, 1), i = at(2, 2);
+    
+    float coA = e * i - f * h;
+    float coB = f * g - d * i;
+    float coC = d * h - e * g;
+    float determinant = a * coA + b * coB + c * coC;
+    if (determinant == 0.0f) return Mat4();
+    float inverse = 1.0f / determinant;
+    
+    Mat4 result;
+    result.at(0, 0) = coA * inverse;
+    result.at(0, 1) = (c * h - b * i) * inverse;
+    result.at(0, 2) = (b * f - c * e) * inverse;
+    result.at(1, 0) = coB * inverse;
+    result.at(1, 1) = (a * i - c * g) * inverse;
+    result.at(1, 2) = (c * d - a * f) * inverse;
+    result.at(2, 0) = coC * inverse;
+    result.at(2, 1) = (b * g - a * h) * inverse;
+    result.at(2, 2) = (a * e - b * d) * inverse;
+    
+    Vec3 t = result.transformDirection(Vec3(at(0, 3), at(1, 3), at(2, 3)));
+    result.at(0, 3) = -t.x;
+    result.at(1, 3) = -t.y;
+    result.at(2, 3) = -t.z;
+    return result;
+}
+
+// Vec3Batch
+
+void Vec3Batch::resize(size_t count) {
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+}
+
+void Vec3Batch::clear() {
+    x.clear();
+    y.clear();
+    z.clear();
+}
+
+void Vec3Batch::push_back(const Vec3& v) {
+    x.push_back(v.x);
+    y.push_back(v.y);
+    z.push_back(v.z);
+}
+
+void Vec3Batch::transformPoints(const Mat4& matrix, Vec3Batch& out) const {
+    size_t count = size();
+    out.resize(count);
+    const float* m = matrix.m;
+    size_t i = 0;
+    
+#ifdef FLOWER_X86
+    __m128 m0 = _mm_set1_ps(m[0]), m1 = _mm_set1_ps(m[1]), m2 = _mm_set1_ps(m[2]);
+    __m128 m4 = _mm_set1_ps(m[4]), m5 = _mm_set1_ps(m[5]), m6 = _mm_set1_ps(m[6]);
+    __m128 m8 = _mm_set1_ps(m[8]), m9 = _mm_set1_ps(m[9]), m10 = _mm_set1_ps(m[10]);
+    __m128 m12 = _mm_set1_ps(m[12]), m13 = _mm_set1_ps(m[13]), m14 = _mm_set1_ps(m[14]);
+    
+    for (; i + 4 <= count; i += 4) {
+        __m128 px = _mm_loadu_ps(&x[i]);
+        __m128 py = _mm_loadu_ps(&y[i]);
+        __m128 pz = _mm_loadu_ps(&z[i]);
+        __m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, px), _mm_mul_ps(m4, py)), _mm_add_ps(_mm_mul_ps(m8, pz), m12));
+        __m128 ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m1, px), _mm_mul_ps(m5, py)), _mm_add_ps(_mm_mul_ps(m9, pz), m13));
+        __m128 rz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m2, px), _mm_mul_ps(m6, py)), _mm_add_ps(_mm_mul_ps(m10, pz), m14));
+        _mm_storeu_ps(&out.x[i], rx);
+        _mm_storeu_ps(&out.y[i], ry);
+        _mm_storeu_ps(&out.z[i], rz);
+    }
+#endif
+    
+    for (; i < count; i++) {
+        float px = x[i], py = y[i], pz = z[i];
+        out.x[i] = m[0] * px + m[4] * py + (m[8] * pz + m[12]);
+        out.y[i] = m[1] * px + m[5] * py + (m[9] * pz + m[13]);
+        out.z[i] = m[2] * px + m[6] * py + (m[10] * pz + m[14]);
+    }
+}
+
+void Vec3Batch::dot(const Vec3Batch& other, float* out) const {
+    size_t count = size();
+    size_t i = 0;
+    
+#ifdef FLOWER_X86
+    for (; i + 4 <= count; i += 4) {
+        __m128 sum = _mm_mul_ps(_mm_loadu_ps(&x[i]), _mm_loadu_ps(&other.x[i]));
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&y[i]), _mm_loadu_ps(&other.y[i])));
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&z[i]), _mm_loadu_ps(&other.z[i])));
+        _mm_storeu_ps(out + i, sum);
+    }
+#endif
+    
+    for (; i < count; i++) {
+        out[i] = x[i] * other.x[i] + y[i] * other.y[i] + z[i] * other.z[i];
+    }
+}
+
+void Vec3Batch::normalize() {
+    size_t count = size();
+    size_t i = 0;
+    
+#ifdef FLOWER_X86
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    for (; i + 4 <= count; i += 4) {
+        __m128 vx = _mm_loadu_ps(&x[i]);
+        __m128 vy = _mm_loadu_ps(&y[i]);
+        __m128 vz = _mm_loadu_ps(&z[i]);
+        __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz)));
+        
+        // Exact division keeps results identical to Vec3::normalize
+        __m128 nonZero = _mm_cmpgt_ps(length, zero);
+        __m128 divisor = _mm_or_ps(_mm_and_ps(nonZero, length), _mm_andnot_ps(nonZero, one));
+        _mm_storeu_ps(&x[i], _mm_div_ps(vx, divisor));
+        _mm_storeu_ps(&y[i], _mm_div_ps(vy, divisor));
+        _mm_storeu_ps(&z[i], _mm_div_ps(vz, divisor));
+    }
+#endif
+    
+    for (; i < count; i++) {
+        Vec3 v(x[i], y[i], z[i]);
+        v.normalize();
+        set(i, v);
+    }
+}
+
+void Vec3Batch::distanceSquared(const Vec3& point, float* out) const {
+    size_t count = size();
+    size_t i = 0;
+    
+#ifdef FLOWER_X86
+    const __m128 px = _mm_set1_ps(point.x);
+    const __m128 py = _mm_set1_ps(point.y);
+    const __m128 pz = _mm_set1_ps(point.z);
+    for (; i + 4 <= count; i += 4) {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(&x[i]), px);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(&y[i]), py);
+        __m128 dz = _mm_sub_ps(_mm_loadu_ps(&z[i]), pz);
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+    }
+#endif
+    
+    for (; i < count; i++) {
+        float dx = x[i] - point.x;
+        float dy = y[i] - point.y;
+        float dz = z[i] - point.z;
+        out[i] = dx * dx + dy * dy + dz * dz;
+    }
+}
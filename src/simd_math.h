@@ -0,0 +1,204 @@
+#pragma once
+
+#include "cpu_features.h"
+#include "math_utils.h"
+#include <cstddef>
+#include <vector>
+
+// SIMD-friendly math types to sit next to the scalar Vec3 of math_utils.h.
+// Vec4, Mat4 and Quat are 16-byte aligned so each row or column is one SSE
+// register; Vec3Batch stores arrays of vectors as separate X, Y and Z
+// columns so operations process four vectors per instruction. Other
+// targets, ARM included, use the scalar loops; they are written lane by
+// lane over the columns so AArch64 compilers can turn them into NEON.
+
+struct alignas(16) Vec4 {
+    float x, y, z, w;
+    
+    Vec4() : x(0), y(0), z(0), w(0) {}
+    Vec4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+    Vec4(const Vec3& v, float w) : x(v.x), y(v.y), z(v.z), w(w) {}
+    
+    Vec3 xyz() const { return Vec3(x, y, z); }
+    
+    Vec4 operator+(const Vec4& other) const;
+    Vec4 operator-(const Vec4& other) const;
+    Vec4 operator*(const Vec4& other) const;   // Component-wise
+    Vec4 operator*(float scalar) const;
+    
+    static float dot(const Vec4& a, const Vec4& b);
+    float length() const;
+    Vec4 normalized() const;
+};
+
+// Quaternion rotation (x, y, z vector part, w scalar part)
+struct alignas(16) Quat {
+    float x, y, z, w;
+    
+    Quat() : x(0), y(0), z(0), w(1) {}
+    Quat(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+    
+    static Quat identity() { return Quat(); }
+    static Quat fromAxisAngle(const Vec3& axis, float angleDeg);
+    
+    // Yaw about Y, then pitch about X, then roll about Z (degrees)
+    static Quat fromEuler(float pitchDeg, float yawDeg, float rollDeg);
+    
+    Quat operator*(const Quat& other) const;
+    Quat conjugate() const { return Quat(-x, -y, -z, w); }
+    Quat normalized() const;
+    Vec3 rotate(const Vec3& v) const;
+    
+    // Shortest-path spherical interpolation
+    static Quat slerp(const Quat& a, const Quat& b, float t);
+};
+
+// Column-major 4x4 matrix, laid out as OpenGL expects (glLoadMatrixf)
+struct alignas(16) Mat4 {
+    float m[16];
+    
+    Mat4();   // Identity
+    
+    static Mat4 identity() { return Mat4(); }
+    static Mat4 translation(const Vec3& offset);
+    static Mat4 scale(const Vec3& factors);
+    static Mat4 rotationX(float angleDeg);
+    static Mat4 rotationY(float angleDeg);
+    static Mat4 rotationZ(float angleDeg);
+    static Mat4 rotation(const Quat& q);
+    
+    // Same matrices as gluPerspective and gluLookAt
+    static Mat4 perspective(float fovYDeg, float aspect, float nearPlane, float farPlane);
+    static Mat4 lookAt(const Vec3& eye, const Vec3& target, const Vec3& up);
+    
+    float& at(int row, int column) { return m[column * 4 + row]; }
+    float at(int row, int column) const { return m[column * 4 + row]; }
+    const float* data() const { return m; }
+    
+    Mat4 operator*(const Mat4& other) const;
+    Vec4 operator*(const Vec4& v) const;
+    Vec3 transformPoint(const Vec3& p) const;       // w = 1, no perspective divide
+    Vec3 transformDirection(const Vec3& d) const;   // w = 0
+    Mat4 transposed() const;
+    
+    // Inverse of a rotation/translation/scale matrix (bottom row 0 0 0 1)
+    Mat4 inverseAffine() const;
+};
+
+// Structure-of-arrays storage for many Vec3s. The batch operations run four
+// vectors at a time and match the scalar Vec3 operations lane by lane.
+struct Vec3Batch {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    
+    size_t size() const { return x.size(); }
+    bool empty() const { return x.empty(); }
+    void resize(size_t count);
+    void clear();
+    void push_back(const Vec3& v);
+    
+    Vec3 get(size_t i) const { return Vec3(x[i], y[i], z[i]); }
+    void set(size_t i, const Vec3& v) { x[i] = v.x; y[i] = v.y; z[i] = v.z; }
+    
+    // out[i] = m * (this[i], 1); out is resized to match
+    void transformPoints(const Mat4& m, Vec3Batch& out) const;
+    
+    // out[i] = dot(this[i], other[i]); other must be at least as long
+    void dot(const Vec3Batch& other, float* out) const;
+    
+    // Normalizes every vector in place; zero vectors stay zero
+    void normalize();
+    
+    // out[i] = |this[i] - point|^2
+    void distanceSquared(const Vec3& point, float* out) const;
+};
+
+// Small Vec4 and Mat4 operations are inline so they compile down to a
+// handful of instructions at the call site
+
+inline Vec4 Vec4::operator+(const Vec4& other) const {
+    Vec4 result;
+#ifdef FLOWER_X86
+    _mm_store_ps(&result.x, _mm_add_ps(_mm_load_ps(&x), _mm_load_ps(&other.x)));
+#else
+    result = Vec4(x + other.x, y + other.y, z + other.z, w + other.w);
+#endif
+    return result;
+}
+
+inline Vec4 Vec4::operator-(const Vec4& other) const {
+    Vec4 result;
+#ifdef FLOWER_X86
+    _mm_store_ps(&result.x, _mm_sub_ps(_mm_load_ps(&x), _mm_load_ps(&other.x)));
+#else
+    result = Vec4(x - other.x, y - other.y, z - other.z, w - other.w);
+#endif
+    return result;
+}
+
+inline Vec4 Vec4::operator*(const Vec4& other) const {
+    Vec4 result;
+#ifdef FLOWER_X86
+    _mm_store_ps(&result.x, _mm_mul_ps(_mm_load_ps(&x), _mm_load_ps(&other.x)));
+#else
+    result = Vec4(x * other.x, y * other.y, z * other.z, w * other.w);
+#endif
+    return result;
+}
+
+inline Vec4 Vec4::operator*(float scalar) const {
+    Vec4 result;
+#ifdef FLOWER_X86
+    _mm_store_ps(&result.x, _mm_mul_ps(_mm_load_ps(&x), _mm_set1_ps(scalar)));
+#else
+    result = Vec4(x * scalar, y * scalar, z * scalar, w * scalar);
+#endif
+    return result;
+}
+
+inline float Vec4::dot(const Vec4& a, const Vec4& b) {
+#ifdef FLOWER_X86
+    __m128 product = _mm_mul_ps(_mm_load_ps(&a.x), _mm_load_ps(&b.x));
+    __m128 swapped = _mm_shuffle_ps(product, product, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 sums = _mm_add_ps(product, swapped);
+    swapped = _mm_movehl_ps(swapped, sums);
+    return _mm_cvtss_f32(_mm_add_ss(sums, swapped));
+#else
+    return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+#endif
+}
+
+inline float Vec4::length() const {
+    return std::sqrt(dot(*this, *this));
+}
+
+inline Vec4 Vec4::normalized() const {
+    float len = length();
+    return len > 0.0f ? *this * (1.0f / len) : Vec4();
+}
+
+inline Vec4 Mat4::operator*(const Vec4& v) const {
+    Vec4 result;
+#ifdef FLOWER_X86
+    __m128 sum = _mm_mul_ps(_mm_load_ps(m), _mm_set1_ps(v.x));
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_load_ps(m + 4), _mm_set1_ps(v.y)));
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_load_ps(m + 8), _mm_set1_ps(v.z)));
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_load_ps(m + 12), _mm_set1_ps(v.w)));
+    _mm_store_ps(&result.x, sum);
+#else
+    result.x = m[0] * v.x + m[4] * v.y + m[8] * v.z + m[12] * v.w;
+    result.y = m[1] * v.x + m[5] * v.y + m[9] * v.z + m[13] * v.w;
+    result.z = m[2] * v.x + m[6] * v.y + m[10] * v.z + m[14] * v.w;
+    result.w = m[3] * v.x + m[7] * v.y + m[11] * v.z + m[15] * v.w;
+#endif
+    return result;
+}
+
+inline Vec3 Mat4::transformPoint(const Vec3& p) const {
+    return (*this * Vec4(p, 1.0f)).xyz();
+}
+
+inline Vec3 Mat4::transformDirection(const Vec3& d) const {
+    return (*this * Vec4(d, 0.0f)).xyz();
+}
@@ -0,0 +1,533 @@
+#include "software_rasterizer.h"
+#include "cpu_features.h"
+#include "job_system.h"
+#include "world.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+namespace {
+    // Triangles reaching this far outside the screen (in NDC units) are
+    // clipped; smaller overhangs are left to the bounding box and the edge
+    // functions, which stay precise well beyond it
+    const float GUARD_BAND = 4.0f;
+    
+    // Clip-space planes a point is inside of when dot(plane, point) >= 0:
+    // near, then the guard band left, right, bottom and top
+    const Vec4 CLIP_PLANES[] = {
+        Vec4(0.0f, 0.0f, 1.0f, 1.0f),
+        Vec4(1.0f, 0.0f, 0.0f, GUARD_BAND),
+        Vec4(-1.0f, 0.0f, 0.0f, GUARD_BAND),
+        Vec4(0.0f, 1.0f, 0.0f, GUARD_BAND),
+        Vec4(0.0f, -1.0f, 0.0f, GUARD_BAND)
+    };
+    const int CLIP_PLANE_COUNT = 5;
+    
+    // A triangle clipped by every plane has at most 3 + CLIP_PLANE_COUNT corners
+    const int MAX_CLIPPED_VERTICES = 3 + CLIP_PLANE_COUNT;
+    
+    // Bit per frustum plane the point is outside of
+    int outcode(const Vec4& v) {
+        return (v.x < -v.w ? 1 : 0) | (v.x > v.w ? 2 : 0) |
+               (v.y < -v.w ? 4 : 0) | (v.y > v.w ? 8 : 0) |
+               (v.z < -v.w ? 16 : 0) | (v.z > v.w ? 32 : 0);
+    }
+    
+    bool insideGuardBand(const Vec4& v) {
+        return v.z >= -v.w && std::abs(v.x) <= GUARD_BAND * v.w && std::abs(v.y) <= GUARD_BAND * v.w;
+    }
+    
+    // Source-over blend of 'source' onto 'destination'; the result is opaque
+    uint32_t blendColor(uint32_t source, uint32_t destination) {
+        uint32_t alpha = source >> 24;
+        uint32_t result = 0xff000000u;
+        for (int shift = 0; shift < 24; shift += 8) {
+            uint32_t s = (source >> shift) & 0xff;
+            uint32_t d = (destination >> shift) & 0xff;
+            result |= ((s * alpha + d * (255 - alpha) + 127) / 255) << shift;
+        }
+        return result;
+    }
+}
+
+SoftwareRasterizer::SoftwareRasterizer(const Settings& settings)
+    : settings(settings)
+    , tilesX((settings.width + settings.tileSize - 1) / settings.tileSize)
+    , tilesY((settings.height + settings.tileSize - 1) / settings.tileSize)
+    , clearColor(0xff000000u)
+    , colorBuffer(static_cast<size_t>(settings.width) * settings.height, clearColor)
+    , depthBuffer(static_cast<size_t>(settings.width) * settings.height, 1.0f)
+    , batchCount(0)
+{
+}
+
+size_t SoftwareRasterizer::getTriangleCount() const {
+    size_t count = 0;
+    for (size_t b = 0; b < batchCount; b++) {
+        count += batches[b].triangles.size();
+    }
+    return count;
+}
+
+void SoftwareRasterizer::render(const RenderScene& scene) {
+    Mat4 viewProjection = scene.getProjection() * scene.getView();
+    clearColor = MathUtils::packColorRGBA8(scene.getBackground()) | 0xff000000u;
+    
+    // Lines, then instances, then loose triangles
+    size_t batchSize = static_cast<size_t>(std::max(1, settings.batchSize));
+    size_t lineCount = scene.getLines().size();
+    size_t lineBatches = (lineCount + batchSize - 1) / batchSize;
+    size_t instanceCount = scene.getInstances().size();
+    size_t instanceBatches = (instanceCount + batchSize - 1) / batchSize;
+    size_t triangleCount = scene.getTriangles().size();
+    batchCount = lineBatches + instanceBatches + (triangleCount + batchSize - 1) / batchSize;
+    if (batches.size() < batchCount) batches.resize(batchCount);
+    
+    size_t tileCount = static_cast<size_t>(tilesX) * tilesY;
+    JobSystem::instance().parallelFor(0, static_cast<int>(batchCount), 1, [&](int first, int last) {
+        for (int b = first; b < last; b++) {
+            Batch& batch = batches[b];
+            batch.triangles.clear();
+            batch.bins.resize(tileCount);
+            for (std::vector<uint32_t>& bin : batch.bins) {
+                bin.clear();
+            }
+            
+            if (static_cast<size_t>(b) < lineBatches) {
+                size_t start = b * batchSize;
+                setupLines(scene, viewProjection, start, std::min(start + batchSize, lineCount), batch);
+            } else if (static_cast<size_t>(b) < lineBatches + instanceBatches) {
+                size_t start = (b - lineBatches) * batchSize;
+                setupInstances(scene, viewProjection, start, std::min(start + batchSize, instanceCount), batch);
+            } else {
+                size_t start = (b - lineBatches - instanceBatches) * batchSize;
+                setupTriangles(scene, viewProjection, start, std::min(start + batchSize, triangleCount), batch);
+            }
+        }
+    });
+    
+    JobSystem::instance().parallelFor(0, static_cast<int>(tileCount), 1, [&](int first, int last) {
+        for (int tile = first; tile < last; tile++) {
+            rasterizeTile(tile);
+        }
+    });
+}
+
+void SoftwareRasterizer::setupLines(const RenderScene& scene, const Mat4& viewProjection,
+                                    size_t first, size_t last, Batch& batch) const {
+    const std::vector<RenderScene::Line>& lines = scene.getLines();
+    for (size_t i = first; i < last; i++) {
+        const RenderScene::Line& line = lines[i];
+        Vec4 start = viewProjection * Vec4(line.start, 1.0f);
+        Vec4 end = viewProjection * Vec4(line.end, 1.0f);
+        if (outcode(start) & outcode(end)) continue;
+        
+        // Trim the segment to the clip planes
+        float t0 = 0.0f, t1 = 1.0f;
+        for (const Vec4& plane : CLIP_PLANES) {
+            float d0 = Vec4::dot(plane, start);
+            float d1 = Vec4::dot(plane, end);
+            if (d0 < 0.0f && d1 < 0.0f) {
+                t0 = 1.0f;
+                t1 = 0.0f;
+                break;
+            }
+            if (d0 < 0.0f) t0 = std::max(t0, d0 / (d0 - d1));
+            if (d1 < 0.0f) t1 = std::min(t1, d0 / (d0 - d1));
+        }
+        if (t0 >= t1) continue;
+        
+        Vec3 a = toScreen(start + (end - start) * t0);
+        Vec3 b = toScreen(start + (end - start) * t1);
+        
+        // A one pixel wide quad along the segment
+        float dx = b.x - a.x, dy = b.y - a.y;
+        float length = std::sqrt(dx * dx + dy * dy);
+        if (length < 1e-6f) {
+            dx = 1.0f;
+            dy = 0.0f;
+            length = 1.0f;
+        }
+        float offsetX = -dy / length * 0.5f;
+        float offsetY = dx / length * 0.5f;
+        Vec3 corners[4] = {
+            Vec3(a.x + offsetX, a.y + offsetY, a.z),
+            Vec3(b.x + offsetX, b.y + offsetY, b.z),
+            Vec3(b.x - offsetX, b.y - offsetY, b.z),
+            Vec3(a.x - offsetX, a.y - offsetY, a.z)
+        };
+        uint32_t color = MathUtils::packColorRGBA8(line.color);
+        bool blend = line.color.a < 1.0f;
+        addScreenTriangle(corners[0], corners[1], corners[2], color, blend, true, batch);
+        addScreenTriangle(corners[0], corners[2], corners[3], color, blend, true, batch);
+    }
+}
+
+void SoftwareRasterizer::setupInstances(const RenderScene& scene, const Mat4& viewProjection,
+                                        size_t first, size_t last, Batch& batch) const {
+    const std::vector<RenderScene::Instance>& instances = scene.getInstances();
+    std::vector<Vec4> clip;
+    for (size_t i = first; i < last; i++) {
+        const RenderScene::Instance& instance = instances[i];
+        const RenderScene::MeshData& mesh = RenderScene::getMesh(instance.mesh);
+        
+        // Skip the whole instance when every corner is outside one plane
+        clip.resize(mesh.vertices.size());
+        int outside = ~0;
+        for (size_t v = 0; v < mesh.vertices.size(); v++) {
+            clip[v] = viewProjection * Vec4(mesh.vertices[v] * instance.scale + instance.position, 1.0f);
+            outside &= outcode(clip[v]);
+        }
+        if (outside) continue;
+        
+        uint32_t color = MathUtils::packColorRGBA8(instance.color);
+        bool blend = instance.color.a < 1.0f;
+        for (size_t index = 0; index + 2 < mesh.indices.size(); index += 3) {
+            addClipTriangle(clip[mesh.indices[index]], clip[mesh.indices[index + 1]], clip[mesh.indices[index + 2]],
+                            color, blend, mesh.doubleSided, batch);
+        }
+    }
+}
+
+void SoftwareRasterizer::setupTriangles(const RenderScene& scene, const Mat4& viewProjection,
+                                        size_t first, size_t last, Batch& batch) const {
+    const std::vector<RenderScene::Triangle>& triangles = scene.getTriangles();
+    for (size_t i = first; i < last; i++) {
+        const RenderScene::Triangle& triangle = triangles[i];
+        addClipTriangle(viewProjection * Vec4(triangle.corners[0], 1.0f),
+                        viewProjection * Vec4(triangle.corners[1], 1.0f),
+                        viewProjection * Vec4(triangle.corners[2], 1.0f),
+                        MathUtils::packColorRGBA8(triangle.color), triangle.color.a < 1.0f, false, batch);
+    }
+}
+
+Vec3 SoftwareRasterizer::toScreen(const Vec4& clip) const {
+    float inverseW = 1.0f / clip.w;
+    return Vec3((clip.x * inverseW * 0.5f + 0.5f) * settings.width,
+                (0.5f - clip.y * inverseW * 0.5f) * settings.height,
+                clip.z * inverseW * 0.5f + 0.5f);
+}
+
+void SoftwareRasterizer::addClipTriangle(const Vec4& v0, const Vec4& v1, const Vec4& v2, uint32_t color,
+                                         bool blend, bool doubleSided, Batch& batch) const {
+    if (outcode(v0) & outcode(v1) & outcode(v2)) return;
+    
+    if (insideGuardBand(v0) && insideGuardBand(v1) && insideGuardBand(v2)) {
+        addScreenTriangle(toScreen(v0), toScreen(v1), toScreen(v2), color, blend, doubleSided, batch);
+        return;
+    }
+    
+    // Sutherland-Hodgman against the near plane and the guard band
+    Vec4 polygon[MAX_CLIPPED_VERTICES];
+    Vec4 clipped[MAX_CLIPPED_VERTICES];
+    polygon[0] = v0;
+    polygon[1] = v1;
+    polygon[2] = v2;
+    int count = 3;
+    for (const Vec4& plane : CLIP_PLANES) {
+        int clippedCount = 0;
+        for (int i = 0; i < count; i++) {
+            const Vec4& current = polygon[i];
+            const Vec4& next = polygon[(i + 1) % count];
+            float d0 = Vec4::dot(plane, current);
+            float d1 = Vec4::dot(plane, next);
+            if (d0 >= 0.0f) clipped[clippedCount++] = current;
+            if ((d0 >= 0.0f) != (d1 >= 0.0f)) {
+                clipped[clippedCount++] = current + (next - current) * (d0 / (d0 - d1));
+            }
+        }
+        count = clippedCount;
+        if (count < 3) return;
+        std::copy(clipped, clipped + count, polygon);
+    }
+    
+    Vec3 first = toScreen(polygon[0]);
+    Vec3 previous = toScreen(polygon[1]);
+    for (int i = 2; i < count; i++) {
+        Vec3 current = toScreen(polygon[i]);
+        addScreenTriangle(first, previous, current, color, blend, doubleSided, batch);
+        previous = current;
+    }
+}
+
+void SoftwareRasterizer::addScreenTriangle(const Vec3& v0, const Vec3& v1, const Vec3& v2, uint32_t color,
+                                           bool blend, bool doubleSided, Batch& batch) const {
+    // Counter-clockwise in NDC is clockwise on screen, where y points down,
+    // so front faces have a negative area here
+    Vec3 p0 = v0, p1 = v1, p2 = v2;
+    float area = (p1.x - p0.x) * (p2.y - p0.y) - (p2.x - p0.x) * (p1.y - p0.y);
+    if (!(area != 0.0f) || !std::isfinite(area)) return;
+    if (area > 0.0f) {
+        if (!doubleSided) return;
+        std::swap(p1, p2);
+        area = -area;
+    }
+    
+    // Pixel centres (x + 0.5, y + 0.5) inside the bounding box
+    Triangle triangle;
+    triangle.minX = std::max(0, static_cast<int>(std::ceil(std::min({ p0.x, p1.x, p2.x }) - 0.5f)));
+    triangle.minY = std::max(0, static_cast<int>(std::ceil(std::min({ p0.y, p1.y, p2.y }) - 0.5f)));
+    triangle.maxX = std::min(settings.width - 1, static_cast<int>(std::floor(std::max({ p0.x, p1.x, p2.x }) - 0.5f)));
+    triangle.maxY = std::min(settings.height - 1, static_cast<int>(std::floor(std::max({ p0.y, p1.y, p2.y }) - 0.5f)));
+    if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) return;
+    
+    // Edge i runs from corner i to corner i + 1 and is positive inside. A
+    // shared edge is walked in opposite directions by its two triangles, so
+    // exactly one of them owns the pixels centred on it.
+    const Vec3* corners[3] = { &p0, &p1, &p2 };
+    triangle.ownsEdge = 0;
+    for (int i = 0; i < 3; i++) {
+        const Vec3& from = *corners[i];
+        const Vec3& to = *corners[(i + 1) % 3];
+        triangle.a[i] = to.y - from.y;
+        triangle.b[i] = from.x - to.x;
+        triangle.c[i] = -(triangle.a[i] * from.x + triangle.b[i] * from.y);
+        if (triangle.a[i] > 0.0f || (triangle.a[i] == 0.0f && triangle.b[i] > 0.0f)) {
+            triangle.ownsEdge |= 1 << i;
+        }
+    }
+    
+    // Window depth is linear in screen space
+    float dx1 = p1.x - p0.x, dy1 = p1.y - p0.y, dz1 = p1.z - p0.z;
+    float dx2 = p2.x - p0.x, dy2 = p2.y - p0.y, dz2 = p2.z - p0.z;
+    triangle.depthX = (dz1 * dy2 - dz2 * dy1) / area;
+    triangle.depthY = (dx1 * dz2 - dx2 * dz1) / area;
+    triangle.depthC = p0.z - triangle.depthX * p0.x - triangle.depthY * p0.y;
+    triangle.color = color;
+    triangle.blend = blend;
+    
+    uint32_t index = static_cast<uint32_t>(batch.triangles.size());
+    batch.triangles.push_back(triangle);
+    
+    int tileX0 = triangle.minX / settings.tileSize, tileX1 = triangle.maxX / settings.tileSize;
+    int tileY0 = triangle.minY / settings.tileSize, tileY1 = triangle.maxY / settings.tileSize;
+    for (int tileY = tileY0; tileY <= tileY1; tileY++) {
+        for (int tileX = tileX0; tileX <= tileX1; tileX++) {
+            batch.bins[tileY * tilesX + tileX].push_back(index);
+        }
+    }
+}
+
+void SoftwareRasterizer::rasterizeTile(int tile) {
+    int x0 = (tile % tilesX) * settings.tileSize;
+    int y0 = (tile / tilesX) * settings.tileSize;
+    int x1 = std::min(x0 + settings.tileSize, settings.width) - 1;
+    int y1 = std::min(y0 + settings.tileSize, settings.height) - 1;
+    
+    for (int y = y0; y <= y1; y++) {
+        size_t row = static_cast<size_t>(y) * settings.width;
+        std::fill(colorBuffer.begin() + row + x0, colorBuffer.begin() + row + x1 + 1, clearColor);
+        std::fill(depthBuffer.begin() + row + x0, depthBuffer.begin() + row + x1 + 1, 1.0f);
+    }
+    
+    bool simd = settings.simd && getCpuFeatures().sse2;
+    for (size_t b = 0; b < batchCount; b++) {
+        const Batch& batch = batches[b];
+        for (uint32_t index : batch.bins[tile]) {
+            const Triangle& triangle = batch.triangles[index];
+            int minX = std::max(triangle.minX, x0);
+            int minY = std::max(triangle.minY, y0);
+            int maxX = std::min(triangle.maxX, x1);
+            int maxY = std::min(triangle.maxY, y1);
+            if (simd) {
+                rasterizeSSE(triangle, minX, minY, maxX, maxY);
+            } else {
+                rasterizeScalar(triangle, minX, minY, maxX, maxY);
+            }
+        }
+    }
+}
+
+void SoftwareRasterizer::shadePixel(const Triangle& triangle, int x, int y) {
+    // Same operations, in the same order, as the SSE path
+    float px = static_cast<float>(x) + 0.5f;
+    float py = static_cast<float>(y) + 0.5f;
+    for (int i = 0; i < 3; i++) {
+        float edge = triangle.a[i] * px + (triangle.b[i] * py + triangle.c[i]);
+        if (!(edge > 0.0f || (edge == 0.0f && (triangle.ownsEdge >> i & 1)))) return;
+    }
+    
+    size_t index = static_cast<size_t>(y) * settings.width + x;
+    float depth = triangle.depthX * px + (triangle.depthY * py + triangle.depthC);
+    if (!(depth < depthBuffer[index])) return;
+    
+    depthBuffer[index] = depth;
+    colorBuffer[index] = triangle.blend ? blendColor(triangle.color, colorBuffer[index]) : triangle.color;
+}
+
+void SoftwareRasterizer::rasterizeScalar(const Triangle& triangle, int minX, int minY, int maxX, int maxY) {
+    for (int y = minY; y <= maxY; y++) {
+        for (int x = minX; x <= maxX; x++) {
+            shadePixel(triangle, x, y);
+        }
+    }
+}
+
+void SoftwareRasterizer::rasterizeSSE(const Triangle& triangle, int minX, int minY, int maxX, int maxY) {
+#ifdef FLOWER_X86
+    const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 firstCentre = _mm_set1_ps(minX + 0.5f);
+    const __m128 lastCentre = _mm_set1_ps(maxX + 0.5f);
+    const __m128 depthX = _mm_set1_ps(triangle.depthX);
+    const __m128i color = _mm_set1_epi32(static_cast<int>(triangle.color));
+    __m128 a[3], owns[3];
+    for (int i = 0; i < 3; i++) {
+        a[i] = _mm_set1_ps(triangle.a[i]);
+        owns[i] = _mm_castsi128_ps(_mm_set1_epi32((triangle.ownsEdge >> i & 1) ? -1 : 0));
+    }
+    
+    // Groups of four start on multiples of 4, so tiles (a multiple of 4
+    // wide) never split one; only the right edge of the screen can
+    int groupStart = minX & ~3;
+    for (int y = minY; y <= maxY; y++) {
+        float py = static_cast<float>(y) + 0.5f;
+        __m128 rowEdge[3];
+        for (int i = 0; i < 3; i++) {
+            rowEdge[i] = _mm_set1_ps(triangle.b[i] * py + triangle.c[i]);
+        }
+        __m128 rowDepth = _mm_set1_ps(triangle.depthY * py + triangle.depthC);
+        size_t row = static_cast<size_t>(y) * settings.width;
+        
+        for (int x = groupStart; x <= maxX; x += 4) {
+            if (x + 4 > settings.width) {
+                for (int column = std::max(x, minX); column <= maxX; column++) {
+                    shadePixel(triangle, column, y);
+                }
+                break;
+            }
+            
+            __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets);
+            __m128 inside = _mm_and_ps(_mm_cmpge_ps(px, firstCentre), _mm_cmple_ps(px, lastCentre));
+            for (int i = 0; i < 3; i++) {
+                __m128 edge = _mm_add_ps(_mm_mul_ps(a[i], px), rowEdge[i]);
+                __m128 covered = _mm_or_ps(_mm_cmpgt_ps(edge, zero), _mm_and_ps(_mm_cmpeq_ps(edge, zero), owns[i]));
+                inside = _mm_and_ps(inside, covered);
+            }
+            if (_mm_movemask_ps(inside) == 0) continue;
+            
+            float* depthPixels = &depthBuffer[row + x];
+            __m128 depth = _mm_add_ps(_mm_mul_ps(depthX, px), rowDepth);
+            __m128 stored = _mm_loadu_ps(depthPixels);
+            __m128 pass = _mm_and_ps(inside, _mm_cmplt_ps(depth, stored));
+            int passMask = _mm_movemask_ps(pass);
+            if (passMask == 0) continue;
+            
+            if (triangle.blend) {
+                for (int lane = 0; lane < 4; lane++) {
+                    if (passMask >> lane & 1) shadePixel(triangle, x + lane, y);
+                }
+                continue;
+            }
+            
+            _mm_storeu_ps(depthPixels, _mm_or_ps(_mm_and_ps(pass, depth), _mm_andnot_ps(pass, stored)));
+            __m128i* colorPixels = reinterpret_cast<__m128i*>(&colorBuffer[row + x]);
+            __m128i passBits = _mm_castps_si128(pass);
+            __m128i previous = _mm_loadu_si128(colorPixels);
+            _mm_storeu_si128(colorPixels, _mm_or_si128(_mm_and_si128(passBits, color), _mm_andnot_si128(passBits, previous)));
+        }
+    }
+#else
+    rasterizeScalar(triangle, minX, minY, maxX, maxY);
+#endif
+}
+
+bool SoftwareRasterizer::saveImage(const std::string& path) const {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cerr << "Failed to create image file: " << path << std::endl;
+        return false;
+    }
+    
+    file << "P6\n" << settings.width << " " << settings.height << "\n255\n";
+    std::vector<uint8_t> rgb(colorBuffer.size() * 3);
+    for (size_t i = 0; i < colorBuffer.size(); i++) {
+        rgb[i * 3] = static_cast<uint8_t>(colorBuffer[i]);
+        rgb[i * 3 + 1] = static_cast<uint8_t>(colorBuffer[i] >> 8);
+        rgb[i * 3 + 2] = static_cast<uint8_t>(colorBuffer[i] >> 16);
+    }
+    file.write(reinterpret_cast<const char*>(rgb.data()), rgb.size());
+    if (!file) {
+        std::cerr << "Failed to write image file: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool SoftwareRasterizer::runBenchmark(const char* imagePath) {
+    const int WORLD_SIDE = 128;
+    const int FRAMES = 10;
+    
+    // A flower field on hills, recorded the way Engine::renderWorld does
+    World world(WORLD_SIDE, WORLD_SIDE);
+    world.generateHillyTerrain(4.0f, 0.08f);
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (int z = 0; z < WORLD_SIDE; z++) {
+        for (int x = 0; x < WORLD_SIDE; x++) {
+            if (unit(rng) < 0.3f) world.setCell(x, z, World::CellType::FLOWER);
+        }
+    }
+    
+    RenderScene scene;
+    Vec3 eye(WORLD_SIDE * 0.5f, 12.0f, -4.0f);
+    scene.setCamera(Mat4::lookAt(eye, Vec3(WORLD_SIDE * 0.5f, 0.0f, WORLD_SIDE * 0.4f), Vec3::up()),
+                    Mat4::perspective(60.0f, 800.0f / 600.0f, 0.1f, 100.0f));
+    for (int i = 0; i <= WORLD_SIDE; i += 5) {
+        scene.addLine(Vec3(i, 0.01f, 0), Vec3(i, 0.01f, WORLD_SIDE), Color(0.2f, 0.5f, 0.2f));
+        scene.addLine(Vec3(0, 0.01f, i), Vec3(WORLD_SIDE, 0.01f, i), Color(0.2f, 0.5f, 0.2f));
+    }
+    for (int z = 0; z < WORLD_SIDE; z++) {
+        for (int x = 0; x < WORLD_SIDE; x++) {
+            Vec3 cellPos(x + 0.5f, world.getTerrainHeight(x, z), z + 0.5f);
+            World::CellType cell = world.getCellType(x, z);
+            scene.addCube(cellPos, World::getCellTypeColor(cell), 1.0f);
+            if (cell == World::CellType::FLOWER) {
+                scene.addFlower(cellPos + Vec3(0.0f, 0.5f, 0.0f),
+                                World::getFlowerSpeciesColor(World::getFlowerSpecies(x, z)), 0.3f);
+            }
+        }
+    }
+    
+    typedef std::chrono::steady_clock Clock;
+    auto timeFrames = [&](SoftwareRasterizer& rasterizer) {
+        rasterizer.render(scene);
+        Clock::time_point start = Clock::now();
+        for (int frame = 0; frame < FRAMES; frame++) {
+            rasterizer.render(scene);
+        }
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count() / FRAMES;
+    };
+    
+    SoftwareRasterizer fast;
+    Settings scalarSettings;
+    scalarSettings.simd = false;
+    SoftwareRasterizer reference(scalarSettings);
+    double fastMs = timeFrames(fast);
+    double referenceMs = timeFrames(reference);
+    
+    size_t mismatches = 0;
+    size_t covered = 0;
+    for (size_t i = 0; i < fast.colorBuffer.size(); i++) {
+        if (fast.colorBuffer[i] != reference.colorBuffer[i] || fast.depthBuffer[i] != reference.depthBuffer[i]) {
+            mismatches++;
+        }
+        if (fast.depthBuffer[i] < 1.0f) covered++;
+    }
+    
+    bool passed = mismatches == 0 && covered > 0;
+    if (imagePath && !fast.saveImage(imagePath)) passed = false;
+    
+    std::cout << "Software rasterizer: " << fast.getWidth() << "x" << fast.getHeight() << ", "
+              << scene.getInstances().size() << " instances, " << scene.getLines().size() << " lines, "
+              << fast.getTriangleCount() << " triangles binned, "
+              << JobSystem::instance().getWorkerCount() + 1 << " threads" << std::endl;
+    std::cout << "  SSE      " << fastMs << " ms/frame (" << 1000.0 / fastMs << " fps)" << std::endl;
+    std::cout << "  scalar   " << referenceMs << " ms/frame" << std::endl;
+    std::cout << "  covered pixels     " << covered << std::endl;
+    std::cout << "  mismatched pixels  " << mismatches << (passed ? "" : "  FAILED") << std::endl;
+    return passed;
+}
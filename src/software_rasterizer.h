@@ -0,0 +1,118 @@
+#pragma once
+
+#include "render_scene.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// SoftwareRasterizer renders a RenderScene into a CPU depth and colour
+// framebuffer, for machines without a GPU: headless benchmarks, photo
+// capture and image comparisons.
+//
+// A frame runs in two parallel passes on the JobSystem. Setup transforms
+// batches of instances and lines to clip space, clips them against the near
+// plane and a guard band, and bins each screen triangle into the square
+// tiles its bounding box touches. Rasterization then gives each job one
+// tile; it walks the tile's bins in submission order and tests four pixels
+// at a time against the triangle's edge functions and the depth buffer
+// (SSE where available). Tiles never share pixels, so no locking is needed
+// and the image does not depend on the number of threads.
+//
+// Like the OpenGL path: depth test GL_LESS with depth writes, alpha blending
+// for colours with alpha below 1, flat colour per instance, back faces of
+// closed meshes culled (OpenGL hides them with the depth test instead).
+class SoftwareRasterizer {
+public:
+    struct Settings {
+        int width;
+        int height;
+        int tileSize;     // Side of the square tiles rasterized as one job; multiple of 4
+        int batchSize;    // Instances (or lines) set up per job
+        bool simd;        // Off to run the scalar reference path
+        
+        Settings()
+            : width(800)
+            , height(600)
+            , tileSize(64)
+            , batchSize(256)
+            , simd(true)
+        {}
+    };
+    
+    explicit SoftwareRasterizer(const Settings& settings = Settings());
+    
+    void render(const RenderScene& scene);
+    
+    int getWidth() const { return settings.width; }
+    int getHeight() const { return settings.height; }
+    
+    // RGBA8 pixels with red in the lowest byte, top row first
+    const std::vector<uint32_t>& getColorBuffer() const { return colorBuffer; }
+    
+    // Window depth in [0, 1] as in OpenGL; 1 where nothing was drawn
+    const std::vector<float>& getDepthBuffer() const { return depthBuffer; }
+    
+    // Triangles binned in the last frame, after culling and clipping
+    size_t getTriangleCount() const;
+    
+    // Writes the colour buffer as a binary PPM image
+    bool saveImage(const std::string& path) const;
+    
+    // Renders a hilly flower field with the SSE and scalar paths, checks the
+    // images match and prints frame times. Saves the image when 'imagePath'
+    // is not null.
+    static bool runBenchmark(const char* imagePath);
+
+private:
+    // Screen-space triangle, set up for rasterization. Edge i is inside
+    // where a[i] * x + (b[i] * y + c[i]) is positive, or zero on an edge
+    // that owns its pixels (ownsEdge bit i).
+    struct Triangle {
+        float a[3];
+        float b[3];
+        float c[3];
+        float depthX;     // Depth at (x, y) is depthX * x + (depthY * y + depthC)
+        float depthY;
+        float depthC;
+        int minX, minY, maxX, maxY;   // Inclusive pixel bounds
+        uint32_t color;
+        uint8_t ownsEdge;
+        bool blend;
+    };
+    
+    // Output of one setup job; bins[tile] lists its triangles in that tile
+    struct Batch {
+        std::vector<Triangle> triangles;
+        std::vector<std::vector<uint32_t>> bins;
+    };
+    
+    void setupLines(const RenderScene& scene, const Mat4& viewProjection, size_t first, size_t last, Batch& batch) const;
+    void setupInstances(const RenderScene& scene, const Mat4& viewProjection, size_t first, size_t last, Batch& batch) const;
+    void setupTriangles(const RenderScene& scene, const Mat4& viewProjection, size_t first, size_t last, Batch& batch) const;
+    
+    // Clips a clip-space triangle and adds the pieces that stay on screen
+    void addClipTriangle(const Vec4& v0, const Vec4& v1, const Vec4& v2, uint32_t color, bool blend,
+                         bool doubleSided, Batch& batch) const;
+    Vec3 toScreen(const Vec4& clip) const;
+    
+    // Sets up and bins a screen-space triangle (x, y in pixels, z window depth)
+    void addScreenTriangle(const Vec3& v0, const Vec3& v1, const Vec3& v2, uint32_t color, bool blend,
+                           bool doubleSided, Batch& batch) const;
+    
+    void rasterizeTile(int tile);
+    void rasterizeScalar(const Triangle& triangle, int minX, int minY, int maxX, int maxY);
+    void rasterizeSSE(const Triangle& triangle, int minX, int minY, int maxX, int maxY);
+    
+    // Coverage, depth test and write for one pixel
+    void shadePixel(const Triangle& triangle, int x, int y);
+    
+    Settings settings;
+    int tilesX;
+    int tilesY;
+    uint32_t clearColor;
+    
+    std::vector<uint32_t> colorBuffer;
+    std::vector<float> depthBuffer;
+    std::vector<Batch> batches;
+    size_t batchCount;
+};
@@ -0,0 +1,305 @@
+#include "streaming_world.h"
+#include "logger.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+
+StreamingWorld::StreamingWorld(World& world, const Settings& settings)
+    : world(world)
+    , settings(settings)
+    , generator(settings.terrain)
+    , stopping(false)
+{
+    if (!this->settings.saveDirectory.empty()) {
+        std::error_code error;
+        std::filesystem::create_directories(this->settings.saveDirectory, error);
+        if (error) {
+            LOG_ERROR("Failed to create chunk directory {}: {}", this->settings.saveDirectory, error.message());
+        }
+    }
+    
+    world.addListener(this);
+    
+    unsigned threadCount = std::max(1u, this->settings.loaderThreads);
+    for (unsigned i = 0; i < threadCount; i++) {
+        loaders.emplace_back(&StreamingWorld::loaderLoop, this);
+    }
+}
+
+StreamingWorld::~StreamingWorld() {
+    world.removeListener(this);
+    if (!heldEdits.empty()) {
+        LOG_WARNING("Dropped edits to {} chunks that never finished loading", heldEdits.size());
+    }
+    
+    saveAll();
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+        loadQueue.clear();
+    }
+    queueChanged.notify_all();
+    
+    // Loaders drain pending writes before they exit
+    for (auto& loader : loaders) {
+        loader.join();
+    }
+}
+
+void StreamingWorld::update(const Vec3& focus) {
+    // Page in chunks the loaders have finished
+    std::vector<LoadedChunk> arrived;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        arrived.swap(finishedLoads);
+    }
+    for (auto& loaded : arrived) {
+        inFlight.erase(loaded.key);
+        if (resident.count(loaded.key)) continue;
+        
+        world.pageInChunk(loaded.key.x, loaded.key.z, std::move(loaded.chunk));
+        lru.push_front(loaded.key);
+        resident[loaded.key] = lru.begin();
+        
+        // Resident now, so the replayed edits are not held again
+        auto held = heldEdits.find(loaded.key);
+        if (held != heldEdits.end()) {
+            std::vector<HeldEdit> edits = std::move(held->second);
+            heldEdits.erase(held);
+            for (const HeldEdit& edit : edits) {
+                if (edit.isHeight) {
+                    world.setTerrainHeight(edit.x, edit.z, edit.height);
+                } else {
+                    world.setCell(edit.x, edit.z, edit.type);
+                }
+            }
+        }
+    }
+    
+    // Chunks inside the load radius and the world, nearest first
+    int chunksX = (world.getWidth() + TerrainChunk::SIZE - 1) / TerrainChunk::SIZE;
+    int chunksZ = (world.getHeight() + TerrainChunk::SIZE - 1) / TerrainChunk::SIZE;
+    int focusX = static_cast<int>(std::floor(focus.x / TerrainChunk::SIZE));
+    int focusZ = static_cast<int>(std::floor(focus.z / TerrainChunk::SIZE));
+    int radius = std::max(0, settings.loadRadius);
+    
+    std::vector<std::pair<int, ChunkKey>> missing;
+    for (int dz = -radius; dz <= radius; dz++) {
+        for (int dx = -radius; dx <= radius; dx++) {
+            int distanceSquared = dx * dx + dz * dz;
+            if (distanceSquared > radius * radius) continue;
+            
+            ChunkKey key(focusX + dx, focusZ + dz);
+            if (key.x < 0 || key.z < 0 || key.x >= chunksX || key.z >= chunksZ) continue;
+            
+            auto it = resident.find(key);
+            if (it != resident.end()) {
+                lru.splice(lru.begin(), lru, it->second);
+            } else {
+                missing.emplace_back(distanceSquared, key);
+            }
+        }
+    }
+    std::sort(missing.begin(), missing.end(),
+              [](const std::pair<int, ChunkKey>& a, const std::pair<int, ChunkKey>& b) {
+                  return a.first < b.first;
+              });
+    
+    // Rebuild the load queue so requests that fell out of range are dropped
+    // and the closest chunks always come first
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        for (const ChunkKey& key : loadQueue) {
+            inFlight.erase(key);
+        }
+        loadQueue.clear();
+        for (const auto& request : missing) {
+            if (inFlight.insert(request.second).second) {
+                loadQueue.push_back(request.second);
+            }
+        }
+    }
+    if (!missing.empty()) {
+        queueChanged.notify_all();
+    }
+    
+    // Page out least recently used chunks outside the radius while over budget
+    auto inRange = [&](const ChunkKey& key) {
+        int dx = key.x - focusX;
+        int dz = key.z - focusZ;
+        return dx * dx + dz * dz <= radius * radius;
+    };
+    
+    auto candidate = lru.end();
+    while (getMemoryUsage() > settings.memoryBudget && candidate != lru.begin()) {
+        --candidate;
+        if (inRange(*candidate)) continue;
+        
+        ChunkKey key = *candidate;
+        std::unique_ptr<TerrainChunk> chunk = world.pageOutChunk(key.x, key.z);
+        if (chunk && chunk->dirty) {
+            queueWrite(key, std::move(chunk));
+        }
+        resident.erase(key);
+        candidate = lru.erase(candidate);
+    }
+}
+
+bool StreamingWorld::isResident(int x, int z) const {
+    if (x < 0 || z < 0) return false;
+    return resident.count(ChunkKey(x / TerrainChunk::SIZE, z / TerrainChunk::SIZE)) != 0;
+}
+
+void StreamingWorld::saveAll() {
+    for (const auto& entry : resident) {
+        // Writers get a copy so the paged-in chunk stays editable
+        std::unique_ptr<TerrainChunk> copy = world.copyDirtyChunk(entry.first.x, entry.first.z);
+        if (copy) {
+            queueWrite(entry.first, std::move(copy));
+        }
+    }
+}
+
+void StreamingWorld::onCellChanged(int x, int z, World::CellType type) {
+    HeldEdit edit = {x, z, false, type, 0.0f};
+    holdEdit(edit);
+}
+
+void StreamingWorld::onTerrainHeightChanged(int x, int z, float height) {
+    HeldEdit edit = {x, z, true, World::CellType::GRASS, height};
+    holdEdit(edit);
+}
+
+void StreamingWorld::onTerrainReset() {
+    // The whole terrain was replaced, including the placeholders edits went to
+    heldEdits.clear();
+}
+
+void StreamingWorld::holdEdit(const HeldEdit& edit) {
+    if (isResident(edit.x, edit.z)) return;
+    heldEdits[ChunkKey(edit.x / TerrainChunk::SIZE, edit.z / TerrainChunk::SIZE)].push_back(edit);
+}
+
+size_t StreamingWorld::getMemoryUsage() const {
+    return resident.size() * (sizeof(TerrainChunk) + sizeof(ChunkKey) * 2 + sizeof(std::list<ChunkKey>::iterator));
+}
+
+void StreamingWorld::queueWrite(const ChunkKey& key, std::unique_ptr<TerrainChunk> chunk) {
+    if (settings.saveDirectory.empty()) return;
+    
+    std::shared_ptr<TerrainChunk> snapshot(std::move(chunk));
+    snapshot->dirty = false;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        writesInProgress[key] = snapshot;
+        writeQueue.push_back(key);
+    }
+    queueChanged.notify_one();
+}
+
+std::string StreamingWorld::chunkPath(const ChunkKey& key) const {
+    return settings.saveDirectory + "/chunk_" + std::to_string(key.x) + "_" + std::to_string(key.z) + ".bin";
+}
+
+void StreamingWorld::loaderLoop() {
+    for (;;) {
+        bool isWrite = false;
+        ChunkKey key;
+        std::shared_ptr<TerrainChunk> snapshot;
+        {
+            // Writes go first so reloads and shutdown see the latest data.
+            // Work on a chunk another loader is busy with waits its turn.
+            std::unique_lock<std::mutex> lock(queueMutex);
+            for (;;) {
+                if (takeWork(writeQueue, key)) {
+                    isWrite = true;
+                    snapshot = writesInProgress[key];
+                    break;
+                }
+                if (takeWork(loadQueue, key)) break;
+                if (stopping && writeQueue.empty()) return;
+                queueChanged.wait(lock);
+            }
+            busyKeys.insert(key);
+        }
+        
+        std::unique_ptr<TerrainChunk> chunk;
+        if (isWrite) {
+            if (!snapshot->saveToFile(chunkPath(key))) {
+                LOG_ERROR("Failed to write chunk {}, {}", key.x, key.z);
+            }
+        } else {
+            chunk = produceChunk(key);
+        }
+        
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            busyKeys.erase(key);
+            if (isWrite) {
+                auto it = writesInProgress.find(key);
+                if (it != writesInProgress.end() && it->second == snapshot) {
+                    writesInProgress.erase(it);
+                }
+            } else {
+                finishedLoads.push_back({key, std::move(chunk)});
+            }
+        }
+        
+        // Work held back for this chunk may go ahead now
+        queueChanged.notify_all();
+    }
+}
+
+bool StreamingWorld::takeWork(std::deque<ChunkKey>& queue, ChunkKey& key) {
+    for (auto it = queue.begin(); it != queue.end(); ++it) {
+        if (busyKeys.count(*it)) continue;
+        key = *it;
+        queue.erase(it);
+        return true;
+    }
+    return false;
+}
+
+std::unique_ptr<TerrainChunk> StreamingWorld::produceChunk(const ChunkKey& key) {
+    // A chunk evicted moments ago may still be waiting for its write
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        auto it = writesInProgress.find(key);
+        if (it != writesInProgress.end()) {
+            return std::unique_ptr<TerrainChunk>(new TerrainChunk(*it->second));
+        }
+    }
+    
+    std::unique_ptr<TerrainChunk> chunk(new TerrainChunk());
+    if (!settings.saveDirectory.empty()) {
+        std::string path = chunkPath(key);
+        std::error_code error;
+        if (std::filesystem::exists(path, error)) {
+            if (chunk->loadFromFile(path)) return chunk;
+            LOG_WARNING("Corrupt chunk file {}, regenerating", path);
+        }
+    }
+    
+    generateChunk(key, *chunk);
+    return chunk;
+}
+
+void StreamingWorld::generateChunk(const ChunkKey& key, TerrainChunk& chunk) const {
+    // One extra cell on every side so border normals match the neighbours
+    const int paddedSize = TerrainChunk::SIZE + 2;
+    std::vector<float> padded(paddedSize * paddedSize);
+    generator.generateBlock(key.x * TerrainChunk::SIZE - 1, key.z * TerrainChunk::SIZE - 1,
+                            paddedSize, paddedSize, padded.data(), paddedSize);
+    
+    for (int lz = 0; lz < TerrainChunk::SIZE; lz++) {
+        const float* row = padded.data() + (lz + 1) * paddedSize;
+        for (int lx = 0; lx < TerrainChunk::SIZE; lx++) {
+            int idx = TerrainChunk::index(lx, lz);
+            chunk.heights[idx] = row[lx + 1];
+            chunk.types[idx] = static_cast<uint8_t>(World::classifyHeight(row[lx + 1]));
+        }
+        packHeightfieldNormalsRow(row - paddedSize, row, row + paddedSize, paddedSize,
+                                  1, TerrainChunk::SIZE, chunk.normals + lz * TerrainChunk::SIZE);
+    }
+    chunk.dirty = false;
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "math_utils.h"
+#include "terrain_chunk.h"
+#include "terrain_generator.h"
+#include "world.h"
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// StreamingWorld pages the terrain of a large World in and out around a
+// focus point (the player). Chunks are loaded or generated on background
+// threads and installed into the World's own chunk table, so gameplay,
+// collision, rendering and the terrain caches read streamed terrain through
+// the World like any other. Paged-in chunks are kept in an LRU bounded by a
+// memory budget; edited chunks are written back to disk when paged out and
+// reloaded later. Nothing on the frame thread ever waits for I/O or
+// generation: chunks that have not arrived yet read as flat grass. Edits
+// made to them are held and replayed onto the chunk when it arrives.
+//
+// The World keeps its size, so the streamed area is bounded by it; only
+// memory use is bounded by the load radius and budget.
+//
+// Loader threads never work on the same chunk at once, so a chunk file is
+// never written by two threads or read while it is being written.
+class StreamingWorld : public WorldListener {
+public:
+    struct Settings {
+        TerrainGenerator::Settings terrain;
+        int loadRadius;              // Chunks kept around the focus, in chunks
+        size_t memoryBudget;         // Paged-in chunk memory in bytes before the LRU evicts
+        std::string saveDirectory;   // Where edited chunks are written (empty = discard edits)
+        unsigned loaderThreads;      // Background threads for loading and writing
+        
+        Settings()
+            : loadRadius(4)
+            , memoryBudget(2 * 1024 * 1024)
+            , loaderThreads(1)
+        {}
+    };
+    
+    // The world must outlive the StreamingWorld
+    StreamingWorld(World& world, const Settings& settings);
+    ~StreamingWorld();
+    
+    StreamingWorld(const StreamingWorld&) = delete;
+    StreamingWorld& operator=(const StreamingWorld&) = delete;
+    
+    // Called once per frame: queues loads around the focus, pages in chunks
+    // that finished loading and pages out least recently used ones over budget
+    void update(const Vec3& focus);
+    
+    // Whether the chunk holding cell (x, z) has been paged in
+    bool isResident(int x, int z) const;
+    
+    // Queue every edited paged-in chunk for writing
+    void saveAll();
+    
+    size_t getResidentChunkCount() const { return resident.size(); }
+    size_t getPendingLoadCount() const { return inFlight.size(); }
+    size_t getMemoryUsage() const;
+    
+    const Settings& getSettings() const { return settings; }
+    
+    // WorldListener
+    void onCellChanged(int x, int z, World::CellType type) override;
+    void onTerrainHeightChanged(int x, int z, float height) override;
+    void onTerrainReset() override;
+
+private:
+    struct ChunkKey {
+        int x;
+        int z;
+        
+        ChunkKey() : x(0), z(0) {}
+        ChunkKey(int x, int z) : x(x), z(z) {}
+        
+        bool operator==(const ChunkKey& other) const { return x == other.x && z == other.z; }
+    };
+    
+    struct ChunkKeyHash {
+        size_t operator()(const ChunkKey& key) const {
+            return static_cast<size_t>(static_cast<uint32_t>(key.x)) * 73856093u ^
+                   static_cast<size_t>(static_cast<uint32_t>(key.z)) * 19349663u;
+        }
+    };
+    
+    struct LoadedChunk {
+        ChunkKey key;
+        std::unique_ptr<TerrainChunk> chunk;
+    };
+    
+    // An edit made before its chunk was paged in
+    struct HeldEdit {
+        int x;
+        int z;
+        bool isHeight;         // Height edit, otherwise a cell type edit
+        World::CellType type;
+        float height;
+    };
+    
+    void holdEdit(const HeldEdit& edit);
+    
+    // Background side
+    void loaderLoop();
+    bool takeWork(std::deque<ChunkKey>& queue, ChunkKey& key);
+    std::unique_ptr<TerrainChunk> produceChunk(const ChunkKey& key);
+    void generateChunk(const ChunkKey& key, TerrainChunk& chunk) const;
+    std::string chunkPath(const ChunkKey& key) const;
+    void queueWrite(const ChunkKey& key, std::unique_ptr<TerrainChunk> chunk);
+    
+    World& world;
+    Settings settings;
+    TerrainGenerator generator;
+    
+    // Frame-thread state
+    std::unordered_map<ChunkKey, std::list<ChunkKey>::iterator, ChunkKeyHash> resident;  // Position in lru
+    std::list<ChunkKey> lru;                                   // Front = most recently used
+    std::unordered_set<ChunkKey, ChunkKeyHash> inFlight;       // Queued or loading
+    std::unordered_map<ChunkKey, std::vector<HeldEdit>, ChunkKeyHash> heldEdits;  // Replayed on page-in
+    
+    // Shared with loader threads (guarded by queueMutex)
+    std::mutex queueMutex;
+    std::condition_variable queueChanged;
+    std::deque<ChunkKey> loadQueue;
+    std::deque<ChunkKey> writeQueue;
+    std::unordered_map<ChunkKey, std::shared_ptr<TerrainChunk>, ChunkKeyHash> writesInProgress;
+    std::unordered_set<ChunkKey, ChunkKeyHash> busyKeys;      // Chunks a loader is working on
+    std::vector<LoadedChunk> finishedLoads;
+    bool stopping;
+    
+    std::vector<std::thread> loaders;
+};
@@ -0,0 +1,108 @@
+#include "terrain_chunk.h"
+#include "cpu_features.h"
+#include "file_sync.h"
+#include "math_utils.h"
+#include <algorithm>
+#include <fstream>
+
+namespace {
+
+const uint32_t CHUNK_FILE_MAGIC = 0x4B484346;  // "FCHK"
+const uint32_t CHUNK_FILE_VERSION = 1;
+
+}  // namespace
+
+TerrainChunk::TerrainChunk(uint8_t type, float height)
+    : dirty(false)
+{
+    uint16_t up = MathUtils::packNormalOct(Vec3::up());
+    std::fill(types, types + CELL_COUNT, type);
+    std::fill(heights, heights + CELL_COUNT, height);
+    std::fill(normals, normals + CELL_COUNT, up);
+}
+
+bool TerrainChunk::saveToFile(const std::string& path) const {
+    // Written beside the old file and renamed over it, so a crash leaves
+    // one or the other intact
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file) return false;
+        
+        uint32_t header[3] = {CHUNK_FILE_MAGIC, CHUNK_FILE_VERSION, static_cast<uint32_t>(SIZE)};
+        file.write(reinterpret_cast<const char*>(header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(types), sizeof(types));
+        file.write(reinterpret_cast<const char*>(heights), sizeof(heights));
+        file.write(reinterpret_cast<const char*>(normals), sizeof(normals));
+        file.close();
+        if (!file) return false;
+    }
+    return FileSync::replaceFile(tempPath, path);
+}
+
+bool TerrainChunk::loadFromFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    
+    uint32_t header[3] = {0, 0, 0};
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!file || header[0] != CHUNK_FILE_MAGIC || header[1] != CHUNK_FILE_VERSION ||
+        header[2] != static_cast<uint32_t>(SIZE)) {
+        return false;
+    }
+    
+    file.read(reinterpret_cast<char*>(types), sizeof(types));
+    file.read(reinterpret_cast<char*>(heights), sizeof(heights));
+    file.read(reinterpret_cast<char*>(normals), sizeof(normals));
+    dirty = false;
+    return static_cast<bool>(file);
+}
+
+void packHeightfieldNormalsRow(const float* back, const float* row, const float* forward,
+                               int width, int x0, int x1, uint16_t* out) {
+    int x = x0;
+    
+    // Edge column needs clamped neighbours
+    if (x == 0 && x <= x1) {
+        out[0] = MathUtils::packHeightfieldNormal(row[0], width > 1 ? row[1] : row[0], back[0], forward[0]);
+        x++;
+    }
+    
+    int interiorEnd = std::min(x1, width - 2);
+    
+#ifdef FLOWER_X86
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 scale = _mm_set1_ps(127.0f);
+    const __m128i bias = _mm_set1_epi32(127);
+    const __m128i packBias = _mm_set1_epi32(32768);
+    const __m128i unpackBias = _mm_set1_epi16(static_cast<short>(0x8000));
+    
+    for (; x + 3 <= interiorEnd; x += 4) {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(row + x + 1), _mm_loadu_ps(row + x - 1));
+        __m128 dz = _mm_sub_ps(_mm_loadu_ps(forward + x), _mm_loadu_ps(back + x));
+        __m128 l1 = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(signMask, dx), two),
+                               _mm_andnot_ps(signMask, dz));
+        __m128 factor = _mm_div_ps(scale, l1);
+        
+        // Negate through the sign bit, then round to nearest
+        __m128i qu = _mm_add_epi32(_mm_cvtps_epi32(_mm_mul_ps(_mm_xor_ps(dx, signMask), factor)), bias);
+        __m128i qv = _mm_add_epi32(_mm_cvtps_epi32(_mm_mul_ps(_mm_xor_ps(dz, signMask), factor)), bias);
+        __m128i packed = _mm_or_si128(qu, _mm_slli_epi32(qv, 8));
+        
+        // SSE2 only has a signed 32->16 pack, so bias into signed range and back
+        packed = _mm_packs_epi32(_mm_sub_epi32(packed, packBias), _mm_sub_epi32(packed, packBias));
+        packed = _mm_xor_si128(packed, unpackBias);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + (x - x0)), packed);
+    }
+#endif
+    
+    for (; x <= interiorEnd; x++) {
+        out[x - x0] = MathUtils::packHeightfieldNormal(row[x - 1], row[x + 1], back[x], forward[x]);
+    }
+    
+    // Last column (when it is not also the first)
+    if (x <= x1 && x == width - 1) {
+        out[x - x0] = MathUtils::packHeightfieldNormal(row[x - 1], row[x], back[x], forward[x]);
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// TerrainChunk is a square block of terrain planes in the same layout the
+// World uses: a type byte, a float height and an octahedral-packed normal
+// per cell, row-major with SIZE cells on a side.
+struct TerrainChunk {
+    static const int SIZE = 32;
+    static const int CELL_COUNT = SIZE * SIZE;
+    
+    uint8_t types[CELL_COUNT];
+    float heights[CELL_COUNT];
+    uint16_t normals[CELL_COUNT];
+    bool dirty;  // Edited since it was loaded or generated
+    
+    // Flat chunk filled with one cell type
+    explicit TerrainChunk(uint8_t type = 0, float height = 0.0f);
+    
+    static int index(int localX, int localZ) { return localZ * SIZE + localX; }
+    
+    // Chunk files hold the raw planes behind a small header. Saving writes a
+    // temporary file, syncs it and renames it over the old one.
+    bool saveToFile(const std::string& path) const;
+    bool loadFromFile(const std::string& path);
+};
+
+// Recomputes packed normals for cells [x0, x1] of one row of a heightfield
+// 'width' cells wide. 'back' and 'forward' are the neighbouring rows, already
+// clamped to 'row' at the edges; the first and last column clamp the same way.
+void packHeightfieldNormalsRow(const float* back, const float* row, const float* forward,
+                               int width, int x0, int x1, uint16_t* out);
@@ -0,0 +1,269 @@
+#include "terrain_generator.h"
+#include "cpu_features.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Per-octave and warp-layer seed offsets
+const uint32_t OCTAVE_SEED_STEP = 0x9E3779B9u;
+const uint32_t WARP_X_SEED = 0x68E31DA4u;
+const uint32_t WARP_Z_SEED = 0xB5297A4Du;
+const int WARP_OCTAVES = 2;
+
+// Sum of octave amplitudes, used to keep fBm in [-1, 1]
+float fbmNormalizer(int octaves, float gain) {
+    float total = 0.0f;
+    float amplitude = 1.0f;
+    for (int o = 0; o < octaves; o++) {
+        total += amplitude;
+        amplitude *= gain;
+    }
+    return total > 0.0f ? 1.0f / total : 0.0f;
+}
+
+#ifdef FLOWER_X86
+
+// 32-bit low multiply for SSE2 (SSE4.1 has _mm_mullo_epi32)
+inline __m128i mullo32(__m128i a, __m128i b) {
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+// Lattice hash mapped to [-1, 1]
+inline __m128 latticeValue(__m128i ix, __m128i iz, __m128i seed) {
+    __m128i h = _mm_xor_si128(mullo32(ix, _mm_set1_epi32(0x27D4EB2D)),
+                              mullo32(iz, _mm_set1_epi32(0x165667B1)));
+    h = _mm_xor_si128(h, seed);
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+    h = mullo32(h, _mm_set1_epi32(0x7FEB352D));
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+    h = mullo32(h, _mm_set1_epi32(static_cast<int>(0x846CA68Bu)));
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+    
+    __m128 unit = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(h, 8)), _mm_set1_ps(2.0f / 16777216.0f));
+    return _mm_sub_ps(unit, _mm_set1_ps(1.0f));
+}
+
+inline __m128 lerp4(__m128 a, __m128 b, __m128 t) {
+    return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+}
+
+// Value noise with quintic fade, four samples at once
+inline __m128 valueNoise4(__m128 x, __m128 z, __m128i seed) {
+    const __m128 one = _mm_set1_ps(1.0f);
+    
+    __m128i ix = _mm_cvttps_epi32(x);
+    __m128i iz = _mm_cvttps_epi32(z);
+    __m128 truncX = _mm_cvtepi32_ps(ix);
+    __m128 truncZ = _mm_cvtepi32_ps(iz);
+    __m128 fixX = _mm_cmpgt_ps(truncX, x);
+    __m128 fixZ = _mm_cmpgt_ps(truncZ, z);
+    ix = _mm_add_epi32(ix, _mm_castps_si128(fixX));
+    iz = _mm_add_epi32(iz, _mm_castps_si128(fixZ));
+    __m128 tx = _mm_sub_ps(x, _mm_sub_ps(truncX, _mm_and_ps(fixX, one)));
+    __m128 tz = _mm_sub_ps(z, _mm_sub_ps(truncZ, _mm_and_ps(fixZ, one)));
+    
+    // t^3 * (t * (6t - 15) + 10)
+    const __m128 six = _mm_set1_ps(6.0f);
+    const __m128 fifteen = _mm_set1_ps(15.0f);
+    const __m128 ten = _mm_set1_ps(10.0f);
+    __m128 sx = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(tx, tx), tx),
+                           _mm_add_ps(_mm_mul_ps(tx, _mm_sub_ps(_mm_mul_ps(tx, six), fifteen)), ten));
+    __m128 sz = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(tz, tz), tz),
+                           _mm_add_ps(_mm_mul_ps(tz, _mm_sub_ps(_mm_mul_ps(tz, six), fifteen)), ten));
+    
+    const __m128i oneI = _mm_set1_epi32(1);
+    __m128i ix1 = _mm_add_epi32(ix, oneI);
+    __m128i iz1 = _mm_add_epi32(iz, oneI);
+    
+    __m128 top = lerp4(latticeValue(ix, iz, seed), latticeValue(ix1, iz, seed), sx);
+    __m128 bottom = lerp4(latticeValue(ix, iz1, seed), latticeValue(ix1, iz1, seed), sx);
+    return lerp4(top, bottom, sz);
+}
+
+inline __m128 fbm4(__m128 x, __m128 z, int octaves, float lacunarity, float gain,
+                   float normalizer, uint32_t seed) {
+    __m128 sum = _mm_setzero_ps();
+    float amplitude = 1.0f;
+    float frequency = 1.0f;
+    for (int o = 0; o < octaves; o++) {
+        __m128 f = _mm_set1_ps(frequency);
+        __m128i octaveSeed = _mm_set1_epi32(static_cast<int>(seed + OCTAVE_SEED_STEP * o));
+        __m128 n = valueNoise4(_mm_mul_ps(x, f), _mm_mul_ps(z, f), octaveSeed);
+        sum = _mm_add_ps(sum, _mm_mul_ps(n, _mm_set1_ps(amplitude)));
+        amplitude *= gain;
+        frequency *= lacunarity;
+    }
+    return _mm_mul_ps(sum, _mm_set1_ps(normalizer));
+}
+
+// Heights of four cells in a row: (x0 .. x0 + 3, z)
+inline __m128 heights4(const TerrainGenerator::Settings& s, float normalizer,
+                       float warpNormalizer, int x0, int z) {
+    __m128 px = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(x0), _mm_set_epi32(3, 2, 1, 0)));
+    __m128 pz = _mm_set1_ps(static_cast<float>(z));
+    
+    if (s.warpStrength != 0.0f) {
+        __m128 wf = _mm_set1_ps(s.warpFrequency);
+        __m128 wx = _mm_mul_ps(px, wf);
+        __m128 wz = _mm_mul_ps(pz, wf);
+        __m128 offsetX = fbm4(wx, wz, WARP_OCTAVES, s.lacunarity, s.gain, warpNormalizer, s.seed ^ WARP_X_SEED);
+        __m128 offsetZ = fbm4(wx, wz, WARP_OCTAVES, s.lacunarity, s.gain, warpNormalizer, s.seed ^ WARP_Z_SEED);
+        __m128 strength = _mm_set1_ps(s.warpStrength);
+        px = _mm_add_ps(px, _mm_mul_ps(offsetX, strength));
+        pz = _mm_add_ps(pz, _mm_mul_ps(offsetZ, strength));
+    }
+    
+    __m128 f = _mm_set1_ps(s.frequency);
+    __m128 h = fbm4(_mm_mul_ps(px, f), _mm_mul_ps(pz, f), s.octaves, s.lacunarity, s.gain, normalizer, s.seed);
+    return _mm_mul_ps(h, _mm_set1_ps(s.amplitude));
+}
+
+#else
+
+inline uint32_t hash32(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    h *= 0x846CA68Bu;
+    h ^= h >> 16;
+    return h;
+}
+
+inline float latticeValue(int ix, int iz, uint32_t seed) {
+    uint32_t h = (static_cast<uint32_t>(ix) * 0x27D4EB2Du) ^ (static_cast<uint32_t>(iz) * 0x165667B1u) ^ seed;
+    h = hash32(h);
+    return static_cast<float>(h >> 8) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+inline float fade(float t) {
+    return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+inline float valueNoise(float x, float z, uint32_t seed) {
+    float floorX = std::floor(x);
+    float floorZ = std::floor(z);
+    int ix = static_cast<int>(floorX);
+    int iz = static_cast<int>(floorZ);
+    float sx = fade(x - floorX);
+    float sz = fade(z - floorZ);
+    
+    float v00 = latticeValue(ix, iz, seed);
+    float v10 = latticeValue(ix + 1, iz, seed);
+    float v01 = latticeValue(ix, iz + 1, seed);
+    float v11 = latticeValue(ix + 1, iz + 1, seed);
+    float top = v00 + (v10 - v00) * sx;
+    float bottom = v01 + (v11 - v01) * sx;
+    return top + (bottom - top) * sz;
+}
+
+inline float fbm(float x, float z, int octaves, float lacunarity, float gain,
+                 float normalizer, uint32_t seed) {
+    float sum = 0.0f;
+    float amplitude = 1.0f;
+    float frequency = 1.0f;
+    for (int o = 0; o < octaves; o++) {
+        sum += valueNoise(x * frequency, z * frequency, seed + OCTAVE_SEED_STEP * o) * amplitude;
+        amplitude *= gain;
+        frequency *= lacunarity;
+    }
+    return sum * normalizer;
+}
+
+inline float heightScalar(const TerrainGenerator::Settings& s, float normalizer,
+                          float warpNormalizer, int x, int z) {
+    float px = static_cast<float>(x);
+    float pz = static_cast<float>(z);
+    
+    if (s.warpStrength != 0.0f) {
+        float wx = px * s.warpFrequency;
+        float wz = pz * s.warpFrequency;
+        float offsetX = fbm(wx, wz, WARP_OCTAVES, s.lacunarity, s.gain, warpNormalizer, s.seed ^ WARP_X_SEED);
+        float offsetZ = fbm(wx, wz, WARP_OCTAVES, s.lacunarity, s.gain, warpNormalizer, s.seed ^ WARP_Z_SEED);
+        px += offsetX * s.warpStrength;
+        pz += offsetZ * s.warpStrength;
+    }
+    
+    return fbm(px * s.frequency, pz * s.frequency, s.octaves, s.lacunarity, s.gain, normalizer, s.seed) *
+           s.amplitude;
+}
+
+#endif
+
+}  // namespace
+
+TerrainGenerator::TerrainGenerator(const Settings& settings)
+    : settings(settings)
+{
+    this->settings.octaves = std::max(1, settings.octaves);
+}
+
+float TerrainGenerator::heightAt(int x, int z) const {
+    float height = 0.0f;
+    generateBlock(x, z, 1, 1, &height, 1);
+    return height;
+}
+
+void TerrainGenerator::generateBlock(int x0, int z0, int blockWidth, int blockHeight,
+                                     float* out, int stride) const {
+    float normalizer = fbmNormalizer(settings.octaves, settings.gain);
+    float warpNormalizer = fbmNormalizer(WARP_OCTAVES, settings.gain);
+    
+    for (int row = 0; row < blockHeight; row++) {
+        float* dest = out + static_cast<size_t>(row) * stride;
+        int z = z0 + row;
+        
+#ifdef FLOWER_X86
+        // Always evaluate whole groups of four so that a cell gets the same
+        // bits whichever block or thread computes it
+        alignas(16) float lanes[4];
+        for (int col = 0; col < blockWidth; col += 4) {
+            __m128 h = heights4(settings, normalizer, warpNormalizer, x0 + col, z);
+            if (col + 4 <= blockWidth) {
+                _mm_storeu_ps(dest + col, h);
+            } else {
+                _mm_store_ps(lanes, h);
+                for (int lane = 0; col + lane < blockWidth; lane++) {
+                    dest[col + lane] = lanes[lane];
+                }
+            }
+        }
+#else
+        for (int col = 0; col < blockWidth; col++) {
+            dest[col] = heightScalar(settings, normalizer, warpNormalizer, x0 + col, z);
+        }
+#endif
+    }
+}
+
+CounterRng::CounterRng(uint64_t seed, uint64_t stream)
+    : seed(seed)
+    , stream(stream)
+    , counter(0)
+{
+}
+
+uint64_t CounterRng::mix(uint64_t seed, uint64_t stream, uint64_t counter) {
+    // SplitMix64 finalizer over a keyed combination of the three inputs
+    uint64_t z = seed * 0x9E3779B97F4A7C15ull ^ (stream + 0x632BE59BD9B4E019ull) * 0xBF58476D1CE4E5B9ull;
+    z += counter * 0x94D049BB133111EBull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+uint32_t CounterRng::nextUInt() {
+    return static_cast<uint32_t>(mix(seed, stream, counter++) >> 32);
+}
+
+int CounterRng::nextInt(int bound) {
+    if (bound <= 0) return 0;
+    return static_cast<int>((static_cast<uint64_t>(nextUInt()) * static_cast<uint64_t>(bound)) >> 32);
+}
+
+float CounterRng::nextFloat() {
+    return static_cast<float>(nextUInt() >> 8) * (1.0f / 16777216.0f);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+
+// TerrainGenerator produces deterministic fractal heightfields: fBm value
+// noise with a layer of domain warping. Every height is a pure function of
+// the settings and the cell coordinate, so any split of the map into
+// chunks or threads reproduces exactly the same terrain for a given seed.
+class TerrainGenerator {
+public:
+    struct Settings {
+        uint32_t seed;
+        float amplitude;      // Peak height of the terrain
+        float frequency;      // Base feature frequency in cycles per cell
+        int octaves;          // Number of noise layers summed
+        float lacunarity;     // Frequency multiplier per octave
+        float gain;           // Amplitude multiplier per octave
+        float warpStrength;   // Domain warp offset in cells (0 disables warping)
+        float warpFrequency;  // Frequency of the warp field
+        
+        Settings()
+            : seed(1)
+            , amplitude(2.0f)
+            , frequency(0.1f)
+            , octaves(4)
+            , lacunarity(2.0f)
+            , gain(0.5f)
+            , warpStrength(4.0f)
+            , warpFrequency(0.05f)
+        {}
+    };
+    
+    explicit TerrainGenerator(const Settings& settings);
+    
+    const Settings& getSettings() const { return settings; }
+    
+    // Height of a single cell
+    float heightAt(int x, int z) const;
+    
+    // Fill a block of heights for cells [x0, x0 + blockWidth) x [z0, z0 + blockHeight).
+    // Row r of the block is written to out + r * stride.
+    void generateBlock(int x0, int z0, int blockWidth, int blockHeight, float* out, int stride) const;
+
+private:
+    Settings settings;
+};
+
+// CounterRng is a counter-based random stream: the n-th value of a stream is
+// a pure hash of (seed, stream, n). Giving every chunk its own stream keeps
+// results identical no matter how chunks are scheduled across threads.
+class CounterRng {
+public:
+    CounterRng(uint64_t seed, uint64_t stream);
+    
+    uint32_t nextUInt();
+    int nextInt(int bound);   // Uniform in [0, bound)
+    float nextFloat();        // Uniform in [0, 1)
+    
+    static uint64_t mix(uint64_t seed, uint64_t stream, uint64_t counter);
+
+private:
+    uint64_t seed;
+    uint64_t stream;
+    uint64_t counter;
+};
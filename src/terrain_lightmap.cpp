@@ -0,0 +1,283 @@
+#include "terrain_lightmap.h"
+#include "job_system.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <iostream>
+
+namespace {
+    // March directions, east (+X) first and west (-X) fifth
+    const int DIRECTION_COUNT = 8;
+    const int DIRECTION_X[DIRECTION_COUNT] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+    const int DIRECTION_Z[DIRECTION_COUNT] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+    const int EAST = 0;
+    const int WEST = 4;
+    
+    uint8_t quantizeUnit(float value) {
+        return static_cast<uint8_t>(std::lround(MathUtils::clamp(value, 0.0f, 1.0f) * 255.0f));
+    }
+    
+    int8_t quantizeSigned(float value) {
+        return static_cast<int8_t>(std::lround(MathUtils::clamp(value, -1.0f, 1.0f) * 127.0f));
+    }
+}
+
+TerrainLightmap::TerrainLightmap(const Settings& settings)
+    : settings(settings)
+    , world(nullptr)
+    , width(0)
+    , height(0)
+    , dirtyMinX(INT_MAX)
+    , dirtyMinZ(INT_MAX)
+    , dirtyMaxX(INT_MIN)
+    , dirtyMaxZ(INT_MIN)
+    , sunAngle(0.0f)
+    , sunX(1.0f)
+    , sunY(0.0f)
+    , ambient(settings.nightAmbient)
+{
+    setSunAngle(PI * 0.5f);
+}
+
+TerrainLightmap::~TerrainLightmap() {
+    detach();
+}
+
+void TerrainLightmap::attach(World& target) {
+    detach();
+    world = &target;
+    world->addListener(this);
+    onTerrainReset();
+    update();
+}
+
+void TerrainLightmap::detach() {
+    if (!world) return;
+    world->removeListener(this);
+    world = nullptr;
+}
+
+void TerrainLightmap::onTerrainHeightChanged(int x, int z, float /*height*/) {
+    // The edit moves the horizon of every cell that can see it
+    int reach = std::max(1, settings.horizonRadius);
+    dirtyMinX = std::min(dirtyMinX, x - reach);
+    dirtyMinZ = std::min(dirtyMinZ, z - reach);
+    dirtyMaxX = std::max(dirtyMaxX, x + reach);
+    dirtyMaxZ = std::max(dirtyMaxZ, z + reach);
+}
+
+void TerrainLightmap::onTerrainRegionChanged(int minX, int minZ, int maxX, int maxZ) {
+    int reach = std::max(1, settings.horizonRadius);
+    pagedRegions.push_back({minX - reach, minZ - reach, maxX + reach, maxZ + reach});
+}
+
+void TerrainLightmap::onTerrainReset() {
+    dirtyMinX = dirtyMinZ = 0;
+    dirtyMaxX = dirtyMaxZ = INT_MAX;
+    pagedRegions.clear();
+}
+
+void TerrainLightmap::update() {
+    if (!world) return;
+    if ((dirtyMinX > dirtyMaxX || dirtyMinZ > dirtyMaxZ) && pagedRegions.empty()) return;
+    
+    // Loading a map can change the world's size
+    if (world->getWidth() != width || world->getHeight() != height) {
+        width = world->getWidth();
+        height = world->getHeight();
+        size_t cellCount = static_cast<size_t>(width) * height;
+        skyVisibility.assign(cellCount, 255);
+        horizonEast.assign(cellCount, 0);
+        horizonWest.assign(cellCount, 0);
+        normalX.assign(cellCount, 0);
+        normalY.assign(cellCount, 127);
+        dirtyMinX = dirtyMinZ = 0;
+        dirtyMaxX = width - 1;
+        dirtyMaxZ = height - 1;
+        pagedRegions.clear();
+    }
+    
+    bakeRegion(std::max(dirtyMinX, 0), std::max(dirtyMinZ, 0),
+               std::min(dirtyMaxX, width - 1), std::min(dirtyMaxZ, height - 1));
+    for (const Region& region : pagedRegions) {
+        bakeRegion(std::max(region.minX, 0), std::max(region.minZ, 0),
+                   std::min(region.maxX, width - 1), std::min(region.maxZ, height - 1));
+    }
+    pagedRegions.clear();
+    
+    dirtyMinX = dirtyMinZ = INT_MAX;
+    dirtyMaxX = dirtyMaxZ = INT_MIN;
+}
+
+void TerrainLightmap::bakeRegion(int minX, int minZ, int maxX, int maxZ) {
+    if (minX > maxX || minZ > maxZ) return;
+    
+    // One job per chunk-aligned tile of the region
+    const int tile = World::CHUNK_SIZE;
+    int tileX0 = minX / tile;
+    int tileZ0 = minZ / tile;
+    int tilesX = maxX / tile - tileX0 + 1;
+    int tilesZ = maxZ / tile - tileZ0 + 1;
+    
+    JobSystem::instance().parallelFor(0, tilesX * tilesZ, 1, [&](int first, int last) {
+        for (int t = first; t < last; t++) {
+            int x0 = (tileX0 + t % tilesX) * tile;
+            int z0 = (tileZ0 + t / tilesX) * tile;
+            bakeTile(std::max(x0, minX), std::max(z0, minZ),
+                     std::min(x0 + tile - 1, maxX), std::min(z0 + tile - 1, maxZ));
+        }
+    });
+}
+
+void TerrainLightmap::bakeTile(int minX, int minZ, int maxX, int maxZ) {
+    // Copy the tile plus a horizonRadius border so the march never leaves
+    // it; beyond the world edge the terrain continues at the edge height
+    const int radius = std::max(0, settings.horizonRadius);
+    int paddedX = minX - radius;
+    int paddedZ = minZ - radius;
+    int paddedWidth = maxX - minX + 1 + 2 * radius;
+    int paddedHeight = maxZ - minZ + 1 + 2 * radius;
+    std::vector<float> heights(static_cast<size_t>(paddedWidth) * paddedHeight);
+    for (int row = 0; row < paddedHeight; row++) {
+        int z = std::min(std::max(paddedZ + row, 0), height - 1);
+        for (int column = 0; column < paddedWidth; column++) {
+            int x = std::min(std::max(paddedX + column, 0), width - 1);
+            heights[static_cast<size_t>(row) * paddedWidth + column] = world->getTerrainHeight(x, z);
+        }
+    }
+    
+    float inverseStep[DIRECTION_COUNT];
+    for (int d = 0; d < DIRECTION_COUNT; d++) {
+        inverseStep[d] = 1.0f / std::sqrt(static_cast<float>(DIRECTION_X[d] * DIRECTION_X[d] +
+                                                             DIRECTION_Z[d] * DIRECTION_Z[d]));
+    }
+    
+    for (int z = minZ; z <= maxZ; z++) {
+        for (int x = minX; x <= maxX; x++) {
+            int column = x - paddedX;
+            int row = z - paddedZ;
+            float origin = heights[static_cast<size_t>(row) * paddedWidth + column];
+            
+            float horizonSine[DIRECTION_COUNT];
+            float sineSum = 0.0f;
+            for (int d = 0; d < DIRECTION_COUNT; d++) {
+                // Steepest rise (as a slope) towards this direction
+                float maxSlope = 0.0f;
+                for (int step = 1; step <= radius; step++) {
+                    size_t sample = static_cast<size_t>(row + DIRECTION_Z[d] * step) * paddedWidth +
+                                    (column + DIRECTION_X[d] * step);
+                    float slope = (heights[sample] - origin) * inverseStep[d] / step;
+                    maxSlope = std::max(maxSlope, slope);
+                }
+                horizonSine[d] = maxSlope / std::sqrt(1.0f + maxSlope * maxSlope);
+                sineSum += horizonSine[d];
+            }
+            
+            size_t index = static_cast<size_t>(z) * width + x;
+            Vec3 normal = world->getTerrainNormal(x, z);
+            skyVisibility[index] = quantizeUnit(1.0f - sineSum / DIRECTION_COUNT);
+            horizonEast[index] = quantizeUnit(horizonSine[EAST]);
+            horizonWest[index] = quantizeUnit(horizonSine[WEST]);
+            normalX[index] = quantizeSigned(normal.x);
+            normalY[index] = quantizeSigned(normal.y);
+        }
+    }
+}
+
+void TerrainLightmap::setSunAngle(float angle) {
+    sunAngle = angle;
+    sunX = std::cos(angle);
+    sunY = std::sin(angle);
+    
+    // Sky light fades in over dawn and out over dusk
+    float daylight = MathUtils::smoothstep(-0.1f, 0.25f, sunY);
+    ambient = MathUtils::lerp(settings.nightAmbient, settings.dayAmbient, daylight);
+}
+
+float TerrainLightmap::shade(float visibleSky, float eastHorizon, float westHorizon,
+                             float normalXValue, float normalYValue) const {
+    // The sun is visible once it clears the horizon on its side of the sky
+    float horizon = sunX >= 0.0f ? eastHorizon : westHorizon;
+    float visibility = MathUtils::smoothstep(horizon - settings.penumbra, horizon + settings.penumbra, sunY);
+    float lambert = std::max(0.0f, normalXValue * sunX + normalYValue * sunY);
+    return std::min(1.0f, ambient * visibleSky + settings.sunStrength * lambert * visibility);
+}
+
+float TerrainLightmap::getBrightness(int x, int z) const {
+    if (x < 0 || z < 0 || x >= width || z >= height) {
+        return shade(1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+    }
+    
+    size_t index = static_cast<size_t>(z) * width + x;
+    const float unit = 1.0f / 255.0f;
+    const float signedUnit = 1.0f / 127.0f;
+    return shade(skyVisibility[index] * unit, horizonEast[index] * unit, horizonWest[index] * unit,
+                 normalX[index] * signedUnit, normalY[index] * signedUnit);
+}
+
+float TerrainLightmap::getAmbientOcclusion(int x, int z) const {
+    if (x < 0 || z < 0 || x >= width || z >= height) return 0.0f;
+    return 1.0f - skyVisibility[static_cast<size_t>(z) * width + x] / 255.0f;
+}
+
+bool TerrainLightmap::runBenchmark() {
+    const int WORLD_SIDE = 256;
+    const int EDIT_COUNT = 20;
+    
+    World world(WORLD_SIDE, WORLD_SIDE);
+    world.generateHillyTerrain(4.0f, 0.08f);
+    
+    typedef std::chrono::steady_clock Clock;
+    TerrainLightmap incremental;
+    Clock::time_point start = Clock::now();
+    incremental.attach(world);
+    double fullMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    
+    // Raise a mound the size of a player's dig, like a few tool uses would
+    const int MOUND_X = 100;
+    const int MOUND_Z = 140;
+    for (int i = 0; i < EDIT_COUNT; i++) {
+        int x = MOUND_X + i % 5;
+        int z = MOUND_Z + i / 5;
+        world.setTerrainHeight(x, z, world.getTerrainHeight(x, z) + 3.0f);
+    }
+    world.update(0.0f);
+    
+    start = Clock::now();
+    incremental.update();
+    double incrementalMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    
+    // A fresh bake of the edited world must agree cell for cell
+    TerrainLightmap reference;
+    reference.attach(world);
+    
+    int mismatches = 0;
+    double occlusionSum = 0.0;
+    for (float angle : { 0.3f, PI * 0.5f, 2.8f, 4.0f }) {
+        incremental.setSunAngle(angle);
+        reference.setSunAngle(angle);
+        for (int z = 0; z < WORLD_SIDE; z++) {
+            for (int x = 0; x < WORLD_SIDE; x++) {
+                if (incremental.getBrightness(x, z) != reference.getBrightness(x, z) ||
+                    incremental.getAmbientOcclusion(x, z) != reference.getAmbientOcclusion(x, z)) {
+                    mismatches++;
+                }
+            }
+        }
+    }
+    for (int z = 0; z < WORLD_SIDE; z++) {
+        for (int x = 0; x < WORLD_SIDE; x++) {
+            occlusionSum += reference.getAmbientOcclusion(x, z);
+        }
+    }
+    
+    bool passed = mismatches == 0;
+    std::cout << "Terrain lightmap: " << WORLD_SIDE << "x" << WORLD_SIDE << " cells, horizon radius "
+              << reference.settings.horizonRadius << std::endl;
+    std::cout << "  full bake          " << fullMs << " ms" << std::endl;
+    std::cout << "  re-bake " << EDIT_COUNT << " edits    " << incrementalMs << " ms" << std::endl;
+    std::cout << "  mean occlusion     " << occlusionSum / (WORLD_SIDE * WORLD_SIDE) << std::endl;
+    std::cout << "  mismatched cells   " << mismatches << (passed ? "" : "  FAILED") << std::endl;
+    return passed;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "world.h"
+#include <cstdint>
+#include <vector>
+
+// TerrainLightmap bakes how much sky and sun each World cell can see from
+// the heightmap, so rendering only has to combine a few stored bytes with
+// the current sun angle instead of tracing the terrain every frame.
+//
+// For every cell the bake marches the heightmap in 8 directions up to
+// horizonRadius cells and keeps the steepest rise in each (the horizon
+// angle). Ambient occlusion is one minus the mean horizon sine; the east
+// (+X) and west (-X) horizons are kept because the sun crosses the sky
+// from east to west, and decide whether the cell is in shadow at a given
+// sun angle. Results live in one byte-per-cell plane per quantity.
+//
+// Bakes run in parallel, one chunk tile per job. As a WorldListener the
+// lightmap collects height edits into a dirty rectangle (grown by the
+// horizon radius, since an edit changes the horizon of cells around it),
+// and update() re-bakes only that rectangle. Chunks paged in or out are
+// kept as separate regions, since they may be far apart.
+class TerrainLightmap : public WorldListener {
+public:
+    struct Settings {
+        int horizonRadius;     // Cells marched per direction
+        float nightAmbient;    // Sky light of an unoccluded cell at night
+        float dayAmbient;      // ... and at noon
+        float sunStrength;     // Direct light of a fully lit, sun-facing cell
+        float penumbra;        // Sine range over which the sun fades at the horizon
+        
+        Settings()
+            : horizonRadius(16)
+            , nightAmbient(0.25f)
+            , dayAmbient(0.45f)
+            , sunStrength(0.55f)
+            , penumbra(0.05f)
+        {}
+    };
+    
+    explicit TerrainLightmap(const Settings& settings = Settings());
+    ~TerrainLightmap();
+    
+    TerrainLightmap(const TerrainLightmap&) = delete;
+    TerrainLightmap& operator=(const TerrainLightmap&) = delete;
+    
+    // Bake the whole world and start following its height edits
+    void attach(World& world);
+    void detach();
+    
+    // Re-bake the region touched by edits since the last call. Call after
+    // World::update so the terrain normals are up to date.
+    void update();
+    
+    // Sun position: 0 rises in the east (+X), PI/2 is noon, PI sets in the
+    // west; the sun is below the horizon from PI to 2*PI
+    void setSunAngle(float angle);
+    float getSunAngle() const { return sunAngle; }
+    
+    // Light multiplier for the top of cell (x, z) at the current sun angle,
+    // in [0, 1]. Cells outside the world are lit as flat open ground.
+    float getBrightness(int x, int z) const;
+    
+    // Baked values, for debugging and tools
+    float getAmbientOcclusion(int x, int z) const;
+    
+    // WorldListener
+    void onTerrainHeightChanged(int x, int z, float height) override;
+    void onTerrainReset() override;
+    void onTerrainRegionChanged(int minX, int minZ, int maxX, int maxZ) override;
+    
+    // Times a full bake of a hilly 256x256 world and an incremental re-bake
+    // after raising a small mound, checks the re-bake matches a fresh bake
+    // and prints the result
+    static bool runBenchmark();
+
+private:
+    void bakeRegion(int minX, int minZ, int maxX, int maxZ);
+    void bakeTile(int minX, int minZ, int maxX, int maxZ);
+    float shade(float visibleSky, float eastHorizon, float westHorizon, float normalX, float normalY) const;
+    
+    Settings settings;
+    World* world;
+    int width;
+    int height;
+    
+    // Row-major planes, width * height entries each
+    std::vector<uint8_t> skyVisibility;    // 1 - ambient occlusion, 0..255
+    std::vector<uint8_t> horizonEast;      // Sine of the +X horizon angle, 0..255
+    std::vector<uint8_t> horizonWest;      // Sine of the -X horizon angle, 0..255
+    std::vector<int8_t> normalX;           // Terrain normal x and y, -127..127
+    std::vector<int8_t> normalY;
+    
+    // Pending re-bake (inclusive bounds, empty when min > max)
+    int dirtyMinX;
+    int dirtyMinZ;
+    int dirtyMaxX;
+    int dirtyMaxZ;
+    
+    struct Region {
+        int minX, minZ, maxX, maxZ;
+    };
+    std::vector<Region> pagedRegions;      // Re-baked after the rectangle above
+    
+    // Per-frame sun terms, updated by setSunAngle
+    float sunAngle;
+    float sunX;
+    float sunY;
+    float ambient;
+};
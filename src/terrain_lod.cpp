@@ -0,0 +1,453 @@
+#include "terrain_lod.h"
+#include "job_system.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <map>
+
+namespace {
+    // Bit per frustum plane the point is outside of
+    int outcode(const Vec4& v) {
+        return (v.x < -v.w ? 1 : 0) | (v.x > v.w ? 2 : 0) |
+               (v.y < -v.w ? 4 : 0) | (v.y > v.w ? 8 : 0) |
+               (v.z < -v.w ? 16 : 0) | (v.z > v.w ? 32 : 0);
+    }
+}
+
+TerrainLod::TerrainLod(const Settings& settings)
+    : settings(settings)
+    , world(nullptr)
+    , width(0)
+    , height(0)
+    , dirtyMinX(INT_MAX)
+    , dirtyMinZ(INT_MAX)
+    , dirtyMaxX(INT_MIN)
+    , dirtyMaxZ(INT_MIN)
+    , holeRadius(0.0f)
+{
+}
+
+TerrainLod::~TerrainLod() {
+    detach();
+}
+
+void TerrainLod::attach(World& target) {
+    detach();
+    world = &target;
+    world->addListener(this);
+    onTerrainReset();
+    update();
+}
+
+void TerrainLod::detach() {
+    if (!world) return;
+    world->removeListener(this);
+    world = nullptr;
+    selection.clear();
+}
+
+void TerrainLod::onTerrainHeightChanged(int x, int z, float /*height*/) {
+    dirtyMinX = std::min(dirtyMinX, x);
+    dirtyMinZ = std::min(dirtyMinZ, z);
+    dirtyMaxX = std::max(dirtyMaxX, x);
+    dirtyMaxZ = std::max(dirtyMaxZ, z);
+}
+
+void TerrainLod::onTerrainRegionChanged(int minX, int minZ, int maxX, int maxZ) {
+    pagedRegions.push_back({minX, minZ, maxX, maxZ});
+}
+
+void TerrainLod::onTerrainReset() {
+    dirtyMinX = dirtyMinZ = 0;
+    dirtyMaxX = dirtyMaxZ = INT_MAX;
+    pagedRegions.clear();
+}
+
+void TerrainLod::update() {
+    if (!world) return;
+    if ((dirtyMinX > dirtyMaxX || dirtyMinZ > dirtyMaxZ) && pagedRegions.empty()) return;
+    
+    // Loading a map can change the world's size
+    if (world->getWidth() != width || world->getHeight() != height) {
+        width = world->getWidth();
+        height = world->getHeight();
+        nodesX.clear();
+        nodesZ.clear();
+        minHeights.clear();
+        maxHeights.clear();
+        ranges.clear();
+        morphStarts.clear();
+        
+        // Levels up to the first one whose single node covers the world
+        int leafSize = std::max(1, settings.leafSize);
+        for (int level = 0; ; level++) {
+            int span = leafSize << level;
+            nodesX.push_back((width + span - 1) / span);
+            nodesZ.push_back((height + span - 1) / span);
+            size_t count = static_cast<size_t>(nodesX.back()) * nodesZ.back();
+            minHeights.emplace_back(count, 0.0f);
+            maxHeights.emplace_back(count, 0.0f);
+            
+            float previous = level > 0 ? ranges.back() : 0.0f;
+            float range = settings.firstRange * std::pow(settings.rangeRatio, static_cast<float>(level));
+            ranges.push_back(range);
+            morphStarts.push_back(previous + (range - previous) * settings.morphStart);
+            if (nodesX.back() <= 1 && nodesZ.back() <= 1) break;
+        }
+        
+        // The roots are drawn at any distance and never morph
+        ranges.back() = std::numeric_limits<float>::max();
+        morphStarts.back() = std::numeric_limits<float>::max();
+        
+        dirtyMinX = dirtyMinZ = 0;
+        dirtyMaxX = width - 1;
+        dirtyMaxZ = height - 1;
+        pagedRegions.clear();
+    }
+    
+    if (dirtyMinX <= dirtyMaxX && dirtyMinZ <= dirtyMaxZ) {
+        refreshBounds(dirtyMinX, dirtyMinZ, dirtyMaxX, dirtyMaxZ);
+    }
+    for (const Region& region : pagedRegions) {
+        refreshBounds(region.minX, region.minZ, region.maxX, region.maxZ);
+    }
+    pagedRegions.clear();
+    
+    dirtyMinX = dirtyMinZ = INT_MAX;
+    dirtyMaxX = dirtyMaxZ = INT_MIN;
+}
+
+void TerrainLod::refreshBounds(int minX, int minZ, int maxX, int maxZ) {
+    // A leaf's vertices sample the cells from one before it to one past it
+    int leafSize = std::max(1, settings.leafSize);
+    int firstX = std::max(0, (std::max(minX, 0) - 1) / leafSize);
+    int firstZ = std::max(0, (std::max(minZ, 0) - 1) / leafSize);
+    int lastX = std::min(nodesX[0] - 1, (std::min(maxX, width - 1) + 1) / leafSize);
+    int lastZ = std::min(nodesZ[0] - 1, (std::min(maxZ, height - 1) + 1) / leafSize);
+    computeLeafBounds(firstX, firstZ, lastX, lastZ);
+    for (int level = 1; level < getLevelCount(); level++) {
+        firstX /= 2;
+        firstZ /= 2;
+        lastX /= 2;
+        lastZ /= 2;
+        reduceBounds(level, firstX, firstZ, lastX, lastZ);
+    }
+}
+
+void TerrainLod::computeLeafBounds(int firstX, int firstZ, int lastX, int lastZ) {
+    int leafSize = std::max(1, settings.leafSize);
+    JobSystem::instance().parallelFor(firstZ, lastZ + 1, 1, [&](int first, int last) {
+        for (int nodeZ = first; nodeZ < last; nodeZ++) {
+            for (int nodeX = firstX; nodeX <= lastX; nodeX++) {
+                int cellMinX = std::max(0, nodeX * leafSize - 1);
+                int cellMinZ = std::max(0, nodeZ * leafSize - 1);
+                int cellMaxX = std::min(width - 1, (nodeX + 1) * leafSize);
+                int cellMaxZ = std::min(height - 1, (nodeZ + 1) * leafSize);
+                
+                float low = std::numeric_limits<float>::max();
+                float high = -low;
+                for (int z = cellMinZ; z <= cellMaxZ; z++) {
+                    for (int x = cellMinX; x <= cellMaxX; x++) {
+                        float h = world->getTerrainHeight(x, z);
+                        low = std::min(low, h);
+                        high = std::max(high, h);
+                    }
+                }
+                size_t index = static_cast<size_t>(nodeZ) * nodesX[0] + nodeX;
+                minHeights[0][index] = low;
+                maxHeights[0][index] = high;
+            }
+        }
+    });
+}
+
+void TerrainLod::reduceBounds(int level, int firstX, int firstZ, int lastX, int lastZ) {
+    const std::vector<float>& childMin = minHeights[level - 1];
+    const std::vector<float>& childMax = maxHeights[level - 1];
+    int childrenX = nodesX[level - 1];
+    int childrenZ = nodesZ[level - 1];
+    for (int nodeZ = firstZ; nodeZ <= lastZ; nodeZ++) {
+        for (int nodeX = firstX; nodeX <= lastX; nodeX++) {
+            float low = std::numeric_limits<float>::max();
+            float high = -low;
+            for (int childZ = nodeZ * 2; childZ < std::min(nodeZ * 2 + 2, childrenZ); childZ++) {
+                for (int childX = nodeX * 2; childX < std::min(nodeX * 2 + 2, childrenX); childX++) {
+                    size_t child = static_cast<size_t>(childZ) * childrenX + childX;
+                    low = std::min(low, childMin[child]);
+                    high = std::max(high, childMax[child]);
+                }
+            }
+            size_t index = static_cast<size_t>(nodeZ) * nodesX[level] + nodeX;
+            minHeights[level][index] = low;
+            maxHeights[level][index] = high;
+        }
+    }
+}
+
+void TerrainLod::select(const Vec3& eye, const Mat4& viewProjection, float holeRadius) {
+    selection.clear();
+    if (!world || ranges.empty()) return;
+    
+    this->eye = eye;
+    this->viewProjection = viewProjection;
+    this->holeRadius = holeRadius;
+    int top = getLevelCount() - 1;
+    for (int nodeZ = 0; nodeZ < nodesZ[top]; nodeZ++) {
+        for (int nodeX = 0; nodeX < nodesX[top]; nodeX++) {
+            selectNode(top, nodeX, nodeZ);
+        }
+    }
+}
+
+bool TerrainLod::selectNode(int level, int nodeX, int nodeZ) {
+    // Parts of the parent past the world's edge
+    if (nodeX >= nodesX[level] || nodeZ >= nodesZ[level]) return true;
+    
+    if (!isNodeVisible(level, nodeX, nodeZ)) return true;
+    
+    int size = settings.leafSize << level;
+    int x = nodeX * size;
+    int z = nodeZ * size;
+    if (holeRadius > 0.0f) {
+        float farX = std::max(std::abs(x - eye.x), std::abs(std::min(x + size, width) - eye.x));
+        float farZ = std::max(std::abs(z - eye.z), std::abs(std::min(z + size, height) - eye.z));
+        if (farX * farX + farZ * farZ <= holeRadius * holeRadius) return true;
+    }
+    
+    // Out of this level's range: the parent draws the area at its own level
+    float distance = distanceToNode(level, nodeX, nodeZ);
+    if (distance > ranges[level]) return false;
+    
+    if (level == 0 || distance > ranges[level - 1]) {
+        addNode(x, z, size, level);
+        return true;
+    }
+    
+    // Children within the finer level's range draw themselves; the others
+    // are drawn as quarters of this node
+    int half = size / 2;
+    for (int child = 0; child < 4; child++) {
+        int childX = nodeX * 2 + (child & 1);
+        int childZ = nodeZ * 2 + (child >> 1);
+        if (!selectNode(level - 1, childX, childZ)) {
+            addNode(childX * half, childZ * half, half, level);
+        }
+    }
+    return true;
+}
+
+float TerrainLod::distanceToNode(int level, int nodeX, int nodeZ) const {
+    int size = settings.leafSize << level;
+    size_t index = static_cast<size_t>(nodeZ) * nodesX[level] + nodeX;
+    float minX = static_cast<float>(nodeX * size), maxX = static_cast<float>(std::min((nodeX + 1) * size, width));
+    float minZ = static_cast<float>(nodeZ * size), maxZ = static_cast<float>(std::min((nodeZ + 1) * size, height));
+    float dx = std::max(std::max(minX - eye.x, eye.x - maxX), 0.0f);
+    float dy = std::max(std::max(minHeights[level][index] - eye.y, eye.y - maxHeights[level][index]), 0.0f);
+    float dz = std::max(std::max(minZ - eye.z, eye.z - maxZ), 0.0f);
+    return std::sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+bool TerrainLod::isNodeVisible(int level, int nodeX, int nodeZ) const {
+    int size = settings.leafSize << level;
+    size_t index = static_cast<size_t>(nodeZ) * nodesX[level] + nodeX;
+    Vec3 min(static_cast<float>(nodeX * size), minHeights[level][index], static_cast<float>(nodeZ * size));
+    Vec3 max(static_cast<float>(std::min((nodeX + 1) * size, width)), maxHeights[level][index],
+             static_cast<float>(std::min((nodeZ + 1) * size, height)));
+    
+    int outside = ~0;
+    for (int corner = 0; corner < 8; corner++) {
+        Vec3 point((corner & 1) ? max.x : min.x, (corner & 2) ? max.y : min.y, (corner & 4) ? max.z : min.z);
+        outside &= outcode(viewProjection * Vec4(point, 1.0f));
+    }
+    return outside == 0;
+}
+
+void TerrainLod::addNode(int x, int z, int size, int level) {
+    selection.push_back({ x, z, size, level });
+}
+
+size_t TerrainLod::getTriangleCount() const {
+    size_t count = 0;
+    for (const Node& node : selection) {
+        size_t quads = static_cast<size_t>(node.size >> node.level);
+        count += quads * quads * 2;
+    }
+    return count;
+}
+
+float TerrainLod::sampleHeight(float x, float z) const {
+    // Grid points on the far edges still sample the last row of cells
+    float clampedX = MathUtils::clamp(x, 0.0f, width - 0.001f);
+    float clampedZ = MathUtils::clamp(z, 0.0f, height - 0.001f);
+    return world->getTerrainHeight(Vec3(clampedX, 0.0f, clampedZ));
+}
+
+void TerrainLod::buildMesh(std::vector<Vec3>& vertices, std::vector<uint32_t>& indices) const {
+    // Each node writes its own range of the output
+    std::vector<size_t> firstVertex(selection.size() + 1, 0);
+    std::vector<size_t> firstIndex(selection.size() + 1, 0);
+    for (size_t i = 0; i < selection.size(); i++) {
+        size_t quads = static_cast<size_t>(selection[i].size >> selection[i].level);
+        firstVertex[i + 1] = firstVertex[i] + (quads + 1) * (quads + 1);
+        firstIndex[i + 1] = firstIndex[i] + quads * quads * 6;
+    }
+    vertices.resize(firstVertex.back());
+    indices.resize(firstIndex.back());
+    
+    JobSystem::instance().parallelFor(0, static_cast<int>(selection.size()), 4, [&](int first, int last) {
+        for (int i = first; i < last; i++) {
+            const Node& node = selection[i];
+            int spacing = 1 << node.level;
+            int quads = node.size >> node.level;
+            float morphStart = morphStarts[node.level];
+            float morphRange = std::max(ranges[node.level] - morphStart, 1e-3f);
+            
+            Vec3* out = &vertices[firstVertex[i]];
+            for (int gz = 0; gz <= quads; gz++) {
+                for (int gx = 0; gx <= quads; gx++) {
+                    float x = static_cast<float>(node.x + gx * spacing);
+                    float z = static_cast<float>(node.z + gz * spacing);
+                    float y = sampleHeight(x, z);
+                    float distance = (Vec3(x, y, z) - eye).length();
+                    float morph = morphStart < std::numeric_limits<float>::max()
+                        ? MathUtils::clamp((distance - morphStart) / morphRange, 0.0f, 1.0f) : 0.0f;
+                    
+                    // Odd grid lines of the level slide onto the even line
+                    // before them, which is where the coarser level has them
+                    int globalX = node.x / spacing + gx;
+                    int globalZ = node.z / spacing + gz;
+                    if (morph > 0.0f && ((globalX | globalZ) & 1)) {
+                        if (globalX & 1) x -= spacing * morph;
+                        if (globalZ & 1) z -= spacing * morph;
+                        y = sampleHeight(x, z);
+                    }
+                    *out++ = Vec3(std::min(x, static_cast<float>(width)), y, std::min(z, static_cast<float>(height)));
+                }
+            }
+            
+            uint32_t* index = &indices[firstIndex[i]];
+            uint32_t base = static_cast<uint32_t>(firstVertex[i]);
+            uint32_t row = static_cast<uint32_t>(quads + 1);
+            for (int gz = 0; gz < quads; gz++) {
+                for (int gx = 0; gx < quads; gx++) {
+                    uint32_t v00 = base + gz * row + gx;
+                    uint32_t v10 = v00 + 1;
+                    uint32_t v01 = v00 + row;
+                    uint32_t v11 = v01 + 1;
+                    *index++ = v00;
+                    *index++ = v01;
+                    *index++ = v11;
+                    *index++ = v00;
+                    *index++ = v11;
+                    *index++ = v10;
+                }
+            }
+        }
+    });
+}
+
+bool TerrainLod::runBenchmark() {
+    const int SIDES[] = { 256, 1024, 4096 };
+    const int FRAMES = 10;
+    typedef std::chrono::steady_clock Clock;
+    
+    bool valid = true;
+    double fewestPerLevel = std::numeric_limits<double>::max();
+    double mostPerLevel = 0.0;
+    std::cout << "Terrain LOD: eye 10 units above the centre, looking towards the horizon" << std::endl;
+    for (int side : SIDES) {
+        World world(side, side);
+        world.generateHillyTerrain(24.0f, 0.02f);
+        
+        TerrainLod lod;
+        Clock::time_point start = Clock::now();
+        lod.attach(world);
+        double boundsMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        
+        Vec3 eye(side * 0.5f, 0.0f, side * 0.5f);
+        eye.y = world.getTerrainHeight(eye) + 10.0f;
+        Mat4 view = Mat4::lookAt(eye, eye + Vec3(1.0f, -0.05f, 0.3f), Vec3::up());
+        Mat4 viewProjection = Mat4::perspective(60.0f, 800.0f / 600.0f, 0.1f, side * 1.5f) * view;
+        
+        std::vector<Vec3> vertices;
+        std::vector<uint32_t> indices;
+        start = Clock::now();
+        for (int frame = 0; frame < FRAMES; frame++) {
+            lod.select(eye, viewProjection);
+            lod.buildMesh(vertices, indices);
+        }
+        double frameMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / FRAMES;
+        
+        // Every node edge is a polyline of its boundary vertices; where two
+        // nodes share part of a line the polylines must agree in height.
+        // Keys are (axis, coordinate): 0 for lines of constant z, 1 for x.
+        struct Edge {
+            float begin;
+            float end;
+            std::vector<std::pair<float, float>> points;   // (position along the line, height)
+        };
+        std::map<std::pair<int, int>, std::vector<Edge>> edges;
+        size_t vertex = 0;
+        for (const Node& node : lod.getSelection()) {
+            int quads = node.size >> node.level;
+            int row = quads + 1;
+            auto addEdge = [&](int axis, int coordinate, int firstVertex, int stride) {
+                if (coordinate <= 0 || coordinate >= side) return;   // World border
+                Edge edge;
+                for (int i = 0; i < row; i++) {
+                    const Vec3& p = vertices[vertex + firstVertex + i * stride];
+                    edge.points.push_back({ axis == 0 ? p.x : p.z, p.y });
+                }
+                edge.begin = edge.points.front().first;
+                edge.end = edge.points.back().first;
+                edges[{ axis, coordinate }].push_back(edge);
+            };
+            addEdge(0, node.z, 0, 1);
+            addEdge(0, node.z + node.size, quads * row, 1);
+            addEdge(1, node.x, 0, row);
+            addEdge(1, node.x + node.size, quads, row);
+            vertex += static_cast<size_t>(row) * row;
+        }
+        
+        auto heightAt = [](const Edge& edge, float t) {
+            for (size_t i = 0; i + 1 < edge.points.size(); i++) {
+                float t0 = edge.points[i].first, t1 = edge.points[i + 1].first;
+                if (t < t0 || t > t1) continue;
+                if (t1 - t0 < 1e-6f) return edge.points[i].second;
+                return MathUtils::lerp(edge.points[i].second, edge.points[i + 1].second, (t - t0) / (t1 - t0));
+            }
+            return edge.points.back().second;
+        };
+        float worstGap = 0.0f;
+        for (const auto& line : edges) {
+            const std::vector<Edge>& shared = line.second;
+            for (size_t a = 0; a < shared.size(); a++) {
+                for (size_t b = 0; b < shared.size(); b++) {
+                    if (a == b) continue;
+                    for (const std::pair<float, float>& point : shared[a].points) {
+                        if (point.first < shared[b].begin || point.first > shared[b].end) continue;
+                        worstGap = std::max(worstGap, std::abs(heightAt(shared[b], point.first) - point.second));
+                    }
+                }
+            }
+        }
+        if (worstGap > 1e-3f) valid = false;
+        
+        size_t triangles = lod.getTriangleCount();
+        double perLevel = static_cast<double>(triangles) / lod.getLevelCount();
+        fewestPerLevel = std::min(fewestPerLevel, perLevel);
+        mostPerLevel = std::max(mostPerLevel, perLevel);
+        std::cout << "  " << side << "x" << side << ": " << lod.getLevelCount() << " levels, "
+                  << lod.getSelection().size() << " nodes, " << triangles << " triangles (uniform mesh "
+                  << static_cast<size_t>(side) * side * 2 << "), bounds " << boundsMs << " ms, select and mesh "
+                  << frameMs << " ms, largest seam " << worstGap << std::endl;
+    }
+    
+    // Each level adds a ring of about the same number of triangles, so the
+    // count follows the number of levels (the log of the side), not the area
+    if (mostPerLevel > fewestPerLevel * 1.5) valid = false;
+    std::cout << "  result             " << (valid ? "seamless, bounded triangle count" : "FAILED") << std::endl;
+    return valid;
+}
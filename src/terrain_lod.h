@@ -0,0 +1,125 @@
+#pragma once
+
+#include "simd_math.h"
+#include "world.h"
+#include <climits>
+#include <cstdint>
+#include <vector>
+
+// TerrainLod draws World's heightmap at a detail that falls off with
+// distance (CDLOD: continuous distance-dependent level of detail), so the
+// triangle count stays about the same however large the world is.
+//
+// The terrain is covered by a quadtree. A node at level L spans
+// leafSize << L cells and is drawn as a grid of leafSize x leafSize quads,
+// so each level has half the resolution of the one below. Level L is used
+// up to ranges[L] from the eye; selection walks down from the roots and
+// stops at the coarsest level whose range the node lies outside of. Nodes
+// outside the view frustum are dropped on the way, using per-node minimum
+// and maximum heights that are kept up to date as the terrain is edited.
+//
+// Towards the end of its range each vertex morphs onto the grid of the
+// next coarser level (its odd grid lines slide onto the even ones). Where a
+// node meets a coarser neighbour the vertices are fully morphed, so the
+// shared edges match without seams or skirts.
+class TerrainLod : public WorldListener {
+public:
+    struct Settings {
+        int leafSize;         // Quads per node side; nodes at level L span leafSize << L cells
+        float firstRange;     // View distance drawn at full resolution
+        float rangeRatio;     // Each level reaches this much farther than the one below
+        float morphStart;     // Fraction of a level's range band where morphing begins
+        
+        Settings()
+            : leafSize(8)
+            , firstRange(24.0f)
+            , rangeRatio(2.0f)
+            , morphStart(0.7f)
+        {}
+    };
+    
+    // A selected piece of terrain: size x size cells from (x, z), drawn with
+    // the grid spacing of 'level' (1 << level cells)
+    struct Node {
+        int x;
+        int z;
+        int size;
+        int level;
+    };
+    
+    explicit TerrainLod(const Settings& settings = Settings());
+    ~TerrainLod();
+    
+    TerrainLod(const TerrainLod&) = delete;
+    TerrainLod& operator=(const TerrainLod&) = delete;
+    
+    // Build the height bounds of the world's terrain and follow its edits
+    void attach(World& world);
+    void detach();
+    
+    // Refresh the height bounds touched by edits since the last call
+    void update();
+    
+    // Choose the nodes to draw for this camera. Nodes lying completely
+    // within holeRadius of the eye (in XZ) are left out, for a detailed
+    // renderer to cover.
+    void select(const Vec3& eye, const Mat4& viewProjection, float holeRadius = 0.0f);
+    
+    const std::vector<Node>& getSelection() const { return selection; }
+    size_t getTriangleCount() const;
+    int getLevelCount() const { return static_cast<int>(ranges.size()); }
+    
+    // Morphed triangle mesh of the selection, counter-clockwise seen from
+    // above; one grid of vertices per node
+    void buildMesh(std::vector<Vec3>& vertices, std::vector<uint32_t>& indices) const;
+    
+    // WorldListener
+    void onTerrainHeightChanged(int x, int z, float height) override;
+    void onTerrainReset() override;
+    void onTerrainRegionChanged(int minX, int minZ, int maxX, int maxZ) override;
+    
+    // Selects and meshes worlds of growing size from the same viewpoint,
+    // checks that edges between nodes match, and prints triangle counts and
+    // timings against a uniform mesh
+    static bool runBenchmark();
+
+private:
+    bool selectNode(int level, int nodeX, int nodeZ);
+    bool isNodeVisible(int level, int nodeX, int nodeZ) const;
+    float distanceToNode(int level, int nodeX, int nodeZ) const;
+    void addNode(int x, int z, int size, int level);
+    
+    void refreshBounds(int minX, int minZ, int maxX, int maxZ);
+    void computeLeafBounds(int firstX, int firstZ, int lastX, int lastZ);
+    void reduceBounds(int level, int firstX, int firstZ, int lastX, int lastZ);
+    float sampleHeight(float x, float z) const;
+    
+    Settings settings;
+    World* world;
+    int width;
+    int height;
+    
+    // Per level, node bounds in row-major order
+    std::vector<int> nodesX;
+    std::vector<int> nodesZ;
+    std::vector<std::vector<float>> minHeights;
+    std::vector<std::vector<float>> maxHeights;
+    
+    std::vector<float> ranges;        // Farthest distance drawn at each level
+    std::vector<float> morphStarts;   // Distance where each level starts morphing
+    
+    // Edited cells since the last update; empty when min > max
+    int dirtyMinX, dirtyMinZ, dirtyMaxX, dirtyMaxZ;
+    
+    // Chunks paged in or out since the last update, kept apart from the
+    // rectangle above since they may be far from each other
+    struct Region {
+        int minX, minZ, maxX, maxZ;
+    };
+    std::vector<Region> pagedRegions;
+    
+    Vec3 eye;
+    Mat4 viewProjection;
+    float holeRadius;
+    std::vector<Node> selection;
+};
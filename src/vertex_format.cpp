@@ -0,0 +1,244 @@
+#include "vertex_format.h"
+#include "world.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <random>
+
+namespace {
+    const float MAX_STEPS = 32767.0f;
+    
+    void addQuad(const Vec3& p0, const Vec3& p1, const Vec3& p2, const Vec3& p3,
+                 const Vec3& normal, const Color& color, ChunkGeometry& out) {
+        uint32_t base = static_cast<uint32_t>(out.vertices.size());
+        for (const Vec3* corner : { &p0, &p1, &p2, &p3 }) {
+            out.vertices.push_back({ *corner, normal, color });
+        }
+        out.indices.insert(out.indices.end(), { base, base + 1, base + 2, base, base + 2, base + 3 });
+    }
+    
+    int16_t quantize(float value, float origin, float inverseStep) {
+        float steps = std::round((value - origin) * inverseStep);
+        return static_cast<int16_t>(MathUtils::clamp(steps, -MAX_STEPS, MAX_STEPS));
+    }
+}
+
+void VertexFormat::buildTerrainGeometry(const World& world, int chunkX, int chunkZ, ChunkGeometry& out) {
+    out.vertices.clear();
+    out.indices.clear();
+    out.instances.clear();
+    
+    int endX = std::min((chunkX + 1) * World::CHUNK_SIZE, world.getWidth());
+    int endZ = std::min((chunkZ + 1) * World::CHUNK_SIZE, world.getHeight());
+    for (int z = chunkZ * World::CHUNK_SIZE; z < endZ; z++) {
+        for (int x = chunkX * World::CHUNK_SIZE; x < endX; x++) {
+            float top = world.getTerrainHeight(x, z);
+            World::CellType cell = world.getCellType(x, z);
+            Color color = World::getCellTypeColor(cell);
+            float x0 = static_cast<float>(x), x1 = x + 1.0f;
+            float z0 = static_cast<float>(z), z1 = z + 1.0f;
+            
+            addQuad(Vec3(x0, top, z0), Vec3(x0, top, z1), Vec3(x1, top, z1), Vec3(x1, top, z0),
+                    world.getTerrainNormal(x, z), color, out);
+            
+            // Walls facing -X, +X, -Z and +Z where the neighbour is lower
+            const int offsets[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+            for (const int* offset : offsets) {
+                int nx = x + offset[0];
+                int nz = z + offset[1];
+                float bottom = world.isValidPosition(nx, nz) ? world.getTerrainHeight(nx, nz) : top - 1.0f;
+                if (bottom >= top) continue;
+                
+                Vec3 normal(static_cast<float>(offset[0]), 0.0f, static_cast<float>(offset[1]));
+                float wx = offset[0] > 0 ? x1 : x0;
+                float wz = offset[1] > 0 ? z1 : z0;
+                if (offset[0] != 0) {
+                    addQuad(Vec3(wx, bottom, z0), Vec3(wx, top, z0), Vec3(wx, top, z1), Vec3(wx, bottom, z1), normal, color, out);
+                } else {
+                    addQuad(Vec3(x0, bottom, wz), Vec3(x0, top, wz), Vec3(x1, top, wz), Vec3(x1, bottom, wz), normal, color, out);
+                }
+            }
+            
+            if (cell == World::CellType::FLOWER) {
+                Color flowerColor = World::getFlowerSpeciesColor(World::getFlowerSpecies(x, z));
+                out.instances.push_back({ Vec3(x + 0.5f, top + 0.5f, z + 0.5f), 0.3f, flowerColor,
+                                          RenderScene::Mesh::FLOWER_HEAD });
+            }
+        }
+    }
+}
+
+bool VertexFormat::packChunk(const ChunkGeometry& geometry, PackedChunk& out) {
+    out.vertices.clear();
+    out.indices.clear();
+    out.instances.clear();
+    if (geometry.vertices.size() > 65536) return false;
+    
+    // Bounds of everything in the chunk, instances included
+    Vec3 min(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+    Vec3 max = min * -1.0f;
+    auto grow = [&](const Vec3& p) {
+        min = Vec3(std::min(min.x, p.x), std::min(min.y, p.y), std::min(min.z, p.z));
+        max = Vec3(std::max(max.x, p.x), std::max(max.y, p.y), std::max(max.z, p.z));
+    };
+    for (const TerrainVertex& vertex : geometry.vertices) grow(vertex.position);
+    for (const RenderScene::Instance& instance : geometry.instances) grow(instance.position);
+    if (geometry.vertices.empty() && geometry.instances.empty()) min = max = Vec3::zero();
+    
+    out.origin = (min + max) * 0.5f;
+    Vec3 halfExtent = (max - min) * 0.5f;
+    float largest = std::max(halfExtent.x, std::max(halfExtent.y, halfExtent.z));
+    out.step = std::max(largest, 1.0f) / MAX_STEPS;
+    float inverseStep = 1.0f / out.step;
+    
+    out.vertices.reserve(geometry.vertices.size());
+    for (const TerrainVertex& vertex : geometry.vertices) {
+        PackedVertex packed;
+        packed.position[0] = quantize(vertex.position.x, out.origin.x, inverseStep);
+        packed.position[1] = quantize(vertex.position.y, out.origin.y, inverseStep);
+        packed.position[2] = quantize(vertex.position.z, out.origin.z, inverseStep);
+        packed.normal = MathUtils::packNormalOct(vertex.normal);
+        packed.color = MathUtils::packColorRGBA8(vertex.color);
+        out.vertices.push_back(packed);
+    }
+    
+    out.indices.reserve(geometry.indices.size());
+    for (uint32_t index : geometry.indices) {
+        out.indices.push_back(static_cast<uint16_t>(index));
+    }
+    
+    out.instances.reserve(geometry.instances.size());
+    for (const RenderScene::Instance& instance : geometry.instances) {
+        PackedInstance packed = {};
+        packed.position[0] = quantize(instance.position.x, out.origin.x, inverseStep);
+        packed.position[1] = quantize(instance.position.y, out.origin.y, inverseStep);
+        packed.position[2] = quantize(instance.position.z, out.origin.z, inverseStep);
+        packed.scale = static_cast<uint16_t>(MathUtils::clamp(std::round(instance.scale * inverseStep), 0.0f, 65535.0f));
+        packed.color = MathUtils::packColorRGBA8(instance.color);
+        packed.mesh = static_cast<uint8_t>(instance.mesh);
+        out.instances.push_back(packed);
+    }
+    return true;
+}
+
+TerrainVertex VertexFormat::unpackVertex(const PackedChunk& chunk, const PackedVertex& vertex) {
+    Vec3 offset(vertex.position[0], vertex.position[1], vertex.position[2]);
+    return { chunk.origin + offset * chunk.step, MathUtils::unpackNormalOct(vertex.normal),
+             MathUtils::unpackColorRGBA8(vertex.color) };
+}
+
+RenderScene::Instance VertexFormat::unpackInstance(const PackedChunk& chunk, const PackedInstance& instance) {
+    Vec3 offset(instance.position[0], instance.position[1], instance.position[2]);
+    return { chunk.origin + offset * chunk.step, instance.scale * chunk.step,
+             MathUtils::unpackColorRGBA8(instance.color), static_cast<RenderScene::Mesh>(instance.mesh) };
+}
+
+size_t VertexFormat::getByteSize(const ChunkGeometry& geometry) {
+    return geometry.vertices.size() * sizeof(TerrainVertex)
+         + geometry.indices.size() * sizeof(uint32_t)
+         + geometry.instances.size() * sizeof(RenderScene::Instance);
+}
+
+size_t VertexFormat::getByteSize(const PackedChunk& chunk) {
+    return sizeof(chunk.origin) + sizeof(chunk.step)
+         + chunk.vertices.size() * sizeof(PackedVertex)
+         + chunk.indices.size() * sizeof(uint16_t)
+         + chunk.instances.size() * sizeof(PackedInstance);
+}
+
+bool VertexFormat::runVertexFormatBenchmark() {
+    const int WORLD_SIDE = 512;
+    
+    // Error bounds for the 8-bit octahedral grid and half a colour level
+    const float NORMAL_BOUND_DEGREES = 1.0f;
+    const float COLOR_BOUND = 0.5f / 255.0f + 1e-6f;
+    
+    World world(WORLD_SIDE, WORLD_SIDE);
+    world.generateHillyTerrain(24.0f, 0.03f);
+    std::mt19937 rng(23);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (int z = 0; z < WORLD_SIDE; z++) {
+        for (int x = 0; x < WORLD_SIDE; x++) {
+            if (unit(rng) < 0.3f) world.setCell(x, z, World::CellType::FLOWER);
+        }
+    }
+    
+    int chunksX = (WORLD_SIDE + World::CHUNK_SIZE - 1) / World::CHUNK_SIZE;
+    int chunksZ = chunksX;
+    ChunkGeometry geometry;
+    PackedChunk packed;
+    size_t floatBytes = 0, packedBytes = 0, vertexCount = 0, instanceCount = 0;
+    float positionError = 0.0f, positionBound = 0.0f, normalError = 0.0f, colorError = 0.0f, scaleError = 0.0f;
+    bool valid = true;
+    double packMs = 0.0;
+    typedef std::chrono::steady_clock Clock;
+    
+    for (int chunk = 0; chunk < chunksX * chunksZ; chunk++) {
+        buildTerrainGeometry(world, chunk % chunksX, chunk / chunksX, geometry);
+        Clock::time_point start = Clock::now();
+        if (!packChunk(geometry, packed)) {
+            std::cerr << "Chunk " << chunk << " has too many vertices to pack" << std::endl;
+            return false;
+        }
+        packMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        
+        floatBytes += getByteSize(geometry);
+        packedBytes += getByteSize(packed);
+        vertexCount += geometry.vertices.size();
+        instanceCount += geometry.instances.size();
+        
+        // Half a step, plus float rounding of the world-space result
+        float bound = packed.step * 0.5f + WORLD_SIDE * std::numeric_limits<float>::epsilon();
+        positionBound = std::max(positionBound, bound);
+        auto checkPosition = [&](const Vec3& original, const Vec3& decoded) {
+            Vec3 delta = decoded - original;
+            float error = std::max(std::abs(delta.x), std::max(std::abs(delta.y), std::abs(delta.z)));
+            positionError = std::max(positionError, error);
+            if (error > bound) valid = false;
+        };
+        auto checkColor = [&](const Color& original, const Color& decoded) {
+            float error = std::max(std::max(std::abs(original.r - decoded.r), std::abs(original.g - decoded.g)),
+                                   std::max(std::abs(original.b - decoded.b), std::abs(original.a - decoded.a)));
+            colorError = std::max(colorError, error);
+            if (error > COLOR_BOUND) valid = false;
+        };
+        
+        for (size_t i = 0; i < geometry.vertices.size(); i++) {
+            const TerrainVertex& original = geometry.vertices[i];
+            TerrainVertex decoded = unpackVertex(packed, packed.vertices[i]);
+            checkPosition(original.position, decoded.position);
+            checkColor(original.color, decoded.color);
+            
+            float cosine = MathUtils::clamp(Vec3::dot(original.normal.normalized(), decoded.normal), -1.0f, 1.0f);
+            float degrees = MathUtils::toDegrees(std::acos(cosine));
+            normalError = std::max(normalError, degrees);
+            if (degrees > NORMAL_BOUND_DEGREES) valid = false;
+        }
+        for (size_t i = 0; i < geometry.indices.size(); i++) {
+            if (packed.indices[i] != geometry.indices[i]) valid = false;
+        }
+        for (size_t i = 0; i < geometry.instances.size(); i++) {
+            const RenderScene::Instance& original = geometry.instances[i];
+            RenderScene::Instance decoded = unpackInstance(packed, packed.instances[i]);
+            checkPosition(original.position, decoded.position);
+            checkColor(original.color, decoded.color);
+            scaleError = std::max(scaleError, std::abs(decoded.scale - original.scale));
+            if (std::abs(decoded.scale - original.scale) > bound || decoded.mesh != original.mesh) valid = false;
+        }
+    }
+    
+    std::cout << "Vertex formats: " << WORLD_SIDE << "x" << WORLD_SIDE << " cells in " << chunksX * chunksZ
+              << " chunks, " << vertexCount << " vertices, " << instanceCount << " instances" << std::endl;
+    std::cout << "  float geometry     " << floatBytes / 1024 << " KiB" << std::endl;
+    std::cout << "  packed geometry    " << packedBytes / 1024 << " KiB ("
+              << static_cast<double>(floatBytes) / packedBytes << "x smaller)" << std::endl;
+    std::cout << "  packing            " << packMs << " ms" << std::endl;
+    std::cout << "  position error     " << positionError << " (bound " << positionBound << ")" << std::endl;
+    std::cout << "  scale error        " << scaleError << std::endl;
+    std::cout << "  normal error       " << normalError << " degrees (bound " << NORMAL_BOUND_DEGREES << ")" << std::endl;
+    std::cout << "  colour error       " << colorError << " (bound " << COLOR_BOUND << ")" << std::endl;
+    std::cout << "  result             " << (valid ? "within bounds" : "OUT OF BOUNDS") << std::endl;
+    return valid;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "math_utils.h"
+#include "render_scene.h"
+#include <cstdint>
+#include <vector>
+
+class World;
+
+// Compact vertex and instance layouts for buffer-based rendering of terrain
+// chunks. Positions are 16-bit steps from a per-chunk origin, normals are
+// octahedral 2x8-bit (MathUtils::packNormalOct), colours RGBA8 and indices
+// 16-bit, since a chunk never has more than 65536 vertices.
+//
+// Sizes against the float layouts they replace:
+//   vertex     40 bytes (position, normal, colour)  ->  12 bytes
+//   index       4 bytes                             ->   2 bytes
+//   instance   36 bytes (RenderScene::Instance)     ->  16 bytes
+//
+// The step is chosen per chunk so its bounds fit the 16-bit range, which
+// keeps position error below half a step (about 0.0005 units for a chunk
+// 32 units across). GL_SHORT positions can be drawn directly with the chunk
+// origin and step folded into the model matrix.
+
+// Full-precision terrain vertex
+struct TerrainVertex {
+    Vec3 position;
+    Vec3 normal;
+    Color color;
+};
+
+struct PackedVertex {
+    int16_t position[3];   // Steps from the chunk origin
+    uint16_t normal;       // MathUtils::packNormalOct
+    uint32_t color;        // MathUtils::packColorRGBA8
+};
+
+struct PackedInstance {
+    int16_t position[3];   // Steps from the chunk origin
+    uint16_t scale;        // In steps
+    uint32_t color;        // MathUtils::packColorRGBA8
+    uint8_t mesh;          // RenderScene::Mesh
+    uint8_t padding[3];
+};
+
+static_assert(sizeof(PackedVertex) == 12, "PackedVertex should stay 12 bytes");
+static_assert(sizeof(PackedInstance) == 16, "PackedInstance should stay 16 bytes");
+
+// One terrain chunk at full precision: the visible faces of its cell
+// columns and the flower heads standing on them
+struct ChunkGeometry {
+    std::vector<TerrainVertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<RenderScene::Instance> instances;
+};
+
+struct PackedChunk {
+    Vec3 origin;           // World position of step (0, 0, 0)
+    float step;            // World units per position step
+    std::vector<PackedVertex> vertices;
+    std::vector<uint16_t> indices;
+    std::vector<PackedInstance> instances;
+};
+
+namespace VertexFormat {
+    // Cell tops with the terrain normal, plus walls down to lower neighbours
+    // (one unit deep at the world edge), coloured by cell type
+    void buildTerrainGeometry(const World& world, int chunkX, int chunkZ, ChunkGeometry& out);
+    
+    // False when the chunk has too many vertices for 16-bit indices
+    bool packChunk(const ChunkGeometry& geometry, PackedChunk& out);
+    
+    TerrainVertex unpackVertex(const PackedChunk& chunk, const PackedVertex& vertex);
+    RenderScene::Instance unpackInstance(const PackedChunk& chunk, const PackedInstance& instance);
+    
+    size_t getByteSize(const ChunkGeometry& geometry);
+    size_t getByteSize(const PackedChunk& chunk);
+    
+    // Validation mode: packs every chunk of a hilly flower world, unpacks it
+    // again and checks position, normal and colour error against the float
+    // geometry. Prints the errors, sizes and packing time; returns false if
+    // any error is outside its bound.
+    bool runVertexFormatBenchmark();
+}
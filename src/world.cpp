@@ -1,25 +1,102 @@
 #include "world.h"
+#include "cpu_features.h"
+#include "job_system.h"
+#include "logger.h"
+#include "map_file.h"
+#include "math_kernels.h"
+#include "terrain_chunk.h"
 #include <cmath>
 #include <algorithm>
-#include <iostream>
+#include <climits>
+
+namespace {
+
+#ifdef FLOWER_X86
+// Decodes four octahedral-packed normals into normalized SoA components,
+// matching MathUtils::unpackNormalOct lane by lane
+inline void unpackNormalsOct4(__m128i packed, __m128& nx, __m128& ny, __m128& nz) {
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 inv127 = _mm_set1_ps(1.0f / 127.0f);
+    const __m128i byteMask = _mm_set1_epi32(0xFF);
+    const __m128i bias = _mm_set1_epi32(127);
+    
+    __m128 u = _mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(_mm_and_si128(packed, byteMask), bias)), inv127);
+    __m128 v = _mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(_mm_and_si128(_mm_srli_epi32(packed, 8), byteMask), bias)), inv127);
+    __m128 absU = _mm_andnot_ps(signMask, u);
+    __m128 absV = _mm_andnot_ps(signMask, v);
+    __m128 y = _mm_sub_ps(_mm_sub_ps(one, absU), absV);
+    
+    // Unfold the lower hemisphere where y < 0
+    __m128 folded = _mm_cmplt_ps(y, _mm_setzero_ps());
+    __m128 unfoldedU = _mm_or_ps(_mm_sub_ps(one, absV), _mm_and_ps(u, signMask));
+    __m128 unfoldedV = _mm_or_ps(_mm_sub_ps(one, absU), _mm_and_ps(v, signMask));
+    u = _mm_or_ps(_mm_and_ps(folded, unfoldedU), _mm_andnot_ps(folded, u));
+    v = _mm_or_ps(_mm_and_ps(folded, unfoldedV), _mm_andnot_ps(folded, v));
+    
+    __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(u, u), _mm_mul_ps(y, y)), _mm_mul_ps(v, v)));
+    nx = _mm_div_ps(u, length);
+    ny = _mm_div_ps(y, length);
+    nz = _mm_div_ps(v, length);
+}
+#endif
+
+// Slab test of a ray against an axis-aligned box. On success 'entry' is the
+// distance at which the ray enters the box (0 when it starts inside) and
+// 'axis' the slab it entered through, or -1 when it starts inside.
+bool intersectRayBox(const Vec3& origin, const Vec3& direction, const Vec3& boxMin, const Vec3& boxMax,
+                     float maxDistance, float& entry, int& axis) {
+    const float origins[3] = { origin.x, origin.y, origin.z };
+    const float directions[3] = { direction.x, direction.y, direction.z };
+    const float mins[3] = { boxMin.x, boxMin.y, boxMin.z };
+    const float maxs[3] = { boxMax.x, boxMax.y, boxMax.z };
+    
+    float tNear = 0.0f;
+    float tFar = maxDistance;
+    axis = -1;
+    
+    for (int i = 0; i < 3; i++) {
+        if (directions[i] == 0.0f) {
+            // Parallel to the slab: inside it for the whole ray or never
+            if (origins[i] < mins[i] || origins[i] > maxs[i]) return false;
+            continue;
+        }
+        
+        float inverse = 1.0f / directions[i];
+        float t0 = (mins[i] - origins[i]) * inverse;
+        float t1 = (maxs[i] - origins[i]) * inverse;
+        if (t0 > t1) std::swap(t0, t1);
+        
+        if (t0 > tNear) {
+            tNear = t0;
+            axis = i;
+        }
+        tFar = std::min(tFar, t1);
+        if (tNear > tFar) return false;
+    }
+    
+    entry = tNear;
+    return true;
+}
+
+}  // namespace
 
 World::World(int width, int height)
     : width(width)
     , height(height)
+    , chunksX((width + CHUNK_SIZE - 1) / CHUNK_SIZE)
+    , chunksZ((height + CHUNK_SIZE - 1) / CHUNK_SIZE)
+    , entityCellsDirty(true)
+    , lightGridDirty(true)
+    , flowerLayer(width, height)
+    , dirtyMinX(INT_MAX)
+    , dirtyMinZ(INT_MAX)
+    , dirtyMaxX(INT_MIN)
+    , dirtyMaxZ(INT_MIN)
 {
-    cells.resize(width * height);
-    
-    // Initialize all cells
-    for (int z = 0; z < height; z++) {
-        for (int x = 0; x < width; x++) {
-            TerrainCell& cell = cells[cellIndex(x, z)];
-            cell.type = CellType::GRASS;
-            cell.height = 0.0f;
-            cell.normal = Vec3::up();
-            cell.color = Color(0.3f, 0.7f, 0.3f);  // Green grass
-            cell.entity = nullptr;
-        }
-    }
+    // Initialize all cells to flat grass, which needs no per-cell storage
+    chunks.resize(static_cast<size_t>(chunksX) * chunksZ);
+    resetChunks(CellType::GRASS, 0.0f);
     
     // Add default lighting
     lights.push_back(Light(Vec3(width / 2.0f, 20.0f, height / 2.0f), 
@@ -27,6 +104,8 @@ World::World(int width, int height)
 }
 
 World::~World() {
+    releaseMapFile();
+    
     // Clean up entities
     for (auto entity : entities) {
         delete entity;
@@ -35,62 +114,85 @@ World::~World() {
 }
 
 void World::update(float deltaTime) {
+    // Bring normals up to date with any height edits since the last frame
+    flushTerrainNormals();
+    
     // Update all entities
     for (auto entity : entities) {
         if (entity && entity->isActive()) {
             entity->update(deltaTime);
         }
     }
+    entityCellsDirty.store(true);
 }
 
 void World::setCell(int x, int z, CellType type) {
     if (isValidPosition(x, z)) {
-        TerrainCell& cell = cells[cellIndex(x, z)];
-        cell.type = type;
-        
-        // Set color based on type
-        switch (type) {
-            case CellType::GRASS:
-                cell.color = Color(0.3f, 0.7f, 0.3f);
-                break;
-            case CellType::DIRT:
-                cell.color = Color(0.5f, 0.3f, 0.2f);
-                break;
-            case CellType::FLOWER:
-                cell.color = Color(0.3f, 0.7f, 0.3f);  // Grass base
-                break;
-            case CellType::WATER:
-                cell.color = Color(0.2f, 0.4f, 0.8f);
-                break;
-            case CellType::STONE:
-                cell.color = Color(0.5f, 0.5f, 0.5f);
-                break;
-            case CellType::SAND:
-                cell.color = Color(0.9f, 0.8f, 0.6f);
-                break;
+        if (typeAt(x, z) != static_cast<uint8_t>(type)) {
+            TerrainChunk& chunk = editChunk(x / CHUNK_SIZE, z / CHUNK_SIZE);
+            chunk.types[localIndex(x, z)] = static_cast<uint8_t>(type);
+            chunk.dirty = true;
+            for (WorldListener* listener : listeners) {
+                listener->onCellChanged(x, z, type);
+            }
         }
+        flowerLayer.assign(x, z, type == CellType::FLOWER);
     }
 }
 
 World::CellType World::getCellType(int x, int z) const {
     if (isValidPosition(x, z)) {
-        return cells[cellIndex(x, z)].type;
+        return static_cast<CellType>(typeAt(x, z));
     }
     return CellType::GRASS;
 }
 
-World::TerrainCell* World::getCell(int x, int z) {
-    if (isValidPosition(x, z)) {
-        return &cells[cellIndex(x, z)];
+World::CellRef World::getCell(int x, int z) const {
+    if (!isValidPosition(x, z)) {
+        return CellRef();
     }
-    return nullptr;
+    
+    TerrainCell cell;
+    cell.type = static_cast<CellType>(typeAt(x, z));
+    cell.height = heightAt(x, z);
+    cell.normal = MathUtils::unpackNormalOct(normalAt(x, z));
+    cell.color = getCellTypeColor(cell.type);
+    cell.entity = getCellEntity(x, z);
+    return CellRef(cell);
 }
 
-const World::TerrainCell* World::getCell(int x, int z) const {
-    if (isValidPosition(x, z)) {
-        return &cells[cellIndex(x, z)];
+Color World::getCellTypeColor(CellType type) {
+    switch (type) {
+        case CellType::GRASS:
+            return Color(0.3f, 0.7f, 0.3f);
+        case CellType::DIRT:
+            return Color(0.5f, 0.3f, 0.2f);
+        case CellType::FLOWER:
+            return Color(0.3f, 0.7f, 0.3f);  // Grass base
+        case CellType::WATER:
+            return Color(0.2f, 0.4f, 0.8f);
+        case CellType::STONE:
+            return Color(0.5f, 0.5f, 0.5f);
+        case CellType::SAND:
+            return Color(0.9f, 0.8f, 0.6f);
+    }
+    return Color(0.3f, 0.7f, 0.3f);
+}
+
+int World::getFlowerSpecies(int x, int z) {
+    int species = (x * 7 + z * 13) % FLOWER_SPECIES_COUNT;
+    return species < 0 ? species + FLOWER_SPECIES_COUNT : species;
+}
+
+Color World::getFlowerSpeciesColor(int species) {
+    switch (species) {
+        case 0: return Color(1.0f, 0.8f, 0.0f);  // Yellow
+        case 1: return Color(1.0f, 0.2f, 0.3f);  // Red
+        case 2: return Color(1.0f, 0.4f, 0.6f);  // Pink
+        case 3: return Color(0.9f, 0.9f, 1.0f);  // White
+        case 4: return Color(0.6f, 0.3f, 0.9f);  // Purple
+        default: return Color(1.0f, 0.6f, 0.2f);  // Orange
     }
-    return nullptr;
 }
 
 bool World::isValidPosition(int x, int z) const {
@@ -99,43 +201,528 @@ bool World::isValidPosition(int x, int z) const {
 
 float World::getTerrainHeight(int x, int z) const {
     if (isValidPosition(x, z)) {
-        return cells[cellIndex(x, z)].height;
+        return heightAt(x, z);
     }
     return 0.0f;
 }
 
 float World::getTerrainHeight(const Vec3& worldPos) const {
-    GridPos gridPos = worldToGrid(worldPos);
-    return getTerrainHeight(gridPos.x, gridPos.z);
+    BilinearSample sample = bilinearSetup(worldPos.x, worldPos.z);
+    if (!sample.inside) return 0.0f;
+    
+    float top = MathUtils::lerp(heightAt(sample.x0, sample.z0), heightAt(sample.x1, sample.z0), sample.tx);
+    float bottom = MathUtils::lerp(heightAt(sample.x0, sample.z1), heightAt(sample.x1, sample.z1), sample.tx);
+    return MathUtils::lerp(top, bottom, sample.tz);
 }
 
 Vec3 World::getTerrainNormal(int x, int z) const {
     if (isValidPosition(x, z)) {
-        return cells[cellIndex(x, z)].normal;
+        return MathUtils::unpackNormalOct(normalAt(x, z));
     }
     return Vec3::up();
 }
 
 Vec3 World::getTerrainNormal(const Vec3& worldPos) const {
-    GridPos gridPos = worldToGrid(worldPos);
-    return getTerrainNormal(gridPos.x, gridPos.z);
+    BilinearSample sample = bilinearSetup(worldPos.x, worldPos.z);
+    if (!sample.inside) return Vec3::up();
+    return blendNormals(sample);
+}
+
+World::BilinearSample World::bilinearSetup(float worldX, float worldZ) const {
+    BilinearSample sample;
+    sample.inside = worldX >= 0.0f && worldX < width && worldZ >= 0.0f && worldZ < height;
+    
+    // Cell centres sit at (x + 0.5, z + 0.5); clamp corners at the edges
+    float fx = worldX - 0.5f;
+    float fz = worldZ - 0.5f;
+    float floorX = std::floor(fx);
+    float floorZ = std::floor(fz);
+    sample.tx = fx - floorX;
+    sample.tz = fz - floorZ;
+    
+    sample.x0 = std::max(0, std::min(static_cast<int>(floorX), width - 1));
+    sample.x1 = std::max(0, std::min(static_cast<int>(floorX) + 1, width - 1));
+    sample.z0 = std::max(0, std::min(static_cast<int>(floorZ), height - 1));
+    sample.z1 = std::max(0, std::min(static_cast<int>(floorZ) + 1, height - 1));
+    return sample;
+}
+
+Vec3 World::blendNormals(const BilinearSample& sample) const {
+    Vec3 n00 = MathUtils::unpackNormalOct(normalAt(sample.x0, sample.z0));
+    Vec3 n10 = MathUtils::unpackNormalOct(normalAt(sample.x1, sample.z0));
+    Vec3 n01 = MathUtils::unpackNormalOct(normalAt(sample.x0, sample.z1));
+    Vec3 n11 = MathUtils::unpackNormalOct(normalAt(sample.x1, sample.z1));
+    
+    Vec3 top = n00 + (n10 - n00) * sample.tx;
+    Vec3 bottom = n01 + (n11 - n01) * sample.tx;
+    Vec3 normal = (top + (bottom - top) * sample.tz).normalized();
+    return normal.lengthSquared() > 0.0f ? normal : Vec3::up();
+}
+
+void World::sampleTerrainHeights(const float* xs, const float* zs, float* outHeights, size_t count) const {
+    size_t i = 0;
+    
+#ifdef FLOWER_X86
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 worldW = _mm_set1_ps(static_cast<float>(width));
+    const __m128 worldH = _mm_set1_ps(static_cast<float>(height));
+    
+    alignas(16) int cornerX[4];
+    alignas(16) int cornerZ[4];
+    alignas(16) float h00[4], h10[4], h01[4], h11[4];
+    
+    for (; i + 4 <= count; i += 4) {
+        __m128 px = _mm_loadu_ps(xs + i);
+        __m128 pz = _mm_loadu_ps(zs + i);
+        __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(px, zero), _mm_cmplt_ps(px, worldW)),
+                                   _mm_and_ps(_mm_cmpge_ps(pz, zero), _mm_cmplt_ps(pz, worldH)));
+        
+        // floor() via truncation, corrected where truncation rounded up
+        __m128 fx = _mm_sub_ps(px, half);
+        __m128 fz = _mm_sub_ps(pz, half);
+        __m128i ix = _mm_cvttps_epi32(fx);
+        __m128i iz = _mm_cvttps_epi32(fz);
+        __m128 truncX = _mm_cvtepi32_ps(ix);
+        __m128 truncZ = _mm_cvtepi32_ps(iz);
+        __m128 fixX = _mm_cmpgt_ps(truncX, fx);
+        __m128 fixZ = _mm_cmpgt_ps(truncZ, fz);
+        ix = _mm_add_epi32(ix, _mm_castps_si128(fixX));
+        iz = _mm_add_epi32(iz, _mm_castps_si128(fixZ));
+        __m128 tx = _mm_sub_ps(fx, _mm_sub_ps(truncX, _mm_and_ps(fixX, one)));
+        __m128 tz = _mm_sub_ps(fz, _mm_sub_ps(truncZ, _mm_and_ps(fixZ, one)));
+        
+        // Fetch the four corners of each lane (no gather in SSE2)
+        _mm_store_si128(reinterpret_cast<__m128i*>(cornerX), ix);
+        _mm_store_si128(reinterpret_cast<__m128i*>(cornerZ), iz);
+        for (int lane = 0; lane < 4; lane++) {
+            int x0 = std::max(0, std::min(cornerX[lane], width - 1));
+            int x1 = std::max(0, std::min(cornerX[lane] + 1, width - 1));
+            int z0 = std::max(0, std::min(cornerZ[lane], height - 1));
+            int z1 = std::max(0, std::min(cornerZ[lane] + 1, height - 1));
+            h00[lane] = heightAt(x0, z0);
+            h10[lane] = heightAt(x1, z0);
+            h01[lane] = heightAt(x0, z1);
+            h11[lane] = heightAt(x1, z1);
+        }
+        
+        __m128 a00 = _mm_load_ps(h00);
+        __m128 a01 = _mm_load_ps(h01);
+        __m128 top = _mm_add_ps(a00, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(h10), a00), tx));
+        __m128 bottom = _mm_add_ps(a01, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(h11), a01), tx));
+        __m128 result = _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), tz));
+        _mm_storeu_ps(outHeights + i, _mm_and_ps(result, inside));
+    }
+#endif
+    
+    for (; i < count; i++) {
+        outHeights[i] = getTerrainHeight(Vec3(xs[i], 0.0f, zs[i]));
+    }
+}
+
+void World::sampleTerrainNormals(const float* xs, const float* zs, Vec3* outNormals, size_t count) const {
+    size_t i = 0;
+    
+#ifdef FLOWER_X86
+    alignas(16) int corners[4][4];
+    alignas(16) float weightX[4], weightZ[4], insideMask[4];
+    alignas(16) float outX[4], outY[4], outZ[4];
+    
+    for (; i + 4 <= count; i += 4) {
+        for (int lane = 0; lane < 4; lane++) {
+            BilinearSample sample = bilinearSetup(xs[i + lane], zs[i + lane]);
+            corners[0][lane] = normalAt(sample.x0, sample.z0);
+            corners[1][lane] = normalAt(sample.x1, sample.z0);
+            corners[2][lane] = normalAt(sample.x0, sample.z1);
+            corners[3][lane] = normalAt(sample.x1, sample.z1);
+            weightX[lane] = sample.tx;
+            weightZ[lane] = sample.tz;
+            insideMask[lane] = sample.inside ? 1.0f : 0.0f;
+        }
+        
+        __m128 x[4], y[4], z[4];
+        for (int c = 0; c < 4; c++) {
+            unpackNormalsOct4(_mm_load_si128(reinterpret_cast<const __m128i*>(corners[c])), x[c], y[c], z[c]);
+        }
+        
+        __m128 tx = _mm_load_ps(weightX);
+        __m128 tz = _mm_load_ps(weightZ);
+        __m128 topX = _mm_add_ps(x[0], _mm_mul_ps(_mm_sub_ps(x[1], x[0]), tx));
+        __m128 topY = _mm_add_ps(y[0], _mm_mul_ps(_mm_sub_ps(y[1], y[0]), tx));
+        __m128 topZ = _mm_add_ps(z[0], _mm_mul_ps(_mm_sub_ps(z[1], z[0]), tx));
+        __m128 bottomX = _mm_add_ps(x[2], _mm_mul_ps(_mm_sub_ps(x[3], x[2]), tx));
+        __m128 bottomY = _mm_add_ps(y[2], _mm_mul_ps(_mm_sub_ps(y[3], y[2]), tx));
+        __m128 bottomZ = _mm_add_ps(z[2], _mm_mul_ps(_mm_sub_ps(z[3], z[2]), tx));
+        _mm_store_ps(outX, _mm_add_ps(topX, _mm_mul_ps(_mm_sub_ps(bottomX, topX), tz)));
+        _mm_store_ps(outY, _mm_add_ps(topY, _mm_mul_ps(_mm_sub_ps(bottomY, topY), tz)));
+        _mm_store_ps(outZ, _mm_add_ps(topZ, _mm_mul_ps(_mm_sub_ps(bottomZ, topZ), tz)));
+        
+        for (int lane = 0; lane < 4; lane++) {
+            Vec3 normal = Vec3(outX[lane], outY[lane], outZ[lane]).normalized();
+            bool usable = insideMask[lane] != 0.0f && normal.lengthSquared() > 0.0f;
+            outNormals[i + lane] = usable ? normal : Vec3::up();
+        }
+    }
+#endif
+    
+    for (; i < count; i++) {
+        BilinearSample sample = bilinearSetup(xs[i], zs[i]);
+        outNormals[i] = sample.inside ? blendNormals(sample) : Vec3::up();
+    }
 }
 
 void World::setTerrainHeight(int x, int z, float height) {
-    if (isValidPosition(x, z)) {
-        cells[cellIndex(x, z)].height = height;
+    if (isValidPosition(x, z) && heightAt(x, z) != height) {
+        TerrainChunk& chunk = editChunk(x / CHUNK_SIZE, z / CHUNK_SIZE);
+        chunk.heights[localIndex(x, z)] = height;
+        chunk.dirty = true;
+        markTerrainDirty(x, z, x, z);
+        for (WorldListener* listener : listeners) {
+            listener->onTerrainHeightChanged(x, z, height);
+        }
     }
 }
 
 void World::calculateTerrainNormals() {
     // Calculate normals for all cells based on surrounding heights
-    for (int z = 0; z < height; z++) {
-        for (int x = 0; x < width; x++) {
-            calculateCellNormal(x, z);
+    markTerrainDirty(0, 0, width - 1, height - 1);
+    flushTerrainNormals();
+}
+
+void World::markTerrainDirty(int minX, int minZ, int maxX, int maxZ) {
+    dirtyMinX = std::min(dirtyMinX, minX);
+    dirtyMinZ = std::min(dirtyMinZ, minZ);
+    dirtyMaxX = std::max(dirtyMaxX, maxX);
+    dirtyMaxZ = std::max(dirtyMaxZ, maxZ);
+}
+
+void World::flushTerrainNormals() {
+    if (!hasDirtyTerrain()) return;
+    
+    // A height change affects the normals of its four neighbours too
+    int x0 = std::max(0, dirtyMinX - 1);
+    int z0 = std::max(0, dirtyMinZ - 1);
+    int x1 = std::min(width - 1, dirtyMaxX + 1);
+    int z1 = std::min(height - 1, dirtyMaxZ + 1);
+    
+    dirtyMinX = dirtyMinZ = INT_MAX;
+    dirtyMaxX = dirtyMaxZ = INT_MIN;
+    
+    if (x0 > x1 || z0 > z1) return;
+    
+    // Work one chunk tile at a time so a collapsed chunk whose normals come
+    // out unchanged stays collapsed
+    float rows[3][CHUNK_SIZE + 2];
+    uint16_t tile[CHUNK_SIZE * CHUNK_SIZE];
+    uint16_t packedUp = MathUtils::packNormalOct(Vec3::up());
+    
+    for (int cz = z0 / CHUNK_SIZE; cz <= z1 / CHUNK_SIZE; cz++) {
+        for (int cx = x0 / CHUNK_SIZE; cx <= x1 / CHUNK_SIZE; cx++) {
+            int tileX0 = std::max(x0, cx * CHUNK_SIZE);
+            int tileX1 = std::min(x1, cx * CHUNK_SIZE + CHUNK_SIZE - 1);
+            int tileZ0 = std::max(z0, cz * CHUNK_SIZE);
+            int tileZ1 = std::min(z1, cz * CHUNK_SIZE + CHUNK_SIZE - 1);
+            int tileWidth = tileX1 - tileX0 + 1;
+            
+            // Row buffers hold the tile plus one neighbour column on each
+            // side, except at the world edge where the kernel clamps
+            int bufferX0 = std::max(0, tileX0 - 1);
+            int bufferX1 = std::min(width - 1, tileX1 + 1);
+            int bufferWidth = bufferX1 - bufferX0 + 1;
+            
+            const ChunkSlot& slot = chunkSlot(cz * chunksX + cx);
+            if (isFlatNeighbourhood(cx, cz) && slot.uniformNormal == packedUp) continue;
+            bool changed = slot.data != nullptr;
+            
+            for (int z = tileZ0; z <= tileZ1; z++) {
+                copyHeightRow(std::max(z - 1, 0), bufferX0, bufferX1, rows[0]);
+                copyHeightRow(z, bufferX0, bufferX1, rows[1]);
+                copyHeightRow(std::min(z + 1, height - 1), bufferX0, bufferX1, rows[2]);
+                
+                uint16_t* out = tile + (z - tileZ0) * CHUNK_SIZE;
+                packHeightfieldNormalsRow(rows[0], rows[1], rows[2], bufferWidth,
+                                          tileX0 - bufferX0, tileX1 - bufferX0, out);
+                for (int i = 0; i < tileWidth && !changed; i++) {
+                    changed = out[i] != slot.uniformNormal;
+                }
+            }
+            
+            if (!changed) continue;
+            
+            TerrainChunk& chunk = editChunk(cx, cz);
+            for (int z = tileZ0; z <= tileZ1; z++) {
+                std::copy(tile + (z - tileZ0) * CHUNK_SIZE, tile + (z - tileZ0) * CHUNK_SIZE + tileWidth,
+                          chunk.normals + localIndex(tileX0, z));
+            }
+        }
+    }
+}
+
+bool World::isFlatNeighbourhood(int chunkX, int chunkZ) const {
+    // A collapsed chunk next to collapsed chunks of the same height is flat
+    // all the way to its border, so every normal in it points up
+    const ChunkSlot& slot = chunkSlot(chunkZ * chunksX + chunkX);
+    if (slot.data) return false;
+    
+    static const int offsets[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    for (const auto& offset : offsets) {
+        int nx = chunkX + offset[0];
+        int nz = chunkZ + offset[1];
+        if (nx < 0 || nx >= chunksX || nz < 0 || nz >= chunksZ) continue;
+        
+        const ChunkSlot& neighbour = chunkSlot(nz * chunksX + nx);
+        if (neighbour.data || neighbour.uniformHeight != slot.uniformHeight) return false;
+    }
+    return true;
+}
+
+void World::copyHeightRow(int z, int x0, int x1, float* out) const {
+    for (int x = x0; x <= x1;) {
+        const ChunkSlot& slot = slotAt(x, z);
+        int segmentEnd = std::min(x1, (x / CHUNK_SIZE) * CHUNK_SIZE + CHUNK_SIZE - 1);
+        if (slot.data) {
+            const float* source = slot.data->heights + localIndex(x, z);
+            out = std::copy(source, source + (segmentEnd - x + 1), out);
+        } else {
+            out = std::fill_n(out, segmentEnd - x + 1, slot.uniformHeight);
+        }
+        x = segmentEnd + 1;
+    }
+}
+
+TerrainChunk& World::editChunk(int chunkX, int chunkZ) {
+    int index = chunkZ * chunksX + chunkX;
+    chunkSlot(index);
+    
+    ChunkSlot& slot = chunks[index];
+    if (!slot.data) {
+        slot.data.reset(new TerrainChunk(slot.uniformType, slot.uniformHeight));
+        std::fill(slot.data->normals, slot.data->normals + TerrainChunk::CELL_COUNT, slot.uniformNormal);
+    }
+    return *slot.data;
+}
+
+void World::resetChunks(CellType type, float height) {
+    releaseMapFile();
+    
+    uint16_t up = MathUtils::packNormalOct(Vec3::up());
+    for (ChunkSlot& slot : chunks) {
+        slot.data.reset();
+        slot.uniformType = static_cast<uint8_t>(type);
+        slot.uniformHeight = height;
+        slot.uniformNormal = up;
+    }
+}
+
+void World::decodeChunk(int index) const {
+    std::lock_guard<std::mutex> lock(decodeMutex);
+    if (!pendingChunks[index].load(std::memory_order_relaxed)) return;
+    
+    ChunkSlot& slot = chunks[index];
+    std::unique_ptr<TerrainChunk> chunk(new TerrainChunk(slot.uniformType, slot.uniformHeight));
+    if (mapFile->decodeChunk(index, *chunk) &&
+        std::all_of(chunk->types, chunk->types + TerrainChunk::CELL_COUNT,
+                    [](uint8_t type) { return type < CELL_TYPE_COUNT; })) {
+        slot.data = std::move(chunk);
+    } else {
+        // Keep the world usable; the chunk reads as its table value instead
+        LOG_ERROR("Failed to decode map chunk {}", index);
+    }
+    pendingChunks[index].store(false, std::memory_order_release);
+}
+
+bool World::chunkMayContain(int index, uint8_t type) const {
+    if (pendingChunks && pendingChunks[index].load(std::memory_order_acquire)) {
+        return (mapFile->getChunkEntry(index).typeMask >> type) & 1;
+    }
+    const ChunkSlot& slot = chunks[index];
+    return slot.data || slot.uniformType == type;
+}
+
+void World::releaseMapFile() {
+    pendingChunks.reset();
+    mapFile.reset();
+}
+
+bool World::saveMapFile(const std::string& path) const {
+    std::vector<MapFile::ChunkSource> sources(chunks.size());
+    for (size_t i = 0; i < chunks.size(); i++) {
+        const ChunkSlot& slot = chunkSlot(static_cast<int>(i));
+        sources[i].data = slot.data.get();
+        sources[i].uniformType = slot.uniformType;
+        sources[i].uniformHeight = slot.uniformHeight;
+        sources[i].uniformNormal = slot.uniformNormal;
+    }
+    
+    if (!MapFile::save(path, width, height, sources)) return false;
+    LOG_INFO("Saved map file: {}", path);
+    return true;
+}
+
+bool World::loadMapFile(const std::string& path) {
+    std::unique_ptr<MapFile> file(new MapFile());
+    if (!file->open(path)) return false;
+    
+    if (file->getWidth() != width || file->getHeight() != height) {
+        LOG_ERROR("Map dimensions don't match world dimensions");
+        return false;
+    }
+    
+    // Cell types index colour and flower tables, so reject any we don't know
+    for (int i = 0; i < file->getChunkCount(); i++) {
+        const MapFile::ChunkEntry& entry = file->getChunkEntry(i);
+        if (entry.uniformType >= CELL_TYPE_COUNT || (entry.typeMask >> CELL_TYPE_COUNT) != 0) {
+            LOG_ERROR("Invalid cell type in map file: {}", path);
+            return false;
+        }
+    }
+    
+    // Uniform chunks are complete from the table alone; the rest stay
+    // pending until something reads them
+    resetChunks(CellType::GRASS, 0.0f);
+    pendingChunks.reset(new std::atomic<bool>[chunks.size()]);
+    for (size_t i = 0; i < chunks.size(); i++) {
+        const MapFile::ChunkEntry& entry = file->getChunkEntry(static_cast<int>(i));
+        chunks[i].uniformType = entry.uniformType;
+        chunks[i].uniformHeight = entry.uniformHeight;
+        chunks[i].uniformNormal = entry.uniformNormal;
+        pendingChunks[i].store(entry.payloadOffset != 0, std::memory_order_relaxed);
+    }
+    mapFile = std::move(file);
+    
+    dirtyMinX = dirtyMinZ = INT_MAX;
+    dirtyMaxX = dirtyMaxZ = INT_MIN;
+    rebuildFlowerLayer();
+    notifyTerrainReset();
+    
+    LOG_INFO("Loaded map file: {}", path);
+    return true;
+}
+
+void World::copyTerrain(const World& source) {
+    releaseMapFile();
+    for (size_t i = 0; i < chunks.size(); i++) {
+        const ChunkSlot& from = source.chunkSlot(static_cast<int>(i));
+        ChunkSlot& slot = chunks[i];
+        slot.data.reset(from.data ? new TerrainChunk(*from.data) : nullptr);
+        slot.uniformType = from.uniformType;
+        slot.uniformHeight = from.uniformHeight;
+        slot.uniformNormal = from.uniformNormal;
+    }
+    
+    dirtyMinX = source.dirtyMinX;
+    dirtyMinZ = source.dirtyMinZ;
+    dirtyMaxX = source.dirtyMaxX;
+    dirtyMaxZ = source.dirtyMaxZ;
+    rebuildFlowerLayer();
+    notifyTerrainReset();
+}
+
+void World::resize(int newWidth, int newHeight) {
+    releaseMapFile();
+    width = newWidth;
+    height = newHeight;
+    chunksX = (width + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    chunksZ = (height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    chunks.clear();
+    chunks.resize(static_cast<size_t>(chunksX) * chunksZ);
+    resetChunks(CellType::GRASS, 0.0f);
+    
+    cellEntities.clear();
+    flowerLayer = FlowerBitboard(width, height);
+    dirtyMinX = dirtyMinZ = INT_MAX;
+    dirtyMaxX = dirtyMaxZ = INT_MIN;
+    notifyTerrainReset();
+}
+
+void World::pageInChunk(int chunkX, int chunkZ, std::unique_ptr<TerrainChunk> chunk) {
+    ChunkSlot& slot = chunks[chunkZ * chunksX + chunkX];
+    chunk->dirty = false;
+    slot.data = std::move(chunk);
+    notifyChunkReplaced(chunkX, chunkZ);
+}
+
+std::unique_ptr<TerrainChunk> World::pageOutChunk(int chunkX, int chunkZ) {
+    ChunkSlot& slot = chunks[chunkZ * chunksX + chunkX];
+    std::unique_ptr<TerrainChunk> chunk = std::move(slot.data);
+    slot.uniformType = static_cast<uint8_t>(CellType::GRASS);
+    slot.uniformHeight = 0.0f;
+    slot.uniformNormal = MathUtils::packNormalOct(Vec3::up());
+    notifyChunkReplaced(chunkX, chunkZ);
+    return chunk;
+}
+
+std::unique_ptr<TerrainChunk> World::copyDirtyChunk(int chunkX, int chunkZ) {
+    ChunkSlot& slot = chunks[chunkZ * chunksX + chunkX];
+    if (!slot.data || !slot.data->dirty) return nullptr;
+    
+    std::unique_ptr<TerrainChunk> copy(new TerrainChunk(*slot.data));
+    slot.data->dirty = false;
+    return copy;
+}
+
+void World::notifyChunkReplaced(int chunkX, int chunkZ) {
+    int x0 = chunkX * CHUNK_SIZE;
+    int z0 = chunkZ * CHUNK_SIZE;
+    int x1 = std::min(x0 + CHUNK_SIZE, width) - 1;
+    int z1 = std::min(z0 + CHUNK_SIZE, height) - 1;
+    
+    for (int z = z0; z <= z1; z++) {
+        for (int x = x0; x <= x1; x++) {
+            flowerLayer.assign(x, z, typeAt(x, z) == static_cast<uint8_t>(CellType::FLOWER));
+        }
+    }
+    
+    // Paged chunks bring their own normals, so nothing is marked dirty here
+    for (WorldListener* listener : listeners) {
+        listener->onTerrainRegionChanged(x0, z0, x1, z1);
+    }
+}
+
+void World::compactStorage() {
+    for (int cz = 0; cz < chunksZ; cz++) {
+        for (int cx = 0; cx < chunksX; cx++) {
+            ChunkSlot& slot = chunks[cz * chunksX + cx];
+            if (!slot.data) continue;
+            
+            // Only cells inside the world count; edge chunks have unused padding
+            const TerrainChunk& chunk = *slot.data;
+            int chunkWidth = std::min(CHUNK_SIZE, width - cx * CHUNK_SIZE);
+            int chunkHeight = std::min(CHUNK_SIZE, height - cz * CHUNK_SIZE);
+            uint8_t type = chunk.types[0];
+            float cellHeight = chunk.heights[0];
+            uint16_t normal = chunk.normals[0];
+            
+            bool uniform = true;
+            for (int lz = 0; lz < chunkHeight && uniform; lz++) {
+                for (int lx = 0; lx < chunkWidth; lx++) {
+                    int idx = TerrainChunk::index(lx, lz);
+                    if (chunk.types[idx] != type || chunk.heights[idx] != cellHeight || chunk.normals[idx] != normal) {
+                        uniform = false;
+                        break;
+                    }
+                }
+            }
+            
+            if (uniform) {
+                slot.uniformType = type;
+                slot.uniformHeight = cellHeight;
+                slot.uniformNormal = normal;
+                slot.data.reset();
+            }
         }
     }
 }
 
+int World::getExpandedChunkCount() const {
+    int count = 0;
+    for (const ChunkSlot& slot : chunks) {
+        if (slot.data) count++;
+    }
+    return count;
+}
+
 void World::calculateCellNormal(int x, int z) {
     if (!isValidPosition(x, z)) return;
     
@@ -146,24 +733,18 @@ void World::calculateCellNormal(int x, int z) {
     float hBack = isValidPosition(x, z - 1) ? getTerrainHeight(x, z - 1) : h;
     float hForward = isValidPosition(x, z + 1) ? getTerrainHeight(x, z + 1) : h;
     
-    // Calculate tangent vectors
-    Vec3 tangentX(2.0f, hRight - hLeft, 0.0f);
-    Vec3 tangentZ(0.0f, hForward - hBack, 2.0f);
-    
-    // Calculate normal via cross product
-    Vec3 normal = Vec3::cross(tangentZ, tangentX).normalized();
-    
-    // Ensure normal points upward
-    if (normal.y < 0) {
-        normal = normal * -1.0f;
+    // Same result as cross(tangentZ, tangentX) with tangentX = (2, hRight - hLeft, 0)
+    // and tangentZ = (0, hForward - hBack, 2); shared with the row kernel
+    uint16_t normal = MathUtils::packHeightfieldNormal(hLeft, hRight, hBack, hForward);
+    if (normalAt(x, z) != normal) {
+        editChunk(x / CHUNK_SIZE, z / CHUNK_SIZE).normals[localIndex(x, z)] = normal;
     }
-    
-    cells[cellIndex(x, z)].normal = normal;
 }
 
 void World::addEntity(Entity* entity) {
     if (entity) {
         entities.push_back(entity);
+        entityCellsDirty.store(true);
     }
 }
 
@@ -171,9 +752,66 @@ void World::removeEntity(Entity* entity) {
     auto it = std::find(entities.begin(), entities.end(), entity);
     if (it != entities.end()) {
         entities.erase(it);
+        entityCellsDirty.store(true);
+    }
+    
+    // Detach from any cell still referencing it
+    for (auto cellIt = cellEntities.begin(); cellIt != cellEntities.end();) {
+        if (cellIt->second == entity) {
+            for (WorldListener* listener : listeners) {
+                listener->onCellEntityChanged(cellIt->first % width, cellIt->first / width, nullptr);
+            }
+            cellIt = cellEntities.erase(cellIt);
+        } else {
+            ++cellIt;
+        }
+    }
+}
+
+void World::rebuildFlowerLayer() {
+    flowerLayer.clearAll();
+    forEachCellOfType(CellType::FLOWER, [this](int x, int z) {
+        flowerLayer.set(x, z);
+    });
+}
+
+void World::setCellEntity(int x, int z, Entity* entity) {
+    if (!isValidPosition(x, z)) return;
+    
+    if (entity) {
+        cellEntities[cellIndex(x, z)] = entity;
+    } else {
+        cellEntities.erase(cellIndex(x, z));
+    }
+    
+    for (WorldListener* listener : listeners) {
+        listener->onCellEntityChanged(x, z, entity);
+    }
+}
+
+void World::addListener(WorldListener* listener) {
+    if (listener && std::find(listeners.begin(), listeners.end(), listener) == listeners.end()) {
+        listeners.push_back(listener);
     }
 }
 
+void World::removeListener(WorldListener* listener) {
+    listeners.erase(std::remove(listeners.begin(), listeners.end(), listener), listeners.end());
+}
+
+void World::notifyTerrainReset() {
+    for (WorldListener* listener : listeners) {
+        listener->onTerrainReset();
+    }
+}
+
+Entity* World::getCellEntity(int x, int z) const {
+    if (!isValidPosition(x, z)) return nullptr;
+    
+    auto it = cellEntities.find(cellIndex(x, z));
+    return it != cellEntities.end() ? it->second : nullptr;
+}
+
 Entity* World::getEntityAt(const Vec3& position, float radius) {
     for (auto entity : entities) {
         if (entity && entity->isActive()) {
@@ -189,7 +827,7 @@ Entity* World::getEntityAt(const Vec3& position, float radius) {
 bool World::loadPrefabricatedMap(const std::string& mapName) {
     auto it = prefabricatedMaps.find(mapName);
     if (it == prefabricatedMaps.end()) {
-        std::cerr << "Map not found: " << mapName << std::endl;
+        LOG_ERROR("Map not found: {}", mapName);
         return false;
     }
     
@@ -199,23 +837,27 @@ bool World::loadPrefabricatedMap(const std::string& mapName) {
     if (mapData.width == width && mapData.height == height) {
         for (int z = 0; z < height; z++) {
             for (int x = 0; x < width; x++) {
-                int idx = cellIndex(x, z);
+                size_t idx = static_cast<size_t>(cellIndex(x, z));
+                TerrainChunk& chunk = editChunk(x / CHUNK_SIZE, z / CHUNK_SIZE);
                 if (idx < mapData.cells.size()) {
-                    cells[idx].type = mapData.cells[idx];
+                    chunk.types[localIndex(x, z)] = static_cast<uint8_t>(mapData.cells[idx]);
                 }
                 if (idx < mapData.heights.size()) {
-                    cells[idx].height = mapData.heights[idx];
+                    chunk.heights[localIndex(x, z)] = mapData.heights[idx];
                 }
             }
         }
         
         calculateTerrainNormals();
+        compactStorage();
+        rebuildFlowerLayer();
+        notifyTerrainReset();
         
-        std::cout << "Loaded prefabricated map: " << mapName << std::endl;
+        LOG_INFO("Loaded prefabricated map: {}", mapName);
         return true;
     }
     
-    std::cerr << "Map dimensions don't match world dimensions" << std::endl;
+    LOG_ERROR("Map dimensions don't match world dimensions");
     return false;
 }
 
@@ -227,9 +869,14 @@ void World::savePrefabricatedMap(const std::string& mapName) {
     mapData.height = height;
     
     // Save terrain data
-    for (const auto& cell : cells) {
-        mapData.cells.push_back(cell.type);
-        mapData.heights.push_back(cell.height);
+    size_t cellCount = static_cast<size_t>(width) * height;
+    mapData.cells.reserve(cellCount);
+    mapData.heights.reserve(cellCount);
+    for (int z = 0; z < height; z++) {
+        for (int x = 0; x < width; x++) {
+            mapData.cells.push_back(static_cast<CellType>(typeAt(x, z)));
+            mapData.heights.push_back(heightAt(x, z));
+        }
     }
     
     // Save entity positions
@@ -241,7 +888,7 @@ void World::savePrefabricatedMap(const std::string& mapName) {
     }
     
     prefabricatedMaps[mapName] = mapData;
-    std::cout << "Saved prefabricated map: " << mapName << std::endl;
+    LOG_INFO("Saved prefabricated map: {}", mapName);
 }
 
 World::MapData* World::createCustomMap(const std::string& name, const std::string& description) {
@@ -256,86 +903,192 @@ World::MapData* World::createCustomMap(const std::string& name, const std::strin
 }
 
 void World::generateFlatTerrain() {
-    for (int z = 0; z < height; z++) {
-        for (int x = 0; x < width; x++) {
-            cells[cellIndex(x, z)].type = CellType::GRASS;
-            cells[cellIndex(x, z)].height = 0.0f;
-            cells[cellIndex(x, z)].normal = Vec3::up();
-        }
-    }
+    resetChunks(CellType::GRASS, 0.0f);
+    flowerLayer.clearAll();
+    notifyTerrainReset();
 }
 
 void World::generateHillyTerrain(float amplitude, float frequency) {
-    // Generate simple hills using sine waves
-    for (int z = 0; z < height; z++) {
-        for (int x = 0; x < width; x++) {
-            float h = amplitude * (
-                std::sin(x * frequency) * std::cos(z * frequency) +
-                std::sin(x * frequency * 0.7f) * std::cos(z * frequency * 1.3f) * 0.5f
-            );
+    // Hills come from the fractal generator with its default shape
+    TerrainGenerator::Settings settings;
+    settings.amplitude = amplitude;
+    settings.frequency = frequency;
+    generateFractalTerrain(settings);
+}
+
+void World::generateFractalTerrain(const TerrainGenerator::Settings& settings) {
+    TerrainGenerator generator(settings);
+    releaseMapFile();
+    
+    // Chunks own disjoint storage, so they can run on any thread
+    JobSystem::instance().parallelFor(0, chunksX * chunksZ, 1, [&](int first, int last) {
+        for (int chunkIndex = first; chunkIndex < last; chunkIndex++) {
+            int x0 = (chunkIndex % chunksX) * CHUNK_SIZE;
+            int z0 = (chunkIndex / chunksX) * CHUNK_SIZE;
+            int blockWidth = std::min(CHUNK_SIZE, width - x0);
+            int blockHeight = std::min(CHUNK_SIZE, height - z0);
             
-            cells[cellIndex(x, z)].height = h;
+            TerrainChunk& chunk = editChunk(chunkIndex % chunksX, chunkIndex / chunksX);
+            generator.generateBlock(x0, z0, blockWidth, blockHeight, chunk.heights, CHUNK_SIZE);
             
             // Set cell type based on height
-            if (h < -0.5f) {
-                cells[cellIndex(x, z)].type = CellType::WATER;
-            } else if (h > 1.5f) {
-                cells[cellIndex(x, z)].type = CellType::STONE;
-            } else if (h > 1.0f) {
-                cells[cellIndex(x, z)].type = CellType::DIRT;
-            } else {
-                cells[cellIndex(x, z)].type = CellType::GRASS;
+            for (int lz = 0; lz < blockHeight; lz++) {
+                for (int lx = 0; lx < blockWidth; lx++) {
+                    int idx = TerrainChunk::index(lx, lz);
+                    chunk.types[idx] = static_cast<uint8_t>(classifyHeight(chunk.heights[idx]));
+                }
             }
         }
-    }
+    });
     
     calculateTerrainNormals();
+    compactStorage();
+    flowerLayer.clearAll();
+    notifyTerrainReset();
 }
 
-void World::generateRandomFlowers(int count) {
-    for (int i = 0; i < count; i++) {
-        int x = rand() % width;
-        int z = rand() % height;
-        
-        if (getCellType(x, z) == CellType::GRASS) {
-            setCell(x, z, CellType::FLOWER);
+World::CellType World::classifyHeight(float height) {
+    if (height < -0.5f) {
+        return CellType::WATER;
+    } else if (height > 1.5f) {
+        return CellType::STONE;
+    } else if (height > 1.0f) {
+        return CellType::DIRT;
+    }
+    return CellType::GRASS;
+}
+
+void World::generateRandomFlowers(int count, uint32_t seed) {
+    if (count <= 0) return;
+    
+    int chunksX = (width + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    int chunksZ = (height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    int chunkCount = chunksX * chunksZ;
+    
+    // Each chunk picks its share of flowers from its own random stream.
+    // Positions are collected in parallel and applied afterwards, because
+    // neighbouring chunks share words of the flower bitboard.
+    std::vector<std::vector<GridPos>> planted(chunkCount);
+    uint64_t totalCells = static_cast<uint64_t>(width) * height;
+    
+    JobSystem::instance().parallelFor(0, chunkCount, 4, [&](int first, int last) {
+        for (int chunk = first; chunk < last; chunk++) {
+            int x0 = (chunk % chunksX) * CHUNK_SIZE;
+            int z0 = (chunk / chunksX) * CHUNK_SIZE;
+            int chunkWidth = std::min(CHUNK_SIZE, width - x0);
+            int chunkHeight = std::min(CHUNK_SIZE, height - z0);
+            
+            // Quota proportional to area; rounding the running total of cells
+            // in chunk order makes the quotas sum exactly to count
+            uint64_t cellsBefore = static_cast<uint64_t>(z0) * width +
+                                   static_cast<uint64_t>(chunkHeight) * x0;
+            uint64_t cellsAfter = cellsBefore + static_cast<uint64_t>(chunkWidth) * chunkHeight;
+            int quota = static_cast<int>(count * cellsAfter / totalCells - count * cellsBefore / totalCells);
+            
+            CounterRng rng(seed, static_cast<uint64_t>(chunk));
+            for (int i = 0; i < quota; i++) {
+                int x = x0 + rng.nextInt(chunkWidth);
+                int z = z0 + rng.nextInt(chunkHeight);
+                planted[chunk].push_back(GridPos(x, z));
+            }
+        }
+    });
+    
+    for (const auto& positions : planted) {
+        for (const GridPos& pos : positions) {
+            if (getCellType(pos.x, pos.z) == CellType::GRASS) {
+                setCell(pos.x, pos.z, CellType::FLOWER);
+            }
         }
     }
 }
 
 void World::addLight(const Light& light) {
     lights.push_back(light);
+    lightGridDirty.store(true);
 }
 
 void World::removeLight(size_t index) {
     if (index < lights.size()) {
         lights.erase(lights.begin() + index);
+        lightGridDirty.store(true);
     }
 }
 
-Color World::calculateLightingAt(const Vec3& position) const {
-    Color finalColor = Color::black();
-    
-    // Accumulate light from all sources
-    for (const auto& light : lights) {
-        float distance = light.position.distance(position);
-        
-        if (distance < light.radius) {
-            // Simple distance-based attenuation
-            float attenuation = 1.0f - (distance / light.radius);
-            attenuation = std::max(0.0f, std::min(1.0f, attenuation));
-            
-            Color contribution = light.color * (light.intensity * attenuation);
-            finalColor = finalColor + contribution;
+void World::moveLight(size_t index, const Vec3& position) {
+    if (index < lights.size()) {
+        lights[index].position = position;
+        lightGridDirty.store(true);
+    }
+}
+
+const std::vector<std::pair<int, Entity*>>& World::currentEntityCells() const {
+    if (entityCellsDirty.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lock(entityCellsMutex);
+        if (entityCellsDirty.load(std::memory_order_relaxed)) {
+            entityCells.clear();
+            for (Entity* entity : entities) {
+                if (!entity || !entity->isActive()) continue;
+                
+                // Boxes reaching past the world edge are listed in the border cells
+                Entity::BoundingBox box = entity->getBoundingBox();
+                int x0 = std::max(0, std::min(static_cast<int>(std::floor(box.min.x)), width - 1));
+                int z0 = std::max(0, std::min(static_cast<int>(std::floor(box.min.z)), height - 1));
+                int x1 = std::max(0, std::min(static_cast<int>(std::floor(box.max.x)), width - 1));
+                int z1 = std::max(0, std::min(static_cast<int>(std::floor(box.max.z)), height - 1));
+                for (int z = z0; z <= z1; z++) {
+                    for (int x = x0; x <= x1; x++) {
+                        entityCells.push_back(std::make_pair(cellIndex(x, z), entity));
+                    }
+                }
+            }
+            std::sort(entityCells.begin(), entityCells.end(),
+                      [](const std::pair<int, Entity*>& a, const std::pair<int, Entity*>& b) {
+                          return a.first < b.first;
+                      });
+            entityCellsDirty.store(false, std::memory_order_release);
         }
     }
+    return entityCells;
+}
+
+const LightGrid& World::currentLightGrid() const {
+    if (lightGridDirty.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lock(lightGridMutex);
+        if (lightGridDirty.load(std::memory_order_relaxed)) {
+            lightGrid.rebuild(lights);
+            lightGridDirty.store(false, std::memory_order_release);
+        }
+    }
+    return lightGrid;
+}
+
+Color World::calculateLightingAt(const Vec3& position) const {
+    // Only the lights reaching this position's cluster are visited
+    return currentLightGrid().shade(position);
+}
+
+void World::calculateCellLighting(std::vector<Color>& out) const {
+    const LightGrid& grid = currentLightGrid();
+    out.resize(static_cast<size_t>(width) * height);
     
-    // Ensure color components don't exceed 1.0
-    finalColor.r = std::min(1.0f, finalColor.r);
-    finalColor.g = std::min(1.0f, finalColor.g);
-    finalColor.b = std::min(1.0f, finalColor.b);
-    
-    return finalColor;
+    // Rows of cells run through the cluster lookups in order, so each
+    // cluster's light list is gathered once per row segment
+    JobSystem::instance().parallelFor(0, height, 4, [&](int first, int last) {
+        std::vector<Vec3> positions(width);
+        for (int z = first; z < last; z++) {
+            for (int x = 0; x < width; x++) {
+                positions[x] = gridToWorld(x, z);
+            }
+            grid.shadeBatch(positions.data(), &out[cellIndex(0, z)], positions.size());
+        }
+    });
+}
+
+size_t World::getTerrainMemoryUsage() const {
+    return chunks.capacity() * sizeof(ChunkSlot) +
+           static_cast<size_t>(getExpandedChunkCount()) * sizeof(TerrainChunk) +
+           cellEntities.size() * (sizeof(int) + sizeof(Entity*));
 }
 
 Vec3 World::gridToWorld(int x, int z) const {
@@ -373,6 +1126,140 @@ float World::getSlopeAngle(const Vec3& surfaceNormal) const {
     dotProduct = std::max(-1.0f, std::min(1.0f, dotProduct));
     
     // Return angle in degrees
-    float angleRad = std::acos(dotProduct);
+    float angleRad = MathUtils::fastAcos(dotProduct);
     return angleRad * RAD_TO_DEG;
 }
+
+bool World::raycast(const Vec3& origin, const Vec3& direction, float maxDistance, RaycastHit& hit,
+                    bool includeEntities) const {
+    hit = RaycastHit();
+    float directionLength = direction.length();
+    if (directionLength <= 0.0f || maxDistance <= 0.0f) return false;
+    Vec3 dir = direction / directionLength;
+    
+    // Entities are tested as the walk reaches the cells under them; the
+    // nearest box hit caps how far the walk goes
+    float tEnd = maxDistance;
+    const std::vector<std::pair<int, Entity*>>* index = includeEntities ? &currentEntityCells() : nullptr;
+    if (index && index->empty()) index = nullptr;
+    auto testEntities = [&](int cellX, int cellZ) {
+        auto range = std::equal_range(index->begin(), index->end(), std::make_pair(cellIndex(cellX, cellZ), nullptr),
+                                      [](const std::pair<int, Entity*>& a, const std::pair<int, Entity*>& b) {
+                                          return a.first < b.first;
+                                      });
+        for (auto it = range.first; it != range.second; ++it) {
+            Entity::BoundingBox box = it->second->getBoundingBox();
+            float entry;
+            int axis;
+            if (!intersectRayBox(origin, dir, box.min, box.max, tEnd, entry, axis) || (hit.entity && entry >= tEnd)) {
+                continue;
+            }
+            tEnd = entry;
+            hit.hit = true;
+            hit.entity = it->second;
+            hit.distance = entry;
+            hit.normal = Vec3::zero();
+            if (axis < 0) {
+                hit.normal = dir * -1.0f;
+            } else if (axis == 0) {
+                hit.normal.x = dir.x > 0.0f ? -1.0f : 1.0f;
+            } else if (axis == 1) {
+                hit.normal.y = dir.y > 0.0f ? -1.0f : 1.0f;
+            } else {
+                hit.normal.z = dir.z > 0.0f ? -1.0f : 1.0f;
+            }
+        }
+    };
+    
+    // Clip the ray to the world footprint
+    float tStart = 0.0f;
+    int enterAxis = -1;
+    if (!intersectRayBox(Vec3(origin.x, 0.0f, origin.z), Vec3(dir.x, 0.0f, dir.z),
+                         Vec3(0.0f, -1.0f, 0.0f), Vec3(static_cast<float>(width), 1.0f, static_cast<float>(height)),
+                         tEnd, tStart, enterAxis)) {
+        tStart = tEnd;
+    }
+    
+    if (tStart < tEnd) {
+        Vec3 start = origin + dir * tStart;
+        int cellX = std::max(0, std::min(static_cast<int>(std::floor(start.x)), width - 1));
+        int cellZ = std::max(0, std::min(static_cast<int>(std::floor(start.z)), height - 1));
+        
+        // Distance along the ray to the next cell boundary on each axis, and
+        // between successive boundaries
+        int stepX = dir.x > 0.0f ? 1 : -1;
+        int stepZ = dir.z > 0.0f ? 1 : -1;
+        float tDeltaX = dir.x != 0.0f ? std::abs(1.0f / dir.x) : INFINITY;
+        float tDeltaZ = dir.z != 0.0f ? std::abs(1.0f / dir.z) : INFINITY;
+        float tMaxX = dir.x != 0.0f ? (cellX + (stepX > 0 ? 1 : 0) - origin.x) / dir.x : INFINITY;
+        float tMaxZ = dir.z != 0.0f ? (cellZ + (stepZ > 0 ? 1 : 0) - origin.z) / dir.z : INFINITY;
+        
+        float tEnter = tStart;
+        int sideAxis = enterAxis;  // 0 for an X face, 2 for a Z face, -1 for none
+        while (tEnter < tEnd) {
+            if (index) testEntities(cellX, cellZ);
+            if (tEnter >= tEnd) break;
+            
+            float tExit = std::min(std::min(tMaxX, tMaxZ), tEnd);
+            float columnTop = heightAt(cellX, cellZ);
+            
+            float tHit = -1.0f;
+            bool side = false;
+            if (origin.y + dir.y * tEnter <= columnTop) {
+                // Entered the column through a side (or started inside it)
+                tHit = tEnter;
+                side = sideAxis >= 0;
+            } else if (dir.y < 0.0f) {
+                float tTop = (columnTop - origin.y) / dir.y;
+                if (tTop <= tExit) tHit = tTop;
+            }
+            
+            if (tHit >= 0.0f && tHit < tEnd) {
+                hit.hit = true;
+                hit.entity = nullptr;
+                hit.distance = tHit;
+                hit.cell = GridPos(cellX, cellZ);
+                if (side) {
+                    hit.normal = sideAxis == 0 ? Vec3(static_cast<float>(-stepX), 0.0f, 0.0f)
+                                               : Vec3(0.0f, 0.0f, static_cast<float>(-stepZ));
+                } else {
+                    hit.normal = MathUtils::unpackNormalOct(normalAt(cellX, cellZ));
+                }
+                break;
+            }
+            
+            // Step into the neighbour across the nearer boundary
+            if (tMaxX < tMaxZ) {
+                cellX += stepX;
+                tEnter = tMaxX;
+                tMaxX += tDeltaX;
+                sideAxis = 0;
+            } else {
+                cellZ += stepZ;
+                tEnter = tMaxZ;
+                tMaxZ += tDeltaZ;
+                sideAxis = 2;
+            }
+            if (!isValidPosition(cellX, cellZ)) break;
+        }
+    }
+    
+    if (hit.hit) {
+        hit.point = origin + dir * hit.distance;
+        if (hit.entity) {
+            hit.cell = worldToGrid(hit.point);
+        }
+    }
+    return hit.hit;
+}
+
+void World::raycastBatch(const Vec3* origins, const Vec3* directions, size_t count, float maxDistance,
+                         RaycastHit* hits, bool includeEntities) const {
+    // Rays are independent and only read the world, so they split freely;
+    // pending map chunks are decoded under decodeMutex
+    JobSystem::instance().parallelFor(0, static_cast<int>(count), 64, [&](int first, int last) {
+        for (int i = first; i < last; i++) {
+            raycast(origins[i], directions[i], maxDistance, hits[i], includeEntities);
+        }
+    });
+}
@@ -1,11 +1,23 @@
 #pragma once
 
 #include "entity.h"
+#include "flower_bitboard.h"
+#include "light_grid.h"
 #include "math_utils.h"
+#include "terrain_chunk.h"
+#include "terrain_generator.h"
+#include <algorithm>
+#include <atomic>
 #include <vector>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <utility>
+
+class MapFile;
+class WorldListener;
 
 // World class manages the game world, entities, and custom prefabricated maps
 // Provides support for terrain, slopes, and entity management
@@ -17,12 +29,19 @@ public:
     // World update
     void update(float deltaTime);
     
+    // Side length of the square chunks used for storage and generation streams
+    static const int CHUNK_SIZE = TerrainChunk::SIZE;
+    
     // World dimensions
     int getWidth() const { return width; }
     int getHeight() const { return height; }
     
+    // Change the dimensions and reset the terrain to flat grass. Entities
+    // and lights stay where they are but are detached from their cells.
+    void resize(int width, int height);
+    
     // Terrain and cell management
-    enum class CellType {
+    enum class CellType : uint8_t {
         GRASS,
         DIRT,
         FLOWER,
@@ -30,12 +49,16 @@ public:
         STONE,
         SAND
     };
+    static const int CELL_TYPE_COUNT = static_cast<int>(CellType::SAND) + 1;
     
+    // Decoded copy of a single cell. Terrain is stored in chunks of separate
+    // planes (type, height, packed normal) plus a sparse entity map, so this
+    // is assembled on request rather than living in memory.
     struct TerrainCell {
         CellType type;
         float height;        // Height of terrain at this cell
         Vec3 normal;         // Surface normal for slopes
-        Color color;         // Visual color
+        Color color;         // Visual color (derived from type)
         Entity* entity;      // Entity placed at this cell (can be null)
         
         TerrainCell() 
@@ -47,23 +70,65 @@ public:
         {}
     };
     
+    // Read-only handle returned by getCell. It tests and dereferences like
+    // the TerrainCell pointer it replaces; writes go through the setters.
+    class CellRef {
+    public:
+        CellRef() : valid(false) {}
+        explicit CellRef(const TerrainCell& cell) : cell(cell), valid(true) {}
+        
+        explicit operator bool() const { return valid; }
+        const TerrainCell* operator->() const { return &cell; }
+        const TerrainCell& operator*() const { return cell; }
+        
+    private:
+        TerrainCell cell;
+        bool valid;
+    };
+    
     void setCell(int x, int z, CellType type);
     CellType getCellType(int x, int z) const;
-    TerrainCell* getCell(int x, int z);
-    const TerrainCell* getCell(int x, int z) const;
+    CellRef getCell(int x, int z) const;
+    static Color getCellTypeColor(CellType type);
+    
+    // Flowers vary in species by position so gardens are colourful without
+    // storing anything per flower
+    static const int FLOWER_SPECIES_COUNT = 6;
+    static int getFlowerSpecies(int x, int z);
+    static Color getFlowerSpeciesColor(int species);
     bool isValidPosition(int x, int z) const;
     
-    // Terrain height and normal queries for slope support
+    // Visit every cell of the given type as fn(x, z). Collapsed chunks of any
+    // other type are skipped without touching their cells.
+    template <typename Fn>
+    void forEachCellOfType(CellType type, Fn&& fn) const;
+    
+    // Terrain height and normal queries for slope support.
+    // The world-space overloads interpolate bilinearly between the four
+    // nearest cell centres, so movement over slopes is continuous.
     float getTerrainHeight(int x, int z) const;
     float getTerrainHeight(const Vec3& worldPos) const;
     Vec3 getTerrainNormal(int x, int z) const;
     Vec3 getTerrainNormal(const Vec3& worldPos) const;
     void setTerrainHeight(int x, int z, float height);
     
+    // Batched versions of the world-space queries over arrays of X and Z
+    // coordinates, for physics and foliage placement that sample thousands
+    // of points per tick. Results match the single-point queries.
+    void sampleTerrainHeights(const float* xs, const float* zs, float* outHeights, size_t count) const;
+    void sampleTerrainNormals(const float* xs, const float* zs, Vec3* outNormals, size_t count) const;
+    
     // Calculate surface normal from surrounding heights (for slopes)
     void calculateTerrainNormals();
     void calculateCellNormal(int x, int z);
     
+    // Height edits mark a dirty rectangle instead of recomputing normals
+    // immediately. flushTerrainNormals() rebuilds only that rectangle plus a
+    // one-cell border, and runs at the start of every update().
+    void markTerrainDirty(int minX, int minZ, int maxX, int maxZ);
+    void flushTerrainNormals();
+    bool hasDirtyTerrain() const { return dirtyMinX <= dirtyMaxX && dirtyMinZ <= dirtyMaxZ; }
+    
     // Entity management
     void addEntity(Entity* entity);
     void removeEntity(Entity* entity);
@@ -71,6 +136,23 @@ public:
     const std::vector<Entity*>& getEntities() const { return entities; }
     Entity* getEntityAt(const Vec3& position, float radius = 1.0f);
     
+    // Ray queries find entities through the cells under them. update()
+    // refreshes that index; call this after moving entities elsewhere.
+    void markEntitiesMoved() { entityCellsDirty.store(true); }
+    
+    // Entities attached to a specific cell (e.g. a planted flower)
+    void setCellEntity(int x, int z, Entity* entity);
+    Entity* getCellEntity(int x, int z) const;
+    
+    // Change notifications for caches and persistence. Listeners are not
+    // owned and must be removed before they are destroyed.
+    void addListener(WorldListener* listener);
+    void removeListener(WorldListener* listener);
+    
+    // Flower occupancy mirrored as a bitboard for pattern queries
+    const FlowerBitboard& getFlowerLayer() const { return flowerLayer; }
+    void rebuildFlowerLayer();
+    
     // Prefabricated map loading
     struct MapData {
         std::string name;
@@ -83,33 +165,70 @@ public:
         std::vector<std::string> entityTypes;
     };
     
+    // Prefabricated maps live in memory; use saveMapFile/loadMapFile to persist them
     bool loadPrefabricatedMap(const std::string& mapName);
     void savePrefabricatedMap(const std::string& mapName);
     MapData* createCustomMap(const std::string& name, const std::string& description);
     
-    // World generation
+    // Binary map files (see MapFile). Loading maps the file into memory and
+    // decodes each chunk on first access, so opening a large map is nearly
+    // instant. The file must match the world's dimensions.
+    bool saveMapFile(const std::string& path) const;
+    bool loadMapFile(const std::string& path);
+    
+    // Replace the terrain with a copy of another world's of the same size.
+    // Entities, lights and listeners are left alone; listeners get a reset.
+    void copyTerrain(const World& source);
+    
+    // World generation. Terrain and flowers are generated per chunk on the
+    // job system and are reproducible for a given seed regardless of how
+    // many threads take part.
     void generateFlatTerrain();
     void generateHillyTerrain(float amplitude = 2.0f, float frequency = 0.1f);
-    void generateRandomFlowers(int count);
-    
-    // Lighting support (for future versions)
-    struct Light {
-        Vec3 position;
-        Color color;
-        float intensity;
-        float radius;
-        
-        Light() : position(Vec3::zero()), color(Color::white()), intensity(1.0f), radius(10.0f) {}
-        Light(const Vec3& pos, const Color& col, float intensity, float radius)
-            : position(pos), color(col), intensity(intensity), radius(radius) {}
-    };
+    void generateFractalTerrain(const TerrainGenerator::Settings& settings);
+    void generateRandomFlowers(int count, uint32_t seed = 1);
+    
+    // Terrain type for a generated height (water in hollows, stone on peaks)
+    static CellType classifyHeight(float height);
+    
+    // Point lights. Queries go through a LightGrid that is rebuilt on the
+    // first query after the lights change, so lights are only changed
+    // through addLight, removeLight and moveLight.
+    typedef PointLight Light;
     
     void addLight(const Light& light);
     void removeLight(size_t index);
-    std::vector<Light>& getLights() { return lights; }
+    void moveLight(size_t index, const Vec3& position);
     const std::vector<Light>& getLights() const { return lights; }
     Color calculateLightingAt(const Vec3& position) const;
     
+    // Lighting at the top centre of every cell (gridToWorld), row-major with
+    // z * width + x, evaluated on the job system
+    void calculateCellLighting(std::vector<Color>& out) const;
+    
+    // Bytes held by the terrain planes (excluding entities and lights)
+    size_t getTerrainMemoryUsage() const;
+    
+    // Terrain lives in a table of CHUNK_SIZE chunks. A chunk whose cells all
+    // share one type, height and normal is stored as that single value and
+    // only gets its planes on the first edit that breaks the uniformity.
+    // compactStorage() collapses chunks that have become uniform again.
+    void compactStorage();
+    int getChunkCount() const { return static_cast<int>(chunks.size()); }
+    int getExpandedChunkCount() const;
+    
+    // Chunk paging, for terrain streamed in from elsewhere (StreamingWorld).
+    // pageInChunk replaces a chunk's terrain; pageOutChunk hands the terrain
+    // back, its dirty flag set if setCell or setTerrainHeight changed it,
+    // and leaves flat grass behind. Listeners get onTerrainRegionChanged.
+    // Reads of paged-out chunks see the flat grass.
+    void pageInChunk(int chunkX, int chunkZ, std::unique_ptr<TerrainChunk> chunk);
+    std::unique_ptr<TerrainChunk> pageOutChunk(int chunkX, int chunkZ);
+    
+    // A copy of an edited chunk's terrain, clearing its dirty flag; null
+    // when the chunk is unchanged since it was paged in or last copied
+    std::unique_ptr<TerrainChunk> copyDirtyChunk(int chunkX, int chunkZ);
+    
     // Grid to world coordinate conversion
     Vec3 gridToWorld(int x, int z) const;
     GridPos worldToGrid(const Vec3& worldPos) const;
@@ -118,19 +237,184 @@ public:
     Vec3 projectVelocityOntoSurface(const Vec3& velocity, const Vec3& surfaceNormal) const;
     Vec3 getSlopeDirection(const Vec3& surfaceNormal) const;
     float getSlopeAngle(const Vec3& surfaceNormal) const;
+    
+    // Ray queries. Each cell is a solid column reaching up to its terrain
+    // height; entities are hit through their bounding boxes.
+    struct RaycastHit {
+        bool hit;
+        GridPos cell;        // Cell that was hit, or the cell under the entity hit
+        Vec3 point;
+        Vec3 normal;         // Terrain normal for column tops, face normal for sides
+        float distance;
+        Entity* entity;      // Entity hit before the terrain, otherwise null
+        
+        RaycastHit()
+            : hit(false)
+            , point(Vec3::zero())
+            , normal(Vec3::up())
+            , distance(0.0f)
+            , entity(nullptr)
+        {}
+    };
+    
+    // Walks the cells under the ray (Amanatides-Woo) until it meets a column
+    // or an entity listed in one of the cells, so the cost grows with the
+    // distance travelled rather than the world size or entity count. Only
+    // entities over the world are found. Line-of-sight checks can skip the
+    // entity test.
+    bool raycast(const Vec3& origin, const Vec3& direction, float maxDistance, RaycastHit& hit,
+                 bool includeEntities = true) const;
+    
+    // Casts count rays on the job system; hits[i] answers ray i
+    void raycastBatch(const Vec3* origins, const Vec3* directions, size_t count, float maxDistance,
+                      RaycastHit* hits, bool includeEntities = true) const;
 
 private:
     int width;
     int height;
-    std::vector<TerrainCell> cells;
+    
+    // One entry of the chunk table. Normals are octahedral-packed, see
+    // MathUtils::packNormalOct.
+    struct ChunkSlot {
+        std::unique_ptr<TerrainChunk> data;  // Null while the chunk is uniform
+        float uniformHeight;
+        uint16_t uniformNormal;
+        uint8_t uniformType;
+    };
+    
+    int chunksX;
+    int chunksZ;
+    // Row-major (index = cz * chunksX + cx). Slots still pending in mapFile
+    // are filled through const reads, so they are written only by
+    // decodeChunk under decodeMutex and published by its release store to
+    // pendingChunks; readers check that flag with acquire before touching
+    // the slot. Everything else writes chunks from the owning thread only.
+    mutable std::vector<ChunkSlot> chunks;
+    std::unordered_map<int, Entity*> cellEntities;   // Sparse: most cells hold no entity
+    
     std::vector<Entity*> entities;
+    mutable std::vector<std::pair<int, Entity*>> entityCells;   // (cell index, entity) for every cell under each box, by cell
+    mutable std::atomic<bool> entityCellsDirty;
+    mutable std::mutex entityCellsMutex;
     std::vector<Light> lights;
+    mutable LightGrid lightGrid;
+    mutable std::atomic<bool> lightGridDirty;
+    mutable std::mutex lightGridMutex;
+    std::vector<WorldListener*> listeners;
+    FlowerBitboard flowerLayer;
+    
+    // Pending normal recomputation (inclusive bounds, empty when min > max)
+    int dirtyMinX;
+    int dirtyMinZ;
+    int dirtyMaxX;
+    int dirtyMaxZ;
     
     // Prefabricated maps storage
     std::map<std::string, MapData> prefabricatedMaps;
     
+    // Map file backing chunks that have not been decoded yet
+    std::unique_ptr<MapFile> mapFile;
+    std::unique_ptr<std::atomic<bool>[]> pendingChunks;  // Null when nothing is pending
+    mutable std::mutex decodeMutex;
+    
     // Helper for array indexing
     int cellIndex(int x, int z) const {
         return z * width + x;
     }
+    
+    // Chunk storage access, decoding chunks still pending in the map file
+    const ChunkSlot& chunkSlot(int index) const {
+        if (pendingChunks && pendingChunks[index].load(std::memory_order_acquire)) {
+            decodeChunk(index);
+        }
+        return chunks[index];
+    }
+    const ChunkSlot& slotAt(int x, int z) const {
+        return chunkSlot((z / CHUNK_SIZE) * chunksX + x / CHUNK_SIZE);
+    }
+    static int localIndex(int x, int z) {
+        return TerrainChunk::index(x % CHUNK_SIZE, z % CHUNK_SIZE);
+    }
+    uint8_t typeAt(int x, int z) const {
+        const ChunkSlot& slot = slotAt(x, z);
+        return slot.data ? slot.data->types[localIndex(x, z)] : slot.uniformType;
+    }
+    float heightAt(int x, int z) const {
+        const ChunkSlot& slot = slotAt(x, z);
+        return slot.data ? slot.data->heights[localIndex(x, z)] : slot.uniformHeight;
+    }
+    uint16_t normalAt(int x, int z) const {
+        const ChunkSlot& slot = slotAt(x, z);
+        return slot.data ? slot.data->normals[localIndex(x, z)] : slot.uniformNormal;
+    }
+    
+    // Expands a collapsed chunk before its first write (copy-on-write)
+    TerrainChunk& editChunk(int chunkX, int chunkZ);
+    void resetChunks(CellType type, float height);
+    
+    void notifyTerrainReset();
+    void notifyChunkReplaced(int chunkX, int chunkZ);
+    
+    // Lazy map file decoding
+    void decodeChunk(int index) const;
+    bool chunkMayContain(int index, uint8_t type) const;
+    void releaseMapFile();
+    
+    bool isFlatNeighbourhood(int chunkX, int chunkZ) const;
+    
+    // The light grid, rebuilt first if the lights changed since the last query
+    const LightGrid& currentLightGrid() const;
+    
+    // The entity cell index, rebuilt first if entities were added, removed or moved
+    const std::vector<std::pair<int, Entity*>>& currentEntityCells() const;
+    
+    // Copies heights of cells [x0, x1] in row z into out
+    void copyHeightRow(int z, int x0, int x1, float* out) const;
+    
+    // Corner cells and weights for bilinear sampling at a world position
+    struct BilinearSample {
+        int x0, x1, z0, z1;
+        float tx, tz;
+        bool inside;
+    };
+    BilinearSample bilinearSetup(float worldX, float worldZ) const;
+    Vec3 blendNormals(const BilinearSample& sample) const;
 };
+
+// Receives World edits as they happen. Single-cell edits report the new
+// value; bulk operations (generation, map loading) report a reset instead,
+// and chunk paging reports the cells (inclusive bounds) it replaced.
+class WorldListener {
+public:
+    virtual ~WorldListener() {}
+    
+    virtual void onCellChanged(int /*x*/, int /*z*/, World::CellType /*type*/) {}
+    virtual void onTerrainHeightChanged(int /*x*/, int /*z*/, float /*height*/) {}
+    virtual void onCellEntityChanged(int /*x*/, int /*z*/, Entity* /*entity*/) {}
+    virtual void onTerrainReset() {}
+    virtual void onTerrainRegionChanged(int /*minX*/, int /*minZ*/, int /*maxX*/, int /*maxZ*/) {}
+};
+
+template <typename Fn>
+void World::forEachCellOfType(CellType type, Fn&& fn) const {
+    uint8_t wanted = static_cast<uint8_t>(type);
+    for (int cz = 0; cz < chunksZ; cz++) {
+        for (int cx = 0; cx < chunksX; cx++) {
+            int index = cz * chunksX + cx;
+            if (!chunkMayContain(index, wanted)) continue;
+            
+            const ChunkSlot& slot = chunkSlot(index);
+            int x0 = cx * CHUNK_SIZE;
+            int z0 = cz * CHUNK_SIZE;
+            int x1 = std::min(x0 + CHUNK_SIZE, width);
+            int z1 = std::min(z0 + CHUNK_SIZE, height);
+            for (int z = z0; z < z1; z++) {
+                for (int x = x0; x < x1; x++) {
+                    if (!slot.data || slot.data->types[localIndex(x, z)] == wanted) {
+                        fn(x, z);
+                    }
+                }
+            }
+        }
+    }
+}